@@ -2,17 +2,19 @@
 
 // QCodeEditor
 #include <QStyleSyntaxHighlighter> // Required for inheritance
-#include <QHighlightRule>
 
 // Qt
 #include <QRegularExpression>
-#include <QVector>
+#include <QHash>
+#include <QString>
 
 class QSyntaxStyle;
 
 /**
- * @brief Class, that describes C++ code
- * highlighter.
+ * @brief Class, that describes LispBM code
+ * highlighter. Each block is classified in a
+ * single scan, with keywords looked up in a
+ * hash table.
  */
 class LispHighlighter : public QStyleSyntaxHighlighter
 {
@@ -29,9 +31,21 @@ protected:
     void highlightBlock(const QString& text) override;
 
 private:
-    QVector<QHighlightRule> m_highlightRules;
-    QVector<QHighlightRule> m_highlightRulesLang;
+    /**
+     * @brief Method for checking if character can
+     * be part of a symbol.
+     */
+    static bool isSymbolChar(QChar c);
+
+    /**
+     * @brief Method for getting the end of the number
+     * that starts at pos, or pos if there is none.
+     */
+    int numberEnd(const QString& text, int pos) const;
+
+    // Keyword with '-' replaced by '_' -> format name
+    QHash<QString, QString> m_keywords;
+    QRegularExpression m_numberRegex;
     QRegularExpression m_keyRegex;
 
 };
-
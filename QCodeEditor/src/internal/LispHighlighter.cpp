@@ -9,8 +9,9 @@
 
 LispHighlighter::LispHighlighter(QTextDocument* document) :
     QStyleSyntaxHighlighter(document),
-    m_highlightRules(),
-    m_highlightRulesLang(),
+    m_keywords(),
+    m_numberRegex(R"(^(?:(?:(?:(?:(?:\d+(?:'\d+)*)?\.(?:\d+(?:'\d+)*)(?:e[+-]?(?:\d+(?:'\d+)*))?)|(?:(?:\d+(?:'\d+)*)\.(?:e[+-]?(?:\d+(?:'\d+)*))?)|(?:(?:\d+(?:'\d+)*)(?:e[+-]?(?:\d+(?:'\d+)*)))|(?:0x(?:[0-9a-f]+(?:'[0-9a-f]+)*)?\.(?:[0-9a-f]+(?:'[0-9a-f]+)*)(?:p[+-]?(?:\d+(?:'\d+)*)))|(?:0x(?:[0-9a-f]+(?:'[0-9a-f]+)*)\.?(?:p[+-]?(?:\d+(?:'\d+)*))))[lf]?)|(?:(?:(?:[1-9]\d*(?:'\d+)*)|(?:0[0-7]*(?:'[0-7]+)*)|(?:0x[0-9a-f]+(?:'[0-9a-f]+)*)|(?:0b[01]+(?:'[01]+)*))(?:u?l{0,2}|l{0,2}u?)))$)",
+                  QRegularExpression::CaseInsensitiveOption),
     m_keyRegex(R"(("[^\r\n:]+?")\s*:)")
 {
     Q_INIT_RESOURCE(qcodeeditor_resources);
@@ -34,63 +35,125 @@ LispHighlighter::LispHighlighter(QTextDocument* document) :
         auto names = language.names(key);
         for (auto&& name : names)
         {
-            m_highlightRulesLang.append({
-                QRegularExpression(QString(R"(\b%1\b)").arg(name.replace("-", "_"))),
-                key
-            });
+            m_keywords.insert(name.replace("-", "_"), key);
         }
     }
 
-    // Numbers
-    m_highlightRules.append({
-        QRegularExpression(R"((?<=\b|\s|^)(?i)(?:(?:(?:(?:(?:\d+(?:'\d+)*)?\.(?:\d+(?:'\d+)*)(?:e[+-]?(?:\d+(?:'\d+)*))?)|(?:(?:\d+(?:'\d+)*)\.(?:e[+-]?(?:\d+(?:'\d+)*))?)|(?:(?:\d+(?:'\d+)*)(?:e[+-]?(?:\d+(?:'\d+)*)))|(?:0x(?:[0-9a-f]+(?:'[0-9a-f]+)*)?\.(?:[0-9a-f]+(?:'[0-9a-f]+)*)(?:p[+-]?(?:\d+(?:'\d+)*)))|(?:0x(?:[0-9a-f]+(?:'[0-9a-f]+)*)\.?(?:p[+-]?(?:\d+(?:'\d+)*))))[lf]?)|(?:(?:(?:[1-9]\d*(?:'\d+)*)|(?:0[0-7]*(?:'[0-7]+)*)|(?:0x[0-9a-f]+(?:'[0-9a-f]+)*)|(?:0b[01]+(?:'[01]+)*))(?:u?l{0,2}|l{0,2}u?)))(?=\b|\s|$))"),
-        "Number"
-    });
-
-    // Strings
-    m_highlightRules.append({
-        QRegularExpression(R"("[^\n"]*")"),
-        "String"
-    });
-
-    // Single line
-    m_highlightRules.append({
-        QRegularExpression(R"(;[^\n]*)"),
-        "Comment"
-    });
+    m_numberRegex.optimize();
 }
 
-void LispHighlighter::highlightBlock(const QString& text)
+bool LispHighlighter::isSymbolChar(QChar c)
 {
-    for (auto&& rule : m_highlightRulesLang) {
-        auto matchIterator = rule.pattern.globalMatch(QString(text).replace("-", "_").replace("#", "_"));
+    return c.isLetterOrNumber() || c == '_' || c == '-' || c == '#' || c == '@';
+}
 
-        while (matchIterator.hasNext()) {
-            auto match = matchIterator.next();
+int LispHighlighter::numberEnd(const QString& text, int pos) const
+{
+    int start = pos;
+    int len = text.size();
+
+    if (text[pos] == '-' || text[pos] == '+') {
+        start++;
+    }
 
-            setFormat(
-                match.capturedStart(),
-                match.capturedLength(),
-                syntaxStyle()->getFormat(rule.formatName)
-            );
+    if (start >= len) {
+        return pos;
+    }
+
+    bool startsNumber = text[start].isDigit() ||
+            (text[start] == '.' && (start + 1) < len && text[start + 1].isDigit());
+
+    if (!startsNumber) {
+        return pos;
+    }
+
+    int end = start;
+    while (end < len) {
+        QChar c = text[end];
+
+        if (c.isLetterOrNumber() || c == '_' || c == '.' || c == '\'') {
+            end++;
+        } else if ((c == '-' || c == '+') && end > start) {
+            // Exponent sign
+            QChar prev = text[end - 1].toLower();
+            if (prev != 'e' && prev != 'p') {
+                break;
+            }
+            end++;
+        } else {
+            break;
         }
     }
 
-    for (auto&& rule : m_highlightRules) {
-        auto matchIterator = rule.pattern.globalMatch(text);
+    if (!m_numberRegex.match(text.midRef(start, end - start)).hasMatch()) {
+        return pos;
+    }
+
+    return end;
+}
+
+void LispHighlighter::highlightBlock(const QString& text)
+{
+    int len = text.size();
+    int pos = 0;
 
-        while (matchIterator.hasNext()) {
-            auto match = matchIterator.next();
+    while (pos < len) {
+        QChar c = text[pos];
 
-            setFormat(
-                match.capturedStart(),
-                match.capturedLength(),
-                syntaxStyle()->getFormat(rule.formatName)
-            );
+        if (c == ';') {
+            setFormat(pos, len - pos, syntaxStyle()->getFormat("Comment"));
+            break;
         }
+
+        if (c == '"') {
+            int end = text.indexOf('"', pos + 1);
+            if (end >= 0) {
+                setFormat(pos, end - pos + 1, syntaxStyle()->getFormat("String"));
+                pos = end + 1;
+            } else {
+                pos++;
+            }
+            continue;
+        }
+
+        if (!isSymbolChar(c) && c != '.' && c != '+') {
+            pos++;
+            continue;
+        }
+
+        int end = numberEnd(text, pos);
+        if (end > pos) {
+            setFormat(pos, end - pos, syntaxStyle()->getFormat("Number"));
+            pos = end;
+            continue;
+        }
+
+        if (!isSymbolChar(c)) {
+            pos++;
+            continue;
+        }
+
+        end = pos + 1;
+        while (end < len && isSymbolChar(text[end])) {
+            end++;
+        }
+
+        QString symbol = text.mid(pos, end - pos);
+        symbol.replace('-', '_');
+
+        auto it = m_keywords.constFind(symbol);
+        if (it != m_keywords.constEnd()) {
+            setFormat(pos, end - pos, syntaxStyle()->getFormat(it.value()));
+        }
+
+        pos = end;
     }
 
     // Special treatment for key regex
+    if (!text.contains('"')) {
+        return;
+    }
+
     auto matchIterator = m_keyRegex.globalMatch(text);
 
     while (matchIterator.hasNext()) {
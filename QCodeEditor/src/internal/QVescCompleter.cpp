@@ -70,9 +70,11 @@ QVescCompleter::QVescCompleter(QObject *parent) :
         addItem("getAppConfDefault()");
         addItem("setAppConf()");
         addItem("setAppConfNoStore()");
+        addItem("setAppConfDelta()");
         addItem("getMcconf()");
         addItem("getMcconfDefault()");
         addItem("setMcconf(check)");
+        addItem("setMcconfDelta(store)");
         addItem("forwardCanFrame(data, id, isExt)");
         addItem("pswGetStatus(by_id, id_ind)");
         addItem("pswSwitch(id, is_on, plot)");
@@ -36,6 +36,26 @@ BleUart::BleUart(QObject *parent) : QObject(parent)
     mServiceUuid = "6e400001-b5a3-f393-e0a9-e50e24dcca9e";
     mRxUuid = "6e400002-b5a3-f393-e0a9-e50e24dcca9e";
     mTxUuid = "6e400003-b5a3-f393-e0a9-e50e24dcca9e";
+
+    // 23 bytes is the default ATT MTU, which leaves 20 bytes per write until
+    // a larger MTU has been negotiated.
+    mMtu = 23;
+    mConnIntervalMs = 15.0;
+    mTxQueueMax = 65536;
+    mTxWindowBytes = 2048;
+    mSimWritesPerEvent = 4;
+    mSimulatedGatt = false;
+    mTxAwaitingAck = false;
+    mTxOverflowReported = false;
+    mTxBytesWindow = 0;
+    mTxBytesPerSec = 0.0;
+
+    mTxTimer.setSingleShot(true);
+    connect(&mTxTimer, SIGNAL(timeout()), this, SLOT(txTimerSlot()));
+    mTxAckTimer.setSingleShot(true);
+    connect(&mTxAckTimer, SIGNAL(timeout()), this, SLOT(txAckTimeout()));
+    mTxStatsTimer.setInterval(1000);
+    connect(&mTxStatsTimer, SIGNAL(timeout()), this, SLOT(txStatsTimerSlot()));
 }
 
 BleUart::~BleUart() {
@@ -67,6 +87,7 @@ void BleUart::startConnect(QString addr)
 
     mUartServiceFound = false;
     mConnectDone = false;
+    mMtu = 23;
 
 #if defined(Q_OS_MACOS) || defined(Q_OS_IOS)
     // Create BT Controller from unique device UUID stored as addr. Creating
@@ -96,6 +117,9 @@ void BleUart::startConnect(QString addr)
             this, SLOT(controlStateChanged(QLowEnergyController::ControllerState)));
     connect(mControl, SIGNAL(connectionUpdated(QLowEnergyConnectionParameters)),
             this, SLOT(connectionUpdated(QLowEnergyConnectionParameters)));
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    connect(mControl, SIGNAL(mtuChanged(int)), this, SLOT(mtuUpdated(int)));
+#endif
 
     mControl->connectToDevice();
     mConnectTimeoutTimer.start(10000);
@@ -104,6 +128,8 @@ void BleUart::startConnect(QString addr)
 void BleUart::disconnectBle()
 {
     init();
+    resetTxQueue();
+
     if (mService) {
         mService->deleteLater();
         mService = nullptr;
@@ -133,21 +159,68 @@ void BleUart::emitScanDone()
 
 void BleUart::writeData(QByteArray data)
 {
-    if (isConnected()) {
-        const QLowEnergyCharacteristic  rxChar = mService->characteristic(QBluetoothUuid(QUuid(mRxUuid)));
-        if (rxChar.isValid()) {
-            int chunk = 20;
-            while(data.size() > chunk) {
-                mService->writeCharacteristic(rxChar, data.mid(0, chunk),
-                                              QLowEnergyService::WriteWithoutResponse);
-                data.remove(0, chunk);
-            }
+    if (!isConnected() && !mSimulatedGatt) {
+        return;
+    }
 
-            mService->writeCharacteristic(rxChar, data, QLowEnergyService::WriteWithoutResponse);
-        }
+    mTxQueue.append(data);
+
+    // Dropping part of the stream would corrupt the packets around it, so
+    // the data is kept and the stalled link is reported instead.
+    if (mTxQueue.size() > mTxQueueMax && !mTxOverflowReported) {
+        mTxOverflowReported = true;
+        qWarning() << "BLE TX queue overflow:" << mTxQueue.size() << "bytes pending";
+        emit bleError(tr("BLE TX queue overflow, %1 bytes are waiting to be sent. "
+                         "The connection is not keeping up.").arg(mTxQueue.size()));
+    }
+
+    // Defer the first write to the next event loop iteration, so that packets
+    // that are sent back-to-back get coalesced into full-size writes.
+    if (!mTxAwaitingAck && !mTxTimer.isActive()) {
+        mTxTimer.start(0);
     }
 }
 
+int BleUart::getMtu()
+{
+    return mMtu;
+}
+
+int BleUart::getTxChunkSize()
+{
+    // ATT write header is 3 bytes and the attribute value is limited to 512 bytes
+    return qBound(20, mMtu - 3, 512);
+}
+
+int BleUart::getTxQueueDepth()
+{
+    return mTxQueue.size();
+}
+
+double BleUart::getTxBytesPerSec()
+{
+    return mTxBytesPerSec;
+}
+
+void BleUart::setSimulatedGatt(bool enabled, int mtu, double connIntervalMs)
+{
+    resetTxQueue();
+    mSimulatedGatt = enabled;
+
+    if (enabled) {
+        mMtu = mtu;
+        mConnIntervalMs = connIntervalMs;
+    } else {
+        mMtu = 23;
+        mConnIntervalMs = 15.0;
+    }
+}
+
+bool BleUart::isSimulatedGatt()
+{
+    return mSimulatedGatt;
+}
+
 void BleUart::addDevice(const QBluetoothDeviceInfo &dev)
 {
     if ((dev.coreConfigurations() & QBluetoothDeviceInfo::LowEnergyCoreConfiguration)) {
@@ -246,6 +319,8 @@ void BleUart::serviceScanDone()
                 this, SLOT(updateData(QLowEnergyCharacteristic,QByteArray)));
         connect(mService, SIGNAL(descriptorWritten(QLowEnergyDescriptor,QByteArray)),
                 this, SLOT(confirmedDescriptorWrite(QLowEnergyDescriptor,QByteArray)));
+        connect(mService, SIGNAL(characteristicWritten(QLowEnergyCharacteristic,QByteArray)),
+                this, SLOT(confirmedCharacteristicWrite(QLowEnergyCharacteristic,QByteArray)));
 
         mService->discoverDetails();
     } else {
@@ -322,6 +397,11 @@ void BleUart::serviceStateChanged(QLowEnergyService::ServiceState s)
 
 void BleUart::serviceError(QLowEnergyService::ServiceError e){
     qDebug() << e;
+
+    // A failed acknowledged write still ends the burst
+    if (e == QLowEnergyService::CharacteristicWriteError && mTxAwaitingAck) {
+        txBurstDone();
+    }
 }
 
 void BleUart::updateData(const QLowEnergyCharacteristic &c, const QByteArray &value)
@@ -339,10 +419,21 @@ void BleUart::confirmedDescriptorWrite(const QLowEnergyDescriptor &d, const QByt
     } else {
         mConnectDone = true;
         mConnectTimeoutTimer.stop();
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        mMtu = mControl->mtu();
+#endif
         emit connected();
     }
 }
 
+void BleUart::confirmedCharacteristicWrite(const QLowEnergyCharacteristic &c, const QByteArray &value)
+{
+    (void)value;
+    if (mTxAwaitingAck && c.uuid() == QBluetoothUuid(QUuid(mRxUuid))) {
+        txBurstDone();
+    }
+}
+
 void BleUart::controlStateChanged(QLowEnergyController::ControllerState state)
 {
     (void)state;
@@ -360,8 +451,115 @@ void BleUart::controlStateChanged(QLowEnergyController::ControllerState state)
 
 void BleUart::connectionUpdated(const QLowEnergyConnectionParameters &newParameters)
 {
-    (void)newParameters;
-    qDebug() << "BLE connection parameters updated";
+    if (newParameters.maximumInterval() > 0.0) {
+        mConnIntervalMs = newParameters.maximumInterval();
+    }
+
+    qDebug() << "BLE connection parameters updated. Interval:" << mConnIntervalMs << "ms";
+}
+
+void BleUart::mtuUpdated(int mtu)
+{
+    mMtu = mtu;
+    qDebug() << "BLE MTU updated:" << mtu << "Chunk size:" << getTxChunkSize();
+}
+
+/**
+ * @brief BleUart::txTimerSlot
+ * Send up to mTxWindowBytes from the queue. The last write of the burst is
+ * acknowledged by the peripheral, and as writes are processed in order the
+ * next burst is sent when that acknowledgement arrives. The rate thus
+ * follows what the link and the peripheral actually accept.
+ */
+void BleUart::txTimerSlot()
+{
+    if (mTxAwaitingAck) {
+        return;
+    }
+
+    if (!mTxStatsTimer.isActive()) {
+        mTxRateTimer.start();
+        mTxStatsTimer.start();
+    }
+
+    int chunk = getTxChunkSize();
+    int burst = qMin(mTxQueue.size(), mTxWindowBytes);
+
+    if (mSimulatedGatt) {
+        // The simulated peripheral accepts mSimWritesPerEvent writes per
+        // connection event and acknowledges the burst after the last one.
+        int writes = (burst + chunk - 1) / chunk;
+        int events = qMax(1, (writes + mSimWritesPerEvent - 1) / mSimWritesPerEvent);
+        mTxBytesWindow += burst;
+        mTxQueue.remove(0, burst);
+        mTxAwaitingAck = true;
+        mTxAckTimer.start(qMax(1, int(double(events) * mConnIntervalMs)));
+    } else if (isConnected()) {
+        const QLowEnergyCharacteristic  rxChar = mService->characteristic(QBluetoothUuid(QUuid(mRxUuid)));
+        if (rxChar.isValid()) {
+            // Without acknowledged writes there is no feedback, so everything
+            // is handed to the stack at once as before.
+            bool canAck = rxChar.properties() & QLowEnergyCharacteristic::Write;
+            if (!canAck) {
+                burst = mTxQueue.size();
+            }
+
+            int pos = 0;
+            while (pos < burst) {
+                int sz = qMin(chunk, burst - pos);
+                bool last = (pos + sz) >= burst;
+                mService->writeCharacteristic(rxChar, mTxQueue.mid(pos, sz),
+                                              (last && canAck) ?
+                                                  QLowEnergyService::WriteWithResponse :
+                                                  QLowEnergyService::WriteWithoutResponse);
+                pos += sz;
+            }
+
+            mTxBytesWindow += burst;
+            mTxQueue.remove(0, burst);
+
+            if (canAck && burst > 0) {
+                mTxAwaitingAck = true;
+                mTxAckTimer.start(2000);
+            }
+        } else {
+            mTxQueue.clear();
+        }
+    } else {
+        mTxQueue.clear();
+    }
+
+    if (mTxQueue.size() <= mTxQueueMax) {
+        mTxOverflowReported = false;
+    }
+}
+
+/**
+ * @brief BleUart::txStatsTimerSlot
+ * Update the TX rate once per second while there is traffic. The rate is
+ * also updated for the first second without traffic, so that it drops to
+ * zero when the link goes idle instead of keeping the last busy value.
+ */
+void BleUart::txStatsTimerSlot()
+{
+    qint64 elapsed = qMax(qint64(1), mTxRateTimer.restart());
+    mTxBytesPerSec = double(mTxBytesWindow) * 1000.0 / double(elapsed);
+    emit txStatsUpdated(mTxBytesPerSec, mTxQueue.size(), getTxChunkSize());
+
+    if (mTxBytesWindow == 0 && mTxQueue.isEmpty() && !mTxAwaitingAck) {
+        mTxStatsTimer.stop();
+    }
+
+    mTxBytesWindow = 0;
+}
+
+void BleUart::txAckTimeout()
+{
+    if (!mSimulatedGatt) {
+        qWarning() << "BLE write acknowledgement timed out";
+    }
+
+    txBurstDone();
 }
 
 void BleUart::init()
@@ -390,3 +588,26 @@ void BleUart::init()
         emit bleError(tr("BLE connect timed out."));
     });
 }
+
+void BleUart::txBurstDone()
+{
+    mTxAwaitingAck = false;
+    mTxAckTimer.stop();
+
+    if (!mTxQueue.isEmpty()) {
+        txTimerSlot();
+    }
+}
+
+void BleUart::resetTxQueue()
+{
+    mTxTimer.stop();
+    mTxAckTimer.stop();
+    mTxAwaitingAck = false;
+    mTxOverflowReported = false;
+    mTxQueue.clear();
+    mTxBytesWindow = 0;
+    mTxBytesPerSec = 0.0;
+    mTxRateTimer.invalidate();
+    mTxStatsTimer.stop();
+}
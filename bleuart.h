@@ -27,6 +27,7 @@
 #include <QLowEnergyService>
 #include <QVariantMap>
 #include <QTimer>
+#include <QElapsedTimer>
 
 class BleUart : public QObject
 {
@@ -42,12 +43,21 @@ public:
     Q_INVOKABLE bool isConnecting();
     Q_INVOKABLE void emitScanDone();
 
+    // Write scheduling
+    Q_INVOKABLE int getMtu();
+    Q_INVOKABLE int getTxChunkSize();
+    Q_INVOKABLE int getTxQueueDepth();
+    Q_INVOKABLE double getTxBytesPerSec();
+    Q_INVOKABLE void setSimulatedGatt(bool enabled, int mtu = 247, double connIntervalMs = 15.0);
+    Q_INVOKABLE bool isSimulatedGatt();
+
 signals:
     void dataRx(QByteArray data);
     void scanDone(QVariantMap devs, bool done);
     void bleError(QString info);
     void connected();
     void unintentionalDisconnect();
+    void txStatsUpdated(double bytesPerSec, int queueDepth, int chunkSize);
 
 public slots:
     void writeData(QByteArray data);
@@ -70,6 +80,11 @@ private slots:
 
     void controlStateChanged(QLowEnergyController::ControllerState state);
     void connectionUpdated(const QLowEnergyConnectionParameters &newParameters);
+    void confirmedCharacteristicWrite(const QLowEnergyCharacteristic &c, const QByteArray &value);
+    void mtuUpdated(int mtu);
+    void txTimerSlot();
+    void txAckTimeout();
+    void txStatsTimerSlot();
 
 private:
     QBluetoothDeviceDiscoveryAgent *mDeviceDiscoveryAgent;
@@ -86,7 +101,27 @@ private:
     bool mInitDone;
     QTimer mConnectTimeoutTimer;
 
+    // Outgoing data is queued and sent in MTU-sized chunks, one burst per
+    // acknowledged write, so that back-to-back packets share writes.
+    QTimer mTxTimer;
+    QTimer mTxAckTimer;
+    QByteArray mTxQueue;
+    int mTxQueueMax;
+    int mTxWindowBytes;
+    int mSimWritesPerEvent;
+    bool mTxAwaitingAck;
+    bool mTxOverflowReported;
+    int mMtu;
+    double mConnIntervalMs;
+    bool mSimulatedGatt;
+    qint64 mTxBytesWindow;
+    double mTxBytesPerSec;
+    QElapsedTimer mTxRateTimer;
+    QTimer mTxStatsTimer;
+
     void init();
+    void txBurstDone();
+    void resetTxQueue();
 
 };
 
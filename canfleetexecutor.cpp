@@ -0,0 +1,240 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "canfleetexecutor.h"
+
+#include <QDebug>
+
+CanFleetExecutor::CanFleetExecutor(VescInterface *vesc, QObject *parent) : QObject(parent)
+{
+    mVesc = vesc;
+    mLoop = nullptr;
+    mMaxInFlight = 4;
+    mRetries = 2;
+    mTimeoutMs = 4000;
+    mNodesDone = 0;
+    mNodesTotal = 0;
+}
+
+void CanFleetExecutor::setMaxInFlight(int num)
+{
+    mMaxInFlight = qMax(1, num);
+}
+
+int CanFleetExecutor::maxInFlight() const
+{
+    return mMaxInFlight;
+}
+
+void CanFleetExecutor::setRetries(int retries)
+{
+    mRetries = qMax(0, retries);
+}
+
+int CanFleetExecutor::retries() const
+{
+    return mRetries;
+}
+
+void CanFleetExecutor::setTimeoutMs(int timeoutMs)
+{
+    mTimeoutMs = timeoutMs;
+}
+
+int CanFleetExecutor::timeoutMs() const
+{
+    return mTimeoutMs;
+}
+
+/**
+ * @brief CanFleetExecutor::run
+ * Prepare and write all nodes. Blocks with an event loop until all writes are
+ * acked, have failed or the operation was aborted by prepare.
+ *
+ * @param canIds
+ * The nodes to run on. -1 is the local device.
+ *
+ * @param prepare
+ * Function that reads the node and builds its writes.
+ *
+ * @return
+ * True if all nodes were prepared and written successfully.
+ */
+bool CanFleetExecutor::run(QVector<int> canIds, PrepareFunc prepare)
+{
+    bool res = true;
+
+    mPending.clear();
+    mInFlight.clear();
+    mInFlightLegacy.clear();
+    mWritesLeft.clear();
+    mFailed.clear();
+    mNodesDone = 0;
+    mNodesTotal = canIds.size();
+
+    for (int id: canIds) {
+        mVesc->canTmpOverride(id >= 0, id);
+
+        // Acks for the nodes written so far are handled while prepare
+        // waits for its reads.
+        QVector<QByteArray> writes;
+        if (!prepare(id, writes)) {
+            nodeFinished(id, false);
+            res = false;
+            break;
+        }
+
+        if (writes.isEmpty()) {
+            nodeFinished(id, true);
+            continue;
+        }
+
+        mWritesLeft.insert(id, writes.size());
+        for (const auto &d: writes) {
+            Write w;
+            w.canId = id;
+            w.data = d;
+            w.packetId = d.isEmpty() ? -1 : int(quint8(d.at(0)));
+            mPending.append(w);
+        }
+
+        fillWindow();
+    }
+
+    if (!mPending.isEmpty() || !mInFlight.isEmpty()) {
+        QEventLoop loop;
+        mLoop = &loop;
+        loop.exec();
+        mLoop = nullptr;
+    }
+
+    // The forwarding of the preparation is kept until every write is done, so
+    // that nothing else is sent with it in between.
+    mVesc->canTmpOverrideEnd();
+
+    return res && mFailed.isEmpty();
+}
+
+QVector<int> CanFleetExecutor::failedIds() const
+{
+    return mFailed;
+}
+
+void CanFleetExecutor::fillWindow()
+{
+    for (int i = 0;i < mPending.size() && mInFlight.size() < mMaxInFlight;i++) {
+        Write w = mPending.at(i);
+        bool ack = hasAck(w.packetId);
+        bool legacy = !mVesc->commands()->getSeqEnvelope(w.canId);
+
+        // An ack without envelope is taken by the oldest write of the same
+        // command, so it must be the only one of them in flight.
+        if (ack && (mInFlightLegacy.contains(w.packetId) ||
+                    (legacy && mInFlight.contains(w.packetId)))) {
+            continue;
+        }
+
+        mPending.removeAt(i);
+        i--;
+
+        Commands *c = mVesc->commands();
+        if (!ack) {
+            c->sendConfigTo(w.canId, w.data);
+            writeDone(w, true);
+            continue;
+        }
+
+        mInFlight.append(w.packetId);
+        if (legacy) {
+            mInFlightLegacy.append(w.packetId);
+        }
+
+        c->request(w.packetId, [c, w]() {
+            c->sendConfigTo(w.canId, w.data);
+        }, nullptr, mTimeoutMs, mRetries)->then([this, w, legacy](CommandRequest *r) {
+            mInFlight.removeOne(w.packetId);
+            if (legacy) {
+                mInFlightLegacy.removeOne(w.packetId);
+            }
+            if (!r->isOk()) {
+                qWarning() << "CAN write to" << w.canId << "failed";
+            }
+            writeDone(w, r->isOk());
+            fillWindow();
+        });
+    }
+
+    if (mLoop && mPending.isEmpty() && mInFlight.isEmpty()) {
+        mLoop->quit();
+    }
+}
+
+void CanFleetExecutor::writeDone(const CanFleetExecutor::Write &w, bool ok)
+{
+    if (!mWritesLeft.contains(w.canId)) {
+        return;
+    }
+
+    if (!ok) {
+        // The remaining writes of a failed node are not sent
+        for (int i = 0;i < mPending.size();i++) {
+            if (mPending.at(i).canId == w.canId) {
+                mPending.removeAt(i);
+                i--;
+            }
+        }
+
+        mWritesLeft.remove(w.canId);
+        nodeFinished(w.canId, false);
+        return;
+    }
+
+    mWritesLeft[w.canId]--;
+    if (mWritesLeft.value(w.canId) <= 0) {
+        mWritesLeft.remove(w.canId);
+        nodeFinished(w.canId, true);
+    }
+}
+
+void CanFleetExecutor::nodeFinished(int canId, bool ok)
+{
+    mNodesDone++;
+
+    if (!ok) {
+        mFailed.append(canId);
+    }
+
+    emit nodeDone(canId, ok);
+    emit progress(mNodesDone, mNodesTotal);
+}
+
+bool CanFleetExecutor::hasAck(int packetId)
+{
+    switch (packetId) {
+    case COMM_SET_MCCONF:
+    case COMM_SET_APPCONF:
+    case COMM_SET_APPCONF_NO_STORE:
+    case COMM_SET_MCCONF_TEMP:
+    case COMM_SET_MCCONF_TEMP_SETUP:
+    case COMM_SET_BATTERY_CUT:
+        return true;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,102 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef CANFLEETEXECUTOR_H
+#define CANFLEETEXECUTOR_H
+
+#include <QObject>
+#include <QVector>
+#include <QList>
+#include <QHash>
+#include <QEventLoop>
+#include <functional>
+
+#include "vescinterface.h"
+
+/*
+ * Runs the same configuration operation on many devices on the CAN-bus over
+ * one link. Each node is first prepared with CAN-forwarding set to it (this
+ * is where the current configuration is read, as the replies do not carry
+ * the sender). The resulting writes are sent directly to the node and
+ * pipelined, with up to maxInFlight() of them outstanding at a time, while
+ * the next node is prepared.
+ *
+ * Nodes that support the sequence envelope return it with the ack, so their
+ * writes are matched by sequence number and any number of them can be
+ * outstanding. The acks of other nodes do not carry the sender, so only one
+ * such write per command is outstanding at a time, and not together with
+ * enveloped writes of the same command. A write that is not acked within
+ * the timeout is sent again, which is safe as configuration writes are
+ * idempotent.
+ */
+class CanFleetExecutor : public QObject
+{
+    Q_OBJECT
+public:
+    // Called with CAN-forwarding set to canId (-1 is the local device). Blocking
+    // reads can be used here. Append the serialized write commands for the node
+    // to writes and return false to abort the whole operation.
+    typedef std::function<bool(int canId, QVector<QByteArray> &writes)> PrepareFunc;
+
+    explicit CanFleetExecutor(VescInterface *vesc, QObject *parent = nullptr);
+
+    void setMaxInFlight(int num);
+    int maxInFlight() const;
+    void setRetries(int retries);
+    int retries() const;
+    void setTimeoutMs(int timeoutMs);
+    int timeoutMs() const;
+
+    bool run(QVector<int> canIds, PrepareFunc prepare);
+    QVector<int> failedIds() const;
+
+signals:
+    void progress(int done, int total);
+    void nodeDone(int canId, bool ok);
+
+private:
+    struct Write {
+        int canId;
+        QByteArray data;
+        int packetId;
+    };
+
+    VescInterface *mVesc;
+    QEventLoop *mLoop;
+
+    int mMaxInFlight;
+    int mRetries;
+    int mTimeoutMs;
+
+    QList<Write> mPending;
+    QList<int> mInFlight;
+    QList<int> mInFlightLegacy;
+    QHash<int, int> mWritesLeft;
+    QVector<int> mFailed;
+    int mNodesDone;
+    int mNodesTotal;
+
+    void fillWindow();
+    void writeDone(const Write &w, bool ok);
+    void nodeFinished(int canId, bool ok);
+    static bool hasAck(int packetId);
+
+};
+
+#endif // CANFLEETEXECUTOR_H
@@ -27,10 +27,12 @@
 #include <QNetworkRequest>
 #include <QNetworkReply>
 #include <QEventLoop>
+#include <QCryptographicHash>
 
 CodeLoader::CodeLoader(QObject *parent) : QObject(parent)
 {
     mVesc = nullptr;
+    mUploadWindow = 4;
     reloadPackageArchive();
 }
 
@@ -307,58 +309,14 @@ bool CodeLoader::lispUpload(VByteArray vb)
         return false;
     }
 
-    auto waitWriteRes = [this]() {
-        int res = -10;
-
-        QEventLoop loop;
-        QTimer timeoutTimer;
-        timeoutTimer.setSingleShot(true);
-        timeoutTimer.start(1000);
-        auto conn = connect(mVesc->commands(), &Commands::lispWriteCodeRx,
-                            [&res,&loop](bool erRes, quint32 offset) {
-            (void)offset;
-            res = erRes ? 1 : -1;
-            loop.quit();
-        });
-
-        connect(&timeoutTimer, SIGNAL(timeout()), &loop, SLOT(quit()));
-        loop.exec();
-
-        disconnect(conn);
-        return res;
-    };
-
-    auto writeChunk = [this, waitWriteRes](QByteArray data, quint32 offset) {
-        int tries = 5;
-        int res = -10;
-        while (tries > 0) {
-            mVesc->commands()->lispWriteCode(data, offset);
-            if ((res = waitWriteRes()) >= 0) {
-                return res;
-            }
-            tries--;
-        }
-
-        return res;
-    };
-
-    quint32 offset = 0;
-    bool ok = true;
-    while (data.size() > 0) {
-        const int chunkSize = 384;
-        int sz = data.size() > chunkSize ? chunkSize : data.size();
-
-        if (writeChunk(data.mid(0, sz), offset) < 0) {
-            mVesc->emitMessageDialog(tr("Upload Code"), tr("Write failed"), false);
-            ok = false;
-            break;
-        }
-
-        offset += sz;
-        data.remove(0, sz);
+    if (!uploadChunks(data, [this](QByteArray chunk, quint32 offset) {
+        return mVesc->commands()->lispWriteCodeAsync(chunk, offset);
+    })) {
+        mVesc->emitMessageDialog(tr("Upload Code"), tr("Write failed"), false);
+        return false;
     }
 
-    return ok;
+    return true;
 }
 
 bool CodeLoader::lispUpload(QString codeStr, QString editorPath)
@@ -584,6 +542,7 @@ bool CodeLoader::qmlErase(int size)
         return res;
     };
 
+    mVesc->invalidateQmlApp();
     mVesc->commands()->qmlUiErase(size);
 
     int erRes = waitEraseRes();
@@ -603,50 +562,25 @@ bool CodeLoader::qmlErase(int size)
     return true;
 }
 
-QByteArray CodeLoader::qmlCompress(QString script)
+/**
+ * @brief CodeLoader::qmlPrepare
+ * Add the imports to a QML script. This is what gets compressed and written
+ * to the device.
+ */
+QString CodeLoader::qmlPrepare(QString script)
 {
     script.prepend("import \"qrc:/mobile\";");
     script.prepend("import Vedder.vesc.vescinterface 1.0;");
-    return qCompress(script.toUtf8(), 9);
+    return script;
 }
 
-bool CodeLoader::qmlUpload(QByteArray script, bool isFullscreen)
+QByteArray CodeLoader::qmlCompress(QString script)
 {
-    auto waitWriteRes = [this]() {
-        int res = -10;
-
-        QEventLoop loop;
-        QTimer timeoutTimer;
-        timeoutTimer.setSingleShot(true);
-        timeoutTimer.start(1000);
-        auto conn = connect(mVesc->commands(), &Commands::writeQmluiResReceived,
-                            [&res,&loop](bool erRes, quint32 offset) {
-            (void)offset;
-            res = erRes ? 1 : -1;
-            loop.quit();
-        });
-
-        connect(&timeoutTimer, SIGNAL(timeout()), &loop, SLOT(quit()));
-        loop.exec();
-
-        disconnect(conn);
-        return res;
-    };
-
-    auto writeChunk = [this, waitWriteRes](QByteArray data, quint32 offset) {
-        int tries = 5;
-        int res = -10;
-        while (tries > 0) {
-            mVesc->commands()->qmlUiWrite(data, offset);
-            if ((res = waitWriteRes()) >= 0) {
-                return res;
-            }
-            tries--;
-        }
-
-        return res;
-    };
+    return qCompress(qmlPrepare(script).toUtf8(), 9);
+}
 
+bool CodeLoader::qmlUpload(QByteArray script, bool isFullscreen)
+{
     VByteArray vb;
     vb.vbAppendUint16(isFullscreen ? 2 : 1);
     vb.append(script);
@@ -662,23 +596,75 @@ bool CodeLoader::qmlUpload(QByteArray script, bool isFullscreen)
         return false;
     }
 
-    quint32 offset = 0;
-    bool ok = true;
-    while (data.size() > 0) {
-        const int chunkSize = 384;
-        int sz = data.size() > chunkSize ? chunkSize : data.size();
+    mVesc->invalidateQmlApp();
 
-        if (writeChunk(data.mid(0, sz), offset) < 0) {
-            mVesc->emitMessageDialog(tr("Upload Qml"), tr("Qml write failed"), false);
-            ok = false;
-            break;
-        }
+    if (!uploadChunks(data, [this](QByteArray chunk, quint32 offset) {
+        return mVesc->commands()->qmlUiWriteAsync(chunk, offset);
+    })) {
+        mVesc->emitMessageDialog(tr("Upload Qml"), tr("Qml write failed"), false);
+        return false;
+    }
 
-        offset += sz;
-        data.remove(0, sz);
+    return true;
+}
+
+/**
+ * @brief CodeLoader::qmlIsOnDevice
+ * Check if the QML app on the device is the same as script, so that
+ * uploading it can be skipped. When the copy in VescInterface came from the
+ * cache or the app has been changed since it was read, only the length of
+ * the app on the device is read first. The full app is read only when the
+ * length matches the compressed script. Nothing is shown to the user when
+ * the device can't be read, the upload just goes ahead.
+ *
+ * @param script
+ * The script before qmlPrepare.
+ *
+ * @param isFullscreen
+ * The fullscreen flag it would be uploaded with.
+ *
+ * @return
+ * True if the device already runs this script.
+ */
+bool CodeLoader::qmlIsOnDevice(QString script, bool isFullscreen)
+{
+    if (!mVesc || !mVesc->isPortConnected()) {
+        return false;
     }
 
-    return ok;
+    auto fwParams = mVesc->getLastFwRxParams();
+    if (!fwParams.hasQmlApp || fwParams.qmlAppFullscreen != isFullscreen) {
+        return false;
+    }
+
+    if (!mVesc->qmlAppFromDevice()) {
+        if (mVesc->qmlAppDeviceSize() != qmlCompress(script).size() ||
+                !mVesc->reloadQmlApp(true)) {
+            return false;
+        }
+    }
+
+    auto hash = [](QString str) {
+        return QCryptographicHash::hash(str.toUtf8(), QCryptographicHash::Sha1);
+    };
+
+    return hash(qmlPrepare(script)) == hash(mVesc->qmlApp());
+}
+
+/**
+ * @brief CodeLoader::setUploadWindow
+ * Set how many chunks can be in flight at the same time when uploading QML
+ * and Lisp code. 1 waits for every chunk to be acknowledged before sending
+ * the next one.
+ */
+void CodeLoader::setUploadWindow(int chunks)
+{
+    mUploadWindow = qMax(1, chunks);
+}
+
+int CodeLoader::getUploadWindow() const
+{
+    return mUploadWindow;
 }
 
 QByteArray CodeLoader::packVescPackage(VescPackage pkg)
@@ -801,11 +787,15 @@ bool CodeLoader::installVescPackage(VescPackage pkg)
     QByteArray qml;
 
     if (!pkg.qmlFile.isEmpty()) {
-        qml = qmlCompress(pkg.qmlFile);
-        res = qmlErase(qml.size() + 100);
+        if (qmlIsOnDevice(pkg.qmlFile, pkg.qmlIsFullscreen)) {
+            mVesc->emitStatusMessage(tr("Qml unchanged, skipping upload"), true);
+        } else {
+            qml = qmlCompress(pkg.qmlFile);
+            res = qmlErase(qml.size() + 100);
 
-        if (res) {
-            res = qmlUpload(qml, pkg.qmlIsFullscreen);
+            if (res) {
+                res = qmlUpload(qml, pkg.qmlIsFullscreen);
+            }
         }
     } else {
         res = qmlErase(16);
@@ -937,6 +927,63 @@ bool CodeLoader::downloadPackageArchive()
     return res;
 }
 
+/**
+ * @brief CodeLoader::uploadChunks
+ * Write data to the device in chunks, with up to mUploadWindow chunks in
+ * flight. The replies carry the offset, so they are matched to their chunk
+ * even when they arrive out of order, and every chunk is retried on its own.
+ *
+ * @param data
+ * The data to write.
+ *
+ * @param write
+ * Function that sends one chunk and returns its request.
+ *
+ * @return
+ * True if all chunks were written.
+ */
+bool CodeLoader::uploadChunks(const QByteArray &data, std::function<CommandRequestPtr (QByteArray, quint32)> write)
+{
+    const int chunkSize = 384;
+    int sent = 0;
+    int inFlight = 0;
+    bool ok = true;
+
+    QEventLoop loop;
+    std::function<void()> fill;
+    fill = [&]() {
+        while (ok && inFlight < mUploadWindow && sent < data.size()) {
+            int sz = qMin(chunkSize, data.size() - sent);
+            auto req = write(data.mid(sent, sz), quint32(sent));
+            sent += sz;
+            inFlight++;
+
+            req->then([&](CommandRequest *r) {
+                inFlight--;
+
+                if (!r->isOk() || r->reply().isEmpty() || r->reply().at(0) == 0) {
+                    ok = false;
+                }
+
+                if (ok) {
+                    fill();
+                }
+
+                if (inFlight == 0) {
+                    loop.quit();
+                }
+            });
+        }
+    };
+
+    fill();
+    if (inFlight > 0) {
+        loop.exec();
+    }
+
+    return ok && sent == data.size();
+}
+
 bool CodeLoader::getImportFromLine(QString line, QString &path, QString &tag, bool &isInvalid)
 {
     bool res = false;
@@ -22,6 +22,7 @@
 
 #include <QObject>
 #include <QDir>
+#include <functional>
 #include "vescinterface.h"
 #include "datatypes.h"
 
@@ -43,8 +44,13 @@ public:
     QString lispRead(QWidget *parent, QString &lispPath);
 
     Q_INVOKABLE bool qmlErase(int size);
+    QString qmlPrepare(QString script);
     QByteArray qmlCompress(QString script);
     bool qmlUpload(QByteArray scripr, bool isFullscreen);
+    bool qmlIsOnDevice(QString script, bool isFullscreen);
+
+    Q_INVOKABLE void setUploadWindow(int chunks);
+    Q_INVOKABLE int getUploadWindow() const;
 
     QByteArray packVescPackage(VescPackage pkg);
     VescPackage unpackVescPackage(QByteArray data);
@@ -60,7 +66,10 @@ signals:
 
 private:
     VescInterface *mVesc;
+    int mUploadWindow;
+
     bool getImportFromLine(QString line, QString &path, QString &tag, bool &isInvalid);
+    bool uploadChunks(const QByteArray &data, std::function<CommandRequestPtr(QByteArray, quint32)> write);
 
 };
 
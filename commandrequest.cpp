@@ -0,0 +1,198 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "commandrequest.h"
+
+#include <QEventLoop>
+
+CommandRequest::CommandRequest(int packetId, quint32 seq, std::function<void()> send,
+                               Matcher matcher, int timeoutMs, int retries)
+{
+    mPacketId = packetId;
+    mSeq = seq;
+    mSend = send;
+    mMatcher = matcher;
+    mRetriesLeft = retries;
+    mState = Pending;
+
+    mTimer.setSingleShot(true);
+    mTimer.setInterval(timeoutMs);
+    connect(&mTimer, SIGNAL(timeout()), this, SLOT(timeout()));
+}
+
+int CommandRequest::packetId() const
+{
+    return mPacketId;
+}
+
+quint32 CommandRequest::seq() const
+{
+    return mSeq;
+}
+
+CommandRequest::State CommandRequest::state() const
+{
+    return mState;
+}
+
+bool CommandRequest::isDone() const
+{
+    return mState != Pending;
+}
+
+bool CommandRequest::isOk() const
+{
+    return mState == Done;
+}
+
+/**
+ * @brief CommandRequest::reply
+ * @return
+ * The reply payload without the packet id, empty until the request is done.
+ */
+QByteArray CommandRequest::reply() const
+{
+    return mReply;
+}
+
+/**
+ * @brief CommandRequest::result
+ * @return
+ * The decoded reply for the packet types that Commands decodes, e.g.
+ * MC_VALUES for COMM_GET_VALUES. Invalid otherwise.
+ */
+QVariant CommandRequest::result() const
+{
+    return mResult;
+}
+
+bool CommandRequest::matches(const QByteArray &payload) const
+{
+    return mState == Pending && (!mMatcher || mMatcher(payload));
+}
+
+void CommandRequest::start()
+{
+    if (mSend) {
+        mSend();
+    }
+
+    mTimer.start();
+}
+
+void CommandRequest::complete(const QByteArray &payload, const QVariant &result)
+{
+    if (mState != Pending) {
+        return;
+    }
+
+    mReply = payload;
+    mResult = result;
+    finish(Done);
+}
+
+void CommandRequest::cancel()
+{
+    if (mState == Pending) {
+        finish(Cancelled);
+    }
+}
+
+/**
+ * @brief CommandRequest::wait
+ * Block with an event loop until the request is finished. Other requests
+ * keep progressing while waiting.
+ *
+ * @return
+ * true if the reply was received.
+ */
+bool CommandRequest::wait()
+{
+    if (mState == Pending) {
+        QEventLoop loop;
+        auto conn = connect(this, &CommandRequest::finished, &loop, &QEventLoop::quit);
+        loop.exec();
+        disconnect(conn);
+    }
+
+    return isOk();
+}
+
+/**
+ * @brief CommandRequest::then
+ * Run callback when the request is finished, or right away if it already
+ * is. Requests can be chained by starting the next one from the callback.
+ */
+void CommandRequest::then(std::function<void (CommandRequest *)> callback)
+{
+    if (mState != Pending) {
+        callback(this);
+    } else {
+        mCallbacks.append(callback);
+    }
+}
+
+/**
+ * @brief CommandRequest::waitAll
+ * Wait for a set of requests that are in flight at the same time.
+ *
+ * @return
+ * true if all of them received their reply.
+ */
+bool CommandRequest::waitAll(const QVector<CommandRequestPtr> &requests)
+{
+    bool res = true;
+    for (const auto &r: requests) {
+        if (!r->wait()) {
+            res = false;
+        }
+    }
+    return res;
+}
+
+void CommandRequest::timeout()
+{
+    if (mState != Pending) {
+        return;
+    }
+
+    if (mRetriesLeft > 0) {
+        mRetriesLeft--;
+        start();
+    } else {
+        finish(TimedOut);
+    }
+}
+
+void CommandRequest::finish(CommandRequest::State state)
+{
+    // The in-flight table can hold the last reference
+    auto self = sharedFromThis();
+
+    mState = state;
+    mTimer.stop();
+
+    auto callbacks = mCallbacks;
+    mCallbacks.clear();
+    for (const auto &c: callbacks) {
+        c(this);
+    }
+
+    emit finished();
+}
@@ -0,0 +1,99 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef COMMANDREQUEST_H
+#define COMMANDREQUEST_H
+
+#include <QObject>
+#include <QTimer>
+#include <QVariant>
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QEnableSharedFromThis>
+#include <QVector>
+#include <functional>
+
+class CommandRequest;
+typedef QSharedPointer<CommandRequest> CommandRequestPtr;
+
+/*
+ * A request that is waiting for its reply from the firmware. Requests are
+ * created with Commands::request, which keeps them in its in-flight table
+ * until the reply arrives, the timeout expires or they are cancelled. Any
+ * number of requests can be outstanding at the same time, also of the same
+ * type, as long as the matcher can tell their replies apart.
+ */
+class CommandRequest : public QObject, public QEnableSharedFromThis<CommandRequest>
+{
+    Q_OBJECT
+public:
+    enum State {
+        Pending,
+        Done,
+        TimedOut,
+        Cancelled
+    };
+
+    // Gets the reply payload without the packet id, returns true if it
+    // belongs to this request.
+    typedef std::function<bool(const QByteArray &payload)> Matcher;
+
+    CommandRequest(int packetId, quint32 seq, std::function<void()> send,
+                   Matcher matcher, int timeoutMs, int retries);
+
+    int packetId() const;
+    quint32 seq() const;
+    State state() const;
+    bool isDone() const;
+    bool isOk() const;
+    QByteArray reply() const;
+    QVariant result() const;
+
+    bool matches(const QByteArray &payload) const;
+    void start();
+    void complete(const QByteArray &payload, const QVariant &result);
+    void cancel();
+    bool wait();
+    void then(std::function<void(CommandRequest *req)> callback);
+
+    static bool waitAll(const QVector<CommandRequestPtr> &requests);
+
+signals:
+    void finished();
+
+private slots:
+    void timeout();
+
+private:
+    int mPacketId;
+    quint32 mSeq;
+    std::function<void()> mSend;
+    Matcher mMatcher;
+    int mRetriesLeft;
+    State mState;
+    QByteArray mReply;
+    QVariant mResult;
+    QTimer mTimer;
+    QVector<std::function<void(CommandRequest *req)>> mCallbacks;
+
+    void finish(State state);
+
+};
+
+#endif // COMMANDREQUEST_H
@@ -21,6 +21,7 @@
 #include "qelapsedtimer.h"
 #include <QDebug>
 #include <QEventLoop>
+#include <QDateTime>
 
 Commands::Commands(QObject *parent) : QObject(parent)
 {
@@ -38,6 +39,8 @@ Commands::Commands(QObject *parent) : QObject(parent)
 
     mMcConfig = nullptr;
     mAppConfig = nullptr;
+    mMcConfigShadowTarget = -2;
+    mAppConfigShadowTarget = -2;
 
     mTimeoutCount = 100;
     mTimeoutFwVer = 0;
@@ -51,10 +54,18 @@ Commands::Commands(QObject *parent) : QObject(parent)
     mTimeoutDecChuk = 0;
     mTimeoutPingCan = 0;
     mTimeoutBmsVal = 0;
+    mTimeoutStats = 0;
+    mTimeoutTotal = 0;
 
     mFilePercentage = 0.0;
     mFileSpeed = 0.0;
 
+    mRequestSeq = 0;
+    mTxSeq = -1;
+    mRxSeq = -1;
+    mSampleBatchRequested = false;
+    mBmReadsStale = 0;
+
     connect(mTimer, SIGNAL(timeout()), this, SLOT(timerSlot()));
 }
 
@@ -98,11 +109,122 @@ int Commands::getCanSendId()
     return mCanId;
 }
 
+/**
+ * @brief Commands::invalidateConfigShadow
+ * Forget the local copies of the configurations on the device, so that the
+ * next delta write is a full write.
+ */
+void Commands::invalidateConfigShadow()
+{
+    mMcConfigShadowTarget = -2;
+    mAppConfigShadowTarget = -2;
+}
+
+/**
+ * @brief Commands::sendPacketTo
+ * Send an already serialized command to a specific device, regardless of the
+ * current CAN-forwarding state.
+ *
+ * @param canId
+ * CAN-id to forward to, or -1 for the local device.
+ *
+ * @param data
+ * Command id followed by its payload.
+ */
+void Commands::sendPacketTo(int canId, QByteArray data)
+{
+    bool sendCanLast = mSendCan;
+    int canIdLast = mCanId;
+
+    mSendCan = canId >= 0;
+    if (canId >= 0) {
+        mCanId = canId;
+    }
+
+    emitData(data);
+
+    mSendCan = sendCanLast;
+    mCanId = canIdLast;
+
+    // This can be anything, including configuration writes
+    invalidateConfigShadow();
+}
+
+/**
+ * @brief Commands::sendConfigTo
+ * Send a configuration write that was serialized earlier, e.g. from a copy
+ * of the configuration, to a specific device. Motor and app configuration
+ * writes update the local state the same way as setMcconf and setAppConf.
+ *
+ * @param canId
+ * The CAN-id to send to, -1 for the local device.
+ *
+ * @param data
+ * The command, starting with COMM_SET_MCCONF or COMM_SET_APPCONF.
+ */
+void Commands::sendConfigTo(int canId, QByteArray data)
+{
+    sendPacketTo(canId, data);
+
+    if (data.isEmpty()) {
+        return;
+    }
+
+    COMM_PACKET_ID id = COMM_PACKET_ID(quint8(data.at(0)));
+    VByteArray vb(data.mid(1));
+
+    if (id == COMM_SET_MCCONF && mMcConfig) {
+        ConfigParams conf;
+        conf = *mMcConfig;
+        if (conf.deSerialize(vb)) {
+            // mMcConfigLast is what checkMcConfig compares the configuration
+            // of the current target with.
+            if (canId == currentTarget()) {
+                mMcConfigLast = conf;
+            }
+
+            QSharedPointer<ConfigParams> written(new ConfigParams);
+            *written = conf;
+            trackConfTransfer(COMM_SET_MCCONF, canId, written);
+        }
+
+        emit mcConfigWriteSent(false);
+    } else if (id == COMM_SET_APPCONF && mAppConfig) {
+        QSharedPointer<ConfigParams> written(new ConfigParams);
+        *written = *mAppConfig;
+        if (written->deSerialize(vb)) {
+            trackConfTransfer(COMM_SET_APPCONF, canId, written);
+        }
+    }
+}
+
 void Commands::processPacket(QByteArray data)
 {
     VByteArray vb(data);
     COMM_PACKET_ID id = COMM_PACKET_ID(vb.vbPopFrontUint8());
 
+    if (int(id) == COMM_SEQ_ENVELOPE && !mSeqEnvelopeTargets.isEmpty()) {
+        if (vb.size() >= 3) {
+            mRxSeq = vb.vbPopFrontUint16();
+            processPacket(vb);
+            mRxSeq = -1;
+        }
+        return;
+    }
+
+    if (int(id) == COMM_SAMPLE_PRINT_BATCH && mSampleBatchRequested) {
+        emit sampleBatchReceived(vb);
+        return;
+    }
+
+    // Decoded reply for requests waiting for this packet
+    QVariant decoded;
+    QByteArray payload;
+    bool requestDone = false;
+    if (!mRequests.isEmpty()) {
+        payload = vb;
+    }
+
     switch (id) {
     case COMM_FW_VERSION: {
         mTimeoutFwVer = 0;
@@ -162,6 +284,32 @@ void Commands::processPacket(QByteArray data)
             params.hwConfCrc = vb.vbPopFrontUint32();
         }
 
+        // No released firmware sends the fields below. Firmware up to the
+        // latest configuration version in res/config (6.06) may append
+        // something else here, so they are only read from newer firmware.
+        bool hasFwFlags = params.major > 6 || (params.major == 6 && params.minor > 6);
+
+        if (hasFwFlags && vb.size() >= 1) {
+            auto fwFlags = vb.vbPopFrontUint8();
+            params.fwDeltaSupported = fwFlags & 1;
+            params.seqEnvelopeSupported = fwFlags & 2;
+            params.sampleBatchSupported = fwFlags & 4;
+        }
+
+        if (hasFwFlags && vb.size() >= 6) {
+            params.fwImageSize = vb.vbPopFrontUint32();
+            params.fwImageCrc = vb.vbPopFrontUint16();
+        }
+
+        // The request records the envelope support of its target, which
+        // has to be done before anything reads the configuration in
+        // response to the signal.
+        decoded = QVariant::fromValue(params);
+        if (!mRequests.isEmpty()) {
+            completeRequest(id, payload, decoded);
+            requestDone = true;
+        }
+
         emit fwVersionReceived(params);
     } break;
 
@@ -285,6 +433,7 @@ void Commands::processPacket(QByteArray data)
             }
         }
 
+        decoded = QVariant::fromValue(values);
         emit valuesReceived(values, mask);
     } break;
 
@@ -313,6 +462,17 @@ void Commands::processPacket(QByteArray data)
         mTimeoutMcconf = 0;
         if (mMcConfig) {
             if (mMcConfig->deSerialize(vb)) {
+                if (id == COMM_GET_MCCONF) {
+                    // Replies that were requested from another target, e.g.
+                    // before the CAN-forwarding changed, are not a valid shadow.
+                    if (takeConfTransfer(COMM_GET_MCCONF).target == currentTarget()) {
+                        mMcConfigShadow = *mMcConfig;
+                        mMcConfigShadowTarget = currentTarget();
+                    } else {
+                        mMcConfigShadowTarget = -2;
+                    }
+                }
+
                 mMcConfig->updateDone();
 
                 if (mCheckNextMcConfig) {
@@ -330,6 +490,15 @@ void Commands::processPacket(QByteArray data)
         mTimeoutAppconf = 0;
         if (mAppConfig) {
             if (mAppConfig->deSerialize(vb)) {
+                if (id == COMM_GET_APPCONF) {
+                    if (takeConfTransfer(COMM_GET_APPCONF).target == currentTarget()) {
+                        mAppConfigShadow = *mAppConfig;
+                        mAppConfigShadowTarget = currentTarget();
+                    } else {
+                        mAppConfigShadowTarget = -2;
+                    }
+                }
+
                 mAppConfig->updateDone();
             } else {
                 emit deserializeConfigFailed(false, true);
@@ -355,6 +524,7 @@ void Commands::processPacket(QByteArray data)
         if (vb.size() >= 4) {
             ld_lq_diff = vb.vbPopFrontDouble32(1e3);
         }
+        decoded = QVariant::fromValue(QVector<double>() << r << l << ld_lq_diff);
         emit motorRLReceived(r, l, ld_lq_diff);
     } break;
 
@@ -401,13 +571,23 @@ void Commands::processPacket(QByteArray data)
         emit decodedChukReceived(vb.vbPopFrontDouble32(1000000.0));
         break;
 
-    case COMM_SET_MCCONF:
+    case COMM_SET_MCCONF: {
+        auto t = takeConfTransfer(id);
+        if (t.conf && t.target == currentTarget()) {
+            mMcConfigShadow = *t.conf;
+            mMcConfigShadowTarget = t.target;
+        }
         emit ackReceived("Motor config write OK");
-        break;
+    } break;
 
-    case COMM_SET_APPCONF:
+    case COMM_SET_APPCONF: {
+        auto t = takeConfTransfer(id);
+        if (t.conf && t.target == currentTarget()) {
+            mAppConfigShadow = *t.conf;
+            mAppConfigShadowTarget = t.target;
+        }
         emit ackReceived("App config write OK");
-        break;
+    } break;
 
     case COMM_SET_APPCONF_NO_STORE:
         emit ackReceived("App config set OK");
@@ -514,9 +694,14 @@ void Commands::processPacket(QByteArray data)
         emit valuesSetupReceived(values, mask);
     } break;
 
-    case COMM_SET_MCCONF_TEMP:
+    case COMM_SET_MCCONF_TEMP: {
+        auto t = takeConfTransfer(id);
+        if (t.conf && t.target == currentTarget()) {
+            mMcConfigShadow = *t.conf;
+            mMcConfigShadowTarget = t.target;
+        }
         emit ackReceived("COMM_SET_MCCONF_TEMP Write OK");
-        break;
+    } break;
 
     case COMM_SET_MCCONF_TEMP_SETUP:
         emit ackReceived("COMM_SET_MCCONF_TEMP_SETUP Write OK");
@@ -526,9 +711,11 @@ void Commands::processPacket(QByteArray data)
         emit motorLinkageReceived(vb.vbPopFrontDouble32(1e7));
         break;
 
-    case COMM_DETECT_APPLY_ALL_FOC:
-        emit detectAllFocReceived(vb.vbPopFrontInt16());
-        break;
+    case COMM_DETECT_APPLY_ALL_FOC: {
+        int res = vb.vbPopFrontInt16();
+        decoded = res;
+        emit detectAllFocReceived(res);
+    } break;
 
     case COMM_PING_CAN: {
         mTimeoutPingCan = 0;
@@ -663,6 +850,15 @@ void Commands::processPacket(QByteArray data)
     } break;
 
     case COMM_BM_MEM_READ: {
+        // The replies do not carry the address, so the late replies to reads
+        // that were given up on are dropped. Replies that are that late are
+        // lost, so this only goes on for a while.
+        if (mBmReadsStale > 0 && mBmReadsStaleTime.elapsed() < 2000) {
+            mBmReadsStale--;
+            break;
+        }
+
+        mBmReadsStale = 0;
         int res = vb.vbPopFrontInt16();
         emit bmReadMemRes(res, vb);
     } break;
@@ -1105,6 +1301,10 @@ void Commands::processPacket(QByteArray data)
     default:
         break;
     }
+
+    if (!requestDone && !mRequests.isEmpty()) {
+        completeRequest(id, payload, decoded);
+    }
 }
 
 void Commands::getFwVersion()
@@ -1113,11 +1313,7 @@ void Commands::getFwVersion()
         return;
     }
 
-    mTimeoutFwVer = mTimeoutCount;
-
-    VByteArray vb;
-    vb.vbAppendInt8(COMM_FW_VERSION);
-    emitData(vb);
+    getFwVersionAsync(mTimeoutCount * mTimer->interval());
 }
 
 void Commands::eraseNewApp(bool fwdCan, quint32 fwSize, HW_TYPE hwType, QString hwName)
@@ -1332,6 +1528,55 @@ void Commands::samplePrint(debug_sampling_mode mode, int sample_len, int dec, bo
     emitData(vb);
 }
 
+/**
+ * @brief Commands::samplePrintBatch
+ * Same as samplePrint, but the samples are sent back in
+ * COMM_SAMPLE_PRINT_BATCH packets. Only use this when
+ * FW_RX_PARAMS::sampleBatchSupported is set.
+ */
+void Commands::samplePrintBatch(debug_sampling_mode mode, int sample_len, int dec, bool raw)
+{
+    mSampleBatchRequested = true;
+
+    VByteArray vb;
+    vb.vbAppendInt8(COMM_SAMPLE_PRINT_BATCH);
+    vb.vbAppendUint8(SAMPLE_BATCH_START);
+    vb.vbAppendInt8(mode);
+    vb.vbAppendUint16(sample_len);
+    vb.vbAppendUint8(dec);
+    vb.vbAppendInt8(raw);
+    emitData(vb);
+}
+
+/**
+ * @brief Commands::sampleBatchAck
+ * Tell the firmware that a range of samples has been received, so that it
+ * can move on without waiting for the range to time out.
+ */
+void Commands::sampleBatchAck(int first, int count)
+{
+    VByteArray vb;
+    vb.vbAppendInt8(COMM_SAMPLE_PRINT_BATCH);
+    vb.vbAppendUint8(SAMPLE_BATCH_ACK);
+    vb.vbAppendUint16(first);
+    vb.vbAppendUint16(count);
+    emitData(vb);
+}
+
+/**
+ * @brief Commands::sampleBatchResend
+ * Request a range of samples again.
+ */
+void Commands::sampleBatchResend(int first, int count)
+{
+    VByteArray vb;
+    vb.vbAppendInt8(COMM_SAMPLE_PRINT_BATCH);
+    vb.vbAppendUint8(SAMPLE_BATCH_RESEND);
+    vb.vbAppendUint16(first);
+    vb.vbAppendUint16(count);
+    emitData(vb);
+}
+
 void Commands::getMcconf()
 {
     if (mTimeoutMcconf > 0) {
@@ -1369,6 +1614,10 @@ void Commands::setMcconf(bool check)
         mMcConfig->serialize(vb);
         emitData(vb);
 
+        QSharedPointer<ConfigParams> written(new ConfigParams);
+        *written = *mMcConfig;
+        trackConfTransfer(COMM_SET_MCCONF, currentTarget(), written);
+
         if (check) {
             checkMcConfig();
         }
@@ -1377,6 +1626,84 @@ void Commands::setMcconf(bool check)
     }
 }
 
+/**
+ * @brief Commands::setMcconfDelta
+ * Write only what changed in the motor configuration since it was last read
+ * from or written to the current target. When only the limits that are part of
+ * MCCONF_TEMP changed they are sent with COMM_SET_MCCONF_TEMP, which is a small
+ * packet. Otherwise the full configuration is written, as the firmware has no
+ * command for setting individual parameters.
+ *
+ * The local copy is updated when the write is acknowledged, so there is no
+ * need to read the configuration back between writes.
+ *
+ * @param store
+ * Store the limits in flash when they are written with COMM_SET_MCCONF_TEMP.
+ * Full writes are always stored.
+ *
+ * @return
+ * The parameters that were different. Empty if nothing had to be sent.
+ */
+QStringList Commands::setMcconfDelta(bool store)
+{
+    QStringList diff;
+
+    if (!mMcConfig) {
+        return diff;
+    }
+
+    if (mMcConfigShadowTarget != currentTarget()) {
+        diff = mMcConfig->getParamOrder();
+        setMcconf(false);
+        return diff;
+    }
+
+    diff = mMcConfig->checkDifference(&mMcConfigShadow);
+    if (diff.isEmpty()) {
+        return diff;
+    }
+
+    static const QStringList tempParams = {
+        "l_current_min_scale", "l_current_max_scale",
+        "l_min_erpm", "l_max_erpm",
+        "l_min_duty", "l_max_duty",
+        "l_watt_min", "l_watt_max"
+    };
+
+    bool onlyTemp = true;
+    for (const auto &p: diff) {
+        if (!tempParams.contains(p)) {
+            onlyTemp = false;
+            break;
+        }
+    }
+
+    if (onlyTemp) {
+        MCCONF_TEMP conf;
+        conf.current_min_scale = mMcConfig->getParamDouble("l_current_min_scale");
+        conf.current_max_scale = mMcConfig->getParamDouble("l_current_max_scale");
+        conf.erpm_or_speed_min = mMcConfig->getParamDouble("l_min_erpm");
+        conf.erpm_or_speed_max = mMcConfig->getParamDouble("l_max_erpm");
+        conf.duty_min = mMcConfig->getParamDouble("l_min_duty");
+        conf.duty_max = mMcConfig->getParamDouble("l_max_duty");
+        conf.watt_min = mMcConfig->getParamDouble("l_watt_min");
+        conf.watt_max = mMcConfig->getParamDouble("l_watt_max");
+        setMcconfTemp(conf, false, store, false, false, true);
+
+        // setMcconfTemp tracked the write, the shadow is taken from
+        // this copy when the ack arrives.
+        if (!mConfTransfers.isEmpty() &&
+                mConfTransfers.last().packetId == COMM_SET_MCCONF_TEMP) {
+            mConfTransfers.last().conf.reset(new ConfigParams);
+            *mConfTransfers.last().conf = *mMcConfig;
+        }
+    } else {
+        setMcconf(false);
+    }
+
+    return diff;
+}
+
 void Commands::getAppConf()
 {
     if (mTimeoutAppconf > 0) {
@@ -1410,9 +1737,42 @@ void Commands::setAppConf()
         vb.vbAppendInt8(COMM_SET_APPCONF);
         mAppConfig->serialize(vb);
         emitData(vb);
+
+        QSharedPointer<ConfigParams> written(new ConfigParams);
+        *written = *mAppConfig;
+        trackConfTransfer(COMM_SET_APPCONF, currentTarget(), written);
     }
 }
 
+/**
+ * @brief Commands::setAppConfDelta
+ * Write the app configuration only if it differs from what was last read from
+ * or written to the current target.
+ *
+ * @return
+ * The parameters that were different. Empty if nothing had to be sent.
+ */
+QStringList Commands::setAppConfDelta()
+{
+    QStringList diff;
+
+    if (!mAppConfig) {
+        return diff;
+    }
+
+    if (mAppConfigShadowTarget != currentTarget()) {
+        diff = mAppConfig->getParamOrder();
+    } else {
+        diff = mAppConfig->checkDifference(&mAppConfigShadow);
+    }
+
+    if (!diff.isEmpty()) {
+        setAppConf();
+    }
+
+    return diff;
+}
+
 void Commands::setAppConfNoStore()
 {
     if (mAppConfig) {
@@ -1596,23 +1956,24 @@ void Commands::getGpdBufferSizeLeft()
     emitData(vb);
 }
 
-void Commands::gpdFillBuffer(QVector<float> samples)
+void Commands::gpdFillBuffer(const QVector<float> &samples)
 {
     VByteArray vb;
 
-    while (!samples.isEmpty()) {
-        vb.vbAppendDouble32Auto(samples.at(0));
-        samples.removeFirst();
+    for (int i = 0;i < samples.size();i++) {
+        if (vb.isEmpty()) {
+            vb.vbAppendInt8(COMM_GPD_FILL_BUFFER);
+        }
 
-        if (vb.size() > 400) {
-            vb.prepend(COMM_GPD_FILL_BUFFER);
+        vb.vbAppendDouble32Auto(samples.at(i));
+
+        if (vb.size() > 401) {
             emitData(vb);
             vb.clear();
         }
     }
 
     if (vb.size() > 0) {
-        vb.prepend(COMM_GPD_FILL_BUFFER);
         emitData(vb);
     }
 }
@@ -1633,44 +1994,46 @@ void Commands::gpdSetMode(gpd_output_mode mode)
     emitData(vb);
 }
 
-void Commands::gpdFillBufferInt8(QVector<qint8> samples)
+void Commands::gpdFillBufferInt8(const QVector<qint8> &samples)
 {
     VByteArray vb;
 
-    while (!samples.isEmpty()) {
-        vb.vbAppendInt8(samples.at(0));
-        samples.removeFirst();
+    for (int i = 0;i < samples.size();i++) {
+        if (vb.isEmpty()) {
+            vb.vbAppendInt8(COMM_GPD_FILL_BUFFER_INT8);
+        }
+
+        vb.vbAppendInt8(samples.at(i));
 
-        if (vb.size() > 400) {
-            vb.prepend(COMM_GPD_FILL_BUFFER_INT8);
+        if (vb.size() > 401) {
             emitData(vb);
             vb.clear();
         }
     }
 
     if (vb.size() > 0) {
-        vb.prepend(COMM_GPD_FILL_BUFFER_INT8);
         emitData(vb);
     }
 }
 
-void Commands::gpdFillBufferInt16(QVector<qint16> samples)
+void Commands::gpdFillBufferInt16(const QVector<qint16> &samples)
 {
     VByteArray vb;
 
-    while (!samples.isEmpty()) {
-        vb.vbAppendInt16(samples.at(0));
-        samples.removeFirst();
+    for (int i = 0;i < samples.size();i++) {
+        if (vb.isEmpty()) {
+            vb.vbAppendInt8(COMM_GPD_FILL_BUFFER_INT16);
+        }
+
+        vb.vbAppendInt16(samples.at(i));
 
-        if (vb.size() > 400) {
-            vb.prepend(COMM_GPD_FILL_BUFFER_INT16);
+        if (vb.size() > 401) {
             emitData(vb);
             vb.clear();
         }
     }
 
     if (vb.size() > 0) {
-        vb.prepend(COMM_GPD_FILL_BUFFER_INT16);
         emitData(vb);
     }
 }
@@ -1699,6 +2062,10 @@ void Commands::getValuesSetup()
 void Commands::setMcconfTemp(const MCCONF_TEMP &conf, bool is_setup, bool store,
                              bool forward_can, bool divide_by_controllers, bool ack)
 {
+    // The limits end up differently on the device depending on the
+    // arguments, so the local copy can no longer be trusted.
+    mMcConfigShadowTarget = -2;
+
     VByteArray vb;
     vb.vbAppendInt8(is_setup ? COMM_SET_MCCONF_TEMP_SETUP : COMM_SET_MCCONF_TEMP);
     vb.vbAppendInt8(store);
@@ -1714,6 +2081,12 @@ void Commands::setMcconfTemp(const MCCONF_TEMP &conf, bool is_setup, bool store,
     vb.vbAppendDouble32Auto(conf.watt_min);
     vb.vbAppendDouble32Auto(conf.watt_max);
     emitData(vb);
+
+    // Keep the acks in order with other temporary writes
+    if (ack && !is_setup) {
+        trackConfTransfer(COMM_SET_MCCONF_TEMP, currentTarget(),
+                          QSharedPointer<ConfigParams>());
+    }
 }
 
 void Commands::getValuesSelective(unsigned int mask)
@@ -1759,6 +2132,13 @@ void Commands::measureLinkageOpenloop(double current, double erpm_per_sec, doubl
 
 void Commands::detectAllFoc(bool detect_can, double max_power_loss, double min_current_in,
                             double max_current_in, double openloop_rpm, double sl_erpm)
+{
+    emitData(detectAllFocPacket(detect_can, max_power_loss, min_current_in,
+                                max_current_in, openloop_rpm, sl_erpm));
+}
+
+QByteArray Commands::detectAllFocPacket(bool detect_can, double max_power_loss, double min_current_in,
+                                        double max_current_in, double openloop_rpm, double sl_erpm)
 {
     if (mMaxPowerLossBug) {
         max_power_loss /= 2.0;
@@ -1772,7 +2152,7 @@ void Commands::detectAllFoc(bool detect_can, double max_power_loss, double min_c
     vb.vbAppendDouble32(max_current_in, 1e3);
     vb.vbAppendDouble32(openloop_rpm, 1e3);
     vb.vbAppendDouble32(sl_erpm, 1e3);
-    emitData(vb);
+    return vb;
 }
 
 void Commands::pingCan()
@@ -2256,35 +2636,471 @@ void Commands::fileRemove(QString path)
     emitData(vb);
 }
 
+/**
+ * @brief Commands::request
+ * Send a request and track it until its reply arrives. Requests do not
+ * block each other, so any number of them can be in flight on the link.
+ *
+ * @param packetId
+ * The packet id of the reply.
+ *
+ * @param send
+ * Function that sends the request. It is called again on retries.
+ *
+ * @param matcher
+ * Function that decides if a reply belongs to this request, e.g. by
+ * comparing the offset. Without matcher the first reply with packetId is
+ * taken. When several requests match, the oldest one gets the reply.
+ *
+ * @param timeoutMs
+ * Timeout for each attempt.
+ *
+ * @param retries
+ * Number of times to send the request again after a timeout.
+ *
+ * @return
+ * The request, which can be waited for, chained or cancelled.
+ */
+CommandRequestPtr Commands::request(int packetId, std::function<void ()> send,
+                                    CommandRequest::Matcher matcher, int timeoutMs, int retries)
+{
+    quint32 seq = mRequestSeq++;
+
+    // Tag everything the request sends with its sequence number, so that the
+    // reply can be matched without looking at its contents.
+    auto sendTagged = [this, seq, send]() {
+        mTxSeq = int(seq & 0xFFFF);
+        send();
+        mTxSeq = -1;
+    };
+
+    CommandRequestPtr req(new CommandRequest(packetId, seq, sendTagged,
+                                             matcher, timeoutMs, retries));
+    mRequests.append(req);
+
+    CommandRequest *reqPtr = req.data();
+    connect(reqPtr, &CommandRequest::finished, this, [this, reqPtr]() {
+        if (reqPtr->state() == CommandRequest::TimedOut) {
+            mTimeoutTotal++;
+        }
+
+        for (int i = 0;i < mRequests.size();i++) {
+            if (mRequests.at(i).data() == reqPtr) {
+                mRequests.removeAt(i);
+                break;
+            }
+        }
+    });
+
+    req->start();
+    return req;
+}
+
+/**
+ * @brief Commands::cancelRequests
+ * Cancel the requests in flight.
+ *
+ * @param packetId
+ * Only cancel requests for this packet id, or all of them if it is -1.
+ */
+void Commands::cancelRequests(int packetId)
+{
+    auto reqs = mRequests;
+    for (const auto &r: reqs) {
+        if (packetId < 0 || r->packetId() == packetId) {
+            r->cancel();
+        }
+    }
+}
+
+int Commands::requestsInFlight() const
+{
+    return mRequests.size();
+}
+
+/**
+ * @brief Commands::setSeqEnvelope
+ * Send requests to target in a sequence-tagged envelope. Only enable this
+ * when the firmware on target reports support for it, older firmware
+ * ignores the envelope. This is done automatically when the reply to
+ * getFwVersionAsync is received.
+ *
+ * @param target
+ * -1 for the local device, otherwise the CAN-id.
+ */
+void Commands::setSeqEnvelope(int target, bool enabled)
+{
+    if (enabled) {
+        mSeqEnvelopeTargets.insert(target);
+    } else {
+        mSeqEnvelopeTargets.remove(target);
+    }
+}
+
+/**
+ * @brief Commands::resetSeqEnvelope
+ * Forget which targets support the envelope, e.g. after a disconnect.
+ */
+void Commands::resetSeqEnvelope()
+{
+    mSeqEnvelopeTargets.clear();
+}
+
+/**
+ * @brief Commands::getSeqEnvelope
+ * Check if requests to target are sent in the envelope.
+ *
+ * @param target
+ * -1 for the local device, otherwise the CAN-id. -2 means the current
+ * target.
+ */
+bool Commands::getSeqEnvelope(int target) const
+{
+    if (target == -2) {
+        target = mSendCan ? mCanId : -1;
+    }
+
+    return mSeqEnvelopeTargets.contains(target);
+}
+
+/**
+ * @brief Commands::getMcconfAsync
+ * Read the motor configuration. The read is always sent, also when another
+ * one is outstanding. With the sequence envelope the replies are matched by
+ * their sequence number, without it in the order the reads were sent.
+ */
+CommandRequestPtr Commands::getMcconfAsync(int timeoutMs)
+{
+    return request(COMM_GET_MCCONF, [this]() {
+        mTimeoutMcconf = mTimeoutCount;
+        mCheckNextMcConfig = false;
+        VByteArray vb;
+        vb.vbAppendInt8(COMM_GET_MCCONF);
+        emitData(vb);
+    }, nullptr, timeoutMs);
+}
+
+CommandRequestPtr Commands::getAppConfAsync(int timeoutMs)
+{
+    return request(COMM_GET_APPCONF, [this]() {
+        mTimeoutAppconf = mTimeoutCount;
+        VByteArray vb;
+        vb.vbAppendInt8(COMM_GET_APPCONF);
+        emitData(vb);
+    }, nullptr, timeoutMs);
+}
+
+CommandRequestPtr Commands::customConfigGetAsync(int confInd, int timeoutMs)
+{
+    return request(COMM_GET_CUSTOM_CONFIG, [this, confInd]() {
+        while (mTimeoutCustomConf.size() <= confInd) {
+            mTimeoutCustomConf.append(0);
+        }
+
+        mTimeoutCustomConf[confInd] = mTimeoutCount;
+        VByteArray vb;
+        vb.vbAppendUint8(COMM_GET_CUSTOM_CONFIG);
+        vb.vbAppendInt8(int8_t(confInd));
+        emitData(vb);
+    }, [confInd](const QByteArray &payload) {
+        return payload.size() >= 1 && int(qint8(payload.at(0))) == confInd;
+    }, timeoutMs);
+}
+
+/**
+ * @brief Commands::getFwVersionAsync
+ * Read the firmware version of the current target. The target is kept with
+ * the request, so that the sequence envelope support in the reply is
+ * recorded for the device that the request went to.
+ */
+CommandRequestPtr Commands::getFwVersionAsync(int timeoutMs)
+{
+    int target = currentTarget();
+
+    auto req = request(COMM_FW_VERSION, [this]() {
+        mTimeoutFwVer = mTimeoutCount;
+        VByteArray vb;
+        vb.vbAppendInt8(COMM_FW_VERSION);
+        emitData(vb);
+    }, nullptr, timeoutMs);
+
+    req->then([this, target](CommandRequest *r) {
+        if (r->isOk()) {
+            setSeqEnvelope(target, r->result().value<FW_RX_PARAMS>().seqEnvelopeSupported);
+        }
+    });
+
+    return req;
+}
+
+CommandRequestPtr Commands::getValuesAsync(int timeoutMs)
+{
+    return request(COMM_GET_VALUES, [this]() { getValues(); }, nullptr, timeoutMs);
+}
+
+CommandRequestPtr Commands::measureRLAsync(int timeoutMs)
+{
+    return request(COMM_DETECT_MOTOR_R_L, [this]() { measureRL(); }, nullptr, timeoutMs);
+}
+
+/**
+ * @brief Commands::detectAllFocAsync
+ * Run detectAllFoc on one device, regardless of the current CAN-forwarding
+ * state. The result is the detection result code.
+ *
+ * @param canId
+ * CAN-id of the device, or -1 for the local device.
+ */
+CommandRequestPtr Commands::detectAllFocAsync(int canId, bool detect_can, double max_power_loss,
+                                              double min_current_in, double max_current_in,
+                                              double openloop_rpm, double sl_erpm, int timeoutMs)
+{
+    QByteArray packet = detectAllFocPacket(detect_can, max_power_loss, min_current_in,
+                                           max_current_in, openloop_rpm, sl_erpm);
+    return request(COMM_DETECT_APPLY_ALL_FOC, [this, canId, packet]() {
+        sendPacketTo(canId, packet);
+    }, nullptr, timeoutMs);
+}
+
+CommandRequestPtr Commands::fileListAsync(QString path, QString from, int retries)
+{
+    return request(COMM_FILE_LIST, [this, path, from]() { fileList(path, from); },
+                   nullptr, 1500, retries);
+}
+
+CommandRequestPtr Commands::fileReadAsync(QString path, qint32 offset, int retries)
+{
+    return request(COMM_FILE_READ, [this, path, offset]() { fileRead(path, offset); },
+                   [offset](const QByteArray &payload) {
+        return payload.size() >= 8 && VByteArray(payload.left(4)).vbPopFrontInt32() == offset;
+    }, 1500, retries);
+}
+
+CommandRequestPtr Commands::fileWriteAsync(QString path, qint32 offset, qint32 size, QByteArray data, int retries)
+{
+    return request(COMM_FILE_WRITE, [this, path, offset, size, data]() { fileWrite(path, offset, size, data); },
+                   [offset](const QByteArray &payload) {
+        return payload.size() >= 5 && VByteArray(payload.left(4)).vbPopFrontInt32() == offset;
+    }, 1500, retries);
+}
+
+CommandRequestPtr Commands::fileMkdirAsync(QString path, int retries)
+{
+    return request(COMM_FILE_MKDIR, [this, path]() { fileMkdir(path); }, nullptr, 1500, retries);
+}
+
+CommandRequestPtr Commands::fileRemoveAsync(QString path, int retries)
+{
+    return request(COMM_FILE_REMOVE, [this, path]() { fileRemove(path); }, nullptr, 1500, retries);
+}
+
+// The write replies carry the offset after the result byte, so several
+// writes can be in flight at the same time.
+static bool writeReplyMatches(const QByteArray &payload, quint32 offset)
+{
+    return payload.size() >= 5 && VByteArray(payload.mid(1, 4)).vbPopFrontUint32() == offset;
+}
+
+CommandRequestPtr Commands::qmlUiWriteAsync(QByteArray data, quint32 offset, int retries)
+{
+    return request(COMM_QMLUI_WRITE, [this, data, offset]() { qmlUiWrite(data, offset); },
+                   [offset](const QByteArray &payload) {
+        return writeReplyMatches(payload, offset);
+    }, 1000, retries);
+}
+
+CommandRequestPtr Commands::lispWriteCodeAsync(QByteArray data, quint32 offset, int retries)
+{
+    return request(COMM_LISP_WRITE_CODE, [this, data, offset]() { lispWriteCode(data, offset); },
+                   [offset](const QByteArray &payload) {
+        return writeReplyMatches(payload, offset);
+    }, 1000, retries);
+}
+
+/**
+ * @brief Commands::eraseNewAppAsync
+ * Erase the buffer for a new firmware on the current target. Erasing the
+ * buffer for all devices on the CAN-bus is not supported here, as every
+ * device would reply.
+ */
+CommandRequestPtr Commands::eraseNewAppAsync(quint32 fwSize, HW_TYPE hwType, QString hwName, int timeoutMs)
+{
+    return request(COMM_ERASE_NEW_APP, [this, fwSize, hwType, hwName]() {
+        eraseNewApp(false, fwSize, hwType, hwName);
+    }, nullptr, timeoutMs, 0);
+}
+
+/**
+ * @brief Commands::writeNewAppDataAsync
+ * Write a chunk of a new firmware to the current target. Firmwares that
+ * include the offset in the reply have it matched to the chunk, the replies
+ * of older firmwares are matched in the order the chunks were sent.
+ */
+CommandRequestPtr Commands::writeNewAppDataAsync(QByteArray data, quint32 offset, HW_TYPE hwType,
+                                                 QString hwName, int retries)
+{
+    return request(COMM_WRITE_NEW_APP_DATA, [this, data, offset, hwType, hwName]() {
+        writeNewAppData(data, offset, false, hwType, hwName);
+    }, [offset](const QByteArray &payload) {
+        return payload.size() < 5 || writeReplyMatches(payload, offset);
+    }, 3000, retries);
+}
+
 void Commands::timerSlot()
 {
-    if (mTimeoutFwVer > 0) mTimeoutFwVer--;
-    if (mTimeoutMcconf > 0) {
-        mTimeoutMcconf--;
-        if (mTimeoutMcconf == 0) {
-            mCheckNextMcConfig = false;
-        }
-    }
-    if (mTimeoutAppconf > 0) mTimeoutAppconf--;
-    if (mTimeoutValues > 0) mTimeoutValues--;
-    if (mTimeoutValuesSetup > 0) mTimeoutValuesSetup--;
-    if (mTimeoutImuData > 0) mTimeoutImuData--;
-    if (mTimeoutDecPpm > 0) mTimeoutDecPpm--;
-    if (mTimeoutDecAdc > 0) mTimeoutDecAdc--;
-    if (mTimeoutDecChuk > 0) mTimeoutDecChuk--;
-    if (mTimeoutPingCan > 0) {
-        mTimeoutPingCan--;
-        if (mTimeoutPingCan == 0) {
-            emit pingCanRx(QVector<int>(), true);
-            qWarning() << "CAN ping timed out";
+    // Replies set the counters to 0, so reaching 0 here is a timeout. Reads
+    // that belong to a request are counted when the request times out.
+    auto tick = [this](int &timeout, int packetId) {
+        if (timeout > 0) {
+            timeout--;
+            if (timeout == 0) {
+                bool hasRequest = false;
+                for (const auto &r: mRequests) {
+                    if (r->packetId() == packetId) {
+                        hasRequest = true;
+                        break;
+                    }
+                }
+
+                if (!hasRequest) {
+                    mTimeoutTotal++;
+                }
+
+                return true;
+            }
         }
+        return false;
+    };
+
+    tick(mTimeoutFwVer, COMM_FW_VERSION);
+    if (tick(mTimeoutMcconf, COMM_GET_MCCONF)) {
+        mCheckNextMcConfig = false;
+    }
+    tick(mTimeoutAppconf, COMM_GET_APPCONF);
+    tick(mTimeoutValues, COMM_GET_VALUES);
+    tick(mTimeoutValuesSetup, COMM_GET_VALUES_SETUP);
+    tick(mTimeoutImuData, COMM_GET_IMU_DATA);
+    tick(mTimeoutDecPpm, COMM_GET_DECODED_PPM);
+    tick(mTimeoutDecAdc, COMM_GET_DECODED_ADC);
+    tick(mTimeoutDecChuk, COMM_GET_DECODED_CHUK);
+    if (tick(mTimeoutPingCan, COMM_PING_CAN)) {
+        emit pingCanRx(QVector<int>(), true);
+        qWarning() << "CAN ping timed out";
     }
     for (int i = 0;i < mTimeoutCustomConf.size();i++) {
-        if (mTimeoutCustomConf.at(i) > 0) mTimeoutCustomConf[i]--;
+        tick(mTimeoutCustomConf[i], COMM_GET_CUSTOM_CONFIG);
+    }
+
+    tick(mTimeoutBmsVal, COMM_BMS_GET_VALUES);
+    tick(mTimeoutStats, COMM_GET_STATS);
+}
+
+/**
+ * @brief Commands::timeoutCount
+ * @return
+ * Number of commands that did not get a reply in time since start.
+ */
+quint64 Commands::timeoutCount() const
+{
+    return mTimeoutTotal;
+}
+
+int Commands::currentTarget()
+{
+    return mSendCan ? mCanId : -1;
+}
+
+void Commands::completeRequest(int packetId, const QByteArray &payload, const QVariant &result)
+{
+    // Iterate over a copy, as callbacks can start new requests
+    auto reqs = mRequests;
+
+    // Replies in an envelope belong to the request with the same sequence
+    // number. Other replies are matched by their contents.
+    if (mRxSeq >= 0) {
+        for (const auto &r: reqs) {
+            if (r->packetId() == packetId && int(r->seq() & 0xFFFF) == mRxSeq &&
+                    r->matches(payload)) {
+                r->complete(payload, result);
+                return;
+            }
+        }
+    }
+
+    for (const auto &r: reqs) {
+        if (r->packetId() == packetId && r->matches(payload)) {
+            r->complete(payload, result);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Commands::trackConfTransfer
+ * Remember a configuration read or write until its reply arrives, so that the
+ * reply can be attributed to the target it was sent to.
+ *
+ * @param packetId
+ * The command that was sent.
+ *
+ * @param target
+ * The target it was sent to, -1 for the local device.
+ *
+ * @param conf
+ * The configuration that was written, or null for reads.
+ */
+void Commands::trackConfTransfer(int packetId, int target, QSharedPointer<ConfigParams> conf)
+{
+    ConfTransfer t;
+    t.packetId = packetId;
+    t.target = target;
+    t.seq = (mTxSeq >= 0 && mSeqEnvelopeTargets.contains(target)) ? mTxSeq : -1;
+    t.sentAt = QDateTime::currentMSecsSinceEpoch();
+    t.conf = conf;
+    mConfTransfers.append(t);
+
+    // Transfers that never got a reply should not pile up
+    while (mConfTransfers.size() > 32) {
+        mConfTransfers.removeFirst();
     }
+}
 
-    if (mTimeoutBmsVal > 0) mTimeoutBmsVal--;
-    if (mTimeoutStats > 0) mTimeoutStats--;
+/**
+ * @brief Commands::takeConfTransfer
+ * Take the transfer that the reply being processed belongs to. Replies in an
+ * envelope are matched by their sequence number, other replies by order.
+ * Transfers that are older than the longest timeout are dropped, as their
+ * replies are not coming anymore.
+ *
+ * @param packetId
+ * The command of the reply.
+ *
+ * @return
+ * The transfer, with target -2 if there was none.
+ */
+Commands::ConfTransfer Commands::takeConfTransfer(int packetId)
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (int i = 0;i < mConfTransfers.size();i++) {
+        if ((now - mConfTransfers.at(i).sentAt) > 5000) {
+            mConfTransfers.removeAt(i);
+            i--;
+        }
+    }
+
+    for (int i = 0;i < mConfTransfers.size();i++) {
+        const auto &t = mConfTransfers.at(i);
+        if (t.packetId == packetId && (mRxSeq < 0 || t.seq == mRxSeq)) {
+            return mConfTransfers.takeAt(i);
+        }
+    }
+
+    ConfTransfer none;
+    none.packetId = packetId;
+    none.target = -2;
+    none.seq = -1;
+    none.sentAt = now;
+    return none;
 }
 
 void Commands::emitData(QByteArray data)
@@ -2306,6 +3122,17 @@ void Commands::emitData(QByteArray data)
         }
     }
 
+    if (data.at(0) == COMM_GET_MCCONF || data.at(0) == COMM_GET_APPCONF) {
+        trackConfTransfer(data.at(0), currentTarget(), QSharedPointer<ConfigParams>());
+    }
+
+    if (mTxSeq >= 0 && mSeqEnvelopeTargets.contains(currentTarget())) {
+        VByteArray env;
+        env.vbAppendUint8(COMM_SEQ_ENVELOPE);
+        env.vbAppendUint16(quint16(mTxSeq));
+        data.prepend(env);
+    }
+
     if (mSendCan) {
         data.prepend((char)mCanId);
         data.prepend((char)COMM_FORWARD_CAN);
@@ -2338,57 +3165,34 @@ QVariantList Commands::fileBlockList(QString path)
 {
     mFileShouldCancel = false;
 
-    auto waitRes = [this](QList<FILE_LIST_ENTRY> &filesNow) {
-        bool res = false;
-        bool more = false;
-
-        QEventLoop loop;
-        QTimer timeoutTimer;
-        timeoutTimer.setSingleShot(true);
-        timeoutTimer.start(1500);
-        auto conn = connect(this, &Commands::fileListRx,
-                            [&res,&loop,&filesNow,&more](bool hasMore, QList<FILE_LIST_ENTRY> files) {
-            filesNow.append(files);
-            res = true;
-            more = hasMore;
-            loop.quit();
-        });
-
-        connect(&timeoutTimer, SIGNAL(timeout()), &loop, SLOT(quit()));
-        loop.exec();
-
-        disconnect(conn);
-        return qMakePair(res, more);
-    };
+    QList<FILE_LIST_ENTRY> files;
+    bool ok = true;
+    bool more = true;
 
-    auto waitResRetry = [waitRes,path,this](QList<FILE_LIST_ENTRY> &filesNow) {
+    while (more && !mFileShouldCancel) {
         QString from = "";
-        if (!filesNow.isEmpty()) {
-            from = filesNow.last().name;
-        }
-        fileList(path, from);
-        auto res = waitRes(filesNow);
-        int retries = 3;
-        while (!res.first && retries > 0) {
-            fileList(path, from);
-            res = waitRes(filesNow);
-            retries--;
+        if (!files.isEmpty()) {
+            from = files.last().name;
         }
-        return res;
-    };
-
-    QList<FILE_LIST_ENTRY> files;
-    auto res = waitResRetry(files);
-
-    while (res.second) {
-        res = waitResRetry(files);
 
-        if (mFileShouldCancel) {
+        auto req = fileListAsync(path, from);
+        if (!req->wait()) {
+            ok = false;
             break;
         }
+
+        VByteArray vb(req->reply());
+        more = vb.vbPopFrontInt8();
+        while (vb.size() > 0) {
+            FILE_LIST_ENTRY f;
+            f.isDir = vb.vbPopFrontInt8();
+            f.size = vb.vbPopFrontInt32();
+            f.name = vb.vbPopFrontString();
+            files.append(f);
+        }
     }
 
-    if (!res.first) {
+    if (!ok) {
         qWarning() << "Could not list files";
     }
 
@@ -2409,63 +3213,40 @@ QByteArray Commands::fileBlockRead(QString path)
 {
     mFileShouldCancel = false;
 
-    auto waitRes = [this](QByteArray &dataNow, qint32 offsetNow) {
-        qint32 sizeRet = -1.0;
-
-        QEventLoop loop;
-        QTimer timeoutTimer;
-        timeoutTimer.setSingleShot(true);
-        timeoutTimer.start(1500);
-        auto conn = connect(this, &Commands::fileReadRx,
-                            [&sizeRet,&loop,&dataNow,&offsetNow]
-                            (qint32 offset, qint32 size, QByteArray data) {
-            if (offset == offsetNow) {
-                sizeRet = size;
-                dataNow.append(data);
-            } else {
-                qWarning() << "Wrong offset";
-            }
-            loop.quit();
-        });
+    QElapsedTimer t;
+    t.start();
 
-        connect(&timeoutTimer, SIGNAL(timeout()), &loop, SLOT(quit()));
-        loop.exec();
+    QByteArray data;
+    qint32 size = -1;
 
-        disconnect(conn);
-        return sizeRet;
-    };
+    do {
+        auto req = fileReadAsync(path, data.size());
+        if (!req->wait()) {
+            if (mFileShouldCancel) {
+                return QByteArray();
+            }
 
-    auto waitResRetry = [waitRes,path,this](QByteArray &dataNow, qint32 offsetNow) {
-        fileRead(path, offsetNow);
-        auto res = waitRes(dataNow, offsetNow);
-        int retries = 3;
-        while (res < 0 && retries > 0) {
-            fileRead(path, offsetNow);
-            res = waitRes(dataNow, offsetNow);
-            retries--;
+            qWarning() << "Could not read file";
+            return QByteArray();
         }
-        return res;
-    };
 
-    QElapsedTimer t;
-    t.start();
-
-    QByteArray data;
-    auto res = waitResRetry(data, 0);
+        VByteArray vb(req->reply());
+        vb.vbPopFrontInt32();
+        size = vb.vbPopFrontInt32();
+        data.append(vb);
 
-    while (res >= 0 && data.size() < res) {
-        mFilePercentage = (double(data.size()) / double(res)) * 100.0;
-        mFileSpeed = (double(data.size()) / double(t.elapsed())) * 1000.0;
-        emit fileProgress(data.size(), res, mFilePercentage, mFileSpeed);
-        res = waitResRetry(data, data.size());
+        if (size >= 0 && data.size() < size) {
+            mFilePercentage = (double(data.size()) / double(size)) * 100.0;
+            mFileSpeed = (double(data.size()) / double(t.elapsed())) * 1000.0;
+            emit fileProgress(data.size(), size, mFilePercentage, mFileSpeed);
+        }
 
         if (mFileShouldCancel) {
             return QByteArray();
-            break;
         }
-    }
+    } while (size >= 0 && data.size() < size);
 
-    if (res < 0) {
+    if (size < 0) {
         qWarning() << "Could not read file";
         return QByteArray();
     }
@@ -2477,38 +3258,26 @@ bool Commands::fileBlockWrite(QString path, QByteArray data)
 {
     mFileShouldCancel = false;
 
-    auto waitRes = [this]() {
-        bool res = false;
-
-        QEventLoop loop;
-        QTimer timeoutTimer;
-        timeoutTimer.setSingleShot(true);
-        timeoutTimer.start(1500);
-        auto conn = connect(this, &Commands::fileWriteRx,
-                            [&res,&loop]
-                            (qint32 offset, bool ok) {
-            (void)offset;
-            res = ok;
-            loop.quit();
-        });
-
-        connect(&timeoutTimer, SIGNAL(timeout()), &loop, SLOT(quit()));
-        loop.exec();
-        disconnect(conn);
+    // Timeouts are retried by the request, a rejected write is sent again here
+    auto writeChunk = [this, path](qint32 offsetNow, qint32 size, QByteArray dataNow) {
+        for (int i = 0;i < 4;i++) {
+            auto req = fileWriteAsync(path, offsetNow, size, dataNow, 3 - i);
+            if (!req->wait()) {
+                return false;
+            }
 
-        return res;
-    };
+            VByteArray vb(req->reply());
+            vb.vbPopFrontInt32();
+            if (vb.vbPopFrontInt8()) {
+                return true;
+            }
 
-    auto waitResRetry = [waitRes,path,this](qint32 offsetNow, qint32 size, QByteArray dataNow) {
-        fileWrite(path, offsetNow, size, dataNow);
-        auto res = waitRes();
-        int retries = 3;
-        while (!res && retries > 0) {
-            fileWrite(path, offsetNow, size, dataNow);
-            res = waitRes();
-            retries--;
+            if (mFileShouldCancel) {
+                break;
+            }
         }
-        return res;
+
+        return false;
     };
 
     const int chunkSize = 384;
@@ -2519,19 +3288,17 @@ bool Commands::fileBlockWrite(QString path, QByteArray data)
     t.start();
 
     qint32 offset = 0;
-    auto res = waitResRetry(offset, size, data.mid(0, sz));
+    auto res = writeChunk(offset, size, data.mid(0, sz));
     offset += sz;
-    data.remove(0, sz);
 
-    while (res && data.size() > 0) {
-        mFilePercentage = (double(size - data.size()) / double(size)) * 100.0;
-        mFileSpeed = (double(size - data.size()) / double(t.elapsed())) * 1000.0;
-        emit fileProgress(size - data.size(), size, mFilePercentage, mFileSpeed);
+    while (res && offset < size) {
+        mFilePercentage = (double(offset) / double(size)) * 100.0;
+        mFileSpeed = (double(offset) / double(t.elapsed())) * 1000.0;
+        emit fileProgress(offset, size, mFilePercentage, mFileSpeed);
 
-        sz = data.size() > chunkSize ? chunkSize : data.size();
-        res = waitResRetry(offset, size, data.mid(0, sz));
+        sz = (size - offset) > chunkSize ? chunkSize : (size - offset);
+        res = writeChunk(offset, size, data.mid(offset, sz));
         offset += sz;
-        data.remove(0, sz);
 
         if (mFileShouldCancel) {
             return false;
@@ -2545,83 +3312,44 @@ bool Commands::fileBlockMkdir(QString path)
 {
     mFileShouldCancel = false;
 
-    auto waitRes = [this]() {
-        bool res = false;
-
-        QEventLoop loop;
-        QTimer timeoutTimer;
-        timeoutTimer.setSingleShot(true);
-        timeoutTimer.start(1500);
-        auto conn = connect(this, &Commands::fileMkdirRx,
-                            [&res,&loop](bool ok) {
-            res = ok;
-            loop.quit();
-        });
-
-        connect(&timeoutTimer, SIGNAL(timeout()), &loop, SLOT(quit()));
-        loop.exec();
-        disconnect(conn);
-
-        return res;
-    };
+    for (int i = 0;i < 4;i++) {
+        auto req = fileMkdirAsync(path, 3 - i);
+        if (!req->wait()) {
+            return false;
+        }
 
-    auto waitResRetry = [waitRes,path,this]() {
-        fileMkdir(path);
-        auto res = waitRes();
-        int retries = 3;
-        while (!res && retries > 0) {
-            fileMkdir(path);
-            res = waitRes();
-            retries--;
+        if (req->reply().size() >= 1 && req->reply().at(0)) {
+            return true;
         }
-        return res;
-    };
+    }
 
-    return waitResRetry();
+    return false;
 }
 
 bool Commands::fileBlockRemove(QString path)
 {
     mFileShouldCancel = false;
 
-    auto waitRes = [this]() {
-        bool res = false;
-
-        QEventLoop loop;
-        QTimer timeoutTimer;
-        timeoutTimer.setSingleShot(true);
-        timeoutTimer.start(1500);
-        auto conn = connect(this, &Commands::fileRemoveRx,
-                            [&res,&loop](bool ok) {
-            res = ok;
-            loop.quit();
-        });
-
-        connect(&timeoutTimer, SIGNAL(timeout()), &loop, SLOT(quit()));
-        loop.exec();
-        disconnect(conn);
-
-        return res;
-    };
+    for (int i = 0;i < 4;i++) {
+        auto req = fileRemoveAsync(path, 3 - i);
+        if (!req->wait()) {
+            return false;
+        }
 
-    auto waitResRetry = [waitRes,path,this]() {
-        fileRemove(path);
-        auto res = waitRes();
-        int retries = 3;
-        while (!res && retries > 0) {
-            fileRemove(path);
-            res = waitRes();
-            retries--;
+        if (req->reply().size() >= 1 && req->reply().at(0)) {
+            return true;
         }
-        return res;
-    };
+    }
 
-    return waitResRetry();
+    return false;
 }
 
 void Commands::fileBlockCancel()
 {
     mFileShouldCancel = true;
+    cancelRequests(COMM_FILE_LIST);
+    cancelRequests(COMM_FILE_READ);
+    cancelRequests(COMM_FILE_WRITE);
     mFilePercentage = 0.0;
     mFileSpeed = 0;
     emit fileProgress(0, 0, mFilePercentage, mFileSpeed);
@@ -2721,9 +3449,118 @@ QByteArray Commands::bmReadMemWait(uint32_t addr, quint16 size, int timeoutMs)
     loop.exec();
 
     disconnect(conn);
+
+    if (res == -10) {
+        bmReadsGivenUp(1);
+    }
+
     return resData;
 }
 
+/**
+ * @brief Commands::bmReadMemRegion
+ * Read a memory region of any size from the SWD target. The region is read in
+ * chunks, with several reads outstanding at a time so that the round trip
+ * time only has to be paid once per window instead of once per chunk. The
+ * replies do not carry the address, but they come back in the same order as
+ * the reads were sent.
+ *
+ * @param addr
+ * Start address.
+ *
+ * @param size
+ * Number of bytes to read.
+ *
+ * @param timeoutMs
+ * Maximum time to wait for each reply.
+ *
+ * @return
+ * The data, or an empty array if the read failed or timed out. The progress
+ * is reported with bmReadMemRegionProgress.
+ */
+QByteArray Commands::bmReadMemRegion(uint32_t addr, int size, int timeoutMs)
+{
+    const int chunkSize = 400;
+    const int maxInFlight = 4;
+
+    QByteArray res;
+    if (size <= 0) {
+        return res;
+    }
+
+    res.reserve(size);
+    QList<int> inFlight;
+    int requested = 0;
+    bool ok = true;
+
+    QEventLoop loop;
+    QTimer timeoutTimer;
+    timeoutTimer.setSingleShot(true);
+
+    auto readMore = [&]() {
+        while (inFlight.size() < maxInFlight && requested < size) {
+            int sz = qMin(chunkSize, size - requested);
+            bmReadMem(addr + uint32_t(requested), quint16(sz));
+            inFlight.append(sz);
+            requested += sz;
+        }
+    };
+
+    auto conn = connect(this, &Commands::bmReadMemRes, [&]
+                        (int rdRes, QByteArray data) {
+        if (inFlight.isEmpty()) {
+            return;
+        }
+
+        int expected = inFlight.takeFirst();
+        if (rdRes != 1 || data.size() != expected) {
+            ok = false;
+            loop.quit();
+            return;
+        }
+
+        res.append(data);
+        emit bmReadMemRegionProgress(res.size(), size);
+
+        if (res.size() >= size) {
+            loop.quit();
+        } else {
+            readMore();
+            timeoutTimer.start(timeoutMs);
+        }
+    });
+
+    connect(&timeoutTimer, SIGNAL(timeout()), &loop, SLOT(quit()));
+    readMore();
+    timeoutTimer.start(timeoutMs);
+    loop.exec();
+
+    disconnect(conn);
+
+    // The replies to these can still arrive during the next read
+    bmReadsGivenUp(inFlight.size());
+
+    if (!ok || res.size() != size) {
+        return QByteArray();
+    }
+
+    return res;
+}
+
+void Commands::bmReadsGivenUp(int num)
+{
+    if (num <= 0) {
+        return;
+    }
+
+    if (mBmReadsStaleTime.isValid() && mBmReadsStaleTime.elapsed() >= 2000) {
+        mBmReadsStale = 0;
+    }
+
+    mBmReadsStale += num;
+    mBmReadsStaleTime.start();
+}
+
 int Commands::bmWriteMemWait(uint32_t addr, QByteArray data, int timeoutMs)
 {
     bmWriteFlash(addr, data);
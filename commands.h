@@ -25,8 +25,11 @@
 #include <QMap>
 #include <QVariant>
 #include <QVariantList>
+#include <QSet>
+#include <QElapsedTimer>
 #include "datatypes.h"
 #include "configparams.h"
+#include "commandrequest.h"
 
 class Commands : public QObject
 {
@@ -40,9 +43,12 @@ public:
     Q_INVOKABLE bool getSendCan();
     Q_INVOKABLE void setCanSendId(unsigned int id);
     Q_INVOKABLE int getCanSendId();
+    void sendPacketTo(int canId, QByteArray data);
+    void sendConfigTo(int canId, QByteArray data);
     void setMcConfig(ConfigParams *mcConfig);
     void setAppConfig(ConfigParams *appConfig);
     void checkMcConfig();
+    Q_INVOKABLE void invalidateConfigShadow();
     Q_INVOKABLE void emitEmptyValues();
     Q_INVOKABLE void emitEmptySetupValues();
     Q_INVOKABLE void emitEmptyStats();
@@ -59,6 +65,7 @@ public:
     Q_INVOKABLE static QString faultToStr(mc_fault_code fault);
 
     Q_INVOKABLE QByteArray bmReadMemWait(uint32_t addr, quint16 size, int timeoutMs = 3000);
+    Q_INVOKABLE QByteArray bmReadMemRegion(uint32_t addr, int size, int timeoutMs = 3000);
     Q_INVOKABLE int bmWriteMemWait(uint32_t addr, QByteArray data, int timeoutMs = 3000);
 
     Q_INVOKABLE void setOdometer(unsigned odometer_meters);
@@ -86,6 +93,36 @@ public:
     Q_INVOKABLE double getFilePercentage() const;
     Q_INVOKABLE double getFileSpeed() const;
 
+    CommandRequestPtr request(int packetId, std::function<void()> send,
+                              CommandRequest::Matcher matcher = nullptr,
+                              int timeoutMs = 1500, int retries = 0);
+    void cancelRequests(int packetId = -1);
+    int requestsInFlight() const;
+    quint64 timeoutCount() const;
+    void setSeqEnvelope(int target, bool enabled);
+    void resetSeqEnvelope();
+    Q_INVOKABLE bool getSeqEnvelope(int target = -2) const;
+
+    CommandRequestPtr getFwVersionAsync(int timeoutMs = 4000);
+    CommandRequestPtr getValuesAsync(int timeoutMs = 4000);
+    CommandRequestPtr measureRLAsync(int timeoutMs = 8000);
+    CommandRequestPtr detectAllFocAsync(int canId, bool detect_can, double max_power_loss,
+                                        double min_current_in, double max_current_in,
+                                        double openloop_rpm, double sl_erpm, int timeoutMs = 180000);
+    CommandRequestPtr getMcconfAsync(int timeoutMs = 4000);
+    CommandRequestPtr getAppConfAsync(int timeoutMs = 4000);
+    CommandRequestPtr customConfigGetAsync(int confInd, int timeoutMs = 4000);
+    CommandRequestPtr fileListAsync(QString path, QString from, int retries = 3);
+    CommandRequestPtr fileReadAsync(QString path, qint32 offset, int retries = 3);
+    CommandRequestPtr fileWriteAsync(QString path, qint32 offset, qint32 size, QByteArray data, int retries = 3);
+    CommandRequestPtr fileMkdirAsync(QString path, int retries = 3);
+    CommandRequestPtr fileRemoveAsync(QString path, int retries = 3);
+    CommandRequestPtr qmlUiWriteAsync(QByteArray data, quint32 offset, int retries = 4);
+    CommandRequestPtr lispWriteCodeAsync(QByteArray data, quint32 offset, int retries = 4);
+    CommandRequestPtr eraseNewAppAsync(quint32 fwSize, HW_TYPE hwType, QString hwName, int timeoutMs = 20000);
+    CommandRequestPtr writeNewAppDataAsync(QByteArray data, quint32 offset, HW_TYPE hwType,
+                                           QString hwName, int retries = 3);
+
 signals:
     void dataToSend(QByteArray &data);
 
@@ -97,6 +134,7 @@ signals:
     void valuesReceived(MC_VALUES values, unsigned int mask);
     void printReceived(QString str);
     void samplesReceived(QByteArray bytes);
+    void sampleBatchReceived(QByteArray bytes);
     void rotorPosReceived(double pos);
     void experimentSamplesReceived(QVector<double> samples);
     void bldcDetectReceived(bldc_detect param);
@@ -130,6 +168,7 @@ signals:
     void plotAddGraphReceived(QString name);
     void plotSetGraphReceived(int graph);
     void bmReadMemRes(int res, QByteArray data);
+    void bmReadMemRegionProgress(int done, int total);
     void deserializeConfigFailed(bool isMc, bool isApp);
     void canFrameRx(QByteArray data, quint32 id, bool isExtended);
     void bmsValuesRx(BMS_VALUES val);
@@ -184,12 +223,17 @@ public slots:
     void setHandbrake(double current);
     void setDetect(disp_pos_mode mode);
     void samplePrint(debug_sampling_mode mode, int sample_len, int dec, bool raw);
+    void samplePrintBatch(debug_sampling_mode mode, int sample_len, int dec, bool raw);
+    void sampleBatchAck(int first, int count);
+    void sampleBatchResend(int first, int count);
     void getMcconf();
     void getMcconfDefault();
     void setMcconf(bool check = true);
+    QStringList setMcconfDelta(bool store = true);
     void getAppConf();
     void getAppConfDefault();
     void setAppConf();
+    QStringList setAppConfDelta();
     void setAppConfNoStore();
     void detectMotorParam(double current, double min_rpm, double low_duty);
     void reboot();
@@ -210,11 +254,11 @@ public slots:
     void pairNrf(int ms);
     void gpdSetFsw(float fsw);
     void getGpdBufferSizeLeft();
-    void gpdFillBuffer(QVector<float> samples);
+    void gpdFillBuffer(const QVector<float> &samples);
     void gpdOutputSample(float sample);
     void gpdSetMode(gpd_output_mode mode);
-    void gpdFillBufferInt8(QVector<qint8> samples);
-    void gpdFillBufferInt16(QVector<qint16> samples);
+    void gpdFillBufferInt8(const QVector<qint8> &samples);
+    void gpdFillBufferInt16(const QVector<qint16> &samples);
     void gpdSetBufferIntScale(float scale);
     void getValuesSetup();
     void setMcconfTemp(const MCCONF_TEMP &conf, bool is_setup, bool store,
@@ -291,7 +335,23 @@ private slots:
     void timerSlot();
 
 private:
+    // A configuration read or write, with the target it was sent to
+    struct ConfTransfer {
+        int packetId;
+        int target;
+        int seq;
+        qint64 sentAt;
+        QSharedPointer<ConfigParams> conf; // What was written, null for reads
+    };
+
     void emitData(QByteArray data);
+    int currentTarget();
+    void completeRequest(int packetId, const QByteArray &payload, const QVariant &result);
+    void trackConfTransfer(int packetId, int target, QSharedPointer<ConfigParams> conf);
+    void bmReadsGivenUp(int num);
+    ConfTransfer takeConfTransfer(int packetId);
+    QByteArray detectAllFocPacket(bool detect_can, double max_power_loss, double min_current_in,
+                                  double max_current_in, double openloop_rpm, double sl_erpm);
 
     QTimer *mTimer;
     bool mSendCan;
@@ -303,11 +363,44 @@ private:
     QVector<int> mCompatibilityCommands; // int to be QML-compatible
     QMap<int, BMS_VALUES> mBmsValues;
 
+    // Requests waiting for their reply, in the order they were sent
+    QList<CommandRequestPtr> mRequests;
+    quint32 mRequestSeq;
+
+    // Sequence-tagged envelope, see COMM_SEQ_ENVELOPE. Support is tracked per
+    // target (-1 for the local device, otherwise the CAN-id) from the
+    // replies to getFwVersionAsync. The sequence numbers are -1 when the
+    // packet being sent or processed has no envelope.
+    QSet<int> mSeqEnvelopeTargets;
+    int mTxSeq;
+    int mRxSeq;
+
+    // COMM_SAMPLE_PRINT_BATCH is only accepted after it has been requested
+    bool mSampleBatchRequested;
+
+    // Replies to SWD memory reads that timed out, which are dropped when
+    // they arrive within a while after mBmReadsStaleTime.
+    int mBmReadsStale;
+    QElapsedTimer mBmReadsStaleTime;
+
     ConfigParams *mMcConfig;
     ConfigParams *mAppConfig;
     ConfigParams mMcConfigLast;
     bool mCheckNextMcConfig;
 
+    // Local copies of what the device is known to have, used for delta writes.
+    // The target is the CAN-id they were read from, -1 for the local device
+    // and -2 when the copy is not valid.
+    ConfigParams mMcConfigShadow;
+    ConfigParams mAppConfigShadow;
+    int mMcConfigShadowTarget;
+    int mAppConfigShadowTarget;
+
+    // Configuration reads and writes waiting for their reply. The shadow
+    // copies are only updated from a reply that belongs to the current
+    // target, and from the ack of a write.
+    QList<ConfTransfer> mConfTransfers;
+
     int mTimeoutCount;
     int mTimeoutFwVer;
     int mTimeoutMcconf;
@@ -322,6 +415,7 @@ private:
     QVector<int> mTimeoutCustomConf;
     int mTimeoutBmsVal;
     int mTimeoutStats;
+    quint64 mTimeoutTotal;
 
     double mFilePercentage;
     double mFileSpeed;
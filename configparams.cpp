@@ -28,6 +28,12 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QBuffer>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QDir>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <cmath>
 #include "utility.h"
 #include "lzokay/lzokay.hpp"
@@ -40,6 +46,7 @@ ConfigParams::ConfigParams(QObject *parent) : QObject(parent)
     mConfigVersion = -1;
     mStoreConfigVersion = true;
     mUpdateCnt = 0;
+    mXmlSections = 0;
 }
 
 void ConfigParams::addParam(const QString &name, ConfigParam param)
@@ -1326,11 +1333,14 @@ bool ConfigParams::setParamsXML(QXmlStreamReader &stream)
         }
     }
 
+    mXmlSections = 0;
+
     if (nameFound) {
         while (stream.readNextStartElement()) {
             QString nameFirst = stream.name().toString();
 
             if (nameFirst == "Params") {
+                mXmlSections |= ParamsSectionParams;
                 clearParams();
 
                 while (stream.readNextStartElement()) {
@@ -1400,6 +1410,7 @@ bool ConfigParams::setParamsXML(QXmlStreamReader &stream)
                     addParam(paramName, p);
                 }
             } else if (nameFirst == "SerOrder") {
+                mXmlSections |= ParamsSectionSerOrder;
                 mSerializeOrder.clear();
                 while (stream.readNextStartElement()) {
                     QString name = stream.name().toString();
@@ -1413,6 +1424,7 @@ bool ConfigParams::setParamsXML(QXmlStreamReader &stream)
                 }
             } else if (nameFirst == "Grouping") {
                 // TODO: This can be done much more efficiently. Does probably not matter too much though.
+                mXmlSections |= ParamsSectionGrouping;
                 mParamGrouping.clear();
                 while (stream.readNextStartElement()) {
                     QString name0 = stream.name().toString();
@@ -1500,6 +1512,14 @@ bool ConfigParams::loadParamsXml(QString fileName)
         return false;
     }
 
+    // The bundled definitions are loaded for every connection, so keep a
+    // binary copy of them instead of parsing the XML each time.
+    if (fileName.startsWith(":")) {
+        QByteArray xml = file.readAll();
+        file.close();
+        return loadParamsXmlCached(xml, false);
+    }
+
     QXmlStreamReader stream(&file);
     bool res = setParamsXML(stream);
 
@@ -1520,9 +1540,273 @@ QByteArray ConfigParams::getCompressedParamsXml()
 
 bool ConfigParams::loadCompressedParamsXml(QByteArray data)
 {
-    QByteArray uncompressed = qUncompress(data);
-    QXmlStreamReader stream(uncompressed);
-    bool res = setParamsXML(stream);
+    return loadParamsXmlCached(data, true);
+}
+
+// Identifies the binary layout. It changes when the fields written by
+// getParamsBinary or the ConfigParam struct change, so that cache files
+// written by another build are not loaded.
+static quint32 paramsBinaryLayout()
+{
+    static quint32 layout = 0;
+    if (layout == 0) {
+        QByteArray desc = "name type longName description cDefine valDouble valInt valString "
+                          "enumNames maxDouble minDouble stepDouble editorDecimalsDouble maxInt "
+                          "minInt stepInt maxLen vTx vTxDoubleScale suffix editorScale "
+                          "editAsPercentage showDisplay transmittable;serOrder;grouping;";
+        desc += QByteArray::number(int(sizeof(ConfigParam)));
+        desc += ";";
+        desc += QByteArray::number(QDataStream::Qt_5_0);
+
+        VByteArray hash(QCryptographicHash::hash(desc, QCryptographicHash::Md5));
+        layout = hash.vbPopFrontUint32() | 1;
+    }
+    return layout;
+}
+
+/**
+ * @brief ConfigParams::getParamsBinary
+ * Get the parameter descriptors, serialization order and grouping in a binary
+ * form that is much faster to load than the XML. This is only meant as a local
+ * cache, the XML remains the interchange format.
+ *
+ * @param sections
+ * The sections to include, see ParamsSectionParams etc. Loading the data
+ * only replaces these sections, like setParamsXML does for XML that only has
+ * some of them.
+ *
+ * @return
+ * The binary data.
+ */
+QByteArray ConfigParams::getParamsBinary(quint32 sections)
+{
+    QByteArray res;
+    QDataStream out(&res, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+
+    out << quint32(0x56435042) << paramsBinaryLayout() << sections;
+
+    if (sections & ParamsSectionParams) {
+        out << qint32(mParamList.size());
+        for (const auto &name: mParamList) {
+            const ConfigParam &p = mParams[name];
+
+            out << name;
+            out << qint32(p.type);
+            out << p.longName << p.description << p.cDefine;
+            out << p.valDouble << qint32(p.valInt) << p.valString;
+            out << p.enumNames;
+            out << p.maxDouble << p.minDouble << p.stepDouble;
+            out << qint32(p.editorDecimalsDouble);
+            out << qint32(p.maxInt) << qint32(p.minInt) << qint32(p.stepInt);
+            out << qint32(p.maxLen);
+            out << qint32(p.vTx) << p.vTxDoubleScale;
+            out << p.suffix << p.editorScale;
+            out << p.editAsPercentage << p.showDisplay << p.transmittable;
+        }
+    }
+
+    if (sections & ParamsSectionSerOrder) {
+        out << mSerializeOrder;
+    }
+
+    if (sections & ParamsSectionGrouping) {
+        out << qint32(mParamGrouping.size());
+        for (const auto &g: mParamGrouping) {
+            out << g.first << qint32(g.second.size());
+            for (const auto &sg: g.second) {
+                out << sg.first << sg.second;
+            }
+        }
+    }
+
+    return res;
+}
+
+/**
+ * @brief ConfigParams::setParamsBinary
+ * Load parameter descriptors from data created with getParamsBinary.
+ *
+ * @param data
+ * The binary data. This is only read during the call, so it can point to
+ * mapped memory.
+ *
+ * @return
+ * True on success, false if the data is not valid.
+ */
+bool ConfigParams::setParamsBinary(const QByteArray &data)
+{
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic, layout, sections;
+    in >> magic >> layout >> sections;
+    if (in.status() != QDataStream::Ok || magic != 0x56435042 || layout != paramsBinaryLayout()) {
+        return false;
+    }
+
+    if (sections & ParamsSectionParams) {
+        clearParams();
+
+        qint32 paramNum;
+        in >> paramNum;
+        for (int i = 0;i < paramNum && in.status() == QDataStream::Ok;i++) {
+            QString name;
+            ConfigParam p;
+            qint32 type, valInt, decimals, maxInt, minInt, stepInt, maxLen, vTx;
+
+            in >> name;
+            in >> type;
+            in >> p.longName >> p.description >> p.cDefine;
+            in >> p.valDouble >> valInt >> p.valString;
+            in >> p.enumNames;
+            in >> p.maxDouble >> p.minDouble >> p.stepDouble;
+            in >> decimals;
+            in >> maxInt >> minInt >> stepInt;
+            in >> maxLen;
+            in >> vTx >> p.vTxDoubleScale;
+            in >> p.suffix >> p.editorScale;
+            in >> p.editAsPercentage >> p.showDisplay >> p.transmittable;
+
+            p.type = CFG_T(type);
+            p.valInt = valInt;
+            p.editorDecimalsDouble = decimals;
+            p.maxInt = maxInt;
+            p.minInt = minInt;
+            p.stepInt = stepInt;
+            p.maxLen = maxLen;
+            p.vTx = VESC_TX_T(vTx);
+
+            addParam(name, p);
+        }
+    }
+
+    if (sections & ParamsSectionSerOrder) {
+        mSerializeOrder.clear();
+        in >> mSerializeOrder;
+    }
+
+    if (sections & ParamsSectionGrouping) {
+        mParamGrouping.clear();
+
+        qint32 groupNum;
+        in >> groupNum;
+        for (int i = 0;i < groupNum && in.status() == QDataStream::Ok;i++) {
+            QPair<QString, QList<QPair<QString, QStringList>>> g;
+            qint32 subgroupNum;
+            in >> g.first >> subgroupNum;
+            for (int j = 0;j < subgroupNum && in.status() == QDataStream::Ok;j++) {
+                QPair<QString, QStringList> sg;
+                in >> sg.first >> sg.second;
+                g.second.append(sg);
+            }
+            mParamGrouping.append(g);
+        }
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    mXmlSections = sections;
+    mXmlStatus = tr("OK");
+    return true;
+}
+
+QString ConfigParams::paramsCacheDir()
+{
+    QString path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (path.isEmpty()) {
+        return QString();
+    }
+
+    path += "/params";
+    if (!QDir().mkpath(path)) {
+        return QString();
+    }
+
+    return path;
+}
+
+/**
+ * @brief ConfigParams::pruneParamsCache
+ * Remove the least recently used parameter cache files until the cache is
+ * at most maxBytes large.
+ */
+void ConfigParams::pruneParamsCache(qint64 maxBytes)
+{
+    QString cacheDir = paramsCacheDir();
+    if (cacheDir.isEmpty()) {
+        return;
+    }
+
+    // Newest first. The files are touched when they are used.
+    QFileInfoList files = QDir(cacheDir).entryInfoList({"*.bin"}, QDir::Files, QDir::Time);
+
+    qint64 total = 0;
+    for (const auto &fi: files) {
+        total += fi.size();
+        if (total > maxBytes) {
+            QFile::remove(fi.absoluteFilePath());
+        }
+    }
+}
+
+bool ConfigParams::loadParamsXmlCached(const QByteArray &xml, bool compressed)
+{
+    QString cacheDir = paramsCacheDir();
+    QString cachePath;
+
+    if (!cacheDir.isEmpty()) {
+        cachePath = cacheDir + "/" +
+                QCryptographicHash::hash(xml, QCryptographicHash::Md5).toHex() + ".bin";
+
+        QFile cacheFile(cachePath);
+        if (cacheFile.open(QIODevice::ReadOnly)) {
+            qint64 size = cacheFile.size();
+            uchar *mem = cacheFile.map(0, size);
+            if (mem) {
+                bool ok = setParamsBinary(QByteArray::fromRawData(
+                                              reinterpret_cast<const char*>(mem), int(size)));
+                cacheFile.unmap(mem);
+
+                if (ok) {
+                    // Keep track of when the file was used, for pruning
+                    cacheFile.close();
+                    if (cacheFile.open(QIODevice::ReadWrite)) {
+                        cacheFile.setFileTime(QDateTime::currentDateTime(),
+                                              QFileDevice::FileModificationTime);
+                    }
+                    return true;
+                }
+            }
+
+            qWarning() << "Invalid parameter cache" << cachePath;
+        }
+    }
+
+    bool res = false;
+    if (compressed) {
+        QByteArray uncompressed = qUncompress(xml);
+        QXmlStreamReader stream(uncompressed);
+        res = setParamsXML(stream);
+    } else {
+        QXmlStreamReader stream(xml);
+        res = setParamsXML(stream);
+    }
+
+    if (res && !cachePath.isEmpty()) {
+        QSaveFile cacheFile(cachePath);
+        if (cacheFile.open(QIODevice::WriteOnly)) {
+            cacheFile.write(getParamsBinary(mXmlSections));
+            if (cacheFile.commit()) {
+                // Every custom configuration the device sends gets a file, so
+                // the cache is bounded.
+                pruneParamsCache(32 * 1024 * 1024);
+            }
+        }
+    }
+
     return res;
 }
 
@@ -105,6 +105,16 @@ public:
     bool loadParamsXml(QString fileName);
     QByteArray getCompressedParamsXml();
     bool loadCompressedParamsXml(QByteArray data);
+    enum {
+        ParamsSectionParams = 1,
+        ParamsSectionSerOrder = 2,
+        ParamsSectionGrouping = 4,
+        ParamsSectionAll = 7
+    };
+    QByteArray getParamsBinary(quint32 sections = ParamsSectionAll);
+    bool setParamsBinary(const QByteArray &data);
+    static QString paramsCacheDir();
+    static void pruneParamsCache(qint64 maxBytes);
 
     bool saveCDefines(const QString &fileName, bool wrapIfdef = false);
 
@@ -181,7 +191,11 @@ private:
     bool mStoreConfigVersion;
     int mUpdateCnt;
 
+    // The sections found by the last setParamsXML
+    quint32 mXmlSections;
+
     bool almostEqual(float A, float B, float eps);
+    bool loadParamsXmlCached(const QByteArray &xml, bool compressed);
 
 };
 
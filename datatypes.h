@@ -609,6 +609,11 @@ struct FW_RX_PARAMS {
     Q_PROPERTY(bool nrfNameSupported MEMBER nrfNameSupported)
     Q_PROPERTY(bool nrfPinSupported MEMBER nrfPinSupported)
     Q_PROPERTY(quint32 hwConfCrc MEMBER hwConfCrc)
+    Q_PROPERTY(bool fwDeltaSupported MEMBER fwDeltaSupported)
+    Q_PROPERTY(bool seqEnvelopeSupported MEMBER seqEnvelopeSupported)
+    Q_PROPERTY(bool sampleBatchSupported MEMBER sampleBatchSupported)
+    Q_PROPERTY(quint32 fwImageSize MEMBER fwImageSize)
+    Q_PROPERTY(quint16 fwImageCrc MEMBER fwImageCrc)
 
 public:
     FW_RX_PARAMS() {
@@ -626,6 +631,11 @@ public:
         nrfNameSupported = false;
         nrfPinSupported = false;
         hwConfCrc = 0;
+        fwDeltaSupported = false;
+        seqEnvelopeSupported = false;
+        sampleBatchSupported = false;
+        fwImageSize = 0;
+        fwImageCrc = 0;
     }
 
     Q_INVOKABLE QString hwTypeStr() {
@@ -664,6 +674,11 @@ public:
     bool nrfNameSupported;
     bool nrfPinSupported;
     quint32 hwConfCrc;
+    bool fwDeltaSupported;
+    bool seqEnvelopeSupported;
+    bool sampleBatchSupported;
+    quint32 fwImageSize; // Size and CRC of the running image, 0 if not reported
+    quint16 fwImageCrc;
 
 };
 
@@ -839,6 +854,12 @@ typedef enum {
     DEBUG_SAMPLING_SEND_SINGLE_SAMPLE
 } debug_sampling_mode;
 
+typedef enum {
+    SAMPLE_BATCH_START = 0,
+    SAMPLE_BATCH_ACK,
+    SAMPLE_BATCH_RESEND
+} sample_batch_op;
+
 typedef enum {
 	COMM_FW_VERSION							= 0,
 	COMM_JUMP_TO_BOOTLOADER					= 1,
@@ -1024,6 +1045,19 @@ typedef enum {
 	COMM_SHUTDOWN							= 156,
 } COMM_PACKET_ID;
 
+// Commands that have not been assigned in the firmware. They are kept out of
+// COMM_PACKET_ID, as the firmware can give these ids to something else. They
+// are only sent to, and only accepted from, firmware that reports support for
+// them in COMM_FW_VERSION.
+typedef enum {
+	// Sequence-tagged envelope around another packet. The firmware echoes
+	// the sequence number in front of the reply when it supports this.
+	COMM_SEQ_ENVELOPE						= 157,
+
+	// Sampled data with many samples per packet, scaled to int16
+	COMM_SAMPLE_PRINT_BATCH					= 158,
+} COMM_EXT_PACKET_ID;
+
 // CAN commands
 typedef enum {
     CAN_PACKET_SET_DUTY = 0,
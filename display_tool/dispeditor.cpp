@@ -28,6 +28,26 @@
 #include <QImage>
 #include <QColorDialog>
 #include <QMessageBox>
+#include <QDir>
+#include <QHash>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QProgressDialog>
+#include <QEventLoop>
+#include <QTextStream>
+#include <QRegularExpression>
+
+namespace {
+class FrameJob : public QRunnable
+{
+public:
+    FrameJob(std::function<void()> func) : mFunc(func) {}
+    void run() override { mFunc(); }
+
+private:
+    std::function<void()> mFunc;
+};
+}
 
 DispEditor::DispEditor(QWidget *parent) :
     QWidget(parent),
@@ -100,92 +120,326 @@ void DispEditor::setColors(int colors)
     }
 }
 
-DispEditor::~DispEditor()
+/**
+ * @brief DispEditor::loadScaledImage
+ * Load image from file and scale it so that it covers size.
+ *
+ * @param path
+ * Image file.
+ *
+ * @param size
+ * Display size.
+ *
+ * @param smooth
+ * Use smooth (antialiased) scaling.
+ *
+ * @return
+ * The scaled image, or a null image if loading failed.
+ */
+QImage DispEditor::loadScaledImage(QString path, QSize size, bool smooth)
 {
-    delete ui;
+    QImage img;
+    if (!img.load(path)) {
+        return QImage();
+    }
+
+    QImage img2(img.size(), QImage::Format_ARGB32);
+    img2.fill(Qt::transparent);
+
+    QPainter p(&img2);
+    p.drawImage(0, 0, img);
+    p.end();
+
+    return img2.scaled(size, Qt::KeepAspectRatioByExpanding,
+                       smooth ? Qt::SmoothTransformation : Qt::FastTransformation);
 }
 
-void DispEditor::on_saveCButton_clicked()
+namespace {
+/*
+ * Floyd-Steinberg on a row-major buffer, keeping the upper bits of each
+ * value. Only the current and the next row are touched, so the buffer is
+ * walked linearly.
+ */
+void ditherChannel(int *buf, int w, int h, int bits, bool dither)
 {
-    QString filename = QFileDialog::getSaveFileName(this,
-                                                    tr("Save Binary Image"), "",
-                                                    tr("Bin files (*.bin *.BIN *.Bin)"));
+    const int mask = (0xFF << (8 - bits)) & 0xFF;
 
-    if (!filename.isEmpty()) {
-        if (!filename.endsWith(".bin", Qt::CaseInsensitive)) {
-            filename.append(".bin");
+    for (int y = 0;y < h;y++) {
+        int *row = buf + y * w;
+        int *next = y < (h - 1) ? row + w : nullptr;
+
+        for (int x = 0;x < w;x++) {
+            int pix = qBound(0, row[x], 255);
+            int pixN = pix & mask;
+            int quantError = (pix - pixN) << 12;
+            row[x] = pixN;
+
+            if (!dither) {
+                continue;
+            }
+
+            if (x < (w - 1)) {
+                row[x + 1] += (quantError * 7) >> 16;
+            }
+
+            if (next) {
+                next[x] += (quantError * 5) >> 16;
+
+                if (x > 0) {
+                    next[x - 1] += (quantError * 3) >> 16;
+                }
+
+                if (x < (w - 1)) {
+                    next[x + 1] += (quantError * 1) >> 16;
+                }
+            }
         }
+    }
+}
 
-        QFile f(filename);
-        if (!f.open(QIODevice::WriteOnly)) {
-            return;
+QHash<QRgb, int> paletteLut(const QVector<QColor> &palette)
+{
+    QHash<QRgb, int> lut;
+    lut.reserve(palette.size());
+    for (int i = palette.size() - 1;i >= 0;i--) {
+        lut.insert(palette.at(i).rgba(), i);
+    }
+    return lut;
+}
+}
+
+/**
+ * @brief DispEditor::quantizeImage
+ * Convert image to the display format. Images that only contain palette
+ * colors are returned as they are.
+ *
+ * @param img
+ * Image scaled to the display size.
+ *
+ * @param palette
+ * Palette for indexed formats.
+ *
+ * @param bits
+ * Bits per pixel.
+ *
+ * @param dither
+ * Dither when reducing the color depth.
+ *
+ * @param colorScale
+ * Brightness scale for indexed formats.
+ *
+ * @return
+ * The quantized image.
+ */
+QImage DispEditor::quantizeImage(const QImage &img, const QVector<QColor> &palette,
+                                 int bits, bool dither, double colorScale)
+{
+    QImage res = img.convertToFormat(QImage::Format_ARGB32);
+    const int w = res.width();
+    const int h = res.height();
+
+    if (palette.isEmpty() && bits <= 4) {
+        return res;
+    }
+
+    auto lut = paletteLut(palette);
+    bool validPalette = true;
+    for (int y = 0;y < h && validPalette;y++) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(res.constScanLine(y));
+        for (int x = 0;x < w;x++) {
+            if (!lut.contains(line[x])) {
+                validPalette = false;
+                break;
+            }
         }
+    }
+
+    if (validPalette) {
+        return res;
+    }
 
-        QImage img = ui->displayEdit->getImageNow();
-        int w = img.width();
-        int h = img.height();
+    if (bits <= 4) {
+        QVector<QRgb> pal;
+        for (const auto &c: palette) {
+            pal.append(c.rgba());
+        }
 
-        VByteArray imgArr;
-        int bits = imgBits();
+        const int levels = 256 / palette.size();
 
-        for (auto &c: imgArr) {
-            c = 0;
+        QVector<int> buf(w * h);
+        for (int y = 0;y < h;y++) {
+            const QRgb *line = reinterpret_cast<const QRgb*>(res.constScanLine(y));
+            int *bufLine = buf.data() + y * w;
+            for (int x = 0;x < w;x++) {
+                int gray = qAlpha(line[x]) == 0 ? 0 : qGray(line[x]);
+                bufLine[x] = qMin(255, int(double(gray) * colorScale));
+            }
         }
 
-        imgArr.vbAppendInt16(w);
-        imgArr.vbAppendInt16(h);
-        imgArr.vbAppendInt8(bits);
+        if (dither) {
+            ditherChannel(buf.data(), w, h, bits, true);
+        }
 
-        if (bits <= 4) {
-            int arrOfs = 0;
-            int bitCnt = 0;
-            uint8_t pixNow = 0;
-            for (int j = 0;j < img.height();j++) {
-                for (int i = 0;i < img.width();i++) {
-                    auto pix = mPalette.indexOf(img.pixelColor(i, j));
-                    pixNow <<= bits;
-                    pixNow |= pix;
-                    bitCnt += bits;
+        for (int y = 0;y < h;y++) {
+            QRgb *line = reinterpret_cast<QRgb*>(res.scanLine(y));
+            const int *bufLine = buf.constData() + y * w;
+            for (int x = 0;x < w;x++) {
+                int ind = bufLine[x] / levels;
 
-                    if (bitCnt >= 8) {
-                        imgArr.vbAppendUint8(pixNow);
-                        pixNow = 0;
-                        bitCnt = 0;
-                    }
+                if (!dither && (256 % palette.size()) != 0) {
+                    ind += 1;
                 }
+
+                line[x] = pal.at(qMin(ind, pal.size() - 1));
             }
-        } else {
-            for (int j = 0;j < img.height();j++) {
-                for (int i = 0;i < img.width();i++) {
-                    auto pix = img.pixelColor(i, j).rgb();
-                    uint8_t r = qRed(pix);
-                    uint8_t g = qGreen(pix);
-                    uint8_t b = qBlue(pix);
+        }
+    } else {
+        QVector<int> bufR(w * h);
+        QVector<int> bufG(w * h);
+        QVector<int> bufB(w * h);
+
+        for (int y = 0;y < h;y++) {
+            const QRgb *line = reinterpret_cast<const QRgb*>(res.constScanLine(y));
+            const int ofs = y * w;
+            for (int x = 0;x < w;x++) {
+                bufR[ofs + x] = qRed(line[x]);
+                bufG[ofs + x] = qGreen(line[x]);
+                bufB[ofs + x] = qBlue(line[x]);
+            }
+        }
 
-                    if (bits == 8) {
-                        r >>= 5;
-                        g >>= 5;
-                        b >>= 6;
-                        uint8_t pix1 = (r << 5) | (g << 2) | b;
-                        imgArr.vbAppendUint8(pix1);
-                    } else  if (bits == 16) {
-                        r >>= 3;
-                        g >>= 2;
-                        b >>= 3;
-                        uint8_t pix1 = (r << 3) | (g >> 3);
-                        uint8_t pix2 = (g << 5) | b;
-                        imgArr.vbAppendUint8(pix1);
-                        imgArr.vbAppendUint8(pix2);
-                    } else {
-                        imgArr.vbAppendUint8(r);
-                        imgArr.vbAppendUint8(g);
-                        imgArr.vbAppendUint8(b);
-                    }
+        if (bits < 24) {
+            int bitsR = 3;
+            int bitsG = 3;
+            int bitsB = 2;
+
+            if (bits == 16) {
+                bitsR = 5;
+                bitsG = 6;
+                bitsB = 5;
+            }
+
+            ditherChannel(bufR.data(), w, h, bitsR, dither);
+            ditherChannel(bufG.data(), w, h, bitsG, dither);
+            ditherChannel(bufB.data(), w, h, bitsB, dither);
+        }
+
+        for (int y = 0;y < h;y++) {
+            QRgb *line = reinterpret_cast<QRgb*>(res.scanLine(y));
+            const int ofs = y * w;
+            for (int x = 0;x < w;x++) {
+                line[x] = qRgb(bufR.at(ofs + x), bufG.at(ofs + x), bufB.at(ofs + x));
+            }
+        }
+    }
+
+    return res;
+}
+
+/**
+ * @brief DispEditor::imageToBin
+ * Serialize image to the binary format of the display library.
+ *
+ * @param img
+ * Quantized image.
+ *
+ * @param palette
+ * Palette for indexed formats.
+ *
+ * @param bits
+ * Bits per pixel.
+ *
+ * @return
+ * The binary image.
+ */
+QByteArray DispEditor::imageToBin(const QImage &img, const QVector<QColor> &palette, int bits)
+{
+    QImage src = img.convertToFormat(QImage::Format_ARGB32);
+    int w = src.width();
+    int h = src.height();
+
+    VByteArray imgArr;
+    imgArr.reserve(5 + (w * h * bits) / 8 + 1);
+
+    imgArr.vbAppendInt16(w);
+    imgArr.vbAppendInt16(h);
+    imgArr.vbAppendInt8(bits);
+
+    if (bits <= 4) {
+        auto lut = paletteLut(palette);
+        int bitCnt = 0;
+        uint8_t pixNow = 0;
+        for (int j = 0;j < h;j++) {
+            const QRgb *line = reinterpret_cast<const QRgb*>(src.constScanLine(j));
+            for (int i = 0;i < w;i++) {
+                int pix = lut.value(line[i], 0);
+                pixNow <<= bits;
+                pixNow |= pix;
+                bitCnt += bits;
+
+                if (bitCnt >= 8) {
+                    imgArr.vbAppendUint8(pixNow);
+                    pixNow = 0;
+                    bitCnt = 0;
                 }
             }
         }
+    } else {
+        for (int j = 0;j < h;j++) {
+            const QRgb *line = reinterpret_cast<const QRgb*>(src.constScanLine(j));
+            for (int i = 0;i < w;i++) {
+                uint8_t r = qRed(line[i]);
+                uint8_t g = qGreen(line[i]);
+                uint8_t b = qBlue(line[i]);
+
+                if (bits == 8) {
+                    r >>= 5;
+                    g >>= 5;
+                    b >>= 6;
+                    uint8_t pix1 = (r << 5) | (g << 2) | b;
+                    imgArr.vbAppendUint8(pix1);
+                } else  if (bits == 16) {
+                    r >>= 3;
+                    g >>= 2;
+                    b >>= 3;
+                    uint8_t pix1 = (r << 3) | (g >> 3);
+                    uint8_t pix2 = (g << 5) | b;
+                    imgArr.vbAppendUint8(pix1);
+                    imgArr.vbAppendUint8(pix2);
+                } else {
+                    imgArr.vbAppendUint8(r);
+                    imgArr.vbAppendUint8(g);
+                    imgArr.vbAppendUint8(b);
+                }
+            }
+        }
+    }
+
+    return imgArr;
+}
+
+DispEditor::~DispEditor()
+{
+    delete ui;
+}
+
+void DispEditor::on_saveCButton_clicked()
+{
+    QString filename = QFileDialog::getSaveFileName(this,
+                                                    tr("Save Binary Image"), "",
+                                                    tr("Bin files (*.bin *.BIN *.Bin)"));
+
+    if (!filename.isEmpty()) {
+        if (!filename.endsWith(".bin", Qt::CaseInsensitive)) {
+            filename.append(".bin");
+        }
 
-        f.write(imgArr);
+        QFile f(filename);
+        if (!f.open(QIODevice::WriteOnly)) {
+            return;
+        }
+
+        f.write(imageToBin(ui->displayEdit->getImageNow(), mPalette, imgBits()));
         f.close();
     }
 }
@@ -294,183 +548,11 @@ void DispEditor::on_loadPngButton_clicked()
                                                     tr("JPG and PNG files (*.png *.Png *.PNG *.jpg *.Jpg *.JPG *.jpeg *.Jpeg *.JPEG)"));
 
     if (!filename.isEmpty()) {
-        QImage img;
-        img.load(filename);
-        QImage img2(img.size(), QImage::Format_ARGB32);
-
-        QPainter p(&img2);
-        p.drawImage(0, 0, img);
-
-        img = img2.scaled(ui->displayEdit->getImageSize(),
-                         Qt::KeepAspectRatioByExpanding,
-                         ui->antialiasBox->isChecked() ?
-                             Qt::SmoothTransformation :
-                             Qt::FastTransformation);
-
-        bool validPalette = true;
-        for (int i = 0;i < img.width();i++) {
-            for (int j = 0;j < img.height();j++) {
-                if (!mPalette.contains(img.pixelColor(i, j))) {
-                    validPalette = false;
-                    break;
-                }
-            }
-        }
-
-        if (!validPalette) {
-            int bits = imgBits();
-
-            if (ui->ditherBox->isChecked() || bits > 4) {
-                int imgW = img.width();
-                int imgH = img.height();
-
-                auto ditherChannel = [](int bits, int **img_buffer, int w, int h, bool dither = true) {
-                    for (int y = 0; y < h;y++) {
-                        for (int x = 0;x < w;x++) {
-                            int pix = img_buffer[x][y];
-
-                            if (pix > 255) pix = 255;
-                            if (pix < 0) pix = 0;
-
-                            int mask = (0xFF << (8 - bits)) & 0xFF;
-                            int pix_n = pix & mask;
-                            int quant_error = pix - pix_n;
-                            img_buffer[x][y]= pix_n;
-
-                            if (dither) {
-                                if (x < (w - 1)) {
-                                    img_buffer[x + 1][y] += ((quant_error << 12) * 7) >> 16;
-                                }
-
-                                if (y < (h - 1)) {
-                                    img_buffer[x][y + 1] += ((quant_error << 12) * 5) >> 16;
-                                }
-
-                                if (x > 0 && y < (h - 1)) {
-                                    img_buffer[x - 1][y + 1] += ((quant_error << 12) * 3) >> 16;
-                                }
-
-                                if (x < (w - 1) && y < (h - 1)) {
-                                    img_buffer[x + 1][y + 1] += ((quant_error << 12) * 1) >> 16;
-                                }
-                            }
-                        }
-                    }
-                };
-
-                if (bits <= 4) {
-                    int **img_buffer = new int*[imgW];
-                    for(int i = 0; i < imgW; i++) {
-                        img_buffer[i] = new int[imgH];
-                    }
-
-                    for (int y = 0;y < imgH;y++) {
-                        for (int x = 0;x < imgW;x++) {
-                            QColor c = img.pixelColor(x, y);
-                            int gray = qGray(c.rgb());
-                            if (c.alpha() == 0) {
-                                gray = 0;
-                            }
-                            gray = (int)((double)gray * ui->loadScaleSpinBox->value());
-                            if (gray > 255) {
-                                gray = 255;
-                            }
-
-                            img_buffer[x][y] = gray;
-                        }
-                    }
-
-                    ditherChannel(bits, img_buffer, imgW, imgH);
-
-                    for (int y = 0;y < imgH;y++) {
-                        for (int x = 0;x < imgW;x++) {
-                            img.setPixelColor(x, y, mPalette.at(img_buffer[x][y] / (256 / mPalette.size())));
-                        }
-                    }
-
-                    for(int i = 0; i < imgW; i++) {
-                        delete[] img_buffer[i];
-                    }
-                    delete[] img_buffer;
-                } else {
-                    int **buf_r = new int*[imgW];
-                    int **buf_g = new int*[imgW];
-                    int **buf_b = new int*[imgW];
-                    for(int i = 0; i < imgW; i++) {
-                        buf_r[i] = new int[imgH];
-                        buf_g[i] = new int[imgH];
-                        buf_b[i] = new int[imgH];
-                    }
-
-                    for (int y = 0;y < imgH;y++) {
-                        for (int x = 0;x < imgW;x++) {
-                            QRgb col = img.pixel(x, y);
-                            buf_r[x][y] = qRed(col);
-                            buf_g[x][y] = qGreen(col);
-                            buf_b[x][y] = qBlue(col);
-                        }
-                    }
-
-                    if (bits < 24) {
-                        int bits_r = 3;
-                        int bits_g = 3;
-                        int bits_b = 2;
-
-                        if (bits == 16) {
-                            bits_r = 5;
-                            bits_g = 6;
-                            bits_b = 5;
-                        }
-
-                        ditherChannel(bits_r, buf_r, imgW, imgH, ui->ditherBox->isChecked());
-                        ditherChannel(bits_g, buf_g, imgW, imgH, ui->ditherBox->isChecked());
-                        ditherChannel(bits_b, buf_b, imgW, imgH, ui->ditherBox->isChecked());
-                    }
-
-                    for (int y = 0;y < imgH;y++) {
-                        for (int x = 0;x < imgW;x++) {
-                            img.setPixelColor(x, y,
-                                              QColor(buf_r[x][y],
-                                                     buf_g[x][y],
-                                                     buf_b[x][y]));
-                        }
-                    }
-
-                    for(int i = 0; i < imgW; i++) {
-                        delete[] buf_r[i];
-                        delete[] buf_g[i];
-                        delete[] buf_b[i];
-                    }
-                    delete[] buf_r;
-                    delete[] buf_g;
-                    delete[] buf_b;
-                }
-            } else {
-                for (int i = 0;i < img.width();i++) {
-                    for (int j = 0;j < img.height();j++) {
-                        QColor c = img.pixelColor(i, j);
-                        int gray = qGray(c.rgb());
-                        if (c.alpha() == 0) {
-                            gray = 0;
-                        }
-                        gray = (int)((double)gray * ui->loadScaleSpinBox->value());
-                        if (gray > 255) {
-                            gray = 255;
-                        }
-
-                        gray /= (256 / mPalette.size());
-
-                        if (256 % mPalette.size() != 0) {
-                            gray += 1;
-                        }
-
-                        img.setPixelColor(i, j, mPalette.at(gray));
-                    }
-                }
-            }
-        }
-
-        ui->displayEdit->loadFromImage(img);
+        QImage img = loadScaledImage(filename, ui->displayEdit->getImageSize(),
+                                     ui->antialiasBox->isChecked());
+        ui->displayEdit->loadFromImage(quantizeImage(img, mPalette, imgBits(),
+                                                     ui->ditherBox->isChecked(),
+                                                     ui->loadScaleSpinBox->value()));
     }
 }
 
@@ -627,3 +709,148 @@ void DispEditor::on_helpButton_clicked()
                              "The second layer can be used to draw overlays on, without messing with the main image. "
                              "This way the background image can be kept clean for when it is saved.");
 }
+
+void DispEditor::on_batchButton_clicked()
+{
+    QString dirIn = QFileDialog::getExistingDirectory(this, tr("Directory with Frames"));
+    if (dirIn.isEmpty()) {
+        return;
+    }
+
+    QDir dir(dirIn);
+    auto files = dir.entryInfoList(QStringList() << "*.png" << "*.PNG" << "*.jpg" << "*.JPG" <<
+                                   "*.jpeg" << "*.JPEG", QDir::Files, QDir::Name);
+
+    if (files.isEmpty()) {
+        QMessageBox::warning(this, tr("Convert Frames"), tr("No images found in %1").arg(dirIn));
+        return;
+    }
+
+    QString dirOut = QFileDialog::getExistingDirectory(this, tr("Output Directory"), dirIn);
+    if (dirOut.isEmpty()) {
+        return;
+    }
+
+    // Everything the conversion needs is copied here, as it runs on the pool
+    const QSize size = ui->displayEdit->getImageSize();
+    const QVector<QColor> palette = mPalette;
+    const int bits = imgBits();
+    const bool dither = ui->ditherBox->isChecked();
+    const bool smooth = ui->antialiasBox->isChecked();
+    const double colorScale = ui->loadScaleSpinBox->value();
+
+    QProgressDialog dialog(tr("Converting frames..."), QString(), 0, files.size(), this);
+    dialog.setWindowModality(Qt::WindowModal);
+    dialog.show();
+
+    // The jobs report back to this thread when they are done, the results
+    // are collected here.
+    QVector<QByteArray> frames(files.size());
+    int done = 0;
+    int failed = 0;
+    QEventLoop loop;
+    QThreadPool pool;
+
+    for (int i = 0;i < files.size();i++) {
+        QString pathIn = files.at(i).absoluteFilePath();
+        QString pathOut = QDir(dirOut).filePath(files.at(i).completeBaseName() + ".bin");
+
+        pool.start(new FrameJob([=, &frames, &done, &failed, &dialog, &loop]() {
+            QImage img = loadScaledImage(pathIn, size, smooth);
+            QByteArray bin;
+            QFile f(pathOut);
+
+            if (!img.isNull() && f.open(QIODevice::WriteOnly)) {
+                bin = imageToBin(quantizeImage(img, palette, bits, dither, colorScale),
+                                 palette, bits);
+                f.write(bin);
+                f.close();
+            }
+
+            QMetaObject::invokeMethod(this, [=, &frames, &done, &failed, &dialog, &loop]() {
+                frames[i] = bin;
+                if (bin.isEmpty()) {
+                    failed++;
+                }
+
+                done++;
+                dialog.setValue(done);
+                if (done == frames.size()) {
+                    loop.quit();
+                }
+            }, Qt::QueuedConnection);
+        }));
+    }
+
+    loop.exec();
+    dialog.close();
+
+    // All frames also go to one C header, with an array of pointers for
+    // stepping through them. There is no header when no frame converted, as
+    // the array would be empty.
+    QString name = QDir(dirOut).dirName().toLower();
+    name.replace(QRegularExpression("[^a-z0-9_]"), "_");
+    if (name.isEmpty() || name.at(0).isDigit()) {
+        name.prepend("frames_");
+    }
+
+    QFile headerFile(QDir(dirOut).filePath(name + ".h"));
+    bool headerOk = failed < files.size();
+    if (headerOk && headerFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        QTextStream out(&headerFile);
+        QStringList frameNames;
+
+        out << "// This file is autogenerated by VESC Tool\n\n";
+        out << "#ifndef " << name.toUpper() << "_H_\n";
+        out << "#define " << name.toUpper() << "_H_\n\n";
+        out << "#include <stdint.h>\n\n";
+
+        for (int i = 0;i < frames.size();i++) {
+            if (frames.at(i).isEmpty()) {
+                continue;
+            }
+
+            QString frameName = name + "_" + QString::number(frameNames.size());
+            frameNames.append(frameName);
+
+            out << "// " << files.at(i).fileName() << "\n";
+            out << "static const uint8_t " << frameName << "[" << frames.at(i).size() << "] = {\n\t";
+
+            int posCnt = 0;
+            for (auto b: frames.at(i)) {
+                if (posCnt >= 16) {
+                    posCnt = 0;
+                    out << "\n\t";
+                }
+
+                out << QString("0x%1, ").arg(quint8(b), 2, 16, QLatin1Char('0'));
+                posCnt++;
+            }
+
+            out << "\n};\n\n";
+        }
+
+        out << "#define " << name.toUpper() << "_NUM\t" << frameNames.size() << "\n\n";
+        out << "static const uint8_t * const " << name << "[" << name.toUpper() << "_NUM] = {\n";
+        for (const auto &n: frameNames) {
+            out << "\t" << n << ",\n";
+        }
+        out << "};\n\n";
+        out << "#endif\n";
+    } else if (headerOk) {
+        headerOk = false;
+        QMessageBox::warning(this, tr("Convert Frames"),
+                             tr("Could not open %1 for writing: %2").
+                             arg(headerFile.fileName(), headerFile.errorString()));
+    }
+
+    if (failed > 0) {
+        QMessageBox::warning(this, tr("Convert Frames"),
+                             tr("%1 of %2 frames could not be converted.").
+                             arg(failed).arg(files.size()));
+    } else if (headerOk) {
+        QMessageBox::information(this, tr("Convert Frames"),
+                                 tr("%1 frames written to %2 as .bin files and %3").
+                                 arg(files.size()).arg(dirOut).arg(headerFile.fileName()));
+    }
+}
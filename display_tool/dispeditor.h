@@ -40,6 +40,11 @@ public:
     QColor paletteColor(int ind);
     void setColors(int colors);
 
+    static QImage loadScaledImage(QString path, QSize size, bool smooth);
+    static QImage quantizeImage(const QImage &img, const QVector<QColor> &palette,
+                                int bits, bool dither, double colorScale);
+    static QByteArray imageToBin(const QImage &img, const QVector<QColor> &palette, int bits);
+
 private slots:
     void on_saveCButton_clicked();
     void on_loadCButton_clicked();
@@ -51,6 +56,7 @@ private slots:
     void on_imgScaleBox_valueChanged(int arg1);
     void on_formatBox_currentIndexChanged(int index);
     void on_helpButton_clicked();
+    void on_batchButton_clicked();
 
 private:
     Ui::DispEditor *ui;
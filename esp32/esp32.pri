@@ -1,5 +1,6 @@
 HEADERS += \
     $$PWD/esp32flash.h \
+    $$PWD/esp32loaderstub.h \
     $$PWD/esp_loader.h \
     $$PWD/esp_targets.h \
     $$PWD/md5_hash.h \
@@ -9,6 +10,7 @@ HEADERS += \
 
 SOURCES += \
     $$PWD/esp32flash.cpp \
+    $$PWD/esp32loaderstub.cpp \
     $$PWD/esp_loader.c \
     $$PWD/esp_targets.c \
     $$PWD/md5_hash.c \
@@ -19,6 +19,8 @@
 
 #include <QDebug>
 #include <QTime>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
 #include "esp32flash.h"
 #include "utility.h"
 
@@ -91,10 +93,10 @@ bool Esp32Flash::connectEsp(QString port)
 
     emit stateUpdate(QString("Connected to %1").arg(targetName));
 
-    qDebug() << "Changing baudrate to 460800";
-    if (esp_loader_change_baudrate(460800) == ESP_LOADER_SUCCESS) {
-        loader_port_change_baudrate(460800);
-        qDebug() << "Baudrate changed!";
+    if (!negotiateBaudrate()) {
+        emit stateUpdate("Lost connection while changing baudrate");
+        sPort->close();
+        return false;
     }
 
     return true;
@@ -122,14 +124,173 @@ bool Esp32Flash::flashFirmware(QByteArray data, quint64 address)
         return false;
     }
 
+    QElapsedTimer timer;
+    timer.start();
+
+    // Split the image into regions and only write the ones where the MD5
+    // reported by the target differs. Adjacent regions are merged so that
+    // they can be written with one compressed stream.
+    const int regionSize = 64 * 1024;
+    bool supportsMd5 = esp_loader_get_target() != ESP8266_CHIP;
+    QVector<QPair<int, int>> toWrite;
+
+    emit stateUpdate("Comparing flash contents...");
+
+    for (int pos = 0;pos < data.size();pos += regionSize) {
+        int len = qMin(regionSize, data.size() - pos);
+        bool matches = false;
+
+        if (supportsMd5) {
+            uint8_t md5Target[32];
+            if (esp_loader_flash_region_md5(uint32_t(address + pos), uint32_t(len), md5Target) ==
+                    ESP_LOADER_SUCCESS) {
+                QByteArray md5Local = QCryptographicHash::hash(data.mid(pos, len),
+                                                               QCryptographicHash::Md5).toHex();
+                matches = md5Local == QByteArray((const char*)md5Target, 32);
+            }
+        }
+
+        if (matches) {
+            continue;
+        }
+
+        if (!toWrite.isEmpty() && (toWrite.last().first + toWrite.last().second) == pos) {
+            toWrite.last().second += len;
+        } else {
+            toWrite.append(qMakePair(pos, len));
+        }
+    }
+
+    qint64 sendTot = 0;
+    for (const auto &r: toWrite) {
+        sendTot += r.second;
+    }
+
+    if (toWrite.isEmpty()) {
+        emit flashProgress(1.0);
+        emit stateUpdate("Flash contents already match, nothing to write");
+        return true;
+    }
+
+    qDebug() << "ESP32 flash:" << sendTot << "of" << data.size() << "bytes differ";
+
+    qint64 sent = 0;
+    for (const auto &r: toWrite) {
+        QByteArray region = data.mid(r.first, r.second);
+        bool ok = false;
+
+        if (supportsMd5) {
+            ok = flashRegionDeflate(region, address + r.first, sent, sendTot);
+        } else {
+            ok = flashRegionRaw(region, address + r.first, sent, sendTot);
+        }
+
+        if (!ok) {
+            return false;
+        }
+    }
+
+    emit stateUpdate("Done, verifying flash...");
+
+    if (supportsMd5) {
+        for (const auto &r: toWrite) {
+            uint8_t md5Target[32];
+            esp_loader_error_t err = esp_loader_flash_region_md5(uint32_t(address + r.first),
+                                                                 uint32_t(r.second), md5Target);
+
+            QByteArray md5Local = QCryptographicHash::hash(data.mid(r.first, r.second),
+                                                           QCryptographicHash::Md5).toHex();
+
+            if (err != ESP_LOADER_SUCCESS || md5Local != QByteArray((const char*)md5Target, 32)) {
+                QString errStr = QString("MD5 error. Code: %1").arg(err);
+
+                if (err == ESP_LOADER_ERROR_TIMEOUT) {
+                    errStr = "MD5 Timeout, but probably OK";
+                }
+
+                emit stateUpdate(errStr);
+                qWarning() << errStr;
+                return false;
+            }
+        }
+    } else {
+        esp_loader_error_t err = esp_loader_flash_verify();
+        if (err != ESP_LOADER_SUCCESS && err != ESP_LOADER_ERROR_UNSUPPORTED_FUNC) {
+            QString errStr = QString("MD5 error. Code: %1").arg(err);
+            emit stateUpdate(errStr);
+            qWarning() << errStr;
+            return false;
+        }
+    }
+
+    emit stateUpdate(QString("Flash verified (%1 s)").arg(double(timer.elapsed()) / 1000.0, 0, 'f', 1));
+
+    return true;
+#else
+    (void)data; (void)address;
+    return false;
+#endif
+}
+
+bool Esp32Flash::flashRegionDeflate(const QByteArray &data, quint64 address,
+                                    qint64 &sent, qint64 sendTot)
+{
+#ifdef HAS_SERIALPORT
+    // qCompress produces a zlib stream with a 4-byte length in front, the
+    // loader wants the zlib stream only.
+    QByteArray comp = qCompress(data, 9).mid(4);
+    const int blockSize = 1024;
+
+    qDebug() << "ESP32 flash: deflated" << data.size() << "to" << comp.size() << "bytes";
+
+    emit stateUpdate("Erasing flash (this may take a while)...");
+
+    esp_loader_error_t err = esp_loader_flash_defl_start(uint32_t(address), uint32_t(data.size()),
+                                                         uint32_t(comp.size()), blockSize);
+    if (err != ESP_LOADER_SUCCESS) {
+        QString errStr = QString("Erasing flash failed with error: %1").arg(err);
+        emit stateUpdate(errStr);
+        qWarning() << errStr;
+        return false;
+    }
+
+    emit stateUpdate("Programming...");
+
+    for (int pos = 0;pos < comp.size();pos += blockSize) {
+        int len = qMin(blockSize, comp.size() - pos);
+
+        err = esp_loader_flash_defl_write(comp.data() + pos, uint32_t(len));
+        if (err != ESP_LOADER_SUCCESS) {
+            QString errStr = QString("Packet could not be written! Code: %1").arg(err);
+            emit stateUpdate(errStr);
+            qWarning() << errStr;
+            return false;
+        }
+
+        // Progress in uncompressed bytes
+        qint64 done = sent + qint64(data.size()) * (pos + len) / comp.size();
+        emit flashProgress(double(done) / double(sendTot));
+    }
+
+    sent += data.size();
+    return true;
+#else
+    (void)data; (void)address; (void)sent; (void)sendTot;
+    return false;
+#endif
+}
+
+bool Esp32Flash::flashRegionRaw(const QByteArray &data, quint64 address,
+                                qint64 &sent, qint64 sendTot)
+{
+#ifdef HAS_SERIALPORT
     size_t size = data.size();
 
     esp_loader_error_t err;
     static uint8_t payload[1024];
-    const uint8_t *bin_addr = (uint8_t*)data.data();
+    const uint8_t *bin_addr = (const uint8_t*)data.constData();
 
     emit stateUpdate("Erasing flash (this may take a while)...");
-    Utility::sleepWithEventLoop(500);
 
     err = esp_loader_flash_start(address, size, sizeof(payload));
     if (err != ESP_LOADER_SUCCESS) {
@@ -140,10 +301,6 @@ bool Esp32Flash::flashFirmware(QByteArray data, quint64 address)
     }
 
     emit stateUpdate("Programming...");
-    Utility::sleepWithEventLoop(500);
-
-    size_t binary_size = size;
-    size_t written = 0;
 
     while (size > 0) {
         size_t to_read = std::min(size, sizeof(payload));
@@ -159,27 +316,78 @@ bool Esp32Flash::flashFirmware(QByteArray data, quint64 address)
 
         size -= to_read;
         bin_addr += to_read;
-        written += to_read;
+        sent += to_read;
 
-        emit flashProgress(double(written) / double(binary_size));
+        emit flashProgress(double(sent) / double(sendTot));
     };
 
-    emit stateUpdate("Done, verifying flash...");
-    Utility::sleepWithEventLoop(500);
+    return true;
+#else
+    (void)data; (void)address; (void)sent; (void)sendTot;
+    return false;
+#endif
+}
 
-    err = esp_loader_flash_verify();
-    if (err != ESP_LOADER_SUCCESS) {
-        QString errStr = QString("MD5 error. Code: %1").arg(err);
+/**
+ * @brief Esp32Flash::negotiateBaudrate
+ * Switch to the highest baudrate that the target and the USB-serial bridge
+ * can sustain. Every rate is checked with a register read, and if that fails
+ * the target is reset and the next lower rate is tried.
+ *
+ * @return
+ * false if the connection could not be brought back after a failed attempt.
+ */
+bool Esp32Flash::negotiateBaudrate()
+{
+#ifdef HAS_SERIALPORT
+    auto info = QSerialPortInfo(sPort->portName());
+    int maxBaud = 921600;
+
+    if (info.hasVendorIdentifier()) {
+        switch (info.vendorIdentifier()) {
+        case 0x303A: // Espressif built in USB, the rate does not matter
+        case 0x1A86: // WCH CH34x
+        case 0x0403: // FTDI
+            maxBaud = 2000000;
+            break;
+        case 0x10C4: // Silicon Labs CP210x
+            maxBaud = 921600;
+            break;
+        default:
+            break;
+        }
+    }
+
+    const QVector<int> rates = {2000000, 1500000, 921600, 460800};
 
-        if (err == ESP_LOADER_ERROR_TIMEOUT) {
-            errStr = "MD5 Timeout, but probably OK";
+    for (int baud: rates) {
+        if (baud > maxBaud) {
+            continue;
         }
 
-        emit stateUpdate(errStr);
-        qWarning() << errStr;
-        return false;
+        qDebug() << "Changing baudrate to" << baud;
+        if (esp_loader_change_baudrate(uint32_t(baud)) != ESP_LOADER_SUCCESS) {
+            continue;
+        }
+
+        loader_port_change_baudrate(uint32_t(baud));
+        Utility::sleepWithEventLoop(20);
+        sPort->clear();
+
+        // Any register will do, the chip detection register is there on all targets
+        uint32_t reg = 0;
+        if (esp_loader_read_register(0x40001000, &reg) == ESP_LOADER_SUCCESS) {
+            qDebug() << "Baudrate changed!";
+            return true;
+        }
+
+        qWarning() << "No response at" << baud << "baud, reconnecting";
+        loader_port_change_baudrate(115200);
+        esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+        if (esp_loader_connect(&connect_config) != ESP_LOADER_SUCCESS) {
+            return false;
+        }
     }
-    emit stateUpdate("Flash verified");
 
     return true;
 #else
@@ -252,6 +460,11 @@ void Esp32Flash::serialPortError(QSerialPort::SerialPortError error)
     case QSerialPort::NoError:
         break;
 
+    case QSerialPort::UnsupportedOperationError:
+        // E.g. modem lines on a pseudo terminal, the port is still usable
+        qWarning() << "Serial port:" << sPort->errorString();
+        break;
+
     default:
         message = "Serial port error: " + sPort->errorString();
         break;
@@ -326,6 +539,12 @@ esp_loader_error_t loader_port_serial_read(uint8_t *data, uint16_t size, uint32_
 }
 
 #ifdef HAS_SERIALPORT
+// Pseudo terminals, such as the one of Esp32LoaderStub, have no modem lines
+static bool isPseudoTerminal() {
+    return sPort->portName().startsWith("pts/") ||
+            sPort->portName().startsWith("/dev/pts/");
+}
+
 static void setDtr(bool state) {
     sPort->setDataTerminalReady(state);
 }
@@ -339,7 +558,7 @@ static void setRts(bool state) {
 void loader_port_enter_bootloader(void)
 {
 #ifdef HAS_SERIALPORT
-    if (!sPort->isOpen()) {
+    if (!sPort->isOpen() || isPseudoTerminal()) {
         return;
     }
 
@@ -383,7 +602,7 @@ void loader_port_enter_bootloader(void)
 void loader_port_reset_target(void)
 {
 #ifdef HAS_SERIALPORT
-    if (!sPort->isOpen()) {
+    if (!sPort->isOpen() || isPseudoTerminal()) {
         return;
     }
 
@@ -53,6 +53,13 @@ private slots:
     void serialPortError(QSerialPort::SerialPortError error);
 #endif
 
+private:
+    bool negotiateBaudrate();
+    bool flashRegionDeflate(const QByteArray &data, quint64 address,
+                            qint64 &sent, qint64 sendTot);
+    bool flashRegionRaw(const QByteArray &data, quint64 address,
+                        qint64 &sent, qint64 sendTot);
+
 };
 
 #endif // ESP32FLASH_H
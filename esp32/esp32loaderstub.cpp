@@ -0,0 +1,379 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "esp32loaderstub.h"
+#include "serial_comm_prv.h"
+
+#include <QDebug>
+#include <QTimer>
+#include <QSocketNotifier>
+#include <QCryptographicHash>
+
+#ifdef Q_OS_LINUX
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#endif
+
+// ESP32-C3 with 4 MB flash
+#define STUB_CHIP_MAGIC         0x1b31506f
+#define STUB_CHIP_MAGIC_REG     0x40001000
+#define STUB_SPI_CMD_REG        0x60002000
+#define STUB_SPI_W0_REG         0x60002058
+#define STUB_SPI_CMD_USR        (1 << 18)
+#define STUB_FLASH_ID           0x1640EF
+#define STUB_FLASH_SIZE         (4 * 1024 * 1024)
+
+static quint32 getU32(const QByteArray &data, int pos)
+{
+    if ((pos + 4) > data.size()) {
+        return 0;
+    }
+
+    const uchar *d = (const uchar*)data.constData() + pos;
+    return quint32(d[0]) | (quint32(d[1]) << 8) |
+            (quint32(d[2]) << 16) | (quint32(d[3]) << 24);
+}
+
+Esp32LoaderStub::Esp32LoaderStub(QObject *parent) : QObject(parent)
+{
+    mMasterFd = -1;
+    mSlaveFd = -1;
+    mNotifier = nullptr;
+    mInFrame = false;
+    mEscape = false;
+    mBaud = 115200;
+    mWireFreeAt = 0.0;
+    mWritePos = 0;
+    mDeflOffset = 0;
+    mDeflSize = 0;
+    mFlash.fill(char(0xFF), STUB_FLASH_SIZE);
+}
+
+Esp32LoaderStub::~Esp32LoaderStub()
+{
+    stop();
+}
+
+/**
+ * @brief Esp32LoaderStub::start
+ * Create the pseudo terminal and start serving. Connect Esp32Flash to
+ * portPath() afterwards.
+ *
+ * @return
+ * true for success.
+ */
+bool Esp32LoaderStub::start()
+{
+#ifdef Q_OS_LINUX
+    stop();
+
+    mMasterFd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (mMasterFd < 0 || grantpt(mMasterFd) != 0 || unlockpt(mMasterFd) != 0) {
+        qWarning() << "Could not create pseudo terminal";
+        stop();
+        return false;
+    }
+
+    mPortPath = QString::fromLocal8Bit(ptsname(mMasterFd));
+
+    // Keep the slave open so that the master does not see a hangup between
+    // connections, and make it raw so that nothing gets echoed back.
+    mSlaveFd = open(mPortPath.toLocal8Bit().constData(), O_RDWR | O_NOCTTY);
+    if (mSlaveFd >= 0) {
+        struct termios tio;
+        if (tcgetattr(mSlaveFd, &tio) == 0) {
+            cfmakeraw(&tio);
+            tcsetattr(mSlaveFd, TCSANOW, &tio);
+        }
+    }
+
+    mNotifier = new QSocketNotifier(mMasterFd, QSocketNotifier::Read, this);
+    connect(mNotifier, SIGNAL(activated(int)), this, SLOT(readyRead()));
+
+    mClock.start();
+    return true;
+#else
+    qWarning() << "The ESP32 loader stub is only available on Linux";
+    return false;
+#endif
+}
+
+void Esp32LoaderStub::stop()
+{
+#ifdef Q_OS_LINUX
+    if (mNotifier) {
+        mNotifier->setEnabled(false);
+        mNotifier->deleteLater();
+        mNotifier = nullptr;
+    }
+
+    if (mSlaveFd >= 0) {
+        close(mSlaveFd);
+        mSlaveFd = -1;
+    }
+
+    if (mMasterFd >= 0) {
+        close(mMasterFd);
+        mMasterFd = -1;
+    }
+#endif
+
+    mPortPath.clear();
+}
+
+QString Esp32LoaderStub::portPath() const
+{
+    return mPortPath;
+}
+
+QByteArray Esp32LoaderStub::flash() const
+{
+    return mFlash;
+}
+
+void Esp32LoaderStub::readyRead()
+{
+#ifdef Q_OS_LINUX
+    char buf[4096];
+    ssize_t len = read(mMasterFd, buf, sizeof(buf));
+
+    for (ssize_t i = 0;i < len;i++) {
+        quint8 c = quint8(buf[i]);
+
+        if (c == 0xC0) {
+            if (mInFrame && !mRxFrame.isEmpty()) {
+                processFrame(mRxFrame);
+            }
+
+            mRxFrame.clear();
+            mInFrame = true;
+            mEscape = false;
+        } else if (mInFrame) {
+            if (mEscape) {
+                mRxFrame.append(char(c == 0xDC ? 0xC0 : 0xDB));
+                mEscape = false;
+            } else if (c == 0xDB) {
+                mEscape = true;
+            } else {
+                mRxFrame.append(char(c));
+            }
+        }
+    }
+#endif
+}
+
+void Esp32LoaderStub::processFrame(const QByteArray &frame)
+{
+    if (frame.size() < 8 || quint8(frame.at(0)) != WRITE_DIRECTION) {
+        return;
+    }
+
+    quint8 cmd = quint8(frame.at(1));
+    QByteArray data = frame.mid(8);
+
+    // The request has to get through the wire at the current baudrate before
+    // it can be answered.
+    double now = double(mClock.nsecsElapsed()) / 1e6;
+    mWireFreeAt = qMax(now, mWireFreeAt) + double(frame.size() + 2) * 10000.0 / double(mBaud);
+
+    switch (cmd) {
+    case SYNC:
+    case SPI_ATTACH:
+    case SPI_SET_PARAMS:
+    case FLASH_END:
+        sendResponse(cmd, 0, QByteArray(), true);
+        break;
+
+    case FLASH_DEFL_END:
+        finishDeflate();
+        sendResponse(cmd, 0, QByteArray(), true);
+        break;
+
+    case READ_REG: {
+        quint32 addr = getU32(data, 0);
+        quint32 val = addr == STUB_CHIP_MAGIC_REG ? STUB_CHIP_MAGIC : mRegs.value(addr, 0);
+        sendResponse(cmd, val, QByteArray(), true);
+    } break;
+
+    case WRITE_REG: {
+        quint32 addr = getU32(data, 0);
+        quint32 val = getU32(data, 4);
+
+        if (addr == STUB_SPI_CMD_REG && (val & STUB_SPI_CMD_USR)) {
+            // The only SPI command that is used by the loader is reading the
+            // flash ID, and it completes immediately.
+            mRegs.insert(STUB_SPI_W0_REG, STUB_FLASH_ID);
+            mRegs.insert(STUB_SPI_CMD_REG, 0);
+        } else {
+            mRegs.insert(addr, val);
+        }
+
+        sendResponse(cmd, 0, QByteArray(), true);
+    } break;
+
+    case CHANGE_BAUDRATE: {
+        // Answered at the old rate
+        sendResponse(cmd, 0, QByteArray(), true);
+        quint32 baud = getU32(data, 0);
+        if (baud > 0) {
+            mBaud = baud;
+        }
+    } break;
+
+    case FLASH_BEGIN:
+    case FLASH_DEFL_BEGIN: {
+        finishDeflate();
+
+        quint32 eraseSize = getU32(data, 0);
+        quint32 offset = getU32(data, 12);
+
+        if ((quint64(offset) + eraseSize) > quint64(mFlash.size())) {
+            sendResponse(cmd, 0, QByteArray(), false);
+            break;
+        }
+
+        memset(mFlash.data() + offset, 0xFF, eraseSize);
+
+        if (cmd == FLASH_BEGIN) {
+            mWritePos = offset;
+        } else {
+            mDeflOffset = offset;
+            mDeflSize = eraseSize;
+            mDeflData.clear();
+        }
+
+        sendResponse(cmd, 0, QByteArray(), true);
+    } break;
+
+    case FLASH_DATA: {
+        quint32 size = getU32(data, 0);
+        QByteArray payload = data.mid(16, int(size));
+        writeFlash(mWritePos, payload);
+        mWritePos += quint32(payload.size());
+        sendResponse(cmd, 0, QByteArray(), true);
+    } break;
+
+    case FLASH_DEFL_DATA: {
+        quint32 size = getU32(data, 0);
+        mDeflData.append(data.mid(16, int(size)));
+        sendResponse(cmd, 0, QByteArray(), true);
+    } break;
+
+    case SPI_FLASH_MD5: {
+        finishDeflate();
+
+        quint32 addr = getU32(data, 0);
+        quint32 size = getU32(data, 4);
+
+        if ((quint64(addr) + size) > quint64(mFlash.size())) {
+            sendResponse(cmd, 0, QByteArray(), false);
+            break;
+        }
+
+        QByteArray md5 = QCryptographicHash::hash(mFlash.mid(int(addr), int(size)),
+                                                  QCryptographicHash::Md5).toHex();
+        sendResponse(cmd, 0, md5, true);
+    } break;
+
+    default:
+        sendResponse(cmd, 0, QByteArray(), false);
+        break;
+    }
+}
+
+void Esp32LoaderStub::sendResponse(quint8 cmd, quint32 value, const QByteArray &data, bool ok)
+{
+    QByteArray payload;
+    payload.append(char(READ_DIRECTION));
+    payload.append(char(cmd));
+    payload.append(char((data.size() + 2) & 0xFF));
+    payload.append(char(((data.size() + 2) >> 8) & 0xFF));
+    for (int i = 0;i < 4;i++) {
+        payload.append(char((value >> (8 * i)) & 0xFF));
+    }
+    payload.append(data);
+    payload.append(char(ok ? STATUS_SUCCESS : STATUS_FAILURE));
+    payload.append(char(ok ? RESPONSE_OK : INVALID_COMMAND));
+
+    QByteArray slip;
+    slip.append(char(0xC0));
+    for (auto c: payload) {
+        if (quint8(c) == 0xC0) {
+            slip.append(char(0xDB));
+            slip.append(char(0xDC));
+        } else if (quint8(c) == 0xDB) {
+            slip.append(char(0xDB));
+            slip.append(char(0xDD));
+        } else {
+            slip.append(c);
+        }
+    }
+    slip.append(char(0xC0));
+
+    mWireFreeAt += double(slip.size()) * 10000.0 / double(mBaud);
+
+    double now = double(mClock.nsecsElapsed()) / 1e6;
+    int delay = qMax(0, int(mWireFreeAt - now));
+
+    QTimer::singleShot(delay, this, [this, slip]() {
+#ifdef Q_OS_LINUX
+        if (mMasterFd >= 0) {
+            ssize_t res = write(mMasterFd, slip.constData(), size_t(slip.size()));
+            (void)res;
+        }
+#endif
+    });
+}
+
+void Esp32LoaderStub::finishDeflate()
+{
+    if (mDeflData.isEmpty()) {
+        return;
+    }
+
+    // qUncompress wants the uncompressed size in front of the zlib stream
+    QByteArray comp;
+    comp.append(char((mDeflSize >> 24) & 0xFF));
+    comp.append(char((mDeflSize >> 16) & 0xFF));
+    comp.append(char((mDeflSize >> 8) & 0xFF));
+    comp.append(char(mDeflSize & 0xFF));
+    comp.append(mDeflData);
+    mDeflData.clear();
+
+    QByteArray data = qUncompress(comp);
+    if (data.isEmpty()) {
+        qWarning() << "ESP32 loader stub: could not inflate data";
+        return;
+    }
+
+    writeFlash(mDeflOffset, data);
+}
+
+void Esp32LoaderStub::writeFlash(quint32 offset, const QByteArray &data)
+{
+    int len = qMin(data.size(), mFlash.size() - int(offset));
+    if (len <= 0) {
+        return;
+    }
+
+    memcpy(mFlash.data() + offset, data.constData(), size_t(len));
+    emit flashWritten(offset, len);
+}
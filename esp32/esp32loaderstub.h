@@ -0,0 +1,82 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef ESP32LOADERSTUB_H
+#define ESP32LOADERSTUB_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QElapsedTimer>
+
+class QSocketNotifier;
+
+/*
+ * Emulates the serial ROM loader of an ESP32-C3 with 4 MB flash on a pseudo
+ * terminal, so that Esp32Flash can be tested and benchmarked without
+ * hardware. Replies are delayed by the time the traffic would take on the
+ * wire at the current baudrate. Only available on Linux.
+ */
+class Esp32LoaderStub : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Esp32LoaderStub(QObject *parent = nullptr);
+    ~Esp32LoaderStub();
+
+    bool start();
+    void stop();
+    QString portPath() const;
+    QByteArray flash() const;
+
+signals:
+    void flashWritten(quint32 offset, int size);
+
+private slots:
+    void readyRead();
+
+private:
+    int mMasterFd;
+    int mSlaveFd;
+    QString mPortPath;
+    QSocketNotifier *mNotifier;
+
+    QByteArray mRxFrame;
+    bool mInFrame;
+    bool mEscape;
+
+    quint32 mBaud;
+    QElapsedTimer mClock;
+    double mWireFreeAt;
+
+    QByteArray mFlash;
+    QHash<quint32, quint32> mRegs;
+    quint32 mWritePos;
+    quint32 mDeflOffset;
+    quint32 mDeflSize;
+    QByteArray mDeflData;
+
+    void processFrame(const QByteArray &frame);
+    void sendResponse(quint8 cmd, quint32 value, const QByteArray &data, bool ok);
+    void finishDeflate();
+    void writeFlash(quint32 offset, const QByteArray &data);
+
+};
+
+#endif // ESP32LOADERSTUB_H
@@ -271,6 +271,56 @@ esp_loader_error_t esp_loader_flash_finish(bool reboot)
 }
 
 
+esp_loader_error_t esp_loader_flash_defl_start(uint32_t offset, uint32_t image_size,
+                                               uint32_t compressed_size, uint32_t block_size)
+{
+    if (s_target == ESP8266_CHIP) {
+        return ESP_LOADER_ERROR_UNSUPPORTED_FUNC;
+    }
+
+    uint32_t blocks_to_write = (compressed_size + block_size - 1) / block_size;
+    uint32_t erase_blocks = (image_size + block_size - 1) / block_size;
+    // The ROM loader expects the erase size rounded up to whole blocks
+    uint32_t erase_size = block_size * erase_blocks;
+    s_flash_write_size = block_size;
+
+    size_t flash_size = 0;
+    if (detect_flash_size(&flash_size) == ESP_LOADER_SUCCESS) {
+        if (image_size > flash_size) {
+            return ESP_LOADER_ERROR_IMAGE_SIZE;
+        }
+        loader_port_start_timer(DEFAULT_TIMEOUT);
+        RETURN_ON_ERROR( loader_spi_parameters(flash_size) );
+    } else {
+        loader_port_debug_print("Flash size detection failed, falling back to default");
+    }
+
+    init_md5(offset, image_size);
+
+    bool encryption_in_cmd = encryption_in_begin_flash_cmd(s_target);
+
+    loader_port_start_timer(timeout_per_mb(erase_size, ERASE_REGION_TIMEOUT_PER_MB));
+    return loader_flash_defl_begin_cmd(offset, erase_size, block_size, blocks_to_write, encryption_in_cmd);
+}
+
+
+esp_loader_error_t esp_loader_flash_defl_write(void *payload, uint32_t size)
+{
+    // Inflating the block and writing it to flash takes longer than a plain write
+    loader_port_start_timer(DEFAULT_FLASH_TIMEOUT);
+
+    return loader_flash_defl_data_cmd((const uint8_t *)payload, size);
+}
+
+
+esp_loader_error_t esp_loader_flash_defl_finish(bool reboot)
+{
+    loader_port_start_timer(DEFAULT_TIMEOUT);
+
+    return loader_flash_defl_end_cmd(!reboot);
+}
+
+
 esp_loader_error_t esp_loader_read_register(uint32_t address, uint32_t *reg_value)
 {
     loader_port_start_timer(DEFAULT_TIMEOUT);
@@ -346,6 +396,23 @@ esp_loader_error_t esp_loader_flash_verify(void)
     return ESP_LOADER_SUCCESS;
 }
 
+esp_loader_error_t esp_loader_flash_region_md5(uint32_t address, uint32_t size, uint8_t hex_md5_out[32])
+{
+    if (s_target == ESP8266_CHIP) {
+        return ESP_LOADER_ERROR_UNSUPPORTED_FUNC;
+    }
+
+    uint8_t received_md5[MD5_SIZE + 2] = {0};
+
+    loader_port_start_timer(timeout_per_mb(size, MD5_TIMEOUT_PER_MB));
+
+    RETURN_ON_ERROR( loader_md5_cmd(address, size, received_md5) );
+
+    memcpy(hex_md5_out, received_md5, MD5_SIZE);
+
+    return ESP_LOADER_SUCCESS;
+}
+
 void esp_loader_reset_target(void)
 {
     loader_port_reset_target();
@@ -162,6 +162,66 @@ esp_loader_error_t esp_loader_flash_write(void *payload, uint32_t size);
   */
 esp_loader_error_t esp_loader_flash_finish(bool reboot);
 
+/**
+  * @brief Initiates compressed flash operation
+  *
+  * @param offset[in]           Address from which flash operation will be performed.
+  * @param image_size[in]       Size of the whole binary before compression.
+  * @param compressed_size[in]  Size of the zlib stream that will be sent.
+  * @param block_size[in]       Size of the blocks passed to esp_loader_flash_defl_write.
+  *
+  * @note  Not supported by the ESP8266 ROM loader.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout
+  *     - ESP_LOADER_ERROR_INVALID_RESPONSE Internal error
+  *     - ESP_LOADER_ERROR_UNSUPPORTED_FUNC Unsupported on the target
+  */
+esp_loader_error_t esp_loader_flash_defl_start(uint32_t offset, uint32_t image_size,
+                                               uint32_t compressed_size, uint32_t block_size);
+
+/**
+  * @brief Writes a block of the zlib stream to the target, which inflates it into flash.
+  *
+  * @param payload[in]      Compressed data.
+  * @param size[in]         Size of payload in bytes. Only the last block may be shorter
+  *                         than block_size, and it is not padded.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout
+  *     - ESP_LOADER_ERROR_INVALID_RESPONSE Internal error
+  */
+esp_loader_error_t esp_loader_flash_defl_write(void *payload, uint32_t size);
+
+/**
+  * @brief Ends compressed flash operation.
+  *
+  * @param reboot[in]       reboot the target if true.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout
+  *     - ESP_LOADER_ERROR_INVALID_RESPONSE Internal error
+  */
+esp_loader_error_t esp_loader_flash_defl_finish(bool reboot);
+
+/**
+  * @brief Get the MD5 of a flash region, as computed by the target.
+  *
+  * @param address[in]      Start address of the region.
+  * @param size[in]         Size of the region in bytes.
+  * @param hex_md5_out[out] MD5 as 32 lowercase hexadecimal characters.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout
+  *     - ESP_LOADER_ERROR_INVALID_RESPONSE Internal error
+  *     - ESP_LOADER_ERROR_UNSUPPORTED_FUNC Unsupported on the target
+  */
+esp_loader_error_t esp_loader_flash_region_md5(uint32_t address, uint32_t size, uint8_t hex_md5_out[32]);
+
 /**
   * @brief Writes register.
   *
@@ -0,0 +1,394 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "firmwarecatalog.h"
+#include "packet.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+
+QMutex FirmwareCatalog::mMutex;
+QHash<QString, FirmwareCatalog::DirIndex> FirmwareCatalog::mDirs;
+QHash<QString, FirmwareCatalog::FileHash> FirmwareCatalog::mHashes;
+bool FirmwareCatalog::mHashesLoaded = false;
+bool FirmwareCatalog::mHashesChanged = false;
+
+/**
+ * @brief FirmwareCatalog::entries
+ * Get the files and directories in dir, sorted by name.
+ */
+QVector<FirmwareCatalog::Entry> FirmwareCatalog::entries(const QString &dir)
+{
+    QMutexLocker locker(&mMutex);
+    return index(cleanDir(dir)).entries;
+}
+
+/**
+ * @brief FirmwareCatalog::entriesForName
+ * Get the entries in dir that have name as one of their names, e.g. the
+ * firmware directories of a hardware. Case insensitive.
+ */
+QVector<FirmwareCatalog::Entry> FirmwareCatalog::entriesForName(const QString &dir, const QString &name)
+{
+    QMutexLocker locker(&mMutex);
+    const auto &ind = index(cleanDir(dir));
+    QVector<Entry> res;
+
+    for (int i: ind.byName.value(name.toLower())) {
+        res.append(ind.entries.at(i));
+    }
+
+    return res;
+}
+
+/**
+ * @brief FirmwareCatalog::fileHash
+ * Get the MD5 hash of a file.
+ *
+ * @return
+ * The hash, or an empty array if the file could not be read.
+ */
+QByteArray FirmwareCatalog::fileHash(const QString &path)
+{
+    FileHash h;
+    bool ok = hashOf(path, h);
+    flushHashIndex();
+
+    if (!ok) {
+        return QByteArray();
+    }
+
+    return h.md5;
+}
+
+/**
+ * @brief FirmwareCatalog::fileImageCrc
+ * Get the size and CRC of a file the way the firmware reports them for
+ * the image it runs.
+ *
+ * @return
+ * False if the file could not be read.
+ */
+bool FirmwareCatalog::fileImageCrc(const QString &path, qint64 &size, quint16 &crc)
+{
+    FileHash h;
+    bool ok = hashOf(path, h);
+    flushHashIndex();
+
+    if (!ok) {
+        return false;
+    }
+
+    size = h.size;
+    crc = h.crc;
+    return true;
+}
+
+/**
+ * @brief FirmwareCatalog::findByHash
+ * Find a file with the given MD5 hash in one of the directories.
+ *
+ * @return
+ * Path to the file, or an empty string if there is none.
+ */
+QString FirmwareCatalog::findByHash(const QStringList &dirs, const QByteArray &hash)
+{
+    QString res;
+
+    for (const auto &dir: dirs) {
+        for (const auto &e: entries(dir)) {
+            FileHash h;
+            if (!e.isDir && hashOf(e.path, h) && h.md5 == hash) {
+                res = e.path;
+                break;
+            }
+        }
+
+        if (!res.isEmpty()) {
+            break;
+        }
+    }
+
+    // Once for all files that were hashed, instead of once per file
+    flushHashIndex();
+    return res;
+}
+
+/**
+ * @brief FirmwareCatalog::findByImage
+ * Find a file in one of the directories that matches the image size and
+ * CRC that the firmware reports. Files with another size are not read.
+ *
+ * @return
+ * Path to the file, or an empty string if there is none.
+ */
+QString FirmwareCatalog::findByImage(const QStringList &dirs, qint64 size, quint16 crc)
+{
+    QString res;
+
+    for (const auto &dir: dirs) {
+        for (const auto &e: entries(dir)) {
+            if (e.isDir || e.size != size) {
+                continue;
+            }
+
+            FileHash h;
+            if (hashOf(e.path, h) && h.size == size && h.crc == crc) {
+                res = e.path;
+                break;
+            }
+        }
+
+        if (!res.isEmpty()) {
+            break;
+        }
+    }
+
+    flushHashIndex();
+    return res;
+}
+
+/**
+ * @brief FirmwareCatalog::invalidate
+ * Forget everything that is cached about dir and its contents.
+ *
+ * @param dir
+ * The directory, or an empty string to clear the whole catalog.
+ */
+void FirmwareCatalog::invalidate(const QString &dir)
+{
+    QMutexLocker locker(&mMutex);
+
+    if (dir.isEmpty()) {
+        mDirs.clear();
+        mHashes.clear();
+        saveHashIndex();
+        return;
+    }
+
+    QString clean = cleanDir(dir);
+    auto inDir = [clean](const QString &path) {
+        return path == clean || path.startsWith(clean + "/");
+    };
+
+    for (auto it = mDirs.begin();it != mDirs.end();) {
+        if (inDir(it.key())) {
+            it = mDirs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    loadHashIndex();
+    for (auto it = mHashes.begin();it != mHashes.end();) {
+        if (inDir(it.key())) {
+            it = mHashes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    saveHashIndex();
+}
+
+/**
+ * @brief FirmwareCatalog::cleanDir
+ * Bring a path to the form that the entry paths have, so that e.g.
+ * "://fw_archive/" and ":/fw_archive" are the same key.
+ */
+QString FirmwareCatalog::cleanDir(const QString &dir)
+{
+    QString res = dir;
+
+    if (res.startsWith("qrc:")) {
+        res.remove(0, 3);
+    }
+
+    while (res.startsWith("://")) {
+        res.remove(1, 1);
+    }
+
+    return QDir::cleanPath(res);
+}
+
+const FirmwareCatalog::DirIndex &FirmwareCatalog::index(const QString &dir)
+{
+    auto it = mDirs.find(dir);
+    if (it != mDirs.end()) {
+        return it.value();
+    }
+
+    DirIndex ind;
+    foreach (const auto &fi, QDir(dir).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot, QDir::Name)) {
+        Entry e;
+        e.name = fi.fileName();
+        e.names = QString(e.name).replace(".bin", "").split("_o_");
+        e.path = cleanDir(fi.absoluteFilePath());
+        e.isDir = fi.isDir();
+        e.size = e.isDir ? 0 : fi.size();
+
+        for (const auto &n: e.names) {
+            ind.byName[n.toLower()].append(ind.entries.size());
+        }
+
+        ind.entries.append(e);
+    }
+
+    return mDirs.insert(dir, ind).value();
+}
+
+/**
+ * @brief FirmwareCatalog::hashOf
+ * Look up the hashes of a file in the index, and compute them if the file
+ * is not there or has changed since. New hashes are only kept in memory
+ * until flushHashIndex is called.
+ */
+bool FirmwareCatalog::hashOf(const QString &path, FileHash &res)
+{
+    QString clean = cleanDir(path);
+    QFileInfo fi(clean);
+    if (!fi.exists() || fi.isDir()) {
+        return false;
+    }
+
+    QDateTime modTime = fi.lastModified();
+    qint64 modified = modTime.isValid() ? modTime.toMSecsSinceEpoch() : -1;
+
+    {
+        QMutexLocker locker(&mMutex);
+        loadHashIndex();
+        auto it = mHashes.find(clean);
+        if (it != mHashes.end() && it.value().size == fi.size() &&
+                it.value().modified == modified) {
+            res = it.value();
+            return true;
+        }
+    }
+
+    QFile file(clean);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QByteArray data = file.readAll();
+    file.close();
+
+    res.size = data.size();
+    res.modified = modified;
+    res.md5 = QCryptographicHash::hash(data, QCryptographicHash::Md5);
+    res.crc = Packet::crc16((const unsigned char*)data.constData(), uint32_t(data.size()));
+
+    QMutexLocker locker(&mMutex);
+    mHashes.insert(clean, res);
+    mHashesChanged = true;
+
+    return true;
+}
+
+/**
+ * @brief FirmwareCatalog::flushHashIndex
+ * Write the hash index to disk if hashOf has added to it.
+ */
+void FirmwareCatalog::flushHashIndex()
+{
+    QMutexLocker locker(&mMutex);
+    if (mHashesChanged) {
+        saveHashIndex();
+    }
+}
+
+QString FirmwareCatalog::hashIndexPath()
+{
+    QString path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (path.isEmpty() || !QDir().mkpath(path)) {
+        return QString();
+    }
+
+    return path + "/fw_hash_index.bin";
+}
+
+void FirmwareCatalog::loadHashIndex()
+{
+    if (mHashesLoaded) {
+        return;
+    }
+
+    mHashesLoaded = true;
+
+    QFile file(hashIndexPath());
+    if (file.fileName().isEmpty() || !file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    qint32 num = 0;
+    in >> magic >> num;
+    if (magic != 0x56434649) {
+        return;
+    }
+
+    for (int i = 0;i < num && in.status() == QDataStream::Ok;i++) {
+        QString path;
+        FileHash h;
+        in >> path >> h.size >> h.modified >> h.md5 >> h.crc;
+
+        if (in.status() == QDataStream::Ok) {
+            mHashes.insert(path, h);
+        }
+    }
+}
+
+/*
+ * Files without a modification time, e.g. resources in some Qt versions,
+ * can not be told apart between runs and are only kept in memory.
+ */
+void FirmwareCatalog::saveHashIndex()
+{
+    mHashesChanged = false;
+
+    QFile file(hashIndexPath());
+    if (file.fileName().isEmpty() || !file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    qint32 num = 0;
+    for (const auto &h: mHashes) {
+        if (h.modified >= 0) {
+            num++;
+        }
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint32(0x56434649) << num;
+
+    for (auto it = mHashes.constBegin();it != mHashes.constEnd();++it) {
+        const auto &h = it.value();
+        if (h.modified >= 0) {
+            out << it.key() << h.size << h.modified << h.md5 << h.crc;
+        }
+    }
+}
@@ -0,0 +1,89 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef FIRMWARECATALOG_H
+#define FIRMWARECATALOG_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+#include <QByteArray>
+
+/*
+ * Index of the firmware, bootloader and configuration directories. The
+ * bundled resources never change at runtime, so every directory is only
+ * listed once. Directory and file names encode the hardware (or firmware
+ * version) names separated by _o_, and they can be looked up directly.
+ * The downloaded archive is re-indexed with invalidate() when it is
+ * replaced. File sizes and hashes are kept in an index in the cache
+ * directory, so that they only have to be computed when a file changes.
+ */
+class FirmwareCatalog
+{
+public:
+    struct Entry {
+        QString name;
+        QStringList names; // Name without .bin split on _o_
+        QString path;
+        bool isDir;
+        qint64 size;
+
+        QString displayName() const { return names.join(" & "); }
+    };
+
+    static QVector<Entry> entries(const QString &dir);
+    static QVector<Entry> entriesForName(const QString &dir, const QString &name);
+    static QByteArray fileHash(const QString &path);
+    static bool fileImageCrc(const QString &path, qint64 &size, quint16 &crc);
+    static QString findByHash(const QStringList &dirs, const QByteArray &hash);
+    static QString findByImage(const QStringList &dirs, qint64 size, quint16 crc);
+    static void invalidate(const QString &dir = QString());
+
+private:
+    struct DirIndex {
+        QVector<Entry> entries;
+        QHash<QString, QVector<int>> byName;
+    };
+
+    struct FileHash {
+        qint64 size;
+        qint64 modified; // ms since epoch, -1 if unknown
+        QByteArray md5;
+        quint16 crc;
+    };
+
+    static QMutex mMutex;
+    static QHash<QString, DirIndex> mDirs;
+    static QHash<QString, FileHash> mHashes;
+    static bool mHashesLoaded;
+    static bool mHashesChanged;
+
+    static QString cleanDir(const QString &dir);
+    static const DirIndex &index(const QString &dir);
+    static bool hashOf(const QString &path, FileHash &res);
+    static QString hashIndexPath();
+    static void loadHashIndex();
+    static void saveHashIndex();
+    static void flushHashIndex();
+
+};
+
+#endif // FIRMWARECATALOG_H
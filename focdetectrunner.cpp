@@ -0,0 +1,433 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "focdetectrunner.h"
+
+#include <QDebug>
+#include <QRandomGenerator>
+#include <memory>
+
+FocDetectVescBackend::FocDetectVescBackend(VescInterface *vesc)
+{
+    mVesc = vesc;
+}
+
+bool FocDetectVescBackend::perNode(const QVector<int> &canIds) const
+{
+    for (int id: canIds) {
+        if (!mVesc->commands()->getSeqEnvelope(id)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void FocDetectVescBackend::detect(int canId, bool allCan, const FocDetectParams &params, DetectDone done)
+{
+    auto req = mVesc->commands()->detectAllFocAsync(canId, allCan, params.maxPowerLoss,
+                                                    params.minCurrentIn, params.maxCurrentIn,
+                                                    params.openloopRpm, params.slErpm);
+    req->then([done](CommandRequest *r) {
+        if (r->isOk()) {
+            done(true, r->result().toInt());
+        } else {
+            done(false, 0);
+        }
+    });
+}
+
+void FocDetectVescBackend::readValues(int canId, ReadDone done)
+{
+    Commands *c = mVesc->commands();
+
+    // The replies also update the configuration of the UI, so the values
+    // are taken from copies that only hold this node.
+    auto mc = std::make_shared<ConfigParams>();
+    *mc = *mVesc->mcConfig();
+
+    auto readConf = [c, canId](int packetId) {
+        return c->request(packetId, [c, canId, packetId]() {
+            VByteArray vb;
+            vb.vbAppendInt8(packetId);
+            c->sendPacketTo(canId, vb);
+        }, nullptr, 4000, 2);
+    };
+
+    readConf(COMM_GET_MCCONF)->then([this, mc, readConf, done](CommandRequest *r) {
+        VByteArray vb(r->reply());
+        if (!r->isOk() || !mc->deSerialize(vb)) {
+            done(false, FocDetectValues());
+            return;
+        }
+
+        readConf(COMM_GET_APPCONF)->then([this, mc, done](CommandRequest *r) {
+            ConfigParams ap;
+            ap = *mVesc->appConfig();
+            VByteArray vb(r->reply());
+            if (!r->isOk() || !ap.deSerialize(vb)) {
+                done(false, FocDetectValues());
+                return;
+            }
+
+            FocDetectValues v;
+            v.controllerId = ap.getParamInt("controller_id");
+            v.currentMax = mc->getParamDouble("l_current_max");
+            v.r = mc->getParamDouble("foc_motor_r");
+            v.l = mc->getParamDouble("foc_motor_l");
+            v.ldLqDiff = mc->getParamDouble("foc_motor_ld_lq_diff");
+            v.fluxLinkage = mc->getParamDouble("foc_motor_flux_linkage");
+            v.tempComp = mc->getParamBool("foc_temp_comp");
+            v.sensorMode = mc->getParamEnum("foc_sensor_mode");
+            done(true, v);
+        });
+    });
+}
+
+void FocDetectVescBackend::cancel()
+{
+    mVesc->commands()->cancelRequests(COMM_DETECT_APPLY_ALL_FOC);
+    mVesc->commands()->cancelRequests(COMM_GET_MCCONF);
+    mVesc->commands()->cancelRequests(COMM_GET_APPCONF);
+}
+
+FocDetectSimBackend::FocDetectSimBackend(bool perNode, QObject *parent) : QObject(parent)
+{
+    mPerNode = perNode;
+    mDetectMin = 2000;
+    mDetectMax = 6000;
+    mReadMs = 150;
+    mCancelled = false;
+}
+
+void FocDetectSimBackend::setDetectTimeMs(int min, int max)
+{
+    mDetectMin = min;
+    mDetectMax = qMax(min, max);
+}
+
+void FocDetectSimBackend::setReadTimeMs(int ms)
+{
+    mReadMs = ms;
+}
+
+/**
+ * @brief FocDetectSimBackend::setResult
+ * Make the detection of a node fail.
+ *
+ * @param canId
+ * The node.
+ *
+ * @param result
+ * The result code the firmware would reply with, e.g. -10 for a failed flux
+ * linkage detection.
+ */
+void FocDetectSimBackend::setResult(int canId, int result)
+{
+    mResults.insert(canId, result);
+}
+
+bool FocDetectSimBackend::perNode(const QVector<int> &canIds) const
+{
+    (void)canIds;
+    return mPerNode;
+}
+
+void FocDetectSimBackend::detect(int canId, bool allCan, const FocDetectParams &params, DetectDone done)
+{
+    (void)params;
+    mCancelled = false;
+
+    // With allCan the firmware detects all nodes in parallel and replies
+    // when the slowest one is done, with the first error if any.
+    int res = mResults.value(canId, 0);
+    int time = QRandomGenerator::global()->bounded(mDetectMin, mDetectMax + 1);
+    if (allCan) {
+        time = mDetectMax;
+        for (int r: mResults) {
+            if (r < 0) {
+                res = r;
+                break;
+            }
+        }
+    }
+
+    later(time, [this, res, done]() {
+        done(!mCancelled, res);
+    });
+}
+
+void FocDetectSimBackend::readValues(int canId, ReadDone done)
+{
+    later(mReadMs, [this, canId, done]() {
+        FocDetectValues v;
+        v.controllerId = canId >= 0 ? canId : 0;
+        v.currentMax = 60.0;
+        v.r = 0.030 + 0.001 * double(canId + 1);
+        v.l = 30e-6 + 1e-6 * double(canId + 1);
+        v.ldLqDiff = 2e-6;
+        v.fluxLinkage = 0.010 + 0.0002 * double(canId + 1);
+        v.tempComp = false;
+        v.sensorMode = 0;
+        done(!mCancelled, v);
+    });
+}
+
+void FocDetectSimBackend::cancel()
+{
+    mCancelled = true;
+
+    // Let the pending steps report that they failed right away
+    for (auto t: mPending) {
+        t->start(0);
+    }
+}
+
+void FocDetectSimBackend::later(int ms, std::function<void()> func)
+{
+    QTimer *t = new QTimer(this);
+    t->setSingleShot(true);
+    mPending.append(t);
+
+    connect(t, &QTimer::timeout, [this, t, func]() {
+        mPending.removeOne(t);
+        t->deleteLater();
+        func();
+    });
+
+    t->start(mCancelled ? 0 : ms);
+}
+
+FocDetectRunner::FocDetectRunner(FocDetectBackend *backend, QObject *parent) : QObject(parent)
+{
+    mBackend = backend;
+    mElapsed = 0;
+    mNodesLeft = 0;
+    mPerNode = false;
+    mCancelled = false;
+    mLoop = nullptr;
+}
+
+/**
+ * @brief FocDetectRunner::run
+ * Detect the motor parameters of all nodes and read back the results. When
+ * the backend can address the nodes concurrently, every node is detected at
+ * the same time and its results are read as soon as its detection is done.
+ * Blocks with an event loop until all nodes are finished.
+ *
+ * @param canIds
+ * The nodes to detect, -1 is the local device.
+ *
+ * @param params
+ * Detection parameters.
+ *
+ * @return
+ * True if all nodes were detected and read back successfully.
+ */
+bool FocDetectRunner::run(QVector<int> canIds, const FocDetectParams &params)
+{
+    mNodes.clear();
+    for (int id: canIds) {
+        FocDetectNode n;
+        n.canId = id;
+        n.result = 0;
+        n.detectReplied = false;
+        n.readOk = false;
+        n.values = FocDetectValues();
+        n.detectStart = -1;
+        n.detectEnd = -1;
+        n.readStart = -1;
+        n.readEnd = -1;
+        mNodes.append(n);
+    }
+
+    mNodesLeft = mNodes.size();
+    mPerNode = mBackend->perNode(canIds);
+    mCancelled = false;
+    mClock.start();
+
+    if (mNodes.isEmpty()) {
+        mElapsed = 0;
+        return true;
+    }
+
+    for (int i = 0;i < mNodes.size();i++) {
+        mNodes[i].detectStart = 0;
+        emit nodeUpdated(i);
+    }
+
+    if (mPerNode) {
+        for (int i = 0;i < mNodes.size();i++) {
+            mBackend->detect(mNodes.at(i).canId, false, params, [this, i](bool replied, int result) {
+                detectDone(i, replied, result);
+            });
+        }
+    } else {
+        mBackend->detect(mNodes.first().canId, mNodes.size() > 1, params, [this](bool replied, int result) {
+            for (int i = 0;i < mNodes.size();i++) {
+                detectDone(i, replied, result);
+            }
+        });
+    }
+
+    QEventLoop loop;
+    mLoop = &loop;
+    if (mNodesLeft > 0) {
+        loop.exec();
+    }
+    mLoop = nullptr;
+
+    mElapsed = mClock.elapsed();
+
+    bool res = !mCancelled;
+    for (const auto &n: mNodes) {
+        if (!n.detectReplied || n.result < 0 || !n.readOk) {
+            res = false;
+        }
+    }
+
+    return res;
+}
+
+QVector<FocDetectNode> FocDetectRunner::nodes() const
+{
+    return mNodes;
+}
+
+qint64 FocDetectRunner::elapsedMs() const
+{
+    return mElapsed;
+}
+
+/**
+ * @brief FocDetectRunner::timelineText
+ * @return
+ * One line per node, with a bar showing when it was detected (D) and read
+ * back (R), for monospace output.
+ */
+QString FocDetectRunner::timelineText() const
+{
+    const int width = 40;
+    double scale = double(width) / double(qMax(mElapsed, qint64(1)));
+    QString res;
+
+    for (const auto &n: mNodes) {
+        QString bar(width, '.');
+        auto fill = [&bar, scale, width](qint64 start, qint64 end, QChar c) {
+            if (start < 0 || end < 0) {
+                return;
+            }
+
+            int a = qBound(0, int(double(start) * scale), width - 1);
+            int b = qBound(a + 1, int(double(end) * scale + 0.5), width);
+            for (int i = a;i < b;i++) {
+                bar[i] = c;
+            }
+        };
+
+        fill(n.detectStart, n.detectEnd, 'D');
+        fill(n.readStart, n.readEnd, 'R');
+
+        QString status = "OK";
+        if (!n.detectReplied) {
+            status = "No reply";
+        } else if (n.result < 0) {
+            status = QString("Failed (%1)").arg(n.result);
+        } else if (!n.readOk) {
+            status = "Read failed";
+        }
+
+        QString name = n.canId < 0 ? QString("Local") : QString("ID %1").arg(n.canId);
+        res += QString("%1 |%2| %3 s  %4\n").
+                arg(name, -6).
+                arg(bar).
+                arg(double(qMax(n.detectEnd, n.readEnd)) / 1000.0, 0, 'f', 1).
+                arg(status);
+    }
+
+    res += QString("Total: %1 s").arg(double(mElapsed) / 1000.0, 0, 'f', 1);
+    return res;
+}
+
+/**
+ * @brief FocDetectRunner::cancel
+ * Abort the detection. The nodes that are not finished are reported as
+ * having no reply.
+ */
+void FocDetectRunner::cancel()
+{
+    if (mNodesLeft > 0) {
+        mCancelled = true;
+        mBackend->cancel();
+    }
+}
+
+void FocDetectRunner::detectDone(int ind, bool replied, int result)
+{
+    FocDetectNode &n = mNodes[ind];
+    n.detectEnd = mClock.elapsed();
+    n.detectReplied = replied;
+    n.result = replied ? result : 0;
+    emit nodeUpdated(ind);
+
+    if (mCancelled || !replied || result < 0) {
+        nodeFinished(ind);
+    } else if (mPerNode || ind == 0) {
+        // Without concurrent addressing the nodes are read one by one,
+        // starting with the first.
+        readNode(ind);
+    }
+}
+
+void FocDetectRunner::readNode(int ind)
+{
+    mNodes[ind].readStart = mClock.elapsed();
+    emit nodeUpdated(ind);
+
+    mBackend->readValues(mNodes.at(ind).canId, [this, ind](bool ok, const FocDetectValues &values) {
+        FocDetectNode &n = mNodes[ind];
+        n.readEnd = mClock.elapsed();
+        n.readOk = ok;
+        if (ok) {
+            n.values = values;
+        }
+
+        nodeFinished(ind);
+
+        if (!mPerNode && (ind + 1) < mNodes.size()) {
+            if (mCancelled) {
+                for (int i = ind + 1;i < mNodes.size();i++) {
+                    nodeFinished(i);
+                }
+            } else {
+                readNode(ind + 1);
+            }
+        }
+    });
+}
+
+void FocDetectRunner::nodeFinished(int ind)
+{
+    mNodesLeft--;
+    emit nodeUpdated(ind);
+
+    if (mNodesLeft == 0 && mLoop) {
+        mLoop->quit();
+    }
+}
@@ -0,0 +1,166 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef FOCDETECTRUNNER_H
+#define FOCDETECTRUNNER_H
+
+#include <QObject>
+#include <QVector>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTimer>
+#include <functional>
+
+#include "vescinterface.h"
+
+struct FocDetectParams {
+    double maxPowerLoss;
+    double minCurrentIn;
+    double maxCurrentIn;
+    double openloopRpm;
+    double slErpm;
+};
+
+struct FocDetectValues {
+    int controllerId;
+    double currentMax;
+    double r;
+    double l;
+    double ldLqDiff;
+    double fluxLinkage;
+    bool tempComp;
+    int sensorMode;
+};
+
+struct FocDetectNode {
+    int canId;
+    int result;
+    bool detectReplied;
+    bool readOk;
+    FocDetectValues values;
+
+    // Milliseconds since the start of the run, -1 when the step has not
+    // started (or ended) yet.
+    qint64 detectStart;
+    qint64 detectEnd;
+    qint64 readStart;
+    qint64 readEnd;
+};
+
+/*
+ * Where the detection commands go. perNode() tells whether the given nodes
+ * can be addressed at the same time; if not, the detection is started once on the
+ * first node with allCan set, which makes the firmware run it on the whole
+ * bus, and the results are read back one node at a time.
+ */
+class FocDetectBackend
+{
+public:
+    typedef std::function<void(bool replied, int result)> DetectDone;
+    typedef std::function<void(bool ok, const FocDetectValues &values)> ReadDone;
+
+    virtual ~FocDetectBackend() {}
+    virtual bool perNode(const QVector<int> &canIds) const = 0;
+    virtual void detect(int canId, bool allCan, const FocDetectParams &params, DetectDone done) = 0;
+    virtual void readValues(int canId, ReadDone done) = 0;
+    virtual void cancel() = 0;
+};
+
+// Backend for a connected VESC. Nodes are detected concurrently when all of
+// them use the sequence envelope, as only then the replies can be told apart.
+class FocDetectVescBackend : public FocDetectBackend
+{
+public:
+    explicit FocDetectVescBackend(VescInterface *vesc);
+
+    bool perNode(const QVector<int> &canIds) const override;
+    void detect(int canId, bool allCan, const FocDetectParams &params, DetectDone done) override;
+    void readValues(int canId, ReadDone done) override;
+    void cancel() override;
+
+private:
+    VescInterface *mVesc;
+
+};
+
+// Simulated controllers with random detection times, for trying the runner
+// without hardware.
+class FocDetectSimBackend : public QObject, public FocDetectBackend
+{
+    Q_OBJECT
+public:
+    explicit FocDetectSimBackend(bool perNode, QObject *parent = nullptr);
+
+    void setDetectTimeMs(int min, int max);
+    void setReadTimeMs(int ms);
+    void setResult(int canId, int result);
+
+    bool perNode(const QVector<int> &canIds) const override;
+    void detect(int canId, bool allCan, const FocDetectParams &params, DetectDone done) override;
+    void readValues(int canId, ReadDone done) override;
+    void cancel() override;
+
+private:
+    bool mPerNode;
+    int mDetectMin;
+    int mDetectMax;
+    int mReadMs;
+    bool mCancelled;
+    QHash<int, int> mResults;
+    QList<QTimer*> mPending;
+
+    void later(int ms, std::function<void()> func);
+
+};
+
+class FocDetectRunner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FocDetectRunner(FocDetectBackend *backend, QObject *parent = nullptr);
+
+    bool run(QVector<int> canIds, const FocDetectParams &params);
+    QVector<FocDetectNode> nodes() const;
+    qint64 elapsedMs() const;
+    QString timelineText() const;
+
+signals:
+    void nodeUpdated(int index);
+
+public slots:
+    void cancel();
+
+private:
+    FocDetectBackend *mBackend;
+    QVector<FocDetectNode> mNodes;
+    QElapsedTimer mClock;
+    qint64 mElapsed;
+    int mNodesLeft;
+    bool mPerNode;
+    bool mCancelled;
+    QEventLoop *mLoop;
+
+    void detectDone(int ind, bool replied, int result);
+    void readNode(int ind);
+    void nodeFinished(int ind);
+
+};
+
+#endif // FOCDETECTRUNNER_H
@@ -0,0 +1,386 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "fwdelta.h"
+#include "vbytearray.h"
+#include "packet.h"
+#include "utility.h"
+
+#include <QHash>
+#include <QVector>
+#include <QtEndian>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <QCryptographicHash>
+#include <cstring>
+
+namespace {
+const char magic[] = "VFD1";
+const int headerSize = 4 + 4 + 16 + 4 + 2;
+
+// Shortest exact match that starts a copy
+const int seedLen = 16;
+
+// Give up extending a match after this many bytes without improvement
+const int extendWindow = 32;
+
+enum {
+    OP_COPY = 0x01,
+    OP_ADD = 0x02,
+    OP_DATA = 0x03
+};
+
+inline quint64 seedHash(const char *p)
+{
+    quint64 a, b;
+    memcpy(&a, p, 8);
+    memcpy(&b, p + 8, 8);
+    a *= 0x9E3779B97F4A7C15ULL;
+    return (a ^ (a >> 29)) + b * 0xC2B2AE3D27D4EB4FULL;
+}
+
+void appendData(VByteArray &patch, const char *data, int len)
+{
+    if (len > 0) {
+        patch.vbAppendUint8(OP_DATA);
+        patch.vbAppendUint32(quint32(len));
+        patch.append(data, len);
+    }
+}
+}
+
+/**
+ * @brief FwDelta::generate
+ * Generate a patch that turns base into target. Matches are seeded by
+ * hashing every 16 byte window of base, and then extended as long as most
+ * bytes still match. The mismatching bytes in a match are stored as
+ * differences, which handles code that moved and got new addresses.
+ *
+ * @param base
+ * The image that is on the device.
+ *
+ * @param target
+ * The new image.
+ *
+ * @return
+ * The patch.
+ */
+QByteArray FwDelta::generate(const QByteArray &base, const QByteArray &target)
+{
+    const char *b = base.constData();
+    const char *t = target.constData();
+    const int bn = base.size();
+    const int tn = target.size();
+
+    VByteArray patch;
+    patch.append(magic, 4);
+    patch.vbAppendUint32(quint32(bn));
+    patch.append(QCryptographicHash::hash(base, QCryptographicHash::Md5));
+    patch.vbAppendUint32(quint32(tn));
+    patch.vbAppendUint16(Packet::crc16((const unsigned char*)t, uint32_t(tn)));
+
+    QHash<quint64, int> index;
+    index.reserve(qMax(0, bn - seedLen + 1));
+    for (int i = 0;i + seedLen <= bn;i++) {
+        auto h = seedHash(b + i);
+        if (!index.contains(h)) {
+            index.insert(h, i);
+        }
+    }
+
+    int tPos = 0;
+    int litStart = 0;
+
+    // Continuing where the last match ended is the most likely match
+    int hintB = -1;
+    int hintT = 0;
+
+    while (tPos + seedLen <= tn) {
+        int bPos = -1;
+
+        if (hintB >= 0) {
+            int hb = hintB + (tPos - hintT);
+            if (hb + seedLen <= bn && memcmp(b + hb, t + tPos, seedLen) == 0) {
+                bPos = hb;
+            }
+        }
+
+        if (bPos < 0) {
+            auto it = index.constFind(seedHash(t + tPos));
+            if (it != index.constEnd() && memcmp(b + it.value(), t + tPos, seedLen) == 0) {
+                bPos = it.value();
+            }
+        }
+
+        if (bPos < 0) {
+            tPos++;
+            continue;
+        }
+
+        // Take back literal bytes that also match
+        while (tPos > litStart && bPos > 0 && b[bPos - 1] == t[tPos - 1]) {
+            tPos--;
+            bPos--;
+        }
+
+        int len = 0;
+        int matches = 0;
+        int bestLen = 0;
+        int bestScore = 0;
+        int bestMatches = 0;
+        while (bPos + len < bn && tPos + len < tn) {
+            if (b[bPos + len] == t[tPos + len]) {
+                matches++;
+            }
+            len++;
+
+            int score = 2 * matches - len;
+            if (score > bestScore) {
+                bestScore = score;
+                bestLen = len;
+                bestMatches = matches;
+            }
+
+            if ((len - bestLen) > extendWindow) {
+                break;
+            }
+        }
+
+        appendData(patch, t + litStart, tPos - litStart);
+
+        if (bestMatches == bestLen) {
+            patch.vbAppendUint8(OP_COPY);
+            patch.vbAppendUint32(quint32(bPos));
+            patch.vbAppendUint32(quint32(bestLen));
+        } else {
+            patch.vbAppendUint8(OP_ADD);
+            patch.vbAppendUint32(quint32(bPos));
+            patch.vbAppendUint32(quint32(bestLen));
+
+            int ofs = patch.size();
+            patch.resize(ofs + bestLen);
+            char *d = patch.data() + ofs;
+            for (int i = 0;i < bestLen;i++) {
+                d[i] = char(quint8(t[tPos + i]) - quint8(b[bPos + i]));
+            }
+        }
+
+        tPos += bestLen;
+        litStart = tPos;
+        hintB = bPos + bestLen;
+        hintT = tPos;
+    }
+
+    appendData(patch, t + litStart, tn - litStart);
+
+    return patch;
+}
+
+/**
+ * @brief FwDelta::apply
+ * Rebuild the target image from base and a patch. This is what the
+ * bootloader does on devices that support delta updates. base and target
+ * must not share memory, as operations read from anywhere in base.
+ *
+ * @param base
+ * The image that is on the device.
+ *
+ * @param patch
+ * The patch.
+ *
+ * @param target
+ * The resulting image.
+ *
+ * @param error
+ * Reason for failure, can be null.
+ *
+ * @return
+ * true if the patch was for base and the result has the expected CRC.
+ */
+bool FwDelta::apply(const QByteArray &base, const QByteArray &patch, QByteArray &target, QString *error)
+{
+    auto fail = [error](QString msg) {
+        if (error) {
+            *error = msg;
+        }
+        return false;
+    };
+
+    if (!isPatch(patch)) {
+        return fail("Not a firmware patch");
+    }
+
+    const uchar *p = (const uchar*)patch.constData();
+    const int pn = patch.size();
+
+    quint32 baseSize = qFromBigEndian<quint32>(p + 4);
+    quint32 targetSize = qFromBigEndian<quint32>(p + 24);
+    quint16 targetCrc = qFromBigEndian<quint16>(p + 28);
+
+    if (baseSize != quint32(base.size()) ||
+            baseHash(patch) != QCryptographicHash::hash(base, QCryptographicHash::Md5)) {
+        return fail("The patch is for a different base image");
+    }
+
+    target.resize(int(targetSize));
+    uchar *t = (uchar*)target.data();
+    const uchar *b = (const uchar*)base.constData();
+    quint32 tPos = 0;
+    int pos = headerSize;
+
+    while (pos < pn) {
+        int op = p[pos++];
+
+        if (op == OP_COPY || op == OP_ADD) {
+            if ((pos + 8) > pn) {
+                return fail("Truncated patch");
+            }
+
+            quint32 src = qFromBigEndian<quint32>(p + pos);
+            quint32 len = qFromBigEndian<quint32>(p + pos + 4);
+            pos += 8;
+
+            if (quint64(src) + len > baseSize || quint64(tPos) + len > targetSize) {
+                return fail("Copy out of range");
+            }
+
+            if (op == OP_COPY) {
+                memcpy(t + tPos, b + src, len);
+            } else {
+                if (quint64(pos) + len > quint64(pn)) {
+                    return fail("Truncated patch");
+                }
+
+                for (quint32 i = 0;i < len;i++) {
+                    t[tPos + i] = uchar(b[src + i] + p[pos + int(i)]);
+                }
+                pos += int(len);
+            }
+
+            tPos += len;
+        } else if (op == OP_DATA) {
+            if ((pos + 4) > pn) {
+                return fail("Truncated patch");
+            }
+
+            quint32 len = qFromBigEndian<quint32>(p + pos);
+            pos += 4;
+
+            if (quint64(pos) + len > quint64(pn) || quint64(tPos) + len > targetSize) {
+                return fail("Data out of range");
+            }
+
+            memcpy(t + tPos, p + pos, len);
+            pos += int(len);
+            tPos += len;
+        } else {
+            return fail(QString("Unknown operation %1").arg(op));
+        }
+    }
+
+    if (tPos != targetSize) {
+        return fail("The patch does not cover the whole image");
+    }
+
+    if (Packet::crc16(t, targetSize) != targetCrc) {
+        return fail("CRC mismatch");
+    }
+
+    return true;
+}
+
+bool FwDelta::isPatch(const QByteArray &data)
+{
+    return data.size() >= headerSize && data.startsWith(magic);
+}
+
+/**
+ * @brief FwDelta::baseHash
+ * Get the MD5 of the image the patch applies to.
+ */
+QByteArray FwDelta::baseHash(const QByteArray &patch)
+{
+    if (!isPatch(patch)) {
+        return QByteArray();
+    }
+
+    return patch.mid(8, 16);
+}
+
+/**
+ * @brief FwDelta::wireBytes
+ * Estimate how many bytes uploading data takes in write commands, with LZO
+ * compression and empty chunks skipped the same way as in
+ * VescInterface::fwUpload.
+ */
+int FwDelta::wireBytes(const QByteArray &data, int chunkSize)
+{
+    auto lzoChunks = Utility::lzoCompressChunks(data, chunkSize);
+    int res = 0;
+
+    for (int i = 0;i < lzoChunks.size();i++) {
+        QByteArray in = data.mid(i * chunkSize, chunkSize);
+
+        if (in.count(char(0xFF)) == in.size()) {
+            continue;
+        }
+
+        // Command and offset
+        res += 5;
+
+        const auto &lzo = lzoChunks.at(i);
+        if (!lzo.isEmpty() && (lzo.size() + 2) < in.size()) {
+            res += lzo.size() + 2;
+        } else {
+            res += in.size();
+        }
+    }
+
+    return res;
+}
+
+/**
+ * @brief FwDelta::simulate
+ * Generate a patch, apply it like the device would and compare the bytes
+ * that the full and the delta upload put on the link.
+ */
+FwDelta::SimResult FwDelta::simulate(const QByteArray &base, const QByteArray &target)
+{
+    SimResult res;
+    QElapsedTimer timer;
+
+    timer.start();
+    QByteArray patch = generate(base, target);
+    res.generateMs = timer.restart();
+
+    QByteArray rebuilt;
+    QString error;
+    res.ok = apply(base, patch, rebuilt, &error) && rebuilt == target;
+    res.applyMs = timer.elapsed();
+
+    if (!error.isEmpty()) {
+        qWarning() << "Applying patch failed:" << error;
+    }
+
+    res.patchSize = patch.size();
+    res.fullWireBytes = wireBytes(target);
+    res.deltaWireBytes = wireBytes(patch);
+
+    return res;
+}
@@ -0,0 +1,71 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef FWDELTA_H
+#define FWDELTA_H
+
+#include <QByteArray>
+#include <QString>
+
+/*
+ * Binary patches between two firmware images. A patch only applies to the
+ * base image with the MD5 stored in its header, and it is rebuilt into the
+ * target image with a sequence of copy, add and data operations:
+ *
+ * Header: "VFD1" | baseSize (u32) | baseMd5 (16) | targetSize (u32) | targetCrc (u16)
+ * COPY:   0x01 | srcOffset (u32) | len (u32)
+ * ADD:    0x02 | srcOffset (u32) | len (u32) | len bytes added to the base
+ * DATA:   0x03 | len (u32) | len bytes
+ *
+ * All integers are big endian. The add bytes are mostly zero for code that
+ * only moved, so the patch compresses well on the way to the device.
+ *
+ * COPY and ADD read from any offset in the base, also from parts that an
+ * earlier operation has already written in the target. The patch can
+ * therefore not be applied in place: the base has to stay intact until the
+ * whole target is built, e.g. by writing the target to the new app buffer
+ * and reading the base from the running image.
+ *
+ * No released firmware applies patches. VescInterface::fwUpload only sends
+ * them (with 0xDD in the top byte of the size) when the firmware reports
+ * FW_RX_PARAMS::fwDeltaSupported.
+ */
+class FwDelta
+{
+public:
+    struct SimResult {
+        bool ok;
+        int patchSize;
+        int fullWireBytes;
+        int deltaWireBytes;
+        qint64 generateMs;
+        qint64 applyMs;
+    };
+
+    static QByteArray generate(const QByteArray &base, const QByteArray &target);
+    static bool apply(const QByteArray &base, const QByteArray &patch,
+                      QByteArray &target, QString *error = nullptr);
+    static bool isPatch(const QByteArray &data);
+    static QByteArray baseHash(const QByteArray &patch);
+    static int wireBytes(const QByteArray &data, int chunkSize = 384);
+    static SimResult simulate(const QByteArray &base, const QByteArray &target);
+
+};
+
+#endif // FWDELTA_H
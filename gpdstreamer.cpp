@@ -0,0 +1,311 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "gpdstreamer.h"
+#include <QDebug>
+#include <cmath>
+
+namespace {
+// Decoded samples that are kept in memory
+const int inBlockSize = 4096;
+
+// Most samples to send per buffer level update, so that other commands
+// still get through on slow links.
+const int maxSamplesPerUpdate = 2048;
+}
+
+GpdStreamer::GpdStreamer(QObject *parent) : QObject(parent)
+{
+    mCommands = nullptr;
+    mTimer = new QTimer(this);
+    mTimer->setInterval(20);
+
+    mRunning = false;
+    mInt16 = true;
+    mSourceDone = false;
+    mQuantScale = 32767.0;
+
+    mStep = 1.0;
+    mFrac = 0.0;
+    mS0 = 0.0;
+    mS1 = 0.0;
+
+    mInPos = 0;
+    mInLen = 0;
+
+    mBufferCapacity = -1;
+    mBufferLeftLast = -1;
+    mBufferLeft = 0;
+    mUnderruns = 0;
+    mSamplesSent = 0;
+    mSizeRequestPending = false;
+
+    connect(mTimer, SIGNAL(timeout()), this, SLOT(timerSlot()));
+}
+
+void GpdStreamer::setCommands(Commands *commands)
+{
+    if (mCommands) {
+        disconnect(mCommands, nullptr, this, nullptr);
+    }
+
+    mCommands = commands;
+
+    if (mCommands) {
+        connect(mCommands, SIGNAL(gpdBufferSizeLeftReceived(int)),
+                this, SLOT(bufferSizeLeftReceived(int)));
+        connect(mCommands, SIGNAL(gpdBufferNotifyReceived()),
+                this, SLOT(bufferNotifyReceived()));
+    }
+}
+
+/**
+ * @brief GpdStreamer::startMp3
+ * Start streaming an MP3 file to the GPD buffer. The GPD output mode has to be
+ * set up separately.
+ *
+ * @param path
+ * The file to play.
+ *
+ * @param fOut
+ * Output sample rate, this is also set as the GPD switching frequency.
+ *
+ * @param int16
+ * Send int16 samples, otherwise int8 samples are used which takes half the
+ * bandwidth.
+ *
+ * @param amplitude
+ * The output value of a full scale sample.
+ *
+ * @return
+ * true if the file could be opened.
+ */
+bool GpdStreamer::startMp3(QString path, double fOut, bool int16, double amplitude)
+{
+    stop();
+
+    if (!mCommands || fOut <= 0.0) {
+        return false;
+    }
+
+    if (!mMp3.open(path)) {
+        return false;
+    }
+
+    mInt16 = int16;
+    mQuantScale = mInt16 ? 32767.0 : 127.0;
+    mStep = double(mMp3.fSamp()) / fOut;
+    mFrac = 0.0;
+    mIn.resize(inBlockSize);
+    mInPos = 0;
+    mInLen = 0;
+    mSourceDone = false;
+
+    if (!nextInput(mS0) || !nextInput(mS1)) {
+        mMp3.close();
+        return false;
+    }
+
+    mBufferCapacity = -1;
+    mBufferLeftLast = -1;
+    mBufferLeft = 0;
+    mUnderruns = 0;
+    mSamplesSent = 0;
+    mSizeRequestPending = false;
+    mRunning = true;
+
+    mCommands->gpdSetFsw(float(fOut));
+    mCommands->gpdSetBufferIntScale(float(amplitude / mQuantScale));
+
+    requestSizeLeft();
+    mTimer->start();
+
+    return true;
+}
+
+void GpdStreamer::stop()
+{
+    mTimer->stop();
+    mMp3.close();
+    mRunning = false;
+}
+
+bool GpdStreamer::isRunning()
+{
+    return mRunning;
+}
+
+qint64 GpdStreamer::samplesSent()
+{
+    return mSamplesSent;
+}
+
+/**
+ * @brief GpdStreamer::underruns
+ * @return
+ * Number of times the device buffer was found empty while there still were
+ * samples left to send.
+ */
+int GpdStreamer::underruns()
+{
+    return mUnderruns;
+}
+
+/**
+ * @brief GpdStreamer::bufferLevel
+ * @return
+ * Samples in the device buffer at the last update.
+ */
+int GpdStreamer::bufferLevel()
+{
+    return mBufferCapacity > 0 ? mBufferCapacity - mBufferLeft : 0;
+}
+
+void GpdStreamer::timerSlot()
+{
+    // Ask again if the reply got lost
+    if (mSizeRequestPending && mSizeRequestTime.elapsed() < 500) {
+        return;
+    }
+
+    requestSizeLeft();
+}
+
+void GpdStreamer::bufferSizeLeftReceived(int sizeLeft)
+{
+    if (!mRunning) {
+        return;
+    }
+
+    mSizeRequestPending = false;
+    mBufferLeft = sizeLeft;
+
+    // The buffer can still be playing something from before, so the
+    // capacity is taken when it has stopped draining between two updates.
+    // Nothing is sent until then.
+    if (mBufferCapacity < 0) {
+        if (sizeLeft != mBufferLeftLast) {
+            mBufferLeftLast = sizeLeft;
+            return;
+        }
+
+        mBufferCapacity = sizeLeft;
+    }
+
+    mBufferCapacity = qMax(mBufferCapacity, sizeLeft);
+
+    if (sizeLeft >= mBufferCapacity && mSamplesSent > 0) {
+        if (mSourceDone) {
+            stop();
+            emit finished();
+            return;
+        }
+
+        mUnderruns++;
+        emit underrun(mUnderruns);
+    }
+
+    if (!mSourceDone) {
+        sendSamples(qMin(sizeLeft, maxSamplesPerUpdate));
+    }
+}
+
+void GpdStreamer::bufferNotifyReceived()
+{
+    // The reply to the pending request has the new level already
+    if (mRunning && !mSizeRequestPending) {
+        requestSizeLeft();
+    }
+}
+
+bool GpdStreamer::nextInput(float &sample)
+{
+    if (mInPos >= mInLen) {
+        mInLen = mMp3.readMono(mIn.data(), mIn.size());
+        mInPos = 0;
+
+        if (mInLen <= 0) {
+            return false;
+        }
+    }
+
+    sample = mIn.at(mInPos++);
+    return true;
+}
+
+/**
+ * @brief GpdStreamer::sendSamples
+ * Resample and quantize the next num samples and send them. The resampler
+ * interpolates linearly between input samples, and keeps its position
+ * between calls so that the blocks join without gaps.
+ */
+void GpdStreamer::sendSamples(int num)
+{
+    if (num <= 0) {
+        return;
+    }
+
+    if (mInt16) {
+        mOut16.resize(0);
+        mOut16.reserve(num);
+    } else {
+        mOut8.resize(0);
+        mOut8.reserve(num);
+    }
+
+    for (int i = 0;i < num && !mSourceDone;i++) {
+        double val = (mS0 + (mS1 - mS0) * mFrac) * mQuantScale;
+        val = qBound(-mQuantScale, std::round(val), mQuantScale);
+
+        if (mInt16) {
+            mOut16.append(qint16(val));
+        } else {
+            mOut8.append(qint8(val));
+        }
+
+        mFrac += mStep;
+        while (mFrac >= 1.0) {
+            mFrac -= 1.0;
+            mS0 = mS1;
+            if (!nextInput(mS1)) {
+                mSourceDone = true;
+                break;
+            }
+        }
+    }
+
+    if (mInt16) {
+        mCommands->gpdFillBufferInt16(mOut16);
+        mSamplesSent += mOut16.size();
+    } else {
+        mCommands->gpdFillBufferInt8(mOut8);
+        mSamplesSent += mOut8.size();
+    }
+
+    if (mSourceDone) {
+        mMp3.close();
+    }
+}
+
+void GpdStreamer::requestSizeLeft()
+{
+    mSizeRequestPending = true;
+    mSizeRequestTime.start();
+    mCommands->getGpdBufferSizeLeft();
+}
@@ -0,0 +1,95 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef GPDSTREAMER_H
+#define GPDSTREAMER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+#include <QElapsedTimer>
+#include "commands.h"
+#include "minimp3/qminimp3.h"
+
+/*
+ * Streams an audio file to the GPD output buffer. The file is decoded,
+ * resampled to the output rate and quantized to int8 or int16 a block at a
+ * time, and only as many samples as the device buffer has room for are
+ * sent. Memory use does not depend on the length of the file.
+ */
+class GpdStreamer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit GpdStreamer(QObject *parent = nullptr);
+
+    Q_INVOKABLE void setCommands(Commands *commands);
+    Q_INVOKABLE bool startMp3(QString path, double fOut, bool int16 = true, double amplitude = 1.0);
+    Q_INVOKABLE void stop();
+    Q_INVOKABLE bool isRunning();
+    Q_INVOKABLE qint64 samplesSent();
+    Q_INVOKABLE int underruns();
+    Q_INVOKABLE int bufferLevel();
+
+signals:
+    void finished();
+    void underrun(int count);
+
+private slots:
+    void timerSlot();
+    void bufferSizeLeftReceived(int sizeLeft);
+    void bufferNotifyReceived();
+
+private:
+    Commands *mCommands;
+    QMiniMp3Stream mMp3;
+    QTimer *mTimer;
+
+    bool mRunning;
+    bool mInt16;
+    bool mSourceDone;
+    double mQuantScale;
+
+    // Resampler state, the output is between mS0 and mS1
+    double mStep;
+    double mFrac;
+    float mS0;
+    float mS1;
+
+    QVector<float> mIn;
+    int mInPos;
+    int mInLen;
+    QVector<qint8> mOut8;
+    QVector<qint16> mOut16;
+
+    int mBufferCapacity;
+    int mBufferLeftLast;
+    int mBufferLeft;
+    int mUnderruns;
+    qint64 mSamplesSent;
+    bool mSizeRequestPending;
+    QElapsedTimer mSizeRequestTime;
+
+    bool nextInput(float &sample);
+    void sendSamples(int num);
+    void requestSizeLeft();
+
+};
+
+#endif // GPDSTREAMER_H
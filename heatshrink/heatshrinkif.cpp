@@ -2,6 +2,7 @@
 
 #include <QFile>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <cstring>
 
 HeatshrinkIf::HeatshrinkIf()
@@ -55,6 +56,59 @@ QByteArray HeatshrinkIf::encode(QByteArray in)
     return res;
 }
 
+void HeatshrinkIf::encodeStart()
+{
+    heatshrink_encoder_reset(hse);
+}
+
+/**
+ * @brief HeatshrinkIf::encodeStream
+ * Feed the next part of the input to the encoder, which has to be reset with
+ * encodeStart first.
+ *
+ * @param data
+ * Input data.
+ *
+ * @param len
+ * Input length.
+ *
+ * @param finish
+ * This is the last part of the input.
+ *
+ * @return
+ * The output that is ready. The encoder keeps some input back until more
+ * arrives or the stream is finished.
+ */
+QByteArray HeatshrinkIf::encodeStream(const char *data, int len, bool finish)
+{
+    QByteArray res;
+    uint8_t out[512];
+    size_t count = 0;
+    int sunk = 0;
+
+    auto pollAll = [&]() {
+        HSE_poll_res pres;
+        do {
+            pres = heatshrink_encoder_poll(hse, out, sizeof(out), &count);
+            res.append((const char*)out, int(count));
+        } while (pres == HSER_POLL_MORE);
+    };
+
+    while (sunk < len) {
+        heatshrink_encoder_sink(hse, (uint8_t*)data + sunk, size_t(len - sunk), &count);
+        sunk += int(count);
+        pollAll();
+    }
+
+    if (finish) {
+        while (heatshrink_encoder_finish(hse) == HSER_FINISH_MORE) {
+            pollAll();
+        }
+    }
+
+    return res;
+}
+
 QByteArray HeatshrinkIf::decode(QByteArray in)
 {
     heatshrink_decoder_reset(hsd);
@@ -109,3 +163,114 @@ void HeatshrinkIf::test(QString fileName)
     qDebug() << "DecompSz:" <<  decomp.size();
     qDebug() << "Compare:" << decomp.compare(dataIn);
 }
+
+HeatshrinkStreamEncoder::HeatshrinkStreamEncoder(QByteArray in, QObject *parent) : QThread(parent)
+{
+    mIn = in;
+    mDone = 0;
+    mEncodeTimeMs = 0;
+}
+
+HeatshrinkStreamEncoder::~HeatshrinkStreamEncoder()
+{
+    wait();
+}
+
+/**
+ * @brief HeatshrinkStreamEncoder::take
+ * Take the output that has been produced since the last call.
+ */
+QByteArray HeatshrinkStreamEncoder::take()
+{
+    QMutexLocker locker(&mMutex);
+    QByteArray res = mOut;
+    mOut.clear();
+    return res;
+}
+
+/**
+ * @brief HeatshrinkStreamEncoder::isDone
+ * True when all input is encoded. Output can still be left to take.
+ */
+bool HeatshrinkStreamEncoder::isDone()
+{
+    return mDone.loadAcquire() != 0;
+}
+
+/**
+ * @brief HeatshrinkStreamEncoder::inputForOutput
+ * Get how much of the input the first outBytes of the output correspond to,
+ * interpolated within the block that they end in.
+ */
+int HeatshrinkStreamEncoder::inputForOutput(int outBytes)
+{
+    QMutexLocker locker(&mMutex);
+
+    int outPrev = 0;
+    int inPrev = 0;
+    for (const auto &b: mBlockEnds) {
+        if (outBytes <= b.first) {
+            if (b.first == outPrev) {
+                return b.second;
+            }
+
+            return inPrev + int(qint64(b.second - inPrev) * (outBytes - outPrev) /
+                                (b.first - outPrev));
+        }
+
+        outPrev = b.first;
+        inPrev = b.second;
+    }
+
+    return inPrev;
+}
+
+int HeatshrinkStreamEncoder::inputSize() const
+{
+    return mIn.size();
+}
+
+qint64 HeatshrinkStreamEncoder::encodeTimeMs()
+{
+    QMutexLocker locker(&mMutex);
+    return mEncodeTimeMs;
+}
+
+void HeatshrinkStreamEncoder::run()
+{
+    const int blockSize = 4096;
+    HeatshrinkIf hs;
+    QElapsedTimer timer;
+    timer.start();
+
+    hs.encodeStart();
+
+    int pos = 0;
+    int outTot = 0;
+    do {
+        int len = qMin(blockSize, mIn.size() - pos);
+        bool last = (pos + len) >= mIn.size();
+        QByteArray out = hs.encodeStream(mIn.constData() + pos, len, last);
+        pos += len;
+
+        outTot += out.size();
+
+        {
+            QMutexLocker locker(&mMutex);
+            mOut.append(out);
+            mBlockEnds.append(qMakePair(outTot, pos));
+        }
+
+        if (!out.isEmpty()) {
+            emit outputAvailable();
+        }
+    } while (pos < mIn.size());
+
+    {
+        QMutexLocker locker(&mMutex);
+        mEncodeTimeMs = timer.elapsed();
+        mDone.storeRelease(1);
+    }
+
+    emit outputAvailable();
+}
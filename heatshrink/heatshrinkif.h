@@ -4,6 +4,11 @@
 #include "heatshrink_encoder.h"
 #include "heatshrink_decoder.h"
 #include <QString>
+#include <QThread>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QVector>
+#include <QPair>
 
 class HeatshrinkIf
 {
@@ -12,6 +17,8 @@ public:
     ~HeatshrinkIf();
 
     QByteArray encode(QByteArray in);
+    void encodeStart();
+    QByteArray encodeStream(const char *data, int len, bool finish);
     QByteArray decode(QByteArray in);
     void test(QString fileName);
 
@@ -20,4 +27,37 @@ private:
     heatshrink_decoder *hsd;
 };
 
+/*
+ * Encodes a buffer block by block on its own thread, so that the output can
+ * be consumed, e.g. uploaded, while the rest is still being compressed. The
+ * output is identical to HeatshrinkIf::encode.
+ */
+class HeatshrinkStreamEncoder : public QThread
+{
+    Q_OBJECT
+public:
+    explicit HeatshrinkStreamEncoder(QByteArray in, QObject *parent = nullptr);
+    ~HeatshrinkStreamEncoder();
+
+    QByteArray take();
+    bool isDone();
+    int inputForOutput(int outBytes);
+    int inputSize() const;
+    qint64 encodeTimeMs();
+
+signals:
+    void outputAvailable();
+
+protected:
+    void run() override;
+
+private:
+    QByteArray mIn;
+    QByteArray mOut;
+    QVector<QPair<int, int> > mBlockEnds;
+    QMutex mMutex;
+    QAtomicInt mDone;
+    qint64 mEncodeTimeMs;
+};
+
 #endif // HEATSHRINKIF_H
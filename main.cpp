@@ -22,8 +22,10 @@
 #include "mobile/qmlui.h"
 #include "mobile/fwhelper.h"
 #include "mobile/vesc3ditem.h"
+#include "widgets/vesc3dview.h"
 #include "mobile/logwriter.h"
 #include "mobile/logreader.h"
+#include "mobile/logcursor.h"
 #include "tcpserversimple.h"
 #include "pages/pagemotorcomparison.h"
 #include "codeloader.h"
@@ -31,6 +33,16 @@
 #include "utility.h"
 #include "heatshrink/heatshrinkif.h"
 #include "minimp3/qminimp3.h"
+#include "lzokay/lzokay.hpp"
+#include "esp32/esp32flash.h"
+#include "esp32/esp32loaderstub.h"
+#include "fwdelta.h"
+#include "gpdstreamer.h"
+#include "telemetrystreamer.h"
+#include "metricsserver.h"
+#include "sdmirror.h"
+#include "focdetectrunner.h"
+#include "vescsessionmanager.h"
 
 #include <QApplication>
 #include <QStyleFactory>
@@ -38,6 +50,14 @@
 #include <QDesktopWidget>
 #include <QFontDatabase>
 #include <QPixmapCache>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QTextDocument>
+#include <QTextCursor>
+#include <LispHighlighter>
+#include <QSyntaxStyle>
+#include <QOpenGLContext>
+#include <ctime>
 
 #include "tcphub.h"
 
@@ -105,11 +125,25 @@ static void showHelp()
     qDebug() << "--uploadFirmware [path] : Upload firmware-file from path.";
     qDebug() << "--uploadBootloaderBuiltin : Upload bootloader from generic included bootloaders.";
     qDebug() << "--writeFileToSdCard [fileLocal:pathSdcard] : Write file to SD-card.";
+    qDebug() << "--mirrorSdCard [pathSdcard:dirLocal] : Download all files under pathSdcard to dirLocal. Files that already are there with the same size are skipped.";
     qDebug() << "--packFirmware [fileIn:fileOut] : Pack firmware-file for compatibility with the bootloader. ";
     qDebug() << "--packLisp [fileIn:fileOut] : Pack lisp-file and the included imports.";
     qDebug() << "--bridgeAppData : Send app data (such as data from send-data in lisp) to stdout.";
     qDebug() << "--offscreen : Use offscreen QPA so that X is not required for the CLI-mode.";
     qDebug() << "--downloadPackageArchive : Download package archive to application data directory.";
+    qDebug() << "--benchmarkConfigLoad : Measure how long it takes to load the bundled configurations from XML and from the binary cache.";
+    qDebug() << "--benchmarkLzo : Compare LZO compression of the bundled firmwares chunk by chunk with a new dictionary per chunk against the parallel chunk compressor used for uploads.";
+    qDebug() << "--benchmarkLispHighlight : Measure how long it takes to highlight the bundled lisp examples, fully and after a single-line edit.";
+    qDebug() << "--benchmark3d : Measure the CPU time per frame of the 3D board in the QML UI. Uses the software scene graph when OpenGL is missing, add --offscreen to run without X.";
+    qDebug() << "--espFlash [port:file:address] : Flash file to an ESP32 in download mode at address (e.g. 0x10000) and print how long it took.";
+    qDebug() << "--espLoaderStub : Emulate the ESP32 serial loader on a pseudo terminal (Linux only). Useful for testing --espFlash without hardware.";
+    qDebug() << "--fwDeltaSim [base:target] : Generate a firmware patch from base to target, apply it like the bootloader would and print the bytes saved on the link.";
+    qDebug() << "--detectFocSim [nodes] : Run FOC detection on simulated VESCs on the CAN-bus, one after the other and concurrently, and print the timelines.";
+    qDebug() << "--benchmarkFleet [port1:port2:...] : Connect to a VESC on each serial port and compare reading the configurations one link at a time against all links at once.";
+    qDebug() << "--streamTelemetry [rates] : Connect and stream telemetry to stdout until stopped. Rates in Hz per source, e.g. mc=20,setup=5,imu=50,bms=1,gnss=5";
+    qDebug() << "--streamFormat [ndjson:binary] : Record format for --streamTelemetry, the default is ndjson.";
+    qDebug() << "--streamSocket [path] : Serve the --streamTelemetry records on a local socket at path instead of stdout.";
+    qDebug() << "--metricsPort [port] : Connect and serve motor, statistics, BMS and link metrics on http://127.0.0.1:port/metrics until stopped.";
 }
 
 #ifdef Q_OS_LINUX
@@ -242,9 +276,11 @@ int main(int argc, char *argv[])
     qmlRegisterType<Vesc3dItem>("Vedder.vesc.vesc3ditem", 1, 0, "Vesc3dItem");
     qmlRegisterType<LogWriter>("Vedder.vesc.logwriter", 1, 0, "LogWriter");
     qmlRegisterType<LogReader>("Vedder.vesc.logreader", 1, 0, "LogReader");
+    qmlRegisterType<LogCursor>("Vedder.vesc.logcursor", 1, 0, "LogCursor");
     qmlRegisterType<TcpHub>("Vedder.vesc.tcphub", 1, 0, "TcpHub");
     qmlRegisterType<CodeLoader>("Vedder.vesc.codeloader", 1, 0, "CodeLoader");
     qmlRegisterType<QMiniMp3>("Vedder.vesc.qminimp3", 1, 0, "QMiniMp3");
+    qmlRegisterType<GpdStreamer>("Vedder.vesc.gpdstreamer", 1, 0, "GpdStreamer");
 #ifdef Q_OS_LINUX
     qmlRegisterType<SystemCommandExecutor>("Vedder.vesc.syscmd", 1, 0, "SysCmd");
 #endif
@@ -314,11 +350,31 @@ int main(int argc, char *argv[])
     QString fwPackOut = "";
     QString fileForSdIn = "";
     QString fileForSdOut = "";
+    QString mirrorSdIn = "";
+    QString mirrorSdOut = "";
     QString lispPackIn = "";
     QString lispPackOut = "";
     bool bridgeAppData = false;
     bool offscreen = false;
     bool downloadPackageArchive = false;
+    bool benchmarkConfigLoad = false;
+    bool benchmarkLispHighlight = false;
+    bool benchmarkLzo = false;
+    bool benchmark3d = false;
+    QString espFlashPort = "";
+    QString espFlashFile = "";
+    quint64 espFlashAddr = 0;
+    bool espLoaderStub = false;
+    QString fwDeltaBase = "";
+    int detectFocSimNodes = -1;
+    QStringList benchmarkFleetPorts;
+    QString fwDeltaTarget = "";
+    QString streamTelemetryRates = "";
+    bool streamBinary = false;
+    QString streamSocket = "";
+    TelemetryStreamer *telemetryStreamer = nullptr;
+    int metricsPort = -1;
+    MetricsServer *metricsServer = nullptr;
 
     // Arguments can be hard-coded in a build like this:
 //    qmlWindowSize = QSize(400, 800);
@@ -634,6 +690,26 @@ int main(int argc, char *argv[])
             }
         }
 
+        if (str == "--mirrorSdCard") {
+            if ((i + 1) < args.size()) {
+                i++;
+                auto p = args.at(i).split(":");
+                if (p.size() == 2) {
+                    mirrorSdIn = p.at(0);
+                    mirrorSdOut = p.at(1);
+                } else {
+                    qCritical() << "Invalid paths specified";
+                    return 1;
+                }
+
+                found = true;
+            } else {
+                i++;
+                qCritical() << "No paths specified";
+                return 1;
+            }
+        }
+
         if (str == "--packFirmware") {
             if ((i + 1) < args.size()) {
                 i++;
@@ -689,6 +765,164 @@ int main(int argc, char *argv[])
             found = true;
         }
 
+        if (str == "--benchmarkConfigLoad") {
+            benchmarkConfigLoad = true;
+            found = true;
+        }
+
+        if (str == "--benchmarkLzo") {
+            benchmarkLzo = true;
+            found = true;
+        }
+
+        if (str == "--benchmark3d") {
+            benchmark3d = true;
+            found = true;
+        }
+
+        if (str == "--benchmarkLispHighlight") {
+            benchmarkLispHighlight = true;
+            found = true;
+        }
+
+        if (str == "--espFlash") {
+            if ((i + 1) < args.size()) {
+                i++;
+                auto p = args.at(i).split(":");
+                bool ok = false;
+                if (p.size() == 3) {
+                    espFlashPort = p.at(0);
+                    espFlashFile = p.at(1);
+                    espFlashAddr = p.at(2).toULongLong(&ok, 0);
+                }
+
+                if (!ok) {
+                    qCritical() << "Invalid arguments specified";
+                    return 1;
+                }
+
+                found = true;
+            } else {
+                i++;
+                qCritical() << "No arguments specified";
+                return 1;
+            }
+        }
+
+        if (str == "--espLoaderStub") {
+            espLoaderStub = true;
+            found = true;
+        }
+
+        if (str == "--fwDeltaSim") {
+            if ((i + 1) < args.size()) {
+                i++;
+                auto p = args.at(i).split(":");
+                if (p.size() == 2) {
+                    fwDeltaBase = p.at(0);
+                    fwDeltaTarget = p.at(1);
+                } else {
+                    qCritical() << "Invalid paths specified";
+                    return 1;
+                }
+
+                found = true;
+            } else {
+                i++;
+                qCritical() << "No paths specified";
+                return 1;
+            }
+        }
+
+        if (str == "--benchmarkFleet") {
+            if ((i + 1) < args.size()) {
+                i++;
+                benchmarkFleetPorts = args.at(i).split(":");
+                benchmarkFleetPorts.removeAll("");
+                found = true;
+            } else {
+                i++;
+                qCritical() << "No ports specified";
+                return 1;
+            }
+        }
+
+        if (str == "--detectFocSim") {
+            if ((i + 1) < args.size()) {
+                i++;
+                bool ok = false;
+                detectFocSimNodes = args.at(i).toInt(&ok);
+                if (!ok || detectFocSimNodes < 1 || detectFocSimNodes > 254) {
+                    qCritical() << "Invalid number of nodes specified";
+                    return 1;
+                }
+                found = true;
+            } else {
+                i++;
+                qCritical() << "No number of nodes specified";
+                return 1;
+            }
+        }
+
+        if (str == "--streamTelemetry") {
+            if ((i + 1) < args.size()) {
+                i++;
+                streamTelemetryRates = args.at(i);
+                found = true;
+            } else {
+                i++;
+                qCritical() << "No rates specified";
+                return 1;
+            }
+        }
+
+        if (str == "--streamFormat") {
+            if ((i + 1) < args.size()) {
+                i++;
+                QString format = args.at(i).toLower();
+                if (format == "binary") {
+                    streamBinary = true;
+                } else if (format != "ndjson") {
+                    qCritical() << "Invalid format specified";
+                    return 1;
+                }
+                found = true;
+            } else {
+                i++;
+                qCritical() << "No format specified";
+                return 1;
+            }
+        }
+
+        if (str == "--metricsPort") {
+            if ((i + 1) < args.size()) {
+                i++;
+                bool ok = false;
+                metricsPort = args.at(i).toInt(&ok);
+                if (!ok || metricsPort <= 0 || metricsPort > 65535) {
+                    qCritical() << "Invalid port specified";
+                    return 1;
+                }
+                found = true;
+            } else {
+                i++;
+                qCritical() << "No port specified";
+                return 1;
+            }
+        }
+
+        if (str == "--streamSocket") {
+            if ((i + 1) < args.size()) {
+                i++;
+                streamSocket = args.at(i);
+                found = true;
+            } else {
+                i++;
+                qCritical() << "No path specified";
+                return 1;
+            }
+        }
+
         if (!found) {
             if (dash) {
                 qCritical() << "At least one of the flags is invalid:" << str;
@@ -709,6 +943,366 @@ int main(int argc, char *argv[])
         qDebug() << "Package archive downloaded!";
     }
 
+    if (benchmarkConfigLoad) {
+        QCoreApplication appTmp(argc, argv);
+
+        QStringList files;
+        QDirIterator it("://res/config", QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            QString path = it.next();
+            if (path.endsWith(".xml")) {
+                files.append(path);
+            }
+        }
+
+        QElapsedTimer t;
+        ConfigParams conf;
+
+        t.start();
+        for (const auto &f: files) {
+            QFile file(f);
+            if (file.open(QIODevice::ReadOnly)) {
+                QXmlStreamReader stream(&file);
+                conf.setParamsXML(stream);
+            }
+        }
+        qint64 timeXml = t.elapsed();
+
+        // First pass creates the cache entries that are missing
+        t.restart();
+        for (const auto &f: files) {
+            conf.loadParamsXml(f);
+        }
+        qint64 timeFirst = t.elapsed();
+
+        t.restart();
+        for (const auto &f: files) {
+            conf.loadParamsXml(f);
+        }
+        qint64 timeCached = t.elapsed();
+
+        qDebug() << "Configuration files:" << files.size();
+        qDebug() << "XML parse:" << timeXml << "ms";
+        qDebug() << "First cached load:" << timeFirst << "ms";
+        qDebug() << "Cached load:" << timeCached << "ms";
+        qDebug() << "Cache directory:" << ConfigParams::paramsCacheDir();
+        return 0;
+    }
+
+    if (benchmarkLzo) {
+        QCoreApplication appTmp(argc, argv);
+
+        const int chunkSize = 384;
+        auto uploadBytes = [chunkSize](const QByteArray &data, const QVector<QByteArray> &comp) {
+            qint64 res = 0;
+            for (int i = 0;i < comp.size();i++) {
+                int sz = qMin(chunkSize, data.size() - i * chunkSize);
+                res += (!comp.at(i).isEmpty() && (comp.at(i).size() + 2) < sz) ? comp.at(i).size() + 2 : sz;
+            }
+            return res;
+        };
+
+        QDirIterator it("://res/firmwares", QDirIterator::Subdirectories);
+        qint64 sizeTot = 0;
+        qint64 serialBytes = 0;
+        qint64 parallelBytes = 0;
+        qint64 serialNs = 0;
+        qint64 parallelNs = 0;
+        int files = 0;
+
+        while (it.hasNext()) {
+            QString path = it.next();
+            if (!path.endsWith(".bin")) {
+                continue;
+            }
+
+            QFile file(path);
+            if (!file.open(QIODevice::ReadOnly)) {
+                continue;
+            }
+
+            QByteArray data = file.readAll();
+            file.close();
+            files++;
+            sizeTot += data.size();
+
+            QElapsedTimer t;
+            t.start();
+            QVector<QByteArray> comp;
+            unsigned char out[lzokay::compress_worst_size(chunkSize)];
+            for (int ofs = 0;ofs < data.size();ofs += chunkSize) {
+                int sz = qMin(chunkSize, data.size() - ofs);
+                std::size_t outLen = 0;
+                lzokay::compress((const uint8_t*)data.constData() + ofs, std::size_t(sz),
+                                 out, sizeof(out), outLen);
+                comp.append(QByteArray((const char*)out, int(outLen)));
+            }
+            serialNs += t.nsecsElapsed();
+            serialBytes += uploadBytes(data, comp);
+
+            t.restart();
+            comp = Utility::lzoCompressChunks(data, chunkSize);
+            parallelNs += t.nsecsElapsed();
+            parallelBytes += uploadBytes(data, comp);
+        }
+
+        qDebug() << "Firmware files:" << files << "Total size:" << sizeTot;
+        qDebug() << "New dictionary per chunk:" << serialBytes << "bytes," << double(serialNs) / 1e6 << "ms";
+        qDebug() << "Parallel, reused dictionary:" << parallelBytes << "bytes," << double(parallelNs) / 1e6 << "ms";
+        return 0;
+    }
+
+    if (benchmarkLispHighlight) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+        QGuiApplication appTmp(argc, argv);
+
+        QString code;
+        int files = 0;
+        QDirIterator it("://res/Lisp", QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            QString path = it.next();
+            if (path.endsWith(".lisp")) {
+                QFile file(path);
+                if (file.open(QIODevice::ReadOnly)) {
+                    code += QString::fromUtf8(file.readAll()) + "\n";
+                    files++;
+                }
+            }
+        }
+
+        QTextDocument doc;
+        doc.setPlainText(code);
+
+        LispHighlighter highlighter;
+        highlighter.setSyntaxStyle(QSyntaxStyle::defaultStyle());
+
+        QElapsedTimer t;
+        t.start();
+        highlighter.setDocument(&doc);
+        qint64 timeFull = t.nsecsElapsed();
+
+        // Edit one line in the middle, only that block should be highlighted again
+        QTextCursor c(doc.findBlockByNumber(doc.blockCount() / 2));
+        t.restart();
+        for (int i = 0;i < 100;i++) {
+            c.insertText("(define a-var 1.5)");
+        }
+        qint64 timeEdit = t.nsecsElapsed() / 100;
+
+        qDebug() << "Lisp files:" << files << "Lines:" << doc.blockCount();
+        qDebug() << "Full highlight:" << double(timeFull) / 1e6 << "ms";
+        qDebug() << "Single-line edit:" << double(timeEdit) / 1e3 << "us";
+        return 0;
+    }
+
+    if (benchmark3d) {
+        if (offscreen) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+        QApplication appTmp(argc, argv);
+
+        QOpenGLContext glCtx;
+        bool hasGl = glCtx.create();
+        if (!hasGl) {
+            QQuickWindow::setSceneGraphBackend(QSGRendererInterface::Software);
+        }
+
+        const int frames = 300;
+        const int size = 512;
+
+        QQuickWindow win;
+        win.resize(size, size);
+        Vesc3dItem *item = new Vesc3dItem(win.contentItem());
+        item->setSize(QSizeF(size, size));
+        win.show();
+        Utility::waitSignal(&win, SIGNAL(frameSwapped()), 2000);
+
+        QElapsedTimer t;
+        t.start();
+        std::clock_t cpuStart = std::clock();
+        int rendered = 0;
+        for (int i = 0;i < frames;i++) {
+            item->setRotation(0.1 + 0.01 * i, 0.75, 0.4 + 0.02 * i);
+            if (Utility::waitSignal(&win, SIGNAL(frameSwapped()), 1000)) {
+                rendered++;
+            }
+        }
+        double cpuItem = 1e3 * double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+        qint64 timeItem = t.elapsed();
+
+        qDebug() << "Scene graph backend:" << (hasGl ? "OpenGL" : "software");
+        qDebug() << "Scene graph item:" << rendered << "frames in" << timeItem << "ms,"
+                 << cpuItem / double(qMax(rendered, 1)) << "ms CPU per frame";
+
+        // The widget that used to be rendered and read back for every update
+        if (hasGl) {
+            Vesc3DView view;
+            view.resize(size, size);
+            view.grabFramebuffer();
+
+            t.restart();
+            cpuStart = std::clock();
+            for (int i = 0;i < frames;i++) {
+                view.setRollPitchYaw(0.1 + 0.01 * i, 0.75, 0.4 + 0.02 * i);
+                view.grabFramebuffer();
+            }
+            double cpuView = 1e3 * double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+            qDebug() << "Framebuffer readback:" << frames << "frames in" << t.elapsed() << "ms,"
+                     << cpuView / double(frames) << "ms CPU per frame";
+        }
+
+        return 0;
+    }
+
+    if (espLoaderStub) {
+        QCoreApplication appTmp(argc, argv);
+        Esp32LoaderStub stub;
+        if (!stub.start()) {
+            return 1;
+        }
+
+        qDebug() << "ESP32 loader stub running on" << stub.portPath();
+        return appTmp.exec();
+    }
+
+    if (!benchmarkFleetPorts.isEmpty()) {
+        QCoreApplication appTmp(argc, argv);
+
+        VescSessionManager mgr;
+        for (const auto &p: benchmarkFleetPorts) {
+            mgr.addSerialSession(p);
+        }
+
+        auto failed = mgr.connectAll();
+        for (auto id: failed) {
+            qWarning() << "Could not connect to" << mgr.sessionName(id);
+        }
+        if (!failed.isEmpty()) {
+            return 1;
+        }
+
+        QElapsedTimer t;
+        int num = mgr.sessionNum();
+
+        for (int parallel = 0;parallel < 2;parallel++) {
+            mgr.setMaxParallel(parallel ? num : 1);
+
+            t.start();
+            failed = mgr.readMcConfAll();
+            failed += mgr.readAppConfAll();
+            qint64 ms = t.elapsed();
+
+            qDebug().noquote() << QString("%1: read %2 configurations in %3 ms (%4 failed)").
+                                  arg(parallel ? "All links at once" : "One link at a time").
+                                  arg(num * 2).arg(ms).arg(failed.size());
+        }
+
+        const int durationMs = 2000;
+        auto samples = mgr.captureTelemetryAll(durationMs, 50);
+        int total = 0;
+        for (auto id: mgr.sessionIds()) {
+            int n = samples.value(id).size();
+            total += n;
+            qDebug().noquote() << QString("%1: %2 samples/s").arg(mgr.sessionName(id)).
+                                  arg(double(n) * 1000.0 / double(durationMs), 0, 'f', 1);
+        }
+        qDebug().noquote() << QString("Total: %1 samples/s").
+                              arg(double(total) * 1000.0 / double(durationMs), 0, 'f', 1);
+
+        mgr.disconnectAll();
+        return 0;
+    }
+
+    if (detectFocSimNodes > 0) {
+        QCoreApplication appTmp(argc, argv);
+
+        QVector<int> canIds;
+        canIds.append(-1);
+        for (int i = 1;i < detectFocSimNodes;i++) {
+            canIds.append(i);
+        }
+
+        FocDetectParams params;
+        params.maxPowerLoss = 50.0;
+        params.minCurrentIn = -10.0;
+        params.maxCurrentIn = 10.0;
+        params.openloopRpm = 700.0;
+        params.slErpm = 4000.0;
+
+        // Detection on a real motor takes several seconds, the times here are
+        // scaled down by 10 to keep the simulation short.
+        for (int perNode = 0;perNode < 2;perNode++) {
+            FocDetectSimBackend backend(perNode);
+            backend.setDetectTimeMs(200, 600);
+            backend.setReadTimeMs(40);
+            FocDetectRunner runner(&backend);
+            bool ok = runner.run(canIds, params);
+
+            qDebug().noquote() << (perNode ? "\nConcurrent nodes (sequence envelope):" :
+                                             "One reply at a time (no sequence envelope):");
+            qDebug().noquote() << runner.timelineText();
+            if (!ok) {
+                qWarning() << "Detection failed";
+                return 1;
+            }
+        }
+
+        return 0;
+    }
+
+    if (!fwDeltaBase.isEmpty()) {
+        QCoreApplication appTmp(argc, argv);
+
+        QFile fileBase(fwDeltaBase);
+        QFile fileTarget(fwDeltaTarget);
+        if (!fileBase.open(QIODevice::ReadOnly) || !fileTarget.open(QIODevice::ReadOnly)) {
+            qCritical() << "Could not open firmware files";
+            return 1;
+        }
+
+        auto res = FwDelta::simulate(fileBase.readAll(), fileTarget.readAll());
+
+        qDebug() << "Patch applied correctly:" << res.ok;
+        qDebug() << "Patch size:" << res.patchSize << "bytes";
+        qDebug() << "Wire bytes full upload:" << res.fullWireBytes;
+        qDebug() << "Wire bytes delta upload:" << res.deltaWireBytes
+                 << "(" << 100.0 * double(res.deltaWireBytes) / double(qMax(1, res.fullWireBytes)) << "% )";
+        qDebug() << "Generate:" << res.generateMs << "ms Apply:" << res.applyMs << "ms";
+        return res.ok ? 0 : 1;
+    }
+
+    if (!espFlashFile.isEmpty()) {
+        QCoreApplication appTmp(argc, argv);
+
+        QFile file(espFlashFile);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qCritical() << "Could not open" << espFlashFile;
+            return 1;
+        }
+
+        QByteArray data = file.readAll();
+        file.close();
+
+        Esp32Flash flasher;
+        QObject::connect(&flasher, &Esp32Flash::stateUpdate, [](QString msg) {
+            qDebug() << msg;
+        });
+
+        QElapsedTimer t;
+        t.start();
+
+        if (!flasher.connectEsp(espFlashPort)) {
+            return 1;
+        }
+
+        bool ok = flasher.flashFirmware(data, espFlashAddr);
+        flasher.disconnectEsp();
+
+        qDebug() << "Flashed" << data.size() << "bytes in" << t.elapsed() << "ms";
+        return ok ? 0 : 1;
+    }
+
     if (!xmlCodePath.isEmpty()) {
         ConfigParams conf;
         if (!conf.loadParamsXml(xmlCodePath)) {
@@ -1004,7 +1598,8 @@ int main(int argc, char *argv[])
 
     if (isMcConf || isAppConf || isCustomConf || !lispPath.isEmpty() ||
             eraseLisp || !firmwarePath.isEmpty() || uploadBootloaderBuiltin ||
-            !fileForSdIn.isEmpty() || bridgeAppData) {
+            !fileForSdIn.isEmpty() || !mirrorSdIn.isEmpty() || bridgeAppData || !streamTelemetryRates.isEmpty() ||
+            metricsPort > 0) {
         if (offscreen) {
             qputenv("QT_QPA_PLATFORM", "offscreen");
         }
@@ -1160,6 +1755,24 @@ int main(int argc, char *argv[])
                     }
                 }
 
+                if (!mirrorSdIn.isEmpty()) {
+                    SdMirror mirror(vesc->commands());
+                    QObject::connect(&mirror, &SdMirror::progress, [](qint64 done, qint64 total, double, double bytesPerSec) {
+                        fprintf(stderr, "\rDownloaded %lld of %lld bytes (%.1f kB/s)    ",
+                                (long long)done, (long long)total, bytesPerSec / 1024.0);
+                    });
+
+                    bool res = mirror.mirror(mirrorSdIn, mirrorSdOut);
+                    fprintf(stderr, "\r\n");
+                    qDebug() << "Downloaded" << mirror.filesDownloaded() << "files, skipped"
+                             << mirror.filesSkipped() << "and failed" << mirror.filesFailed();
+
+                    if (!res) {
+                        qWarning() << "Could not mirror SD-card";
+                        exitCode = -52;
+                    }
+                }
+
                 if (isMcConf || isAppConf || isCustomConf) {
                     bool res = vesc->customConfigRxDone();
                     if (!res) {
@@ -1358,12 +1971,31 @@ int main(int argc, char *argv[])
                         exitCode = -21;
                     }
                 }
+
+                if (!streamTelemetryRates.isEmpty()) {
+                    telemetryStreamer = new TelemetryStreamer(vesc, vesc);
+                    telemetryStreamer->setBinary(streamBinary);
+                    if (!telemetryStreamer->setRates(streamTelemetryRates) ||
+                            !telemetryStreamer->start(streamSocket)) {
+                        qWarning() << "Could not start telemetry streaming";
+                        exitCode = -60;
+                    }
+                }
+
+                if (metricsPort > 0) {
+                    metricsServer = new MetricsServer(vesc, vesc);
+                    metricsServer->setPollInterval(1000);
+                    if (!metricsServer->start(metricsPort)) {
+                        exitCode = -61;
+                    }
+                }
             } else {
                 qWarning() << "Could not connect";
                 exitCode = -1;
             }
 
-            if (!bridgeAppData) {
+            bool isService = !streamTelemetryRates.isEmpty() || metricsPort > 0;
+            if (!bridgeAppData && (!isService || exitCode != 0)) {
                 qApp->exit(exitCode);
             }
         });
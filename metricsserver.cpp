@@ -0,0 +1,330 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "metricsserver.h"
+#include "packet.h"
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QDateTime>
+#include <QMetaProperty>
+#include <QDebug>
+#include <cstring>
+
+namespace {
+template<typename T>
+void fillGroup(MetricsSnapshot::Group &group, const T &val, bool valid)
+{
+    const QMetaObject &mo = T::staticMetaObject;
+    group.valid = valid;
+    group.num = 0;
+
+    for (int i = mo.propertyOffset();i < mo.propertyCount();i++) {
+        if (group.num >= MetricsSnapshot::MAX_VALUES) {
+            break;
+        }
+
+        QVariant v = mo.property(i).readOnGadget(&val);
+        if (v.type() == QVariant::String) {
+            continue;
+        }
+
+        bool ok = false;
+        double d = v.toDouble(&ok);
+        if (ok) {
+            group.prop[group.num] = i;
+            group.value[group.num] = d;
+            group.num++;
+        }
+    }
+}
+
+void renderGroup(QByteArray &out, const char *prefix, const QMetaObject &mo,
+                 const MetricsSnapshot::Group &group)
+{
+    if (!group.valid) {
+        return;
+    }
+
+    for (int i = 0;i < group.num;i++) {
+        out += prefix;
+        out += mo.property(group.prop[i]).name();
+        out += ' ';
+        out += QByteArray::number(group.value[i], 'g', 10);
+        out += '\n';
+    }
+}
+
+void renderValue(QByteArray &out, const char *name, const char *type, double value)
+{
+    out += "# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+    out += name;
+    out += ' ';
+    out += QByteArray::number(value, 'g', 15);
+    out += '\n';
+}
+}
+
+MetricsServer::MetricsServer(VescInterface *vesc, QObject *parent) : QObject(parent)
+{
+    mVesc = vesc;
+    mTimer = new QTimer(this);
+    mTimer->setInterval(1000);
+    mServer = nullptr;
+    mSeq = 0;
+
+    memset(mSlots, 0, sizeof(mSlots));
+
+    mMcValid = false;
+    mStatValid = false;
+    mBmsValid = false;
+
+    mWasConnected = false;
+    mReconnects = 0;
+    mPacketsLast = 0;
+    mPacketsPerSec = 0.0;
+
+    connect(mTimer, SIGNAL(timeout()), this, SLOT(timerSlot()));
+
+    connect(mVesc->commands(), &Commands::valuesReceived, this, [this](MC_VALUES val, unsigned int mask) {
+        (void)mask;
+        mMc = val;
+        mMcValid = true;
+    });
+
+    connect(mVesc->commands(), &Commands::statsRx, this, [this](STAT_VALUES val, unsigned int mask) {
+        (void)mask;
+        mStat = val;
+        mStatValid = true;
+    });
+
+    connect(mVesc->commands(), &Commands::bmsValuesRx, this, [this](BMS_VALUES val) {
+        mBms = val;
+        mBmsValid = true;
+    });
+
+    connect(mVesc, &VescInterface::portConnectedChanged, this, [this]() {
+        if (mVesc->isPortConnected()) {
+            if (mWasConnected) {
+                mReconnects++;
+            }
+            mWasConnected = true;
+        }
+    });
+}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+/**
+ * @brief MetricsServer::start
+ * Start serving metrics and polling the values.
+ *
+ * @param port
+ * TCP port on the loopback interface.
+ *
+ * @return
+ * true if the port could be opened.
+ */
+bool MetricsServer::start(int port)
+{
+    stop();
+
+    mServer = new QTcpServer;
+    if (!mServer->listen(QHostAddress::LocalHost, quint16(port))) {
+        qWarning() << "Could not start metrics server:" << mServer->errorString();
+        delete mServer;
+        mServer = nullptr;
+        return false;
+    }
+
+    mServer->moveToThread(&mThread);
+    connect(&mThread, &QThread::finished, mServer, &QObject::deleteLater);
+
+    // Runs in mThread, as that is where the server lives
+    connect(mServer, &QTcpServer::newConnection, mServer, [this]() {
+        while (auto socket = mServer->nextPendingConnection()) {
+            connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            connect(socket, &QTcpSocket::readyRead, socket, [this, socket]() {
+                if (!socket->canReadLine()) {
+                    return;
+                }
+
+                QByteArray request = socket->readLine();
+                socket->readAll();
+
+                QByteArray body;
+                QByteArray status = "200 OK";
+                if (request.startsWith("GET /metrics") || request.startsWith("GET / ")) {
+                    MetricsSnapshot snapshot;
+                    readSnapshot(snapshot);
+                    body = render(snapshot);
+                } else {
+                    status = "404 Not Found";
+                }
+
+                QByteArray response = "HTTP/1.1 " + status + "\r\n";
+                response += "Content-Type: text/plain; version=0.0.4\r\n";
+                response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+                response += "Connection: close\r\n\r\n";
+                response += body;
+
+                socket->write(response);
+                socket->disconnectFromHost();
+            });
+        }
+    });
+
+    mThread.start();
+
+    mPacketsLast = mVesc->packet()->packetsReceived();
+    mRateTimer.start();
+    mWasConnected = mVesc->isPortConnected();
+    mTimer->start();
+    publish();
+
+    return true;
+}
+
+void MetricsServer::stop()
+{
+    mTimer->stop();
+
+    if (mServer) {
+        mThread.quit();
+        mThread.wait();
+        mServer = nullptr;
+    }
+}
+
+/**
+ * @brief MetricsServer::setPollInterval
+ * Poll the motor, statistics and BMS values at this interval. With 0 only
+ * replies to requests from elsewhere are used, and the snapshot is
+ * updated once per second.
+ */
+void MetricsServer::setPollInterval(int ms)
+{
+    mTimer->setProperty("poll", ms > 0);
+    mTimer->setInterval(ms > 0 ? ms : 1000);
+}
+
+/**
+ * @brief MetricsServer::readSnapshot
+ * Copy the latest snapshot. Can be called from any thread. The writer only
+ * reuses a slot two publications after it was made current, so the copy
+ * is retried if that happened while it was being made.
+ */
+void MetricsServer::readSnapshot(MetricsSnapshot &snapshot) const
+{
+    for (;;) {
+        int seq1 = mSeq.load(std::memory_order_acquire);
+        snapshot = mSlots[seq1 % 3];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        int seq2 = mSeq.load(std::memory_order_relaxed);
+
+        if ((seq2 - seq1) < 2) {
+            return;
+        }
+    }
+}
+
+QByteArray MetricsServer::render(const MetricsSnapshot &snapshot)
+{
+    QByteArray out;
+
+    renderValue(out, "vesc_link_connected", "gauge", snapshot.connected ? 1 : 0);
+    renderValue(out, "vesc_link_packets_per_second", "gauge", snapshot.packetsPerSec);
+    renderValue(out, "vesc_link_packets_received_total", "counter", double(snapshot.packetsReceived));
+    renderValue(out, "vesc_link_crc_errors_total", "counter", double(snapshot.crcErrors));
+    renderValue(out, "vesc_link_timeouts_total", "counter", double(snapshot.timeouts));
+    renderValue(out, "vesc_link_reconnects_total", "counter", double(snapshot.reconnects));
+    renderValue(out, "vesc_snapshot_timestamp_seconds", "gauge", double(snapshot.timestampMs) / 1000.0);
+
+    renderGroup(out, "vesc_mc_", MC_VALUES::staticMetaObject, snapshot.mc);
+    renderGroup(out, "vesc_stat_", STAT_VALUES::staticMetaObject, snapshot.stat);
+    renderGroup(out, "vesc_bms_", BMS_VALUES::staticMetaObject, snapshot.bms);
+
+    for (int i = 0;i < snapshot.cellNum;i++) {
+        out += "vesc_bms_v_cell{cell=\"" + QByteArray::number(i) + "\"} " +
+                QByteArray::number(snapshot.cells[i], 'g', 10) + "\n";
+    }
+
+    for (int i = 0;i < snapshot.tempNum;i++) {
+        out += "vesc_bms_temp{sensor=\"" + QByteArray::number(i) + "\"} " +
+                QByteArray::number(snapshot.temps[i], 'g', 10) + "\n";
+    }
+
+    return out;
+}
+
+void MetricsServer::timerSlot()
+{
+    if (mTimer->property("poll").toBool() && mVesc->isPortConnected()) {
+        mVesc->commands()->getValues();
+        mVesc->commands()->getStats(0xFFFFFFFF);
+        mVesc->commands()->bmsGetValues();
+    }
+
+    publish();
+}
+
+void MetricsServer::publish()
+{
+    int seq = mSeq.load(std::memory_order_relaxed);
+    MetricsSnapshot &s = mSlots[(seq + 1) % 3];
+
+    auto packet = mVesc->packet();
+    quint64 packets = packet->packetsReceived();
+    qint64 elapsed = mRateTimer.restart();
+    if (elapsed > 0) {
+        mPacketsPerSec = double(packets - mPacketsLast) * 1000.0 / double(elapsed);
+    }
+    mPacketsLast = packets;
+
+    s.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    s.connected = mVesc->isPortConnected();
+    s.packetsPerSec = mPacketsPerSec;
+    s.packetsReceived = packets;
+    s.crcErrors = packet->crcErrors();
+    s.timeouts = mVesc->commands()->timeoutCount();
+    s.reconnects = mReconnects;
+
+    fillGroup(s.mc, mMc, mMcValid);
+    fillGroup(s.stat, mStat, mStatValid);
+    fillGroup(s.bms, mBms, mBmsValid);
+
+    s.cellNum = mBmsValid ? qMin(int(MetricsSnapshot::MAX_CELLS), mBms.v_cells.size()) : 0;
+    for (int i = 0;i < s.cellNum;i++) {
+        s.cells[i] = mBms.v_cells.at(i);
+    }
+
+    s.tempNum = mBmsValid ? qMin(int(MetricsSnapshot::MAX_CELLS), mBms.temps.size()) : 0;
+    for (int i = 0;i < s.tempNum;i++) {
+        s.temps[i] = mBms.temps.at(i);
+    }
+
+    mSeq.store(seq + 1, std::memory_order_release);
+}
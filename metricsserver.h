@@ -0,0 +1,115 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QThread>
+#include <QElapsedTimer>
+#include <atomic>
+#include "vescinterface.h"
+
+class QTcpServer;
+
+/*
+ * Plain values only, so that it can be copied between threads without
+ * locks.
+ */
+struct MetricsSnapshot {
+    enum {
+        MAX_VALUES = 48,
+        MAX_CELLS = 32
+    };
+
+    struct Group {
+        bool valid;
+        int num;
+        int prop[MAX_VALUES];
+        double value[MAX_VALUES];
+    };
+
+    qint64 timestampMs;
+    bool connected;
+    double packetsPerSec;
+    quint64 packetsReceived;
+    quint64 crcErrors;
+    quint64 timeouts;
+    quint64 reconnects;
+
+    Group mc;
+    Group stat;
+    Group bms;
+    int cellNum;
+    double cells[MAX_CELLS];
+    int tempNum;
+    double temps[MAX_CELLS];
+};
+
+/*
+ * Serves the latest controller values and link statistics as text metrics
+ * on http://127.0.0.1:port/metrics. The polling side publishes snapshots
+ * into a triple buffer, and the HTTP thread reads them without locks, so a
+ * slow scrape never holds up polling.
+ */
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MetricsServer(VescInterface *vesc, QObject *parent = nullptr);
+    ~MetricsServer();
+
+    bool start(int port);
+    void stop();
+    void setPollInterval(int ms);
+    void readSnapshot(MetricsSnapshot &snapshot) const;
+
+    static QByteArray render(const MetricsSnapshot &snapshot);
+
+private slots:
+    void timerSlot();
+
+private:
+    VescInterface *mVesc;
+    QTimer *mTimer;
+    QThread mThread;
+    QTcpServer *mServer;
+
+    MetricsSnapshot mSlots[3];
+    std::atomic<int> mSeq;
+
+    MC_VALUES mMc;
+    STAT_VALUES mStat;
+    BMS_VALUES mBms;
+    bool mMcValid;
+    bool mStatValid;
+    bool mBmsValid;
+
+    bool mWasConnected;
+    quint64 mReconnects;
+    quint64 mPacketsLast;
+    double mPacketsPerSec;
+    QElapsedTimer mRateTimer;
+
+    void publish();
+
+};
+
+#endif // METRICSSERVER_H
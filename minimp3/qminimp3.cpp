@@ -54,3 +54,107 @@ MiniMp3Dec QMiniMp3::decodeFileMono(QString path)
 
     return res;
 }
+
+struct MiniMp3StreamState {
+    mp3dec_ex_t dec;
+    mp3dec_io_t io;
+};
+
+namespace {
+size_t streamRead(void *buf, size_t size, void *user_data)
+{
+    qint64 res = static_cast<QFile*>(user_data)->read((char*)buf, qint64(size));
+    return res > 0 ? size_t(res) : 0;
+}
+
+int streamSeek(uint64_t position, void *user_data)
+{
+    return static_cast<QFile*>(user_data)->seek(qint64(position)) ? 0 : -1;
+}
+}
+
+QMiniMp3Stream::QMiniMp3Stream()
+{
+    mState = nullptr;
+}
+
+QMiniMp3Stream::~QMiniMp3Stream()
+{
+    close();
+}
+
+bool QMiniMp3Stream::open(QString path)
+{
+    close();
+
+    mFile.setFileName(path);
+    if (!mFile.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open MP3 file";
+        return false;
+    }
+
+    mState = new MiniMp3StreamState;
+    mState->io.read = streamRead;
+    mState->io.read_data = &mFile;
+    mState->io.seek = streamSeek;
+    mState->io.seek_data = &mFile;
+
+    // Do not scan the file, as the frame index grows with its length
+    if (mp3dec_ex_open_cb(&mState->dec, &mState->io, MP3D_SEEK_TO_BYTE | MP3D_DO_NOT_SCAN) ||
+            mState->dec.info.channels <= 0) {
+        qWarning() << "Could not decode MP3 file";
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void QMiniMp3Stream::close()
+{
+    if (mState) {
+        mp3dec_ex_close(&mState->dec);
+        delete mState;
+        mState = nullptr;
+    }
+
+    mFile.close();
+}
+
+bool QMiniMp3Stream::isOpen() const
+{
+    return mState != nullptr;
+}
+
+int QMiniMp3Stream::fSamp() const
+{
+    return mState ? mState->dec.info.hz : -1;
+}
+
+/**
+ * @brief QMiniMp3Stream::readMono
+ * Decode the next samples of the first channel.
+ *
+ * @param buf
+ * Buffer for at least maxSamples samples.
+ *
+ * @return
+ * The number of samples written to buf, 0 at the end of the file.
+ */
+int QMiniMp3Stream::readMono(float *buf, int maxSamples)
+{
+    if (!mState || maxSamples <= 0) {
+        return 0;
+    }
+
+    int channels = mState->dec.info.channels;
+    mInterleaved.resize(maxSamples * channels);
+    int read = int(mp3dec_ex_read(&mState->dec, mInterleaved.data(), size_t(mInterleaved.size())));
+
+    int res = read / channels;
+    for (int i = 0;i < res;i++) {
+        buf[i] = mInterleaved.at(i * channels);
+    }
+
+    return res;
+}
@@ -3,6 +3,7 @@
 
 #include <QObject>
 #include <QVector>
+#include <QFile>
 
 struct MiniMp3Dec {
     Q_GADGET
@@ -32,4 +33,31 @@ signals:
 
 };
 
+struct MiniMp3StreamState;
+
+/*
+ * Decodes an MP3 file a block at a time, so that arbitrarily long files can
+ * be played with constant memory use.
+ */
+class QMiniMp3Stream
+{
+public:
+    QMiniMp3Stream();
+    ~QMiniMp3Stream();
+
+    bool open(QString path);
+    void close();
+    bool isOpen() const;
+    int fSamp() const;
+    int readMono(float *buf, int maxSamples);
+
+private:
+    Q_DISABLE_COPY(QMiniMp3Stream)
+
+    QFile mFile;
+    MiniMp3StreamState *mState;
+    QVector<float> mInterleaved;
+
+};
+
 #endif // QMINIMP3_H
@@ -19,8 +19,9 @@
 
 #include "fwhelper.h"
 #include "hexfile.h"
+#include "firmwarecatalog.h"
 
-#include <QDirIterator>
+#include <QDir>
 #include <QStandardPaths>
 #include <QResource>
 
@@ -39,18 +40,12 @@ QVariantMap FwHelper::getHardwares(FW_RX_PARAMS params, QString hw)
         fwDir = "://res/firmwares_bms";
     }
 
-    QDirIterator it(fwDir);
-    while (it.hasNext()) {
-        QFileInfo fi(it.next());
-        QStringList names = fi.fileName().split("_o_");
+    auto entries = hw.isEmpty() ? FirmwareCatalog::entries(fwDir) :
+                                  FirmwareCatalog::entriesForName(fwDir, hw);
 
-        if (fi.isDir() && (hw.isEmpty() || names.contains(hw, Qt::CaseInsensitive))) {
-            QString name = names.at(0);
-            for(int i = 1;i < names.size();i++) {
-                name += " & " + names.at(i);
-            }
-
-            hws.insert(name, fi.absoluteFilePath());
+    for (const auto &e: entries) {
+        if (e.isDir) {
+            hws.insert(e.displayName(), e.path);
         }
     }
 
@@ -80,12 +75,10 @@ QVariantMap FwHelper::getFirmwares(QString hw)
 {
     QVariantMap fws;
 
-    QDirIterator it(hw);
-    while (it.hasNext()) {
-        QFileInfo fi(it.next());
-        if (fi.fileName().toLower() == "vesc_default.bin" ||
-                fi.fileName().toLower() == "vesc_express.bin") {
-            fws.insert(fi.fileName(), fi.absoluteFilePath());
+    for (const auto &e: FirmwareCatalog::entries(hw)) {
+        if (e.name.toLower() == "vesc_default.bin" ||
+                e.name.toLower() == "vesc_express.bin") {
+            fws.insert(e.name, e.path);
         }
     }
 
@@ -127,18 +120,12 @@ QVariantMap FwHelper::getBootloaders(FW_RX_PARAMS params, QString hw)
         return bls;
     }
 
-    QDirIterator it(blDir);
-    while (it.hasNext()) {
-        QFileInfo fi(it.next());
-        QStringList names = fi.fileName().replace(".bin", "").split("_o_");
-
-        if (!fi.isDir() && (hw.isEmpty() || names.contains(hw, Qt::CaseInsensitive))) {
-            QString name = names.at(0);
-            for(int i = 1;i < names.size();i++) {
-                name += " & " + names.at(i);
-            }
+    auto entries = hw.isEmpty() ? FirmwareCatalog::entries(blDir) :
+                                  FirmwareCatalog::entriesForName(blDir, hw);
 
-            bls.insert(name, fi.absoluteFilePath());
+    for (const auto &e: entries) {
+        if (!e.isDir) {
+            bls.insert(e.displayName(), e.path);
         }
     }
 
@@ -267,12 +254,11 @@ QVariantMap FwHelper::getArchiveDirs()
         QResource::unregisterResource(path);
         QResource::registerResource(path);
 
-        QString fwDir = "://fw_archive";
+        QString fwDir = ":/fw_archive";
+        FirmwareCatalog::invalidate(fwDir);
 
-        QDirIterator it(fwDir);
-        while (it.hasNext()) {
-            QFileInfo fi(it.next());
-            fws.insert(fi.fileName(), fi.absoluteFilePath());
+        for (const auto &e: FirmwareCatalog::entries(fwDir)) {
+            fws.insert(e.name, e.path);
         }
     }
 
@@ -283,25 +269,13 @@ QVariantMap FwHelper::getArchiveFirmwares(QString fwPath, FW_RX_PARAMS params)
 {
     QVariantMap fws;
 
-    QDirIterator it(fwPath);
-    while (it.hasNext()) {
-        QFileInfo fi(it.next());
+    auto hws = params.hw.isEmpty() ? FirmwareCatalog::entries(fwPath) :
+                                     FirmwareCatalog::entriesForName(fwPath, params.hw);
 
-        QDirIterator it2(fi.absoluteFilePath());
-        while (it2.hasNext()) {
-            QFileInfo fi2(it2.next());
-
-            QStringList names = fi.fileName().split("_o_");
-
-            if (params.hw.isEmpty() || names.contains(params.hw, Qt::CaseInsensitive)) {
-                if (fi2.fileName().toLower() == "vesc_default.bin") {
-                    QString name = names.at(0);
-                    for(int i = 1;i < names.size();i++) {
-                        name += " & " + names.at(i);
-                    }
-
-                    fws.insert("HW " + name + ": " + fi2.fileName(), fi2.absoluteFilePath());
-                }
+    for (const auto &e: hws) {
+        for (const auto &e2: FirmwareCatalog::entries(e.path)) {
+            if (e2.name.toLower() == "vesc_default.bin") {
+                fws.insert("HW " + e.displayName() + ": " + e2.name, e2.path);
             }
         }
     }
@@ -0,0 +1,316 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "logcursor.h"
+#include <algorithm>
+#include <cmath>
+
+LogCursor::LogCursor(QObject *parent) : QObject(parent)
+{
+    mIndex = 0;
+    mWindowSize = 100;
+    invalidateWindows();
+}
+
+VescInterface *LogCursor::vesc() const
+{
+    return mVesc;
+}
+
+void LogCursor::setVesc(VescInterface *vesc)
+{
+    if (mVesc == vesc) {
+        return;
+    }
+
+    if (mVesc) {
+        disconnect(mVesc, &VescInterface::rtLogLoaded, this, &LogCursor::reload);
+    }
+
+    mVesc = vesc;
+
+    if (mVesc) {
+        connect(mVesc, &VescInterface::rtLogLoaded, this, &LogCursor::reload);
+    }
+
+    emit vescChanged();
+    reload();
+}
+
+int LogCursor::count() const
+{
+    return mTimeMs.size();
+}
+
+int LogCursor::durationMs() const
+{
+    return mTimeMs.isEmpty() ? 0 : mTimeMs.last();
+}
+
+int LogCursor::index() const
+{
+    return mIndex;
+}
+
+void LogCursor::setIndex(int index)
+{
+    index = qBound(0, index, qMax(0, mTimeMs.size() - 1));
+    if (index != mIndex) {
+        mIndex = index;
+        emit sampleChanged();
+    }
+}
+
+double LogCursor::progress() const
+{
+    if (mTimeMs.size() < 2) {
+        return 0.0;
+    }
+
+    return double(mIndex) / double(mTimeMs.size() - 1);
+}
+
+int LogCursor::timeMs() const
+{
+    return mTimeMs.isEmpty() ? 0 : mTimeMs.at(mIndex);
+}
+
+int LogCursor::windowSize() const
+{
+    return mWindowSize;
+}
+
+void LogCursor::setWindowSize(int samples)
+{
+    samples = qMax(1, samples);
+    if (samples != mWindowSize) {
+        mWindowSize = samples;
+        invalidateWindows();
+        emit windowSizeChanged();
+    }
+}
+
+/**
+ * @brief LogCursor::reload
+ * Take the RT log from VescInterface and split it into columns. This is done
+ * automatically when a new log is loaded. The log itself is not kept, sample()
+ * takes it again when it is needed.
+ */
+void LogCursor::reload()
+{
+    mLog.clear();
+    invalidateWindows();
+
+    // Implicitly shared, no copy is made here
+    const QVector<LOG_DATA> log = mVesc ? mVesc->getRtLogData() : QVector<LOG_DATA>();
+
+    for (int i = 0;i < FieldNum;i++) {
+        mColumns[i].resize(log.size());
+        mColumns[i].squeeze();
+    }
+    mTimeMs.resize(log.size());
+    mTimeMs.squeeze();
+    mFault.resize(log.size());
+    mFault.squeeze();
+
+    const int dayMs = 24 * 60 * 60 * 1000;
+    int startTime = log.isEmpty() ? 0 : log.first().valTime;
+    int dayOffset = 0;
+    int lastTime = 0;
+
+    for (int i = 0;i < log.size();i++) {
+        const LOG_DATA &d = log.at(i);
+
+        // The time is in ms since midnight. It is kept increasing, so that
+        // it can be searched.
+        int t = d.valTime - startTime + dayOffset;
+        if (t < (lastTime - dayMs / 2)) {
+            dayOffset += dayMs;
+            t += dayMs;
+        }
+        t = qMax(t, lastTime);
+        mTimeMs[i] = t;
+        lastTime = t;
+
+        mColumns[VIn][i] = d.values.v_in;
+        mColumns[TempMos][i] = d.values.temp_mos;
+        mColumns[TempMotor][i] = d.values.temp_motor;
+        mColumns[CurrentMotor][i] = d.values.current_motor;
+        mColumns[CurrentIn][i] = d.values.current_in;
+        mColumns[Power][i] = d.values.current_in * d.values.v_in;
+        mColumns[Rpm][i] = d.values.rpm;
+        mColumns[Duty][i] = d.values.duty_now;
+        mColumns[AmpHours][i] = d.values.amp_hours;
+        mColumns[WattHours][i] = d.values.watt_hours;
+        mColumns[Speed][i] = d.setupValues.speed;
+        mColumns[BatteryLevel][i] = d.setupValues.battery_level;
+        mColumns[Distance][i] = d.setupValues.tachometer_abs;
+        mColumns[Roll][i] = d.imuValues.roll;
+        mColumns[Pitch][i] = d.imuValues.pitch;
+        mColumns[Yaw][i] = d.imuValues.yaw;
+        mColumns[Lat][i] = d.lat;
+        mColumns[Lon][i] = d.lon;
+        mColumns[Alt][i] = d.alt;
+        mColumns[GVel][i] = d.gVel;
+        mFault[i] = int(d.values.fault_code);
+    }
+
+    mIndex = 0;
+    emit loaded();
+    emit sampleChanged();
+}
+
+/**
+ * @brief LogCursor::step
+ * Move a number of samples forwards or backwards.
+ *
+ * @return
+ * false if the cursor already was at the end (or start) of the log.
+ */
+bool LogCursor::step(int samples)
+{
+    int last = mIndex;
+    setIndex(mIndex + samples);
+    return mIndex != last;
+}
+
+bool LogCursor::next()
+{
+    return step(1);
+}
+
+bool LogCursor::prev()
+{
+    return step(-1);
+}
+
+/**
+ * @brief LogCursor::seekProgress
+ * Go to a sample by its position in the log, 0.0 is the first and 1.0 the
+ * last sample.
+ */
+void LogCursor::seekProgress(double progress)
+{
+    if (mTimeMs.isEmpty()) {
+        return;
+    }
+
+    setIndex(int(std::round(double(mTimeMs.size() - 1) * qBound(0.0, progress, 1.0))));
+}
+
+/**
+ * @brief LogCursor::seekTime
+ * Go to the first sample at or after a time.
+ *
+ * @param timeMs
+ * Milliseconds from the start of the log.
+ */
+void LogCursor::seekTime(int timeMs)
+{
+    auto it = std::lower_bound(mTimeMs.constBegin(), mTimeMs.constEnd(), timeMs);
+    setIndex(int(it - mTimeMs.constBegin()));
+}
+
+double LogCursor::value(LogCursor::Field field) const
+{
+    if (field < 0 || field >= FieldNum || mTimeMs.isEmpty()) {
+        return 0.0;
+    }
+
+    return mColumns[field].at(mIndex);
+}
+
+/**
+ * @brief LogCursor::window
+ * Get the last windowSize samples of a field up to and including the
+ * current one, e.g. for drawing a trend behind a gauge.
+ *
+ * The last window of each field is kept. Reading it again at the same sample
+ * returns it without copying, and when the cursor moved forward by less than
+ * a window only the new samples are appended and the old ones shifted out.
+ */
+QVector<double> LogCursor::window(LogCursor::Field field) const
+{
+    if (field < 0 || field >= FieldNum || mTimeMs.isEmpty()) {
+        return QVector<double>();
+    }
+
+    int start = qMax(0, mIndex - mWindowSize + 1);
+    int len = mIndex - start + 1;
+    QVector<double> &w = mWindow[field];
+    int end = mWindowEnd[field];
+
+    if (end == mIndex) {
+        return w;
+    }
+
+    const QVector<double> &col = mColumns[field];
+
+    if (end >= 0 && end < mIndex && (mIndex - end) < len) {
+        for (int i = end + 1;i <= mIndex;i++) {
+            w.append(col.at(i));
+        }
+        if (w.size() > len) {
+            w.remove(0, w.size() - len);
+        }
+    } else {
+        w.resize(len);
+        std::copy(col.constBegin() + start, col.constBegin() + mIndex + 1, w.begin());
+    }
+
+    mWindowEnd[field] = mIndex;
+    return w;
+}
+
+/**
+ * @brief LogCursor::sample
+ * @return
+ * The full current sample. Prefer the properties when only a few fields
+ * are needed.
+ */
+LOG_DATA LogCursor::sample() const
+{
+    if (mTimeMs.isEmpty()) {
+        return LOG_DATA();
+    }
+
+    if (mLog.size() != mTimeMs.size()) {
+        mLog = mVesc ? mVesc->getRtLogData() : QVector<LOG_DATA>();
+        if (mLog.size() != mTimeMs.size()) {
+            mLog.clear();
+            return LOG_DATA();
+        }
+    }
+
+    return mLog.at(mIndex);
+}
+
+int LogCursor::faultCode() const
+{
+    return mFault.isEmpty() ? 0 : mFault.at(mIndex);
+}
+
+void LogCursor::invalidateWindows()
+{
+    for (int i = 0;i < FieldNum;i++) {
+        mWindow[i].clear();
+        mWindow[i].reserve(mWindowSize + 1);
+        mWindowEnd[i] = -1;
+    }
+}
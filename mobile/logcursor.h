@@ -0,0 +1,165 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef LOGCURSOR_H
+#define LOGCURSOR_H
+
+#include <QObject>
+#include <QVector>
+#include <QPointer>
+
+#include "vescinterface.h"
+
+/*
+ * Position in the RT log loaded in VescInterface, for replaying it from QML.
+ * The fields are stored column by column when the log is loaded, so reading
+ * a property is an array lookup instead of a LOG_DATA copy, stepping is O(1)
+ * and seeking to a time is a binary search. The full log is only referenced
+ * again when sample() is used.
+ */
+class LogCursor : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(VescInterface* vesc READ vesc WRITE setVesc NOTIFY vescChanged)
+    Q_PROPERTY(int count READ count NOTIFY loaded)
+    Q_PROPERTY(int durationMs READ durationMs NOTIFY loaded)
+    Q_PROPERTY(int index READ index WRITE setIndex NOTIFY sampleChanged)
+    Q_PROPERTY(double progress READ progress WRITE seekProgress NOTIFY sampleChanged)
+    Q_PROPERTY(int timeMs READ timeMs WRITE seekTime NOTIFY sampleChanged)
+    Q_PROPERTY(int windowSize READ windowSize WRITE setWindowSize NOTIFY windowSizeChanged)
+
+    Q_PROPERTY(double vIn READ vIn NOTIFY sampleChanged)
+    Q_PROPERTY(double tempMos READ tempMos NOTIFY sampleChanged)
+    Q_PROPERTY(double tempMotor READ tempMotor NOTIFY sampleChanged)
+    Q_PROPERTY(double currentMotor READ currentMotor NOTIFY sampleChanged)
+    Q_PROPERTY(double currentIn READ currentIn NOTIFY sampleChanged)
+    Q_PROPERTY(double power READ power NOTIFY sampleChanged)
+    Q_PROPERTY(double rpm READ rpm NOTIFY sampleChanged)
+    Q_PROPERTY(double duty READ duty NOTIFY sampleChanged)
+    Q_PROPERTY(double ampHours READ ampHours NOTIFY sampleChanged)
+    Q_PROPERTY(double wattHours READ wattHours NOTIFY sampleChanged)
+    Q_PROPERTY(double speed READ speed NOTIFY sampleChanged)
+    Q_PROPERTY(double batteryLevel READ batteryLevel NOTIFY sampleChanged)
+    Q_PROPERTY(double distance READ distance NOTIFY sampleChanged)
+    Q_PROPERTY(double roll READ roll NOTIFY sampleChanged)
+    Q_PROPERTY(double pitch READ pitch NOTIFY sampleChanged)
+    Q_PROPERTY(double yaw READ yaw NOTIFY sampleChanged)
+    Q_PROPERTY(double lat READ lat NOTIFY sampleChanged)
+    Q_PROPERTY(double lon READ lon NOTIFY sampleChanged)
+    Q_PROPERTY(double alt READ alt NOTIFY sampleChanged)
+    Q_PROPERTY(double gVel READ gVel NOTIFY sampleChanged)
+    Q_PROPERTY(int faultCode READ faultCode NOTIFY sampleChanged)
+
+public:
+    enum Field {
+        VIn = 0,
+        TempMos,
+        TempMotor,
+        CurrentMotor,
+        CurrentIn,
+        Power,
+        Rpm,
+        Duty,
+        AmpHours,
+        WattHours,
+        Speed,
+        BatteryLevel,
+        Distance,
+        Roll,
+        Pitch,
+        Yaw,
+        Lat,
+        Lon,
+        Alt,
+        GVel,
+        FieldNum
+    };
+    Q_ENUM(Field)
+
+    explicit LogCursor(QObject *parent = nullptr);
+
+    VescInterface *vesc() const;
+    void setVesc(VescInterface *vesc);
+
+    int count() const;
+    int durationMs() const;
+    int index() const;
+    void setIndex(int index);
+    double progress() const;
+    int timeMs() const;
+    int windowSize() const;
+    void setWindowSize(int samples);
+
+    Q_INVOKABLE void reload();
+    Q_INVOKABLE bool step(int samples);
+    Q_INVOKABLE bool next();
+    Q_INVOKABLE bool prev();
+    Q_INVOKABLE void seekProgress(double progress);
+    Q_INVOKABLE void seekTime(int timeMs);
+    Q_INVOKABLE double value(LogCursor::Field field) const;
+    Q_INVOKABLE QVector<double> window(LogCursor::Field field) const;
+    Q_INVOKABLE LOG_DATA sample() const;
+
+    double vIn() const { return value(VIn); }
+    double tempMos() const { return value(TempMos); }
+    double tempMotor() const { return value(TempMotor); }
+    double currentMotor() const { return value(CurrentMotor); }
+    double currentIn() const { return value(CurrentIn); }
+    double power() const { return value(Power); }
+    double rpm() const { return value(Rpm); }
+    double duty() const { return value(Duty); }
+    double ampHours() const { return value(AmpHours); }
+    double wattHours() const { return value(WattHours); }
+    double speed() const { return value(Speed); }
+    double batteryLevel() const { return value(BatteryLevel); }
+    double distance() const { return value(Distance); }
+    double roll() const { return value(Roll); }
+    double pitch() const { return value(Pitch); }
+    double yaw() const { return value(Yaw); }
+    double lat() const { return value(Lat); }
+    double lon() const { return value(Lon); }
+    double alt() const { return value(Alt); }
+    double gVel() const { return value(GVel); }
+    int faultCode() const;
+
+signals:
+    void vescChanged();
+    void loaded();
+    void sampleChanged();
+    void windowSizeChanged();
+
+private:
+    QPointer<VescInterface> mVesc;
+    mutable QVector<LOG_DATA> mLog;
+    QVector<double> mColumns[FieldNum];
+    QVector<int> mTimeMs;
+    QVector<int> mFault;
+    int mIndex;
+    int mWindowSize;
+
+    // Last window per field and the sample it ends at, -1 when not valid
+    mutable QVector<double> mWindow[FieldNum];
+    mutable int mWindowEnd[FieldNum];
+
+    void invalidateWindows();
+
+};
+
+#endif // LOGCURSOR_H
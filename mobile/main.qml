@@ -394,7 +394,7 @@ ApplicationWindow {
                         visible: status == Loader.Ready
                         anchors.centerIn: parent
                         anchors.verticalCenterOffset: rtIMU.height/2
-                        width:  Math.min(parent.width*Screen.devicePixelRatio, (parent.height - rtIMU.height)*Screen.devicePixelRatio)
+                        width:  Math.min(parent.width, parent.height - rtIMU.height)
                         antialiasing: true
                         height: width
                         onLoaded: {
@@ -405,7 +405,6 @@ ApplicationWindow {
                             Vesc3dItem {
                             id: vesc3d
                             anchors.fill: parent
-                            scale: 1.0 / Screen.devicePixelRatio
                             z:1
                         }
                     }
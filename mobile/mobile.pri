@@ -3,14 +3,16 @@ HEADERS += \
     $$PWD/logwriter.h \
     $$PWD/qmlui.h \
     $$PWD/fwhelper.h \
-    $$PWD/vesc3ditem.h
+    $$PWD/vesc3ditem.h \
+    $$PWD/logcursor.h
 
 SOURCES += \
     $$PWD/logreader.cpp \
     $$PWD/logwriter.cpp \
     $$PWD/qmlui.cpp \
     $$PWD/fwhelper.cpp \
-    $$PWD/vesc3ditem.cpp
+    $$PWD/vesc3ditem.cpp \
+    $$PWD/logcursor.cpp
 
 RESOURCES += \
     $$PWD/qml.qrc
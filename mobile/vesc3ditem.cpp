@@ -20,25 +20,71 @@
 #include "vesc3ditem.h"
 #include <QtDebug>
 #include "utility.h"
-#include <QApplication>
+#include <QPainter>
+#include <QSGImageNode>
+#include <QSGRectangleNode>
+#include <cmath>
 
+namespace {
 
+// Same box as Vesc3DView, one quad per face
+const int faceCoords[6][4][3] = {
+    { { +1, -1, -1 }, { -1, -1, -1 }, { -1, +1, -1 }, { +1, +1, -1 } },
+    { { +1, +1, -1 }, { -1, +1, -1 }, { -1, +1, +1 }, { +1, +1, +1 } },
+    { { +1, -1, +1 }, { +1, -1, -1 }, { +1, +1, -1 }, { +1, +1, +1 } },
+    { { -1, -1, -1 }, { -1, -1, +1 }, { -1, +1, +1 }, { -1, +1, -1 } },
+    { { +1, -1, +1 }, { -1, -1, +1 }, { -1, -1, -1 }, { +1, -1, -1 } },
+    { { -1, -1, +1 }, { +1, -1, +1 }, { +1, +1, +1 }, { -1, +1, +1 } }
+};
 
-Vesc3dItem::Vesc3dItem(QQuickItem *parent) : QQuickPaintedItem(parent)
+class Vesc3dNode : public QSGNode
 {
-    mVesc3d.setBgColor(Utility::getAppQColor("normalBackground").redF(),
-                       Utility::getAppQColor("normalBackground").greenF(),
-                       Utility::getAppQColor("normalBackground").blueF(), 1.0);
-    setRenderTarget(QQuickPaintedItem::FramebufferObject);
-    setAntialiasing(true);
-    setOpaquePainting(true);
+public:
+    QSGRectangleNode *bg;
+    QSGTransformNode *face[6];
+    QSGImageNode *img[6];
+};
+
+QImage faceImage(int face)
+{
+    if (face == 4) {
+        return QImage(QString(":/res/images/v6plus_top.png")).mirrored();
+    }
+
+    QImage img(512, face == 1 ? 512 : 102, QImage::Format_RGB32);
+    img.fill(Qt::darkGray);
+    QPainter p(&img);
+    QPen pen;
+    pen.setWidth(6);
+    pen.setColor(QColor(1, 1, 1));
+    p.setPen(pen);
+    p.drawRect(img.rect());
+    return img;
+}
+
+}
+
+Vesc3dItem::Vesc3dItem(QQuickItem *parent) : QQuickItem(parent)
+{
+    mBgColor = Utility::getAppQColor("normalBackground");
+    mXRot = 0;
+    mYRot = 0;
+    mZRot = 0;
+    mQ0 = 1.0;
+    mQ1 = 0.0;
+    mQ2 = 0.0;
+    mQ3 = 0.0;
+    mUseQuaternions = false;
+    setFlag(ItemHasContents, true);
 }
 
 void Vesc3dItem::setRotation(double roll, double pitch, double yaw)
 {
     if(abs(roll - mRoll) > 0.005 || abs(pitch - mPitch) > 0.005 ||  abs(yaw - mYaw) > 0.005) {
-        mVesc3d.setRollPitchYaw(roll * 180.0 / M_PI, pitch * 180.0 / M_PI, yaw * 180.0 / M_PI);
-        updateImage();
+        mXRot = float(roll * 180.0 / M_PI);
+        mYRot = float(pitch * 180.0 / M_PI);
+        mZRot = float(yaw * 180.0 / M_PI);
+        mUseQuaternions = false;
         update();
         mRoll = roll; mPitch = pitch; mYaw = yaw;
     }
@@ -46,29 +92,99 @@ void Vesc3dItem::setRotation(double roll, double pitch, double yaw)
 
 void Vesc3dItem::setRotationQuat(double q0, double q1, double q2, double q3)
 {
-    mVesc3d.setQuanternions(q0, q1, q2, q3);
-    updateImage();
+    mQ0 = float(q0);
+    mQ1 = float(q1);
+    mQ2 = float(q2);
+    mQ3 = float(q3);
+    mUseQuaternions = true;
     update();
 }
 
-void Vesc3dItem::paint(QPainter *painter)
+QSGNode *Vesc3dItem::updatePaintNode(QSGNode *oldNode, QQuickItem::UpdatePaintNodeData *)
 {
-    painter->fillRect(boundingRect(), Qt::transparent);
-    if (!mLastCornerImg.isNull()) {
-        painter->drawImage(boundingRect(), mLastCornerImg, mLastCornerImg.rect());
+    auto node = static_cast<Vesc3dNode*>(oldNode);
+
+    if (!node) {
+        node = new Vesc3dNode;
+        node->bg = window()->createRectangleNode();
+        node->appendChildNode(node->bg);
+
+        for (int i = 0;i < 6;i++) {
+            node->face[i] = new QSGTransformNode;
+            node->img[i] = window()->createImageNode();
+            node->img[i]->setTexture(window()->createTextureFromImage(faceImage(i)));
+            node->img[i]->setOwnsTexture(true);
+            node->img[i]->setFiltering(QSGTexture::Linear);
+            node->face[i]->appendChildNode(node->img[i]);
+            node->appendChildNode(node->face[i]);
+        }
     }
-}
 
-void Vesc3dItem::updateImage()
-{
-    if (qApp->applicationState() == Qt::ApplicationState::ApplicationActive) {
-        double scale = 1.0;
+    double w = width();
+    double h = height();
+
+    node->bg->setRect(boundingRect());
+    node->bg->setColor(mBgColor);
+
+    // Same projection as Vesc3DView::paintGL
+    QMatrix4x4 m;
+    double aspect = w / (h > 0.0 ? h : 1.0);
+    m.perspective(30.0 / qMin(aspect, 1.0), aspect, 0.5, 5.0);
+    m.translate(0.0f, 0.0f, -1.2f);
+    m.rotate(180, 0.0f, 1.0f, 0.0f);
+    m.rotate(180, 0.0f, 0.0f, 1.0f);
+
+    if (mUseQuaternions) {
+        m.rotate(QQuaternion(mQ0, mQ1, mQ2, mQ3));
+    } else {
+        m.rotate(mZRot, 0.0f, 1.0f, 0.0f);
+        m.rotate(mYRot, 1.0f, 0.0f, 0.0f);
+        m.rotate(mXRot, 0.0f, 0.0f, 1.0f);
+    }
+    m.scale(1.0, 0.2, 1.0);
+
+    for (int i = 0;i < 6;i++) {
+        QSizeF texSize = node->img[i]->texture()->textureSize();
+        QPolygonF src, dst;
+        double area = 0.0;
+        bool visible = true;
 
-        if (mVesc3d.size() != size().toSize()) {
-            mVesc3d.resize(size().toSize() * scale);
-            mVesc3d.render(&mLastCornerImg, QPoint(), QRegion(), QWidget::RenderFlags());
+        for (int j = 0;j < 4;j++) {
+            QVector4D v = m * QVector4D(0.2f * faceCoords[i][j][0],
+                                        0.2f * faceCoords[i][j][1],
+                                        0.2f * faceCoords[i][j][2], 1.0f);
+            if (v.w() <= 0.0f) {
+                visible = false;
+                break;
+            }
+
+            QPointF ndc(v.x() / v.w(), v.y() / v.w());
+            dst.append(QPointF((ndc.x() + 1.0) / 2.0 * w, (1.0 - ndc.y()) / 2.0 * h));
+            src.append(QPointF(double(j == 0 || j == 3) * texSize.width(),
+                               double(j == 0 || j == 1) * texSize.height()));
+
+            if (j > 0) {
+                area += dst.at(j - 1).x() * dst.at(j).y() - dst.at(j).x() * dst.at(j - 1).y();
+            }
+        }
+
+        if (visible) {
+            area += dst.at(3).x() * dst.at(0).y() - dst.at(0).x() * dst.at(3).y();
         }
 
-        mLastCornerImg = mVesc3d.grabFramebuffer();
+        // The box is convex, so dropping the faces that point away from the
+        // viewer is enough and no depth buffer is needed. Front faces are
+        // counter-clockwise in GL, which is clockwise with y pointing down.
+        QTransform tr;
+        if (visible && area < 0.0 && QTransform::quadToQuad(src, dst, tr)) {
+            node->face[i]->setMatrix(QMatrix4x4(tr));
+            node->img[i]->setRect(QRectF(QPointF(0, 0), texSize));
+            node->img[i]->setSourceRect(QRectF(QPointF(0, 0), texSize));
+        } else {
+            node->face[i]->setMatrix(QMatrix4x4());
+            node->img[i]->setRect(QRectF());
+        }
     }
+
+    return node;
 }
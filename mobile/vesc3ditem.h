@@ -23,9 +23,13 @@
 #include <QObject>
 #include <QtQuick>
 
-#include "widgets/vesc3dview.h"
-
-class Vesc3dItem : public QQuickPaintedItem
+/*
+ * Draws the board directly into the Qt Quick scene graph. The six faces of
+ * the box are projected on the CPU and every visible face becomes a textured
+ * image node under a perspective transform, so nothing is read back from the
+ * GPU and the same nodes work with the OpenGL and the software backend.
+ */
+class Vesc3dItem : public QQuickItem
 {
     Q_OBJECT
 
@@ -35,7 +39,8 @@ public:
     Q_INVOKABLE void setRotation(double roll, double pitch, double yaw);
     Q_INVOKABLE void setRotationQuat(double q0, double q1, double q2, double q3);
 
-    void paint(QPainter *painter) override;
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *) override;
 
 signals:
 
@@ -43,14 +48,16 @@ private slots:
 
 
 private:
-    Vesc3DView mVesc3d;
-    QImage mLastCornerImg;
+    QColor mBgColor;
+    float mXRot;
+    float mYRot;
+    float mZRot;
+    float mQ0, mQ1, mQ2, mQ3;
+    bool mUseQuaternions;
     double mRoll = 0;
     double mPitch = 0;
     double mYaw = 0;
 
-    void updateImage();
-
 };
 
 #endif // VESC3DITEM_H
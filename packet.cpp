@@ -62,6 +62,8 @@ Packet::Packet(QObject *parent) : QObject(parent)
     mBytesLeft = 0;
     mBufferLen = mMaxPacketLen + 8;
     mRxBuffer = new unsigned char[mBufferLen];
+    mPacketsReceived = 0;
+    mCrcErrors = 0;
 }
 
 Packet::~Packet()
@@ -259,8 +261,26 @@ int Packet::try_decode_packet(unsigned char *buffer, unsigned int in_len,
     if (crc_calc == crc_rx) {
         QByteArray res((const char*)(buffer + data_start), (int)len);
         decodedPackets.append(res);
+        mPacketsReceived++;
         return len + data_start + 3;
     } else {
+        mCrcErrors++;
         return -1;
     }
 }
+
+quint64 Packet::packetsReceived() const
+{
+    return mPacketsReceived;
+}
+
+/**
+ * @brief Packet::crcErrors
+ * @return
+ * Number of correctly framed packets that were dropped because of a CRC
+ * mismatch.
+ */
+quint64 Packet::crcErrors() const
+{
+    return mCrcErrors;
+}
@@ -31,6 +31,8 @@ public:
     void sendPacket(const QByteArray &data);
     void resetState();
     static unsigned short crc16(const unsigned char *buf, unsigned int len);
+    quint64 packetsReceived() const;
+    quint64 crcErrors() const;
 
 signals:
     void dataToSend(QByteArray &data);
@@ -46,6 +48,8 @@ private:
     unsigned int mMaxPacketLen;
     unsigned int mBufferLen;
     unsigned char *mRxBuffer;
+    quint64 mPacketsReceived;
+    quint64 mCrcErrors;
 
     int try_decode_packet(unsigned char *buffer, unsigned int in_len,
                           int *bytes_left, QVector<QByteArray> &decodedPackets);
@@ -22,9 +22,9 @@
 #include "widgets/helpdialog.h"
 #include "utility.h"
 #include "hexfile.h"
+#include "firmwarecatalog.h"
 #include <QMessageBox>
 #include <QFileDialog>
-#include <QDirIterator>
 
 PageFirmware::PageFirmware(QWidget *parent) :
     QWidget(parent),
@@ -226,18 +226,14 @@ void PageFirmware::updateHwList(FW_RX_PARAMS params)
         fwDir = "://res/firmwares_bms";
     }
 
-    foreach (const auto &fi, QDir(fwDir).entryInfoList(QDir::NoFilter, QDir::Name)) {
-        QStringList names = fi.fileName().split("_o_");
-        if (fi.isDir() && (params.hw.isEmpty() || names.contains(params.hw, Qt::CaseInsensitive))) {
-            QListWidgetItem *item = new QListWidgetItem;
-
-            QString name = names.at(0);
-            for(int i = 1;i < names.size();i++) {
-                name += " & " + names.at(i);
-            }
+    auto hws = params.hw.isEmpty() ? FirmwareCatalog::entries(fwDir) :
+                                     FirmwareCatalog::entriesForName(fwDir, params.hw);
 
-            item->setText(name);
-            item->setData(Qt::UserRole, fi.absoluteFilePath());
+    for (const auto &e: hws) {
+        if (e.isDir) {
+            QListWidgetItem *item = new QListWidgetItem;
+            item->setText(e.displayName());
+            item->setData(Qt::UserRole, e.path);
             ui->hwList->insertItem(ui->hwList->count(), item);
         }
     }
@@ -283,15 +279,13 @@ void PageFirmware::updateFwList()
     if (item != nullptr) {
         QString hw = item->data(Qt::UserRole).toString();
 
-        QDirIterator it(hw);
-        while (it.hasNext()) {
-            QFileInfo fi(it.next());
+        for (const auto &e: FirmwareCatalog::entries(hw)) {
             if (ui->showNonDefaultBox->isChecked() ||
-                    fi.fileName().toLower() == "vesc_default.bin" ||
-                    fi.fileName().toLower() == "vesc_express.bin") {
+                    e.name.toLower() == "vesc_default.bin" ||
+                    e.name.toLower() == "vesc_express.bin") {
                 QListWidgetItem *item = new QListWidgetItem;
-                item->setText(fi.fileName());
-                item->setData(Qt::UserRole, fi.absoluteFilePath());
+                item->setText(e.name);
+                item->setData(Qt::UserRole, e.path);
                 ui->fwList->insertItem(ui->fwList->count(), item);
             }
         }
@@ -309,32 +303,19 @@ void PageFirmware::updateArchFwList()
     if (item != nullptr) {
         QString hw = item->data(Qt::UserRole).toString();
 
-        QDirIterator it(hw);
-        while (it.hasNext()) {
-            QFileInfo fi(it.next());
-
-            QDirIterator it2(fi.absoluteFilePath());
-            while (it2.hasNext()) {
-                QFileInfo fi2(it2.next());
-
-                QStringList names = fi.fileName().split("_o_");
-                auto params = mVesc->getLastFwRxParams();
-
-                if (!mVesc->isPortConnected() || params.hw.isEmpty() ||
-                        names.contains(params.hw, Qt::CaseInsensitive)) {
-
-                    if (ui->showNonDefaultArchBox->isChecked() ||
-                            fi2.fileName().toLower() == "vesc_default.bin") {
-                        QString name = names.at(0);
-                        for(int i = 1;i < names.size();i++) {
-                            name += " & " + names.at(i);
-                        }
-
-                        QListWidgetItem *item = new QListWidgetItem;
-                        item->setText("HW " + name + ": " + fi2.fileName());
-                        item->setData(Qt::UserRole, fi2.absoluteFilePath());
-                        ui->archFwList->insertItem(ui->archFwList->count(), item);
-                    }
+        auto params = mVesc->getLastFwRxParams();
+        auto hws = (!mVesc->isPortConnected() || params.hw.isEmpty()) ?
+                    FirmwareCatalog::entries(hw) :
+                    FirmwareCatalog::entriesForName(hw, params.hw);
+
+        for (const auto &e: hws) {
+            for (const auto &e2: FirmwareCatalog::entries(e.path)) {
+                if (ui->showNonDefaultArchBox->isChecked() ||
+                        e2.name.toLower() == "vesc_default.bin") {
+                    QListWidgetItem *item = new QListWidgetItem;
+                    item->setText("HW " + e.displayName() + ": " + e2.name);
+                    item->setData(Qt::UserRole, e2.path);
+                    ui->archFwList->insertItem(ui->archFwList->count(), item);
                 }
             }
         }
@@ -380,21 +361,14 @@ void PageFirmware::updateBlList(FW_RX_PARAMS params)
         return;
     }
 
-    QDirIterator it(blDir);
-    while (it.hasNext()) {
-        QFileInfo fi(it.next());
-        QStringList names = fi.fileName().replace(".bin", "").split("_o_");
+    auto bls = params.hw.isEmpty() ? FirmwareCatalog::entries(blDir) :
+                                     FirmwareCatalog::entriesForName(blDir, params.hw);
 
-        if (!fi.isDir() && (params.hw.isEmpty() || names.contains(params.hw, Qt::CaseInsensitive))) {
+    for (const auto &e: bls) {
+        if (!e.isDir) {
             QListWidgetItem *item = new QListWidgetItem;
-
-            QString name = names.at(0);
-            for(int i = 1;i < names.size();i++) {
-                name += " & " + names.at(i);
-            }
-
-            item->setText(name);
-            item->setData(Qt::UserRole, fi.absoluteFilePath());
+            item->setText(e.displayName());
+            item->setData(Qt::UserRole, e.path);
             ui->blList->insertItem(ui->blList->count(), item);
         }
     }
@@ -613,6 +587,51 @@ void PageFirmware::uploadFw(bool allOverCan)
             return;
         }
 
+        // Newer firmwares report the size and CRC of the image they run, so
+        // uploading the same image again can be skipped and the running image
+        // can be used as the base for a delta upload.
+        QByteArray deltaBase;
+        auto fwParams = mVesc->getLastFwRxParams();
+        bool isBin = file.fileName().toLower().endsWith(".bin");
+
+        if (isBin && !allOverCan && fwParams.fwImageSize > 0) {
+            qint64 fwSize = 0;
+            quint16 fwCrc = 0;
+            if (FirmwareCatalog::fileImageCrc(file.fileName(), fwSize, fwCrc) &&
+                    fwSize == fwParams.fwImageSize && fwCrc == fwParams.fwImageCrc) {
+                if (QMessageBox::question(this,
+                                          tr("Identical Firmware"),
+                                          tr("The connected device already runs the selected firmware. "
+                                             "Do you want to upload it anyway?"),
+                                          QMessageBox::Yes | QMessageBox::No, QMessageBox::No) != QMessageBox::Yes) {
+                    return;
+                }
+            }
+
+            if (fwParams.fwDeltaSupported) {
+                QStringList dirs;
+                dirs.append(QFileInfo(file.fileName()).absolutePath());
+                for (int i = 0;i < ui->hwList->count();i++) {
+                    dirs.append(ui->hwList->item(i)->data(Qt::UserRole).toString());
+                }
+
+                for (const auto &ver: FirmwareCatalog::entries(":/fw_archive")) {
+                    for (const auto &e: FirmwareCatalog::entriesForName(ver.path, fwParams.hw)) {
+                        dirs.append(e.path);
+                    }
+                }
+
+                QString basePath = FirmwareCatalog::findByImage(dirs, fwParams.fwImageSize,
+                                                                fwParams.fwImageCrc);
+                if (basePath.toLower().endsWith(".bin")) {
+                    QFile fileBase(basePath);
+                    if (fileBase.open(QIODevice::ReadOnly)) {
+                        deltaBase = fileBase.readAll();
+                    }
+                }
+            }
+        }
+
         QMessageBox::StandardButton reply;
 
         if ((ui->fwTabWidget->currentIndex() == 0 && ui->hwList->count() == 1) || ui->fwTabWidget->currentIndex() == 3) {
@@ -649,7 +668,8 @@ void PageFirmware::uploadFw(bool allOverCan)
             reply = QMessageBox::No;
         }
 
-        auto uploadFw = [this](QFile *file, bool isBootloader, bool allOverCan) {
+        auto uploadFw = [this, &deltaBase](QFile *file, bool isBootloader, bool allOverCan) {
+            QByteArray base = isBootloader ? QByteArray() : deltaBase;
             bool fwRes = false;
 
             if (file->fileName().toLower().endsWith(".hex")) {
@@ -677,11 +697,11 @@ void PageFirmware::uploadFw(bool allOverCan)
                         data.append(i.value());
                     }
 
-                    fwRes = mVesc->fwUpload(data, isBootloader, allOverCan);
+                    fwRes = mVesc->fwUpload(data, isBootloader, allOverCan, true, true, base);
                 }
             } else {
                 QByteArray data = file->readAll();
-                fwRes = mVesc->fwUpload(data, isBootloader, allOverCan);
+                fwRes = mVesc->fwUpload(data, isBootloader, allOverCan, true, true, base);
             }
 
             return fwRes;
@@ -722,17 +742,16 @@ void PageFirmware::reloadArchive()
         QResource::unregisterResource(path);
         QResource::registerResource(path);
 
-        QString fwDir = "://fw_archive";
+        QString fwDir = ":/fw_archive";
+        FirmwareCatalog::invalidate(fwDir);
 
         ui->archVersionList->clear();
 
-        QDirIterator it(fwDir);
-        while (it.hasNext()) {
-            QFileInfo fi(it.next());
+        for (const auto &e: FirmwareCatalog::entries(fwDir)) {
             QListWidgetItem *item = new QListWidgetItem;
 
-            item->setText(fi.fileName());
-            item->setData(Qt::UserRole, fi.absoluteFilePath());
+            item->setText(e.name);
+            item->setData(Qt::UserRole, e.path);
             ui->archVersionList->insertItem(ui->archVersionList->count(), item);
         }
     }
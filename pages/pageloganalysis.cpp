@@ -21,6 +21,7 @@
 #include "pageloganalysis.h"
 #include "ui_pageloganalysis.h"
 #include "utility.h"
+#include "sdmirror.h"
 #include <QFileDialog>
 #include <QMessageBox>
 #include <cmath>
@@ -153,6 +154,14 @@ PageLogAnalysis::PageLogAnalysis(QWidget *parent) :
     mLogRtFieldUpdatePending = false;
     mLogRtAppendTime = false;
     mLogRtTimer = new QTimer(this);
+    mLogRtIngested = 0;
+    mLogSampleColGenerated = false;
+    mLogTripGnssGenerated = false;
+    mTripGnssPrevSet = false;
+    mTripGnssMeters = 0.0;
+    mMapPosTimeLast = -1;
+    mPlotStartTime = -1.0;
+    mPlotTimeLast = 0.0;
 
     connect(mGnssTimer, &QTimer::timeout, [this]() {
         if (mVesc && ui->pollGnssBox->isChecked()) {
@@ -309,6 +318,8 @@ void PageLogAnalysis::setVesc(VescInterface *vesc)
 
             mLogHeader = mLogRtHeader;
             mLog = mLogRt;
+            mLogRtIngested = mLogRt.size();
+            mLogRtRebuildTimer.start();
 
             updateInds();
             generateMissingEntries();
@@ -366,6 +377,7 @@ void PageLogAnalysis::setVesc(VescInterface *vesc)
             mLogRtSamplesNow.resize(fieldNum);
             mLogRtTimer->start(1000.0 / rateHz);
             mLogRt.clear();
+            mLogRtIngested = 0;
         });
 
         connect(mVesc->commands(), &Commands::logStop, [this, updatePlots] () {
@@ -404,18 +416,25 @@ void PageLogAnalysis::setVesc(VescInterface *vesc)
             mLogRt.append(mLogRtSamplesNow);
 
             if (ui->updateRtBox->isChecked()) {
-                updatePlots();
+                // Only the new rows are added when the whole log is shown. Otherwise
+                // the shown range moves with every row, so it is rebuilt at a
+                // lower rate.
+                bool fullSpan = ui->spanSlider->alt_value() == ui->spanSlider->minimum() &&
+                        ui->spanSlider->value() == ui->spanSlider->maximum();
+
+                if (mLogRtIngested > 0 && !mLog.isEmpty() && !mLogRtFieldUpdatePending &&
+                        mLogHeader.size() >= mLogRtHeader.size() && fullSpan) {
+                    appendLogRt();
+                } else if (mLogRtIngested == 0 || !mLogRtRebuildTimer.isValid() ||
+                           mLogRtRebuildTimer.elapsed() > 1000) {
+                    updatePlots();
+                }
             }
         });
 
         connect(mVesc->commands(), &Commands::fileProgress, [this]
                 (int32_t prog, int32_t tot, double percentage, double bytesPerSec) {
-            QTime t(0, 0, 0, 0);;
-            t = t.addSecs((tot - prog) / bytesPerSec);
-            ui->vescDisplay->setValue(percentage);
-            ui->vescDisplay->setText(tr("%1 KB/s, %2").
-                                     arg(bytesPerSec / 1024, 0, 'f', 2).
-                                     arg(t.toString("hh:mm:ss")));
+            showFileProgress(prog, tot, percentage, bytesPerSec);
         });
 
         connect(mVesc->commands(), &Commands::gnssRx, [this](GNSS_DATA val) {
@@ -724,7 +743,7 @@ void PageLogAnalysis::truncateDataAndPlot(bool zoomGraph)
 
     int ind = 0;
     double i_llh[3];
-    int posTimeLast = -1;
+    mMapPosTimeLast = -1;
 
     ui->map->getEnuRef(i_llh);
     mLogTruncated.clear();
@@ -737,53 +756,7 @@ void PageLogAnalysis::truncateDataAndPlot(bool zoomGraph)
         }
 
         mLogTruncated.append(d);
-        bool skip = false;
-
-        if (mInd_t_day_pos >= 0 && mInd_gnss_h_acc >= 0) {
-            int postime = int(d[mInd_t_day_pos] * 1000.0);
-            double h_acc = d[mInd_gnss_h_acc];
-
-            skip = true;
-            if (h_acc > 0.0 &&
-                    (!ui->filterOutlierBox->isChecked() ||
-                     h_acc < ui->filterhAccBox->value()) &&
-                    posTimeLast != postime) {
-                skip = false;
-                posTimeLast = postime;
-            }
-        }
-
-        if (mInd_gnss_lat < 0 || mInd_gnss_lon < 0) {
-            skip = true;
-        }
-
-        if (!skip) {
-            double llh[3];
-            double xyz[3];
-
-            llh[0] = d[mInd_gnss_lat];
-            llh[1] = d[mInd_gnss_lon];
-            if (mInd_gnss_alt >= 0) {
-                llh[2] = d[mInd_gnss_alt];
-            } else {
-                llh[2] = 0.0;
-            }
-
-            if (!ui->filterOutlierBox->isChecked() ||
-                Utility::distLlhToLlh(llh[0], llh[1], 0.0, i_llh[0], i_llh[1], 0.0) < (ui->filterdMaxBox->value() * 1000.0)) {
-                Utility::llhToEnu(i_llh, llh, xyz);
-
-                LocPoint p;
-                p.setXY(xyz[0], xyz[1]);
-                p.setRadius(5);
-
-                if (mInd_t_day >= 0) {
-                    p.setInfo(QString("%1").arg(d[mInd_t_day]));
-                }
-
-                ui->map->addInfoPoint(p, false);
-            }
-        }
+        addMapPoint(d, i_llh);
     }
 
     if (zoomGraph) {
@@ -818,6 +791,22 @@ void PageLogAnalysis::updateGraphs()
 
     auto rows = uniqueRows.values();
 
+    // Remember what the graphs show, so that live rows can be appended
+    mGraphRows.clear();
+    mGraphScales.clear();
+    for (const auto &r: rows) {
+        int row = r.row();
+        if (!mLogHeader[row].isTimeStamp) {
+            double rowScale = 1.0;
+            if(QDoubleSpinBox *sb = qobject_cast<QDoubleSpinBox*>
+                    (ui->dataTable->cellWidget(row, dataTableColScale))) {
+                rowScale = sb->value();
+            }
+            mGraphRows.append(row);
+            mGraphScales.append(rowScale);
+        }
+    }
+
     QVector<double> xAxis;
     QVector<QVector<double> > yAxes;
     QVector<QString> names;
@@ -828,19 +817,11 @@ void PageLogAnalysis::updateGraphs()
 
     double time = 0;
     foreach (const auto &d, mLogTruncated) {
-        if (mInd_t_day >= 0) {
-            if (startTime < 0) {
-                startTime = d[mInd_t_day];
-            }
-
-            time = d[mInd_t_day] - startTime;
-            if (time < 0) { // Handle midnight
-                time += 60 * 60 * 24;
-            }
-        } else {
-            time++;;
+        if (mInd_t_day >= 0 && startTime < 0) {
+            startTime = d[mInd_t_day];
         }
 
+        time = plotTime(d, startTime, time);
         xAxis.append(time);
         int rowInd = 0;
 
@@ -865,6 +846,9 @@ void PageLogAnalysis::updateGraphs()
         }
     }
 
+    mPlotStartTime = startTime;
+    mPlotTimeLast = time;
+
     ui->plot->clearGraphs();
     ui->plot->yAxis2->setVisible(false);
 
@@ -1141,17 +1125,24 @@ QVector<double> PageLogAnalysis::getLogSample(double time)
         if (mInd_t_day >= 0) {
             double startTime = d[mInd_t_day];
 
-            for (auto dn: mLogTruncated) {
-                double timeNow = dn[mInd_t_day] - startTime;
-                if (timeNow < 0) { // Handle midnight
-                    timeNow += 60 * 60 * 24;
-                }
+            // The time relative to the first sample is increasing, so the
+            // first sample at or after time can be found with a binary search.
+            int lo = 0;
+            int hi = mLogTruncated.size();
+            while (lo < hi) {
+                int mid = lo + (hi - lo) / 2;
+                double timeNow = plotTime(mLogTruncated.at(mid), startTime, 0.0);
 
-                if (timeNow >= time) {
-                    d = dn;
-                    break;
+                if (timeNow < time) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
                 }
             }
+
+            if (lo < mLogTruncated.size()) {
+                d = mLogTruncated.at(lo);
+            }
         }
     }
 
@@ -1318,9 +1309,13 @@ void PageLogAnalysis::openLog(QByteArray data)
 
 void PageLogAnalysis::generateMissingEntries()
 {
+    mLogSampleColGenerated = false;
+    mLogTripGnssGenerated = false;
+
     // Create sample array if t_day is missing
     if (mInd_t_day < 0) {
         mLogHeader.append(LOG_HEADER("t_day", "Sample", "", 0));
+        mLogSampleColGenerated = true;
 
         for (int i = 0;i < mLog.size();i++) {
             mLog[i].append(i);
@@ -1365,67 +1360,224 @@ void PageLogAnalysis::generateMissingEntries()
         // Create GNSS trip counter if it is missing
         if (mInd_trip_vesc < 0) {
             mLogHeader.append(LOG_HEADER("trip_gnss", "Trip GNSS", "m", 3, true));
+            mLogTripGnssGenerated = true;
 
-            double prevSampleGnss[3];
-            bool prevSampleGnssSet = false;
-            double metersGnss = 0.0;
+            mTripGnssPrevSet = false;
+            mTripGnssMeters = 0.0;
 
             for (int i = 0;i < mLog.size();i++) {
-                double lat = mLog.at(i).at(mInd_gnss_lat);
-                double lon = mLog.at(i).at(mInd_gnss_lon);
-                double alt = 0;
-                if (mInd_gnss_alt >= 0) {
-                    alt = mLog.at(i).at(mInd_gnss_alt);
-                }
+                mLog[i].append(tripGnssStep(mLog.at(i)));
+            }
+        }
+    }
 
-                double hacc = 0.0;
-                if (mInd_gnss_h_acc >= 0) {
-                    hacc = mLog.at(i).at(mInd_gnss_h_acc);
-                }
+    updateInds();
+}
 
-                if (hacc > 0.0 && (!ui->filterOutlierBox->isChecked() ||
-                                   (
-                                       hacc < ui->filterhAccBox->value()) &&
-                                       Utility::distLlhToLlh(lat, lon, alt, 0.0, i_llh[1], 0.0) < (ui->filterdMaxBox->value() * 1000.0)
-                                   )) {
-                    if (prevSampleGnssSet) {
-                        double i_llh[3];
-                        double llh[3];
-                        double xyz[3];
-                        ui->map->getEnuRef(i_llh);
-
-                        llh[0] = lat;
-                        llh[1] = lon;
-                        llh[2] = alt;
-                        Utility::llhToEnu(i_llh, llh, xyz);
-
-                        LocPoint p, p2;
-                        p.setXY(xyz[0], xyz[1]);
-                        p.setRadius(10);
-
-                        llh[0] = prevSampleGnss[0];
-                        llh[1] = prevSampleGnss[1];
-                        llh[2] = prevSampleGnss[2];
-                        Utility::llhToEnu(i_llh, llh, xyz);
-
-                        p2.setXY(xyz[0], xyz[1]);
-                        p2.setRadius(10);
-
-                        metersGnss += p.getDistanceTo(p2);
-                    }
+/**
+ * @brief PageLogAnalysis::tripGnssStep
+ * Advance the generated GNSS trip counter with one log row.
+ *
+ * @param d
+ * The log row, without the generated trip column.
+ *
+ * @return
+ * The trip distance at this row.
+ */
+double PageLogAnalysis::tripGnssStep(const QVector<double> &d)
+{
+    double i_llh[3];
+    ui->map->getEnuRef(i_llh);
 
-                    prevSampleGnssSet = true;
-                    prevSampleGnss[0] = lat;
-                    prevSampleGnss[1] = lon;
-                    prevSampleGnss[2] = alt;
-                }
+    double lat = d.at(mInd_gnss_lat);
+    double lon = d.at(mInd_gnss_lon);
+    double alt = 0;
+    if (mInd_gnss_alt >= 0) {
+        alt = d.at(mInd_gnss_alt);
+    }
+
+    double hacc = 0.0;
+    if (mInd_gnss_h_acc >= 0) {
+        hacc = d.at(mInd_gnss_h_acc);
+    }
+
+    if (hacc > 0.0 && (!ui->filterOutlierBox->isChecked() ||
+                       (
+                           hacc < ui->filterhAccBox->value()) &&
+                           Utility::distLlhToLlh(lat, lon, alt, 0.0, i_llh[1], 0.0) < (ui->filterdMaxBox->value() * 1000.0)
+                       )) {
+        if (mTripGnssPrevSet) {
+            double llh[3];
+            double xyz[3];
+
+            llh[0] = lat;
+            llh[1] = lon;
+            llh[2] = alt;
+            Utility::llhToEnu(i_llh, llh, xyz);
+
+            LocPoint p, p2;
+            p.setXY(xyz[0], xyz[1]);
+            p.setRadius(10);
+
+            Utility::llhToEnu(i_llh, mTripGnssPrev, xyz);
+
+            p2.setXY(xyz[0], xyz[1]);
+            p2.setRadius(10);
+
+            mTripGnssMeters += p.getDistanceTo(p2);
+        }
+
+        mTripGnssPrevSet = true;
+        mTripGnssPrev[0] = lat;
+        mTripGnssPrev[1] = lon;
+        mTripGnssPrev[2] = alt;
+    }
+
+    return mTripGnssMeters;
+}
+
+/**
+ * @brief PageLogAnalysis::addMapPoint
+ * Add the position of a log row to the map trace, if it has a valid one.
+ */
+void PageLogAnalysis::addMapPoint(const QVector<double> &d, const double *i_llh)
+{
+    bool skip = false;
+
+    if (mInd_t_day_pos >= 0 && mInd_gnss_h_acc >= 0) {
+        int postime = int(d[mInd_t_day_pos] * 1000.0);
+        double h_acc = d[mInd_gnss_h_acc];
 
-                mLog[i].append(metersGnss);
+        skip = true;
+        if (h_acc > 0.0 &&
+                (!ui->filterOutlierBox->isChecked() ||
+                 h_acc < ui->filterhAccBox->value()) &&
+                mMapPosTimeLast != postime) {
+            skip = false;
+            mMapPosTimeLast = postime;
+        }
+    }
+
+    if (mInd_gnss_lat < 0 || mInd_gnss_lon < 0) {
+        skip = true;
+    }
+
+    if (!skip) {
+        double llh[3];
+        double xyz[3];
+
+        llh[0] = d[mInd_gnss_lat];
+        llh[1] = d[mInd_gnss_lon];
+        if (mInd_gnss_alt >= 0) {
+            llh[2] = d[mInd_gnss_alt];
+        } else {
+            llh[2] = 0.0;
+        }
+
+        if (!ui->filterOutlierBox->isChecked() ||
+            Utility::distLlhToLlh(llh[0], llh[1], 0.0, i_llh[0], i_llh[1], 0.0) < (ui->filterdMaxBox->value() * 1000.0)) {
+            Utility::llhToEnu(i_llh, llh, xyz);
+
+            LocPoint p;
+            p.setXY(xyz[0], xyz[1]);
+            p.setRadius(5);
+
+            if (mInd_t_day >= 0) {
+                p.setInfo(QString("%1").arg(d[mInd_t_day]));
             }
+
+            ui->map->addInfoPoint(p, false);
         }
     }
+}
 
-    updateInds();
+/**
+ * @brief PageLogAnalysis::plotTime
+ * Get the plot x-value of a log row.
+ *
+ * @param startTime
+ * t_day of the first plotted row.
+ *
+ * @param timeLast
+ * x-value of the previous row, used when there is no time column.
+ */
+double PageLogAnalysis::plotTime(const QVector<double> &d, double startTime, double timeLast)
+{
+    if (mInd_t_day < 0) {
+        return timeLast + 1;
+    }
+
+    double time = d[mInd_t_day] - startTime;
+    if (time < 0) { // Handle midnight
+        time += 60 * 60 * 24;
+    }
+
+    return time;
+}
+
+/**
+ * @brief PageLogAnalysis::appendLogRt
+ * Add the live log rows that arrived since the last call to the log, the
+ * graphs and the map. The cost only depends on the number of new rows, so
+ * long live sessions stay responsive.
+ */
+void PageLogAnalysis::appendLogRt()
+{
+    double i_llh[3];
+    ui->map->getEnuRef(i_llh);
+    ui->map->setInfoTraceNow(0);
+
+    int graphs = qMin(ui->plot->graphCount(), mGraphRows.size());
+
+    while (mLogRtIngested < mLogRt.size()) {
+        auto d = mLogRt.at(mLogRtIngested++);
+
+        if (mLogSampleColGenerated) {
+            d.append(mLog.size());
+        }
+
+        if (mLogTripGnssGenerated) {
+            d.append(tripGnssStep(d));
+        }
+
+        mLog.append(d);
+        mLogTruncated.append(d);
+        addMapPoint(d, i_llh);
+
+        if (mInd_t_day >= 0 && mPlotStartTime < 0) {
+            mPlotStartTime = d[mInd_t_day];
+        }
+
+        mPlotTimeLast = plotTime(d, mPlotStartTime, mPlotTimeLast);
+
+        for (int i = 0;i < graphs;i++) {
+            double val = d[mGraphRows.at(i)] * mGraphScales.at(i);
+            auto graph = ui->plot->graph(i);
+            graph->addData(mPlotTimeLast, val);
+
+            if (ui->autoZoomBox->isChecked()) {
+                auto axis = graph->valueAxis();
+                if (val < axis->range().lower) {
+                    axis->setRangeLower(val);
+                } else if (val > axis->range().upper) {
+                    axis->setRangeUpper(val);
+                }
+            }
+        }
+    }
+
+    if (ui->autoZoomBox->isChecked()) {
+        ui->plot->xAxis->setRangeUpper(mPlotTimeLast);
+    }
+
+    ui->map->update();
+    updateStats();
+
+    if (mInd_t_day >= 0 && !mLog.isEmpty()) {
+        updateDataAndPlot(mPlotTimeLast);
+    } else {
+        ui->plot->replotWhenVisible();
+    }
 }
 
 void PageLogAnalysis::storeSelection()
@@ -1758,32 +1910,47 @@ void PageLogAnalysis::on_vescSaveAsButton_clicked()
 
                 mLastSaveAsPath = path;
 
-                bool didCancel = false;
+                QVector<SdMirror::Entry> files;
                 foreach (auto it, items) {
-                    if (didCancel) {
-                        break;
-                    }
-
                     if (it->data(Qt::UserRole).canConvert<FILE_LIST_ENTRY>()) {
                         fe = it->data(Qt::UserRole).value<FILE_LIST_ENTRY>();
                         if (!fe.isDir) {
-                            QFile file(path + "/" + fe.name);
-                            if (file.open(QIODevice::WriteOnly)) {
-                                auto data = mVesc->commands()->fileBlockRead(mVescLastPath + "/" + fe.name);
-                                didCancel = mVesc->commands()->fileBlockDidCancel();
-                                file.write(data);
-                                file.close();
-                            }
+                            SdMirror::Entry e;
+                            e.path = mVescLastPath + "/" + fe.name;
+                            e.size = fe.size;
+                            files.append(e);
                         }
                     }
                 }
 
+                // The user chose the destination, so existing files are
+                // replaced rather than skipped.
+                SdMirror mirror(mVesc->commands());
+                connect(&mirror, &SdMirror::progress, this, &PageLogAnalysis::showFileProgress);
+
+                if (!mirror.download(files, mVescLastPath, path, true)) {
+                    mVesc->emitMessageDialog("Save File",
+                                             tr("%1 of %2 files could not be saved to %3.").
+                                             arg(files.size() - mirror.filesDownloaded()).
+                                             arg(files.size()).arg(path), false);
+                }
+
                 setFileButtonsEnabled(true);
             }
         }
     }
 }
 
+void PageLogAnalysis::showFileProgress(qint64 done, qint64 total, double percentage, double bytesPerSec)
+{
+    QTime t(0, 0, 0, 0);
+    t = t.addSecs((total - done) / qMax(bytesPerSec, 1.0));
+    ui->vescDisplay->setValue(percentage);
+    ui->vescDisplay->setText(tr("%1 KB/s, %2").
+                             arg(bytesPerSec / 1024, 0, 'f', 2).
+                             arg(t.toString("hh:mm:ss")));
+}
+
 void PageLogAnalysis::on_vescLogDeleteButton_clicked()
 {
     auto items = ui->vescLogTable->selectedItems();
@@ -23,6 +23,7 @@
 
 #include <QWidget>
 #include <QCheckBox>
+#include <QElapsedTimer>
 #include <vescinterface.h>
 #include "widgets/qcustomplot.h"
 #include "widgets/vesc3dview.h"
@@ -92,6 +93,22 @@ private:
     bool mLogRtAppendTime;
     bool mLogRtFieldUpdatePending;
 
+    // Live logs are appended to mLog row by row. Rows of mLogRt before
+    // mLogRtIngested are in mLog already, and the generated columns are
+    // continued from the state below.
+    int mLogRtIngested;
+    QElapsedTimer mLogRtRebuildTimer;
+    bool mLogSampleColGenerated;
+    bool mLogTripGnssGenerated;
+    double mTripGnssPrev[3];
+    bool mTripGnssPrevSet;
+    double mTripGnssMeters;
+    int mMapPosTimeLast;
+    double mPlotStartTime;
+    double mPlotTimeLast;
+    QVector<int> mGraphRows;
+    QVector<double> mGraphScales;
+
     // Lightweight pre-calculated offsets in the log. These
     // need to be looked up a lot and finding them in the
     // header each time slows down the responsiveness.
@@ -178,10 +195,15 @@ private:
                      double scaleStep = 0.1, double scaleMax = 99.99);
     void openLog(QByteArray data);
     void generateMissingEntries();
+    double tripGnssStep(const QVector<double> &d);
+    void addMapPoint(const QVector<double> &d, const double *i_llh);
+    double plotTime(const QVector<double> &d, double startTime, double timeLast);
+    void appendLogRt();
 
     void storeSelection();
     void restoreSelection();
     void setFileButtonsEnabled(bool en);
+    void showFileProgress(qint64 done, qint64 total, double percentage, double bytesPerSec);
 
 };
 
@@ -66,6 +66,7 @@ PageSampledData::PageSampledData(QWidget *parent) :
     mSamplesToWait = 0;
     tmpSampleCnt = 0;
     tmpSampleRetryCnt = 0;
+    mBatchMode = false;
 
     mSampleGetTimer = new QTimer(this);
     mTimer = new QTimer(this);
@@ -122,6 +123,8 @@ void PageSampledData::setVesc(VescInterface *vesc)
     if (mVesc) {
         connect(mVesc->commands(), SIGNAL(samplesReceived(QByteArray)),
                 this, SLOT(samplesReceived(QByteArray)));
+        connect(mVesc->commands(), SIGNAL(sampleBatchReceived(QByteArray)),
+                this, SLOT(sampleBatchReceived(QByteArray)));
     }
 }
 
@@ -504,6 +507,22 @@ void PageSampledData::sampleGetTimerSlot()
         return;
     }
 
+    if (mBatchMode) {
+        // Request the missing samples as ranges
+        int first = -1;
+        for (int i = 0;i <= mSamplesToWait;i++) {
+            bool missing = i < mSamplesToWait && tmpIndexVector.at(i) == -1;
+
+            if (missing && first < 0) {
+                first = i;
+            } else if (!missing && first >= 0) {
+                mVesc->commands()->sampleBatchResend(first, i - first);
+                first = -1;
+            }
+        }
+        return;
+    }
+
     for (int i = 0; i < mSamplesToWait; i++) {
         if (tmpIndexVector.size() <= i || tmpIndexVector.at(i) == -1) {
             mVesc->commands()->samplePrint(DEBUG_SAMPLING_SEND_SINGLE_SAMPLE, i,
@@ -524,25 +543,8 @@ void PageSampledData::samplesReceived(QByteArray bytes)
     }
 
     // Pad vectors with zeroes for missing samples
-    while (tmpIndexVector.size() <= sampleIndex) {
-        tmpIndexVector.append(-1);
-        tmpCurr1Vector.append(0.0);
-        tmpCurr2Vector.append(0.0);
-        tmpCurr3Vector.append(0.0);
-        tmpPh1Vector.append(0.0);
-        tmpPh2Vector.append(0.0);
-        tmpPh3Vector.append(0.0);
-        tmpVZeroVector.append(0.0);
-        tmpCurrTotVector.append(0.0);
-
-        if (tmpFSwVector.size() > 0) {
-            tmpFSwVector.append(tmpFSwVector.last());
-        } else {
-            tmpFSwVector.append(0.0);
-        }
-
-        tmpStatusArray.append(char(0));
-        tmpPhaseArray.append(char(0));
+    if (tmpIndexVector.size() <= sampleIndex) {
+        resizeBuffers(sampleIndex + 1);
     }
 
     if (tmpIndexVector[sampleIndex] == -1) {
@@ -580,23 +582,76 @@ void PageSampledData::samplesReceived(QByteArray bytes)
     }
 
     if (tmpSampleCnt == mSamplesToWait) {
-        mSampleGetTimer->stop();
+        finishSampling();
+    }
+}
+
+/**
+ * @brief PageSampledData::sampleBatchReceived
+ * Decode a COMM_SAMPLE_PRINT_BATCH packet. The layout is
+ *
+ * first (u16) | count (u8) | total (u16) | currScale | voltScale | fSwScale
+ *
+ * followed by count samples with curr1, curr2, curr3, ph1, ph2, ph3, vZero,
+ * currTot and fSw as int16 that are multiplied with their scale, and the
+ * status and phase bytes. That is 20 bytes per sample instead of the 44 of
+ * COMM_SAMPLE_PRINT.
+ */
+void PageSampledData::sampleBatchReceived(QByteArray bytes)
+{
+    VByteArray vb(bytes);
+
+    if (!mBatchMode || vb.size() < 17) {
+        return;
+    }
+
+    int first = vb.vbPopFrontUint16();
+    int count = vb.vbPopFrontUint8();
+    int total = vb.vbPopFrontUint16();
+    double currScale = vb.vbPopFrontDouble32Auto();
+    double voltScale = vb.vbPopFrontDouble32Auto();
+    double fSwScale = vb.vbPopFrontDouble32Auto();
+
+    // The number of samples is only known here for the trigger modes, so the
+    // buffers are allocated once when the first packet arrives.
+    if (tmpIndexVector.size() != total) {
+        clearBuffers();
+        resizeBuffers(total);
+        mSamplesToWait = total;
+    }
 
-        curr1Vector = tmpCurr1Vector;
-        curr2Vector = tmpCurr2Vector;
-        curr3Vector = tmpCurr3Vector;
-        ph1Vector = tmpPh1Vector;
-        ph2Vector = tmpPh2Vector;
-        ph3Vector = tmpPh3Vector;
-        vZeroVector = tmpVZeroVector;
-        currTotVector = tmpCurrTotVector;
-        fSwVector = tmpFSwVector;
-        statusArray = tmpStatusArray;
-        phaseArray = tmpPhaseArray;
-
-        mDoReplot = true;
-        mDoFilterReplot = true;
-        mDoRescale = true;
+    if (count > (vb.size() / 20) || (first + count) > total) {
+        return;
+    }
+
+    for (int i = first;i < (first + count);i++) {
+        if (tmpIndexVector.at(i) == -1) {
+            tmpSampleCnt++;
+        }
+
+        tmpIndexVector[i] = i;
+        tmpCurr1Vector[i] = double(vb.vbPopFrontInt16()) * currScale;
+        tmpCurr2Vector[i] = double(vb.vbPopFrontInt16()) * currScale;
+        tmpCurr3Vector[i] = double(vb.vbPopFrontInt16()) * currScale;
+        tmpPh1Vector[i] = double(vb.vbPopFrontInt16()) * voltScale;
+        tmpPh2Vector[i] = double(vb.vbPopFrontInt16()) * voltScale;
+        tmpPh3Vector[i] = double(vb.vbPopFrontInt16()) * voltScale;
+        tmpVZeroVector[i] = double(vb.vbPopFrontInt16()) * voltScale;
+        tmpCurrTotVector[i] = double(vb.vbPopFrontInt16()) * currScale;
+        tmpFSwVector[i] = double(vb.vbPopFrontInt16()) * fSwScale;
+        tmpStatusArray[i] = vb.vbPopFrontInt8();
+        tmpPhaseArray[i] = vb.vbPopFrontInt8();
+    }
+
+    mVesc->commands()->sampleBatchAck(first, count);
+
+    ui->sampProgBar->setValue(double(tmpSampleCnt) / double(total) * 100.0);
+
+    mSampleGetTimer->start(1000);
+    tmpSampleRetryCnt = 0;
+
+    if (tmpSampleCnt == total) {
+        finishSampling();
     }
 }
 
@@ -608,72 +663,37 @@ void PageSampledData::replotAll()
 
 void PageSampledData::on_sampleNowButton_clicked()
 {
-    if (mVesc) {
-        clearBuffers();
-        mVesc->commands()->samplePrint(DEBUG_SAMPLING_NOW, ui->samplesBox->value(),
-                                       ui->decimationBox->value(), ui->rawBox->isChecked());
-        mSamplesToWait = ui->samplesBox->value();
-    }
+    startSampling(DEBUG_SAMPLING_NOW, ui->samplesBox->value());
 }
 
 void PageSampledData::on_sampleStartButton_clicked()
 {
-    if (mVesc) {
-        clearBuffers();
-        mVesc->commands()->samplePrint(DEBUG_SAMPLING_START, ui->samplesBox->value(),
-                                       ui->decimationBox->value(), ui->rawBox->isChecked());
-        mSamplesToWait = ui->samplesBox->value();
-    }
+    startSampling(DEBUG_SAMPLING_START, ui->samplesBox->value());
 }
 
 void PageSampledData::on_sampleTriggerStartButton_clicked()
 {
-    if (mVesc) {
-        clearBuffers();
-        mVesc->commands()->samplePrint(DEBUG_SAMPLING_TRIGGER_START, ui->samplesBox->value(),
-                                       ui->decimationBox->value(), ui->rawBox->isChecked());
-        mSamplesToWait = ui->samplesBox->maximum();
-    }
+    startSampling(DEBUG_SAMPLING_TRIGGER_START, ui->samplesBox->maximum());
 }
 
 void PageSampledData::on_sampleTriggerFaultButton_clicked()
 {
-    if (mVesc) {
-        clearBuffers();
-        mVesc->commands()->samplePrint(DEBUG_SAMPLING_TRIGGER_FAULT, ui->samplesBox->value(),
-                                       ui->decimationBox->value(), ui->rawBox->isChecked());
-        mSamplesToWait = ui->samplesBox->maximum();
-    }
+    startSampling(DEBUG_SAMPLING_TRIGGER_FAULT, ui->samplesBox->maximum());
 }
 
 void PageSampledData::on_sampleTriggerStartNosendButton_clicked()
 {
-    if (mVesc) {
-        clearBuffers();
-        mVesc->commands()->samplePrint(DEBUG_SAMPLING_TRIGGER_START_NOSEND, ui->samplesBox->value(),
-                                       ui->decimationBox->value(), ui->rawBox->isChecked());
-        mSamplesToWait = ui->samplesBox->maximum();
-    }
+    startSampling(DEBUG_SAMPLING_TRIGGER_START_NOSEND, ui->samplesBox->maximum());
 }
 
 void PageSampledData::on_sampleTriggerFaultNosendButton_clicked()
 {
-    if (mVesc) {
-        clearBuffers();
-        mVesc->commands()->samplePrint(DEBUG_SAMPLING_TRIGGER_FAULT_NOSEND, ui->samplesBox->value(),
-                                       ui->decimationBox->value(), ui->rawBox->isChecked());
-        mSamplesToWait = ui->samplesBox->maximum();
-    }
+    startSampling(DEBUG_SAMPLING_TRIGGER_FAULT_NOSEND, ui->samplesBox->maximum());
 }
 
 void PageSampledData::on_sampleLastButton_clicked()
 {
-    if (mVesc) {
-        clearBuffers();
-        mVesc->commands()->samplePrint(DEBUG_SAMPLING_SEND_LAST_SAMPLES, ui->samplesBox->value(),
-                                       ui->decimationBox->value(), ui->rawBox->isChecked());
-        mSamplesToWait = ui->samplesBox->maximum();
-    }
+    startSampling(DEBUG_SAMPLING_SEND_LAST_SAMPLES, ui->samplesBox->maximum());
 }
 
 void PageSampledData::on_sampleStopButton_clicked()
@@ -713,6 +733,41 @@ void PageSampledData::on_rescaleButton_clicked()
     ui->filterResponsePlot->replotWhenVisible();
 }
 
+void PageSampledData::startSampling(debug_sampling_mode mode, int samplesToWait)
+{
+    if (!mVesc) {
+        return;
+    }
+
+    clearBuffers();
+    mSamplesToWait = samplesToWait;
+    mBatchMode = mVesc->getLastFwRxParams().sampleBatchSupported;
+
+    if (mBatchMode) {
+        mVesc->commands()->samplePrintBatch(mode, ui->samplesBox->value(),
+                                            ui->decimationBox->value(), ui->rawBox->isChecked());
+    } else {
+        // The sample count is not known up front in the trigger modes
+        if (mode == DEBUG_SAMPLING_NOW || mode == DEBUG_SAMPLING_START) {
+            tmpIndexVector.reserve(samplesToWait);
+            tmpCurr1Vector.reserve(samplesToWait);
+            tmpCurr2Vector.reserve(samplesToWait);
+            tmpCurr3Vector.reserve(samplesToWait);
+            tmpPh1Vector.reserve(samplesToWait);
+            tmpPh2Vector.reserve(samplesToWait);
+            tmpPh3Vector.reserve(samplesToWait);
+            tmpVZeroVector.reserve(samplesToWait);
+            tmpCurrTotVector.reserve(samplesToWait);
+            tmpFSwVector.reserve(samplesToWait);
+            tmpStatusArray.reserve(samplesToWait);
+            tmpPhaseArray.reserve(samplesToWait);
+        }
+
+        mVesc->commands()->samplePrint(mode, ui->samplesBox->value(),
+                                       ui->decimationBox->value(), ui->rawBox->isChecked());
+    }
+}
+
 void PageSampledData::clearBuffers()
 {
     mSampleGetTimer->stop();
@@ -733,6 +788,66 @@ void PageSampledData::clearBuffers()
     tmpPhaseArray.clear();
 }
 
+/**
+ * @brief PageSampledData::resizeBuffers
+ * Grow the capture buffers to size. New samples are marked as missing and
+ * set to zero, except fSw that repeats the last known value.
+ */
+void PageSampledData::resizeBuffers(int size)
+{
+    int oldSize = tmpIndexVector.size();
+    double fSwLast = oldSize > 0 ? tmpFSwVector.last() : 0.0;
+
+    tmpIndexVector.resize(size);
+    tmpCurr1Vector.resize(size);
+    tmpCurr2Vector.resize(size);
+    tmpCurr3Vector.resize(size);
+    tmpPh1Vector.resize(size);
+    tmpPh2Vector.resize(size);
+    tmpPh3Vector.resize(size);
+    tmpVZeroVector.resize(size);
+    tmpCurrTotVector.resize(size);
+    tmpFSwVector.resize(size);
+    tmpStatusArray.resize(size);
+    tmpPhaseArray.resize(size);
+
+    for (int i = oldSize;i < size;i++) {
+        tmpIndexVector[i] = -1;
+        tmpCurr1Vector[i] = 0.0;
+        tmpCurr2Vector[i] = 0.0;
+        tmpCurr3Vector[i] = 0.0;
+        tmpPh1Vector[i] = 0.0;
+        tmpPh2Vector[i] = 0.0;
+        tmpPh3Vector[i] = 0.0;
+        tmpVZeroVector[i] = 0.0;
+        tmpCurrTotVector[i] = 0.0;
+        tmpFSwVector[i] = fSwLast;
+        tmpStatusArray[i] = char(0);
+        tmpPhaseArray[i] = char(0);
+    }
+}
+
+void PageSampledData::finishSampling()
+{
+    mSampleGetTimer->stop();
+
+    curr1Vector = tmpCurr1Vector;
+    curr2Vector = tmpCurr2Vector;
+    curr3Vector = tmpCurr3Vector;
+    ph1Vector = tmpPh1Vector;
+    ph2Vector = tmpPh2Vector;
+    ph3Vector = tmpPh3Vector;
+    vZeroVector = tmpVZeroVector;
+    currTotVector = tmpCurrTotVector;
+    fSwVector = tmpFSwVector;
+    statusArray = tmpStatusArray;
+    phaseArray = tmpPhaseArray;
+
+    mDoReplot = true;
+    mDoFilterReplot = true;
+    mDoRescale = true;
+}
+
 void PageSampledData::updateZoom()
 {
     Qt::Orientations plotOrientations = (Qt::Orientations)
@@ -44,6 +44,7 @@ private slots:
     void timerSlot();
     void sampleGetTimerSlot();
     void samplesReceived(QByteArray bytes);
+    void sampleBatchReceived(QByteArray bytes);
     void replotAll();
 
     void on_sampleNowButton_clicked();
@@ -94,6 +95,7 @@ private:
     QByteArray tmpPhaseArray;
     int tmpSampleCnt;
     int tmpSampleRetryCnt;
+    bool mBatchMode;
 
     bool mDoReplot;
     bool mDoRescale;
@@ -101,6 +103,9 @@ private:
     int mSamplesToWait;
 
     void clearBuffers();
+    void resizeBuffers(int size);
+    void finishSampling();
+    void startSampling(debug_sampling_mode mode, int samplesToWait);
     void updateZoom();
 
 };
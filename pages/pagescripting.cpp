@@ -774,7 +774,17 @@ void PageScripting::on_uploadButton_clicked()
     ui->uploadButton->setEnabled(false);
     ui->eraseOnlyButton->setEnabled(false);
 
-    auto script = mLoader.qmlCompress(qmlToRun(false, false));
+    auto qml = qmlToRun(false, false);
+
+    if (!ui->forceUploadBox->isChecked() &&
+            mLoader.qmlIsOnDevice(qml, ui->uploadFullscreenBox->isChecked())) {
+        ui->uploadTextEdit->appendPlainText("Qml unchanged, skipping upload");
+        ui->uploadButton->setEnabled(true);
+        ui->eraseOnlyButton->setEnabled(true);
+        return;
+    }
+
+    auto script = mLoader.qmlCompress(qml);
 
     if (!eraseQml(script.size() + 100, false)) {
         ui->uploadButton->setEnabled(true);
@@ -808,7 +818,7 @@ void PageScripting::on_calcSizeButton_clicked()
 {
     QMessageBox::information(this, "QML Size",
                              QString("Compressed QML size: %1").
-                             arg(qCompress(qmlToRun(false).toUtf8(), 9).size()));
+                             arg(mLoader.qmlCompress(qmlToRun(false)).size()));
 }
 
 void PageScripting::on_recentFilterEdit_textChanged(const QString &filter)
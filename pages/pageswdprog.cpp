@@ -282,7 +282,8 @@ void PageSwdProg::on_uploadButton_clicked()
                     i.next();
                     QByteArray data = i.value();
                     fwRes = mVesc->swdUploadFw(data, i.key(),
-                                               ui->verifyBox->isChecked());
+                                               ui->verifyBox->isChecked(), true,
+                                               ui->skipErasedBox->isChecked());
                     if (!fwRes) {
                         break;
                     }
@@ -323,7 +324,7 @@ void PageSwdProg::on_uploadButton_clicked()
                 if (isHex) {
                     uploadHex(file.fileName());
                 } else {
-                    mVesc->swdUploadFw(file.readAll(), mFlashOffset + fw.addr, ui->verifyBox->isChecked());
+                    mVesc->swdUploadFw(file.readAll(), mFlashOffset + fw.addr, ui->verifyBox->isChecked(), true, ui->skipErasedBox->isChecked());
                 }
 
                 if (!fw.bootloaderPath.isEmpty()) {
@@ -350,7 +351,7 @@ void PageSwdProg::on_uploadButton_clicked()
                     if (isHex) {
                         uploadHex(file2.fileName());
                     } else {
-                        mVesc->swdUploadFw(file2.readAll(), mFlashOffset + fw.bootloaderAddr, ui->verifyBox->isChecked());
+                        mVesc->swdUploadFw(file2.readAll(), mFlashOffset + fw.bootloaderAddr, ui->verifyBox->isChecked(), true, ui->skipErasedBox->isChecked());
                     }
                 }
             } else {
@@ -405,7 +406,7 @@ void PageSwdProg::on_uploadButton_clicked()
             if (isHex) {
                 uploadHex(file.fileName());
             } else {
-                mVesc->swdUploadFw(file.readAll(), mFlashOffset, ui->verifyBox->isChecked());
+                mVesc->swdUploadFw(file.readAll(), mFlashOffset, ui->verifyBox->isChecked(), true, ui->skipErasedBox->isChecked());
             }
         }
 
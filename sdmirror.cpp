@@ -0,0 +1,385 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "sdmirror.h"
+#include "vbytearray.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+#include <functional>
+
+SdMirror::SdMirror(Commands *commands, QObject *parent) : QObject(parent)
+{
+    mCommands = commands;
+    mWindow = 4;
+    mFilesSkipped = 0;
+    mFilesDownloaded = 0;
+    mFilesFailed = 0;
+    mCancelled = false;
+    mInFlight = 0;
+    mBytesDone = 0;
+    mBytesTotal = 0;
+    mLoop = nullptr;
+}
+
+/**
+ * @brief SdMirror::setWindow
+ * Set how many reads can be waiting for their reply at the same time.
+ */
+void SdMirror::setWindow(int reads)
+{
+    mWindow = qMax(1, reads);
+}
+
+/**
+ * @brief SdMirror::listRecursive
+ * List all files under a directory on the SD-card. Directories are listed
+ * in parallel when the sequence envelope is active.
+ *
+ * @param remoteDir
+ * Directory to list.
+ *
+ * @param files
+ * The files, with their full path.
+ *
+ * @return
+ * true if all directories could be listed.
+ */
+bool SdMirror::listRecursive(QString remoteDir, QVector<Entry> &files)
+{
+    QStringList dirs;
+    dirs.append(remoteDir);
+    int active = 0;
+    bool ok = true;
+    int maxActive = mCommands->getSeqEnvelope() ? mWindow : 1;
+    QEventLoop loop;
+
+    std::function<void(QString, QString)> listPage;
+    std::function<void()> startMore;
+
+    listPage = [&](QString dir, QString from) {
+        active++;
+        mCommands->fileListAsync(dir, from)->then([&, dir](CommandRequest *req) {
+            active--;
+
+            if (!req->isOk()) {
+                ok = false;
+            } else {
+                VByteArray vb(req->reply());
+                bool more = vb.vbPopFrontInt8();
+                QString last;
+
+                while (vb.size() > 0) {
+                    bool isDir = vb.vbPopFrontInt8();
+                    qint32 size = vb.vbPopFrontInt32();
+                    last = vb.vbPopFrontString();
+
+                    QString path = QString(dir + "/" + last).replace("//", "/");
+                    if (isDir) {
+                        dirs.append(path);
+                    } else {
+                        Entry e;
+                        e.path = path;
+                        e.size = size;
+                        files.append(e);
+                    }
+                }
+
+                // Pages of one directory have to be listed in order
+                if (more && !last.isEmpty()) {
+                    listPage(dir, last);
+                }
+            }
+
+            startMore();
+
+            if (active == 0) {
+                loop.quit();
+            }
+        });
+    };
+
+    startMore = [&]() {
+        while (ok && active < maxActive && !dirs.isEmpty()) {
+            listPage(dirs.takeFirst(), "");
+        }
+    };
+
+    startMore();
+    if (active > 0) {
+        loop.exec();
+    }
+
+    if (!ok) {
+        qWarning() << "Could not list" << remoteDir;
+    }
+
+    return ok;
+}
+
+/**
+ * @brief SdMirror::download
+ * Download files from the SD-card. Files that already exist locally with
+ * the same size are skipped, and partial downloads are continued.
+ *
+ * @param files
+ * The files to download.
+ *
+ * @param remoteDir
+ * The files are stored at their path relative to this directory.
+ *
+ * @param localDir
+ * Local directory to store the files in.
+ *
+ * @param overwrite
+ * Download all files again, replacing the local files and discarding
+ * partial downloads.
+ *
+ * @return
+ * true if all files were downloaded or skipped.
+ */
+bool SdMirror::download(const QVector<SdMirror::Entry> &files, QString remoteDir, QString localDir,
+                        bool overwrite)
+{
+    mTransfers.clear();
+    mFilesSkipped = 0;
+    mFilesDownloaded = 0;
+    mFilesFailed = 0;
+    mCancelled = false;
+    mInFlight = 0;
+    mBytesDone = 0;
+    mBytesTotal = 0;
+
+    QDir remoteBase(remoteDir.isEmpty() ? "/" : remoteDir);
+
+    for (const auto &f: files) {
+        QString rel = remoteBase.relativeFilePath(f.path);
+        QString local = QDir(localDir).filePath(rel);
+
+        QFileInfo fi(local);
+        if (!overwrite && fi.exists() && fi.size() == f.size) {
+            mFilesSkipped++;
+            continue;
+        }
+
+        QDir().mkpath(fi.absolutePath());
+
+        Transfer t;
+        t.remote = f.path;
+        t.local = local;
+        t.size = f.size;
+        t.chunk = 0;
+        t.inFlight = 0;
+        t.done = false;
+        t.file = QSharedPointer<QFile>(new QFile(local + ".part"));
+
+        qint64 partSize = t.file->exists() ? t.file->size() : 0;
+        if (overwrite || partSize > f.size) {
+            t.file->remove();
+            partSize = 0;
+        }
+
+        if (!t.file->open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qWarning() << "Could not open" << t.file->fileName();
+            mFilesFailed++;
+            continue;
+        }
+
+        t.nextOffset = qint32(partSize);
+        t.writeOffset = qint32(partSize);
+        mBytesTotal += f.size - partSize;
+        mTransfers.append(t);
+    }
+
+    mTimer.start();
+
+    for (int i = 0;i < mTransfers.size();i++) {
+        if (mTransfers.at(i).writeOffset >= mTransfers.at(i).size) {
+            finishTransfer(i, true);
+        }
+    }
+
+    QEventLoop loop;
+    mLoop = &loop;
+    fillWindow();
+    if (mInFlight > 0) {
+        loop.exec();
+    }
+    mLoop = nullptr;
+
+    mTransfers.clear();
+
+    return mFilesFailed == 0 && !mCancelled;
+}
+
+/**
+ * @brief SdMirror::mirror
+ * Make localDir a copy of remoteDir, like rsync without deleting.
+ */
+bool SdMirror::mirror(QString remoteDir, QString localDir)
+{
+    QVector<Entry> files;
+    if (!listRecursive(remoteDir, files)) {
+        return false;
+    }
+
+    return download(files, remoteDir, localDir);
+}
+
+int SdMirror::filesSkipped() const
+{
+    return mFilesSkipped;
+}
+
+int SdMirror::filesDownloaded() const
+{
+    return mFilesDownloaded;
+}
+
+int SdMirror::filesFailed() const
+{
+    return mFilesFailed;
+}
+
+void SdMirror::fillWindow()
+{
+    if (mCancelled) {
+        return;
+    }
+
+    int maxFiles = mCommands->getSeqEnvelope() ? mWindow : 1;
+    int activeFiles = 0;
+
+    for (int i = 0;i < mTransfers.size() && mInFlight < mWindow;i++) {
+        Transfer &t = mTransfers[i];
+        if (t.done) {
+            continue;
+        }
+
+        if (activeFiles >= maxFiles) {
+            break;
+        }
+
+        activeFiles++;
+
+        // The read size is only known after the first reply
+        if (t.chunk <= 0) {
+            if (t.inFlight == 0) {
+                sendRead(i, t.nextOffset);
+            }
+            continue;
+        }
+
+        while (mInFlight < mWindow && t.nextOffset < t.size) {
+            sendRead(i, t.nextOffset);
+            t.nextOffset += t.chunk;
+        }
+    }
+}
+
+void SdMirror::sendRead(int ind, qint32 offset)
+{
+    mTransfers[ind].inFlight++;
+    mInFlight++;
+
+    mCommands->fileReadAsync(mTransfers.at(ind).remote, offset)->then([this, ind, offset](CommandRequest *req) {
+        readDone(ind, offset, req);
+    });
+}
+
+void SdMirror::readDone(int ind, qint32 offset, CommandRequest *req)
+{
+    Transfer &t = mTransfers[ind];
+    t.inFlight--;
+    mInFlight--;
+
+    if (!t.done) {
+        if (req->state() == CommandRequest::Cancelled) {
+            mCancelled = true;
+        }
+
+        if (!req->isOk()) {
+            finishTransfer(ind, false);
+        } else {
+            VByteArray vb(req->reply());
+            vb.vbPopFrontInt32();
+            qint32 size = vb.vbPopFrontInt32();
+
+            if (size != t.size || (vb.isEmpty() && offset < size)) {
+                qWarning() << "Unexpected reply when reading" << t.remote;
+                finishTransfer(ind, false);
+            } else {
+                if (t.chunk <= 0) {
+                    t.chunk = vb.size();
+                    t.nextOffset = offset + vb.size();
+                } else if (vb.size() < t.chunk && (offset + vb.size()) < size) {
+                    // Short read, get the rest separately
+                    sendRead(ind, offset + vb.size());
+                }
+
+                t.received.insert(offset, vb);
+                mBytesDone += vb.size();
+
+                while (t.received.contains(t.writeOffset)) {
+                    QByteArray data = t.received.take(t.writeOffset);
+                    t.file->write(data);
+                    t.writeOffset += data.size();
+                }
+
+                double elapsed = qMax(qint64(1), mTimer.elapsed());
+                emit progress(mBytesDone, mBytesTotal,
+                              mBytesTotal > 0 ? double(mBytesDone) / double(mBytesTotal) * 100.0 : 100.0,
+                              double(mBytesDone) / elapsed * 1000.0);
+
+                if (t.writeOffset >= t.size) {
+                    finishTransfer(ind, true);
+                }
+            }
+        }
+    }
+
+    fillWindow();
+
+    if (mInFlight == 0 && mLoop) {
+        mLoop->quit();
+    }
+}
+
+void SdMirror::finishTransfer(int ind, bool ok)
+{
+    Transfer &t = mTransfers[ind];
+    t.done = true;
+    t.received.clear();
+    t.file->close();
+
+    // The partial file is kept, so that the next run can continue from it
+    if (ok) {
+        QFile::remove(t.local);
+        ok = t.file->rename(t.local);
+    }
+
+    if (ok) {
+        mFilesDownloaded++;
+    } else {
+        mFilesFailed++;
+    }
+
+    emit fileDone(t.local, ok);
+}
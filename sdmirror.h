@@ -0,0 +1,102 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef SDMIRROR_H
+#define SDMIRROR_H
+
+#include <QObject>
+#include <QFile>
+#include <QMap>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QEventLoop>
+#include "commands.h"
+
+/*
+ * Copies files from the SD-card of the VESC with several reads in flight,
+ * instead of waiting for each reply before sending the next request. Files
+ * are downloaded to name.part first and renamed when they are complete, so
+ * that an interrupted transfer continues where it stopped the next time.
+ *
+ * Reads of different files can only be told apart with the sequence
+ * envelope, so without it the files are downloaded one at a time, with the
+ * reads of that file pipelined.
+ */
+class SdMirror : public QObject
+{
+    Q_OBJECT
+public:
+    struct Entry {
+        QString path;
+        qint32 size;
+    };
+
+    explicit SdMirror(Commands *commands, QObject *parent = nullptr);
+
+    void setWindow(int reads);
+    bool listRecursive(QString remoteDir, QVector<Entry> &files);
+    bool download(const QVector<Entry> &files, QString remoteDir, QString localDir,
+                  bool overwrite = false);
+    bool mirror(QString remoteDir, QString localDir);
+
+    int filesSkipped() const;
+    int filesDownloaded() const;
+    int filesFailed() const;
+
+signals:
+    void progress(qint64 bytesDone, qint64 bytesTotal, double percentage, double bytesPerSec);
+    void fileDone(QString localPath, bool ok);
+
+private:
+    struct Transfer {
+        QString remote;
+        QString local;
+        qint32 size;
+        qint32 chunk;
+        qint32 nextOffset;
+        qint32 writeOffset;
+        int inFlight;
+        bool done;
+        QSharedPointer<QFile> file;
+        QMap<qint32, QByteArray> received;
+    };
+
+    Commands *mCommands;
+    int mWindow;
+    int mFilesSkipped;
+    int mFilesDownloaded;
+    int mFilesFailed;
+    bool mCancelled;
+
+    QVector<Transfer> mTransfers;
+    int mInFlight;
+    qint64 mBytesDone;
+    qint64 mBytesTotal;
+    QElapsedTimer mTimer;
+    QEventLoop *mLoop;
+
+    void fillWindow();
+    void sendRead(int ind, qint32 offset);
+    void readDone(int ind, qint32 offset, CommandRequest *req);
+    void finishTransfer(int ind, bool ok);
+
+};
+
+#endif // SDMIRROR_H
@@ -0,0 +1,522 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "telemetrystreamer.h"
+#include "vbytearray.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QDateTime>
+#include <QMetaProperty>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QtEndian>
+#include <QDebug>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+void appendFloat64(VByteArray &vb, double number)
+{
+    quint64 bits;
+    memcpy(&bits, &number, 8);
+    vb.vbAppendUint32(quint32(bits >> 32));
+    vb.vbAppendUint32(quint32(bits));
+}
+}
+
+/*
+ * Writes to stdout from its own thread, so that a blocking write never
+ * holds up the event loop that does the polling.
+ */
+class TelemetryWriterThread : public QThread
+{
+public:
+    TelemetryWriterThread(qint64 maxBytes)
+    {
+        mMaxBytes = maxBytes;
+        mBytes = 0;
+        mStop = false;
+    }
+
+    bool enqueue(const QByteArray &data)
+    {
+        QMutexLocker locker(&mMutex);
+        if ((mBytes + data.size()) > mMaxBytes) {
+            return false;
+        }
+
+        mQueue.enqueue(data);
+        mBytes += data.size();
+        mCond.wakeOne();
+        return true;
+    }
+
+    void stop()
+    {
+        mMutex.lock();
+        mStop = true;
+        mCond.wakeOne();
+        mMutex.unlock();
+        wait();
+    }
+
+protected:
+    void run() override
+    {
+        for (;;) {
+            mMutex.lock();
+            while (mQueue.isEmpty() && !mStop) {
+                mCond.wait(&mMutex);
+            }
+
+            if (mQueue.isEmpty()) {
+                mMutex.unlock();
+                break;
+            }
+
+            QByteArray data = mQueue.dequeue();
+            mMutex.unlock();
+
+            fwrite(data.constData(), 1, size_t(data.size()), stdout);
+            fflush(stdout);
+
+            mMutex.lock();
+            mBytes -= data.size();
+            mMutex.unlock();
+        }
+    }
+
+private:
+    QMutex mMutex;
+    QWaitCondition mCond;
+    QQueue<QByteArray> mQueue;
+    qint64 mMaxBytes;
+    qint64 mBytes;
+    bool mStop;
+
+};
+
+TelemetryStreamer::TelemetryStreamer(VescInterface *vesc, QObject *parent) : QObject(parent)
+{
+    mVesc = vesc;
+    mBinary = false;
+    mMaxBufferedBytes = 1024 * 1024;
+    mStdoutWriter = nullptr;
+    mServer = nullptr;
+    mStdoutDropped = 0;
+    mDisconnectedDropped = 0;
+
+    for (int i = 0;i < SOURCE_NUM;i++) {
+        mSources[i].rateHz = 0.0;
+        mSources[i].timer = nullptr;
+        mSources[i].pending = false;
+        mSources[i].seq = 0;
+        mSources[i].dropped = 0;
+
+        if (i > 0) {
+            mSources[i].timer = new QTimer(this);
+            mSources[i].timer->setProperty("source", i);
+            connect(mSources[i].timer, SIGNAL(timeout()), this, SLOT(pollTimerSlot()));
+        }
+    }
+
+    auto c = mVesc->commands();
+
+    connect(c, &Commands::valuesReceived, this, [this](MC_VALUES val, unsigned int mask) {
+        (void)mask;
+        received(SOURCE_MC, &val);
+    });
+
+    connect(c, &Commands::valuesSetupReceived, this, [this](SETUP_VALUES val, unsigned int mask) {
+        (void)mask;
+        received(SOURCE_SETUP, &val);
+    });
+
+    connect(c, &Commands::valuesImuReceived, this, [this](IMU_VALUES val, unsigned int mask) {
+        (void)mask;
+        received(SOURCE_IMU, &val);
+    });
+
+    connect(c, &Commands::bmsValuesRx, this, [this](BMS_VALUES val) {
+        received(SOURCE_BMS, &val);
+    });
+
+    connect(c, &Commands::gnssRx, this, [this](GNSS_DATA val, unsigned int mask) {
+        (void)mask;
+        received(SOURCE_GNSS, &val);
+    });
+}
+
+TelemetryStreamer::~TelemetryStreamer()
+{
+    stop();
+}
+
+/**
+ * @brief TelemetryStreamer::setRates
+ * Set the poll rates.
+ *
+ * @param spec
+ * Comma separated source=rate pairs, e.g. mc=20,imu=50,gnss=5. The sources
+ * are mc, setup, imu, bms and gnss, and the rates are in Hz.
+ *
+ * @return
+ * false if spec could not be parsed.
+ */
+bool TelemetryStreamer::setRates(QString spec)
+{
+    for (auto s: spec.split(",")) {
+        if (s.trimmed().isEmpty()) {
+            continue;
+        }
+
+        auto p = s.split("=");
+        bool ok = false;
+        double rate = p.size() == 2 ? p.at(1).toDouble(&ok) : 0.0;
+
+        if (!ok || rate < 0.0 || rate > 1000.0) {
+            qWarning() << "Invalid telemetry rate:" << s;
+            return false;
+        }
+
+        int source = 0;
+        for (int i = 1;i < SOURCE_NUM;i++) {
+            if (sourceName(i) == p.at(0).trimmed().toLower()) {
+                source = i;
+            }
+        }
+
+        if (source == 0) {
+            qWarning() << "Invalid telemetry source:" << p.at(0);
+            return false;
+        }
+
+        mSources[source].rateHz = rate;
+    }
+
+    return true;
+}
+
+void TelemetryStreamer::setBinary(bool binary)
+{
+    mBinary = binary;
+}
+
+void TelemetryStreamer::setMaxBufferedBytes(qint64 bytes)
+{
+    mMaxBufferedBytes = bytes;
+}
+
+/**
+ * @brief TelemetryStreamer::start
+ * Start polling and writing records.
+ *
+ * @param socketPath
+ * Listen on this local socket, or write to stdout if it is empty.
+ *
+ * @return
+ * true on success.
+ */
+bool TelemetryStreamer::start(QString socketPath)
+{
+    stop();
+
+    QJsonObject schema;
+    for (int i = 1;i < SOURCE_NUM;i++) {
+        QJsonArray fields;
+        auto mo = sourceMetaObject(i);
+        for (int j = mo->propertyOffset();j < mo->propertyCount();j++) {
+            fields.append(QString(mo->property(j).name()));
+        }
+
+        QJsonObject src;
+        src.insert("name", sourceName(i));
+        src.insert("fields", fields);
+        schema.insert(QString::number(i), src);
+    }
+
+    QByteArray schemaJson = QJsonDocument(schema).toJson(QJsonDocument::Compact);
+    VByteArray schemaRec;
+    schemaRec.vbAppendUint32(quint32(schemaJson.size() + 1));
+    schemaRec.vbAppendUint8(0);
+    schemaRec.append(schemaJson);
+    mSchema = schemaRec;
+
+    if (socketPath.isEmpty()) {
+        mStdoutWriter = new TelemetryWriterThread(mMaxBufferedBytes);
+        mStdoutWriter->start();
+
+        if (mBinary) {
+            mStdoutWriter->enqueue(mSchema);
+        }
+    } else {
+        mServer = new QLocalServer(this);
+        QLocalServer::removeServer(socketPath);
+        if (!mServer->listen(socketPath)) {
+            qWarning() << "Could not listen on" << socketPath << mServer->errorString();
+            delete mServer;
+            mServer = nullptr;
+            return false;
+        }
+
+        connect(mServer, SIGNAL(newConnection()), this, SLOT(newSocketConnection()));
+    }
+
+    mStdoutDropped = 0;
+    mDisconnectedDropped = 0;
+    mClientDropped.clear();
+
+    for (int i = 1;i < SOURCE_NUM;i++) {
+        mSources[i].pending = false;
+        mSources[i].seq = 0;
+        mSources[i].dropped = 0;
+
+        if (mSources[i].rateHz > 0.0) {
+            mSources[i].timer->start(qMax(1, int(1000.0 / mSources[i].rateHz)));
+        }
+    }
+
+    return true;
+}
+
+void TelemetryStreamer::stop()
+{
+    for (int i = 1;i < SOURCE_NUM;i++) {
+        mSources[i].timer->stop();
+    }
+
+    if (mStdoutWriter) {
+        mStdoutWriter->stop();
+        delete mStdoutWriter;
+        mStdoutWriter = nullptr;
+    }
+
+    if (mServer) {
+        for (auto c: mClients) {
+            disconnect(c, nullptr, this, nullptr);
+            mDisconnectedDropped += mClientDropped.take(c);
+            c->disconnectFromServer();
+            c->deleteLater();
+        }
+        mClients.clear();
+
+        mServer->close();
+        mServer->deleteLater();
+        mServer = nullptr;
+    }
+}
+
+/**
+ * @brief TelemetryStreamer::droppedTotal
+ * @return
+ * Polls without reply, plus the records that were dropped for each consumer
+ * that did not keep up. A record that two consumers missed counts twice.
+ */
+qint64 TelemetryStreamer::droppedTotal() const
+{
+    qint64 res = mStdoutDropped + mDisconnectedDropped;
+    for (int i = 1;i < SOURCE_NUM;i++) {
+        res += mSources[i].dropped;
+    }
+    for (auto d: mClientDropped) {
+        res += d;
+    }
+    return res;
+}
+
+void TelemetryStreamer::pollTimerSlot()
+{
+    auto timer = qobject_cast<QTimer*>(sender());
+    if (!timer || !mVesc->isPortConnected()) {
+        return;
+    }
+
+    int source = timer->property("source").toInt();
+    auto &s = mSources[source];
+
+    // No reply to the previous poll, that sample is lost
+    if (s.pending) {
+        s.dropped++;
+    }
+
+    s.pending = true;
+
+    auto c = mVesc->commands();
+    switch (source) {
+    case SOURCE_MC: c->getValues(); break;
+    case SOURCE_SETUP: c->getValuesSetup(); break;
+    case SOURCE_IMU: c->getImuData(0xFFFF); break;
+    case SOURCE_BMS: c->bmsGetValues(); break;
+    case SOURCE_GNSS: c->getGnss(0xFFFF); break;
+    default: break;
+    }
+}
+
+void TelemetryStreamer::newSocketConnection()
+{
+    while (mServer && mServer->hasPendingConnections()) {
+        auto c = mServer->nextPendingConnection();
+        mClients.append(c);
+        mClientDropped.insert(c, 0);
+
+        connect(c, &QLocalSocket::disconnected, this, [this, c]() {
+            mClients.removeAll(c);
+            mDisconnectedDropped += mClientDropped.take(c);
+            c->deleteLater();
+        });
+
+        if (mBinary) {
+            c->write(mSchema);
+        }
+    }
+}
+
+QString TelemetryStreamer::sourceName(int source)
+{
+    switch (source) {
+    case SOURCE_MC: return "mc";
+    case SOURCE_SETUP: return "setup";
+    case SOURCE_IMU: return "imu";
+    case SOURCE_BMS: return "bms";
+    case SOURCE_GNSS: return "gnss";
+    default: return "";
+    }
+}
+
+const QMetaObject *TelemetryStreamer::sourceMetaObject(int source)
+{
+    switch (source) {
+    case SOURCE_MC: return &MC_VALUES::staticMetaObject;
+    case SOURCE_SETUP: return &SETUP_VALUES::staticMetaObject;
+    case SOURCE_IMU: return &IMU_VALUES::staticMetaObject;
+    case SOURCE_BMS: return &BMS_VALUES::staticMetaObject;
+    default: return &GNSS_DATA::staticMetaObject;
+    }
+}
+
+void TelemetryStreamer::received(int source, const void *gadget)
+{
+    auto &s = mSources[source];
+
+    // Only forward replies to our own polls, other parts of the program can
+    // request the same data.
+    if (!s.pending || (!mStdoutWriter && !mServer)) {
+        return;
+    }
+
+    s.pending = false;
+    s.seq++;
+    write(encodeRecord(source, gadget));
+}
+
+void TelemetryStreamer::write(const QByteArray &record)
+{
+    if (mStdoutWriter && !mStdoutWriter->enqueue(record)) {
+        mStdoutDropped++;
+    }
+
+    for (auto c: mClients) {
+        if ((c->bytesToWrite() + record.size()) > mMaxBufferedBytes) {
+            mClientDropped[c]++;
+        } else {
+            c->write(record);
+        }
+    }
+}
+
+QByteArray TelemetryStreamer::encodeRecord(int source, const void *gadget)
+{
+    const auto &s = mSources[source];
+    auto mo = sourceMetaObject(source);
+    qint64 timestamp = QDateTime::currentMSecsSinceEpoch();
+
+    if (mBinary) {
+        VByteArray vb;
+        vb.vbAppendUint32(0);
+        vb.vbAppendUint8(quint8(source));
+        vb.vbAppendUint32(quint32(quint64(timestamp) >> 32));
+        vb.vbAppendUint32(quint32(timestamp));
+        vb.vbAppendUint32(s.seq);
+        vb.vbAppendUint32(s.dropped);
+
+        for (int i = mo->propertyOffset();i < mo->propertyCount();i++) {
+            QVariant v = mo->property(i).readOnGadget(gadget);
+
+            if (v.userType() == qMetaTypeId<QVector<qreal>>()) {
+                auto vec = v.value<QVector<qreal>>();
+                vb.vbAppendUint16(quint16(vec.size()));
+                for (auto d: vec) {
+                    appendFloat64(vb, d);
+                }
+            } else if (v.userType() == qMetaTypeId<QVector<bool>>()) {
+                auto vec = v.value<QVector<bool>>();
+                vb.vbAppendUint16(quint16(vec.size()));
+                for (auto d: vec) {
+                    appendFloat64(vb, d ? 1.0 : 0.0);
+                }
+            } else if (v.type() == QVariant::String) {
+                QByteArray str = v.toString().toUtf8();
+                vb.vbAppendUint16(quint16(str.size()));
+                vb.append(str);
+            } else {
+                appendFloat64(vb, v.toDouble());
+            }
+        }
+
+        qToBigEndian<quint32>(quint32(vb.size() - 4), (uchar*)vb.data());
+        return vb;
+    }
+
+    QJsonObject data;
+    for (int i = mo->propertyOffset();i < mo->propertyCount();i++) {
+        auto prop = mo->property(i);
+        QVariant v = prop.readOnGadget(gadget);
+
+        if (v.userType() == qMetaTypeId<QVector<qreal>>()) {
+            QJsonArray arr;
+            for (auto d: v.value<QVector<qreal>>()) {
+                arr.append(d);
+            }
+            data.insert(prop.name(), arr);
+        } else if (v.userType() == qMetaTypeId<QVector<bool>>()) {
+            QJsonArray arr;
+            for (auto d: v.value<QVector<bool>>()) {
+                arr.append(d);
+            }
+            data.insert(prop.name(), arr);
+        } else if (v.type() == QVariant::String) {
+            data.insert(prop.name(), v.toString());
+        } else {
+            data.insert(prop.name(), v.toDouble());
+        }
+    }
+
+    QJsonObject rec;
+    rec.insert("type", sourceName(source));
+    rec.insert("t", double(timestamp));
+    rec.insert("seq", double(s.seq));
+    rec.insert("dropped", double(s.dropped));
+    rec.insert("data", data);
+
+    return QJsonDocument(rec).toJson(QJsonDocument::Compact) + "\n";
+}
@@ -0,0 +1,108 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef TELEMETRYSTREAMER_H
+#define TELEMETRYSTREAMER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMetaObject>
+#include <QHash>
+#include "vescinterface.h"
+
+class TelemetryWriterThread;
+
+/*
+ * Polls telemetry from the connected VESC at a fixed rate per source and
+ * writes every reply as a record to stdout or to the clients of a local
+ * socket. Records are either NDJSON or binary:
+ *
+ * length (u32) | type (u8) | timestamp ms (u64) | seq (u32) | dropped (u32) | fields
+ *
+ * where length counts the bytes after itself. The fields are in the order
+ * given by the schema record that is written first, which is just length,
+ * type 0 and a JSON object that maps type ids to field names. Numbers are
+ * float64, strings and arrays have a u16 count in front. All integers are
+ * big endian.
+ *
+ * dropped counts the polls of the source that got no reply. Output is
+ * buffered up to a fixed size per consumer. When a consumer does not keep
+ * up, records are dropped for that consumer only, which it sees as a gap in
+ * seq, and counted per consumer instead of stalling the polling.
+ */
+class TelemetryStreamer : public QObject
+{
+    Q_OBJECT
+public:
+    enum Source {
+        SOURCE_MC = 1,
+        SOURCE_SETUP,
+        SOURCE_IMU,
+        SOURCE_BMS,
+        SOURCE_GNSS,
+        SOURCE_NUM
+    };
+
+    explicit TelemetryStreamer(VescInterface *vesc, QObject *parent = nullptr);
+    ~TelemetryStreamer();
+
+    bool setRates(QString spec);
+    void setBinary(bool binary);
+    void setMaxBufferedBytes(qint64 bytes);
+    bool start(QString socketPath = "");
+    void stop();
+
+    qint64 droppedTotal() const;
+
+private slots:
+    void pollTimerSlot();
+    void newSocketConnection();
+
+private:
+    struct SourceState {
+        double rateHz;
+        QTimer *timer;
+        bool pending;
+        quint32 seq;
+        quint32 dropped;
+    };
+
+    VescInterface *mVesc;
+    SourceState mSources[SOURCE_NUM];
+    bool mBinary;
+    qint64 mMaxBufferedBytes;
+    TelemetryWriterThread *mStdoutWriter;
+    QLocalServer *mServer;
+    QList<QLocalSocket*> mClients;
+    QHash<QLocalSocket*, qint64> mClientDropped;
+    qint64 mStdoutDropped;
+    qint64 mDisconnectedDropped;
+    QByteArray mSchema;
+
+    static QString sourceName(int source);
+    static const QMetaObject *sourceMetaObject(int source);
+    void received(int source, const void *gadget);
+    void write(const QByteArray &record);
+    QByteArray encodeRecord(int source, const void *gadget);
+
+};
+
+#endif // TELEMETRYSTREAMER_H
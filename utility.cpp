@@ -18,6 +18,9 @@
     */
 
 #include "utility.h"
+#include "canfleetexecutor.h"
+#include "focdetectrunner.h"
+#include "firmwarecatalog.h"
 #ifdef Q_OS_IOS
 #include "ios/src/setIosParameters.h"
 #endif
@@ -35,10 +38,13 @@
 #include <QFileInfo>
 #include <QtGlobal>
 #include <QNetworkInterface>
-#include <QDirIterator>
 #include <QPixmapCache>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
 
 #include "maddy/parser.h"
+#include "lzokay/lzokay.hpp"
 
 #ifdef Q_OS_ANDROID
 #include <QtAndroid>
@@ -409,6 +415,50 @@ void Utility::sleepWithEventLoop(int timeMs)
     QObject::disconnect(conn1);
 }
 
+static QString detectAllFocReason(int res)
+{
+    QString reason;
+    switch (res) {
+    case -1: reason = "Peristent fault, check realtime data page"; break;
+    case -10: reason = "Flux linkage detection failed"; break;
+    case -50: reason = "CAN detection timeout"; break;
+    case -51: reason = "CAN detection failed"; break;
+    case -100 + FAULT_CODE_NONE: reason = "No fault, detection failed for an unknown reason"; break;
+    case -100 + FAULT_CODE_OVER_VOLTAGE: reason = "Over voltage fault, check voltage is below set limit"; break;
+    case -100 + FAULT_CODE_UNDER_VOLTAGE: reason = "Under voltage fault, check voltage is above set limit. If using a power supply make sure the current limit is high enough."; break;
+    case -100 + FAULT_CODE_DRV: reason = "DRV fault, hardware fault occured. Check there are no shorts"; break;
+    case -100 + FAULT_CODE_ABS_OVER_CURRENT: reason = "Overcurrent fault, Check there are no shorts and ABS Overcurrent limit is sensible"; break;
+    case -100 + FAULT_CODE_OVER_TEMP_FET: reason = "Mosfet Overtemperature fault, Mosfets overheated, check for shorts. Cool down device"; break;
+    case -100 + FAULT_CODE_OVER_TEMP_MOTOR: reason = "Motor Overtemperature fault, Motor overheated, is the current limit OK?"; break;
+    case -100 + FAULT_CODE_GATE_DRIVER_OVER_VOLTAGE: reason = "Gate Driver over voltage, check for hardware failure"; break;
+    case -100 + FAULT_CODE_GATE_DRIVER_UNDER_VOLTAGE: reason = "Gate Driver under voltage, check for hardware failure"; break;
+    case -100 + FAULT_CODE_MCU_UNDER_VOLTAGE: reason = "MCU under voltage, check for hardware failure, shorts on outputs"; break;
+    case -100 + FAULT_CODE_BOOTING_FROM_WATCHDOG_RESET: reason = "Boot from watchdog reset, software locked up check for firmware corruption"; break;
+    case -100 + FAULT_CODE_ENCODER_SPI: reason = "Encoder SPI fault, check encoder connections"; break;
+    case -100 + FAULT_CODE_ENCODER_SINCOS_BELOW_MIN_AMPLITUDE: reason = "Encoder SINCOS below min amplitude, check encoder connections and magnet alignment / distance"; break;
+    case -100 + FAULT_CODE_ENCODER_SINCOS_ABOVE_MAX_AMPLITUDE: reason = "Encoder SINCOS above max amplitude, check encoder connections and magnet alignment / distance"; break;
+    case -100 + FAULT_CODE_FLASH_CORRUPTION: reason = "Flash corruption, reflash firmware immediately!"; break;
+    case -100 + FAULT_CODE_HIGH_OFFSET_CURRENT_SENSOR_1: reason = "High offset on current sensor 1, check for hardware failure"; break;
+    case -100 + FAULT_CODE_HIGH_OFFSET_CURRENT_SENSOR_2: reason = "High offset on current sensor 2, check for hardware failure"; break;
+    case -100 + FAULT_CODE_HIGH_OFFSET_CURRENT_SENSOR_3: reason = "High offset on current sensor 3, check for hardware failure"; break;
+    case -100 + FAULT_CODE_UNBALANCED_CURRENTS: reason = "Unbalanced currents, check for hardware failure"; break;
+    case -100 + FAULT_CODE_BRK: reason = "BRK, hardware protection triggered, check for shorts or possible hardware failure"; break;
+    case -100 + FAULT_CODE_RESOLVER_LOT: reason = "Encoder/Resolver: Loss of tracking"; break;
+    case -100 + FAULT_CODE_RESOLVER_DOS: reason = "Encoder/Resolver: Degradation of signal"; break;
+    case -100 + FAULT_CODE_RESOLVER_LOS: reason = "Encoder/Resolver: Loss of signal"; break;
+    case -100 + FAULT_CODE_FLASH_CORRUPTION_APP_CFG: reason = "Flash corruption, App config corrupt, rewrite app config to restore"; break;
+    case -100 + FAULT_CODE_FLASH_CORRUPTION_MC_CFG: reason = "Flash corruption, Motor config corrupt, rewrite motor config to restore"; break;
+    case -100 + FAULT_CODE_ENCODER_NO_MAGNET: reason = "Encoder no magnet, magnet is too weak or too far from the encoder"; break;
+    case -100 + FAULT_CODE_ENCODER_MAGNET_TOO_STRONG: reason = "Magnet too strong, magnet is too strong or too close to the encoder"; break;
+    case -100 + FAULT_CODE_PHASE_FILTER: reason = "Phase filter fault, invalid phase filter readings"; break;
+    case -100 + FAULT_CODE_ENCODER_FAULT: reason = "Encoder fault, check encoder connections and alignment"; break;
+
+    default: reason = QString::number(res); break;
+    }
+
+    return reason;
+}
+
 QString Utility::detectAllFoc(VescInterface *vesc,
                               bool detect_can, double max_power_loss, double min_current_in,
                               double max_current_in, double openloop_rpm, double sl_erpm)
@@ -419,167 +469,135 @@ QString Utility::detectAllFoc(VescInterface *vesc,
     vesc->commands()->disableAppOutput(180000, true);
     Utility::sleepWithEventLoop(100);
 
-    vesc->commands()->detectAllFoc(detect_can, max_power_loss, min_current_in,
-                                   max_current_in, openloop_rpm, sl_erpm);
-
-    QEventLoop loop;
-    QTimer timeoutTimer;
-    QTimer pollTimer;
-    timeoutTimer.setSingleShot(true);
-    timeoutTimer.start(180000);
-    pollTimer.start(100);
-
-    int resDetect = 0;
-    auto conn = connect(vesc->commands(), &Commands::detectAllFocReceived,
-                        [&resDetect, &loop](int result) {
-        resDetect = result;
-        loop.quit();
-    });
+    QVector<int> canIds;
+    if (detect_can) {
+        canIds.append(-1);
+        canIds.append(Utility::scanCanVescOnly(vesc));
+    } else {
+        canIds.append(vesc->commands()->getSendCan() ? vesc->commands()->getCanSendId() : -1);
+    }
 
-    QString pollRes;
-    auto conn2 = connect(&pollTimer, &QTimer::timeout,
-                        [&pollRes, &loop, &vesc]() {
-        if (!vesc->isPortConnected()) {
-            pollRes = "VESC disconnected during detection.";
-            loop.quit();
+    // The configurations of the nodes are read back while other nodes may
+    // still be detecting, so all of them are checked before starting.
+    for (int id: canIds) {
+        if (id < 0) {
+            continue;
         }
-    });
 
-    connect(&timeoutTimer, SIGNAL(timeout()), &loop, SLOT(quit()));
-    loop.exec();
-
-    disconnect(conn);
-    disconnect(conn2);
+        vesc->canTmpOverride(true, id);
+        bool compatible = checkFwCompatibility(vesc);
+        vesc->canTmpOverrideEnd();
 
-    if (timeoutTimer.isActive() && pollRes.isEmpty()) {
-        if (resDetect >= 0) {
-            ConfigParams *p = vesc->mcConfig();
-            ConfigParams *ap = vesc->appConfig();
+        if (!compatible) {
+            vesc->emitMessageDialog("FW Versions",
+                                    "All VESCs must have the latest firmware to perform this operation.",
+                                    false, false);
+            vesc->commands()->disableAppOutput(0, true);
+            return QString("Detection not started. VESC %1 does not have the latest firmware.").arg(id);
+        }
+    }
 
-            // MCConf should have been sent after the detection
-            vesc->commands()->getAppConf();
-            waitSignal(ap, SIGNAL(updated()), 4000);
-
-            auto genRes = [&p, &ap]() {
-                QString sensors;
-                switch (p->getParamEnum("foc_sensor_mode")) {
-                case 0: sensors = "Sensorless"; break;
-                case 1: sensors = "Encoder"; break;
-                case 2: sensors = "Hall Sensors"; break;
-                default: break; }
-                return QString("VESC ID            : %1\n"
-                               "Motor current      : %2 A\n"
-                               "Motor R            : %3 mΩ\n"
-                               "Motor L            : %4 µH\n"
-                               "Motor Lq-Ld        : %5 µH\n"
-                               "Motor Flux Linkage : %6 mWb\n"
-                               "Temp Comp          : %7\n"
-                               "Sensors            : %8").
-                        arg(ap->getParamInt("controller_id")).
-                        arg(p->getParamDouble("l_current_max"), 0, 'f', 2).
-                        arg(p->getParamDouble("foc_motor_r") * 1e3, 0, 'f', 2).
-                        arg(p->getParamDouble("foc_motor_l") * 1e6, 0, 'f', 2).
-                        arg(p->getParamDouble("foc_motor_ld_lq_diff") * 1e6, 0, 'f', 2).
-                        arg(p->getParamDouble("foc_motor_flux_linkage") * 1e3, 0, 'f', 2).
-                        arg(p->getParamBool("foc_temp_comp") ? "True" : "False").
-                        arg(sensors);
-            };
-
-            QVector<int> canDevs;
-            if (detect_can) {
-                if (!vesc->commands()->getSendCan()) {
-                    res = genRes();
-                }
+    FocDetectParams params;
+    params.maxPowerLoss = max_power_loss;
+    params.minCurrentIn = min_current_in;
+    params.maxCurrentIn = max_current_in;
+    params.openloopRpm = openloop_rpm;
+    params.slErpm = sl_erpm;
 
-                canDevs = Utility::scanCanVescOnly(vesc);
-            } else {
-                res = genRes();
-            }
+    // Each controller detects its own motor. With the sequence envelope all
+    // of them are started at once and read back as they finish, otherwise
+    // the firmware runs the detection on the bus and they are read one by one.
+    FocDetectVescBackend backend(vesc);
+    FocDetectRunner runner(&backend);
 
-            int canLastFwd = vesc->commands()->getSendCan();
-            int canLastId = vesc->commands()->getCanSendId();
-            vesc->ignoreCanChange(true);
+    auto conn = connect(vesc, &VescInterface::portConnectedChanged, [vesc, &runner]() {
+        if (!vesc->isPortConnected()) {
+            runner.cancel();
+        }
+    });
 
-            if (!canDevs.empty()) {
-                res += "\n\nVESCs on CAN-bus:";
-            }
+    runner.run(canIds, params);
+    disconnect(conn);
 
-            for (int id: canDevs) {
-                vesc->commands()->setSendCan(true, id);
-                if (!checkFwCompatibility(vesc)) {
-                    vesc->emitMessageDialog("FW Versions",
-                                            "All VESCs must have the latest firmware to perform this operation.",
-                                            false, false);
-                    break;
-                }
+    auto genRes = [](const FocDetectValues &v) {
+        QString sensors;
+        switch (v.sensorMode) {
+        case 0: sensors = "Sensorless"; break;
+        case 1: sensors = "Encoder"; break;
+        case 2: sensors = "Hall Sensors"; break;
+        default: break; }
+        return QString("VESC ID            : %1\n"
+                       "Motor current      : %2 A\n"
+                       "Motor R            : %3 mΩ\n"
+                       "Motor L            : %4 µH\n"
+                       "Motor Lq-Ld        : %5 µH\n"
+                       "Motor Flux Linkage : %6 mWb\n"
+                       "Temp Comp          : %7\n"
+                       "Sensors            : %8").
+                arg(v.controllerId).
+                arg(v.currentMax, 0, 'f', 2).
+                arg(v.r * 1e3, 0, 'f', 2).
+                arg(v.l * 1e6, 0, 'f', 2).
+                arg(v.ldLqDiff * 1e6, 0, 'f', 2).
+                arg(v.fluxLinkage * 1e3, 0, 'f', 2).
+                arg(v.tempComp ? "True" : "False").
+                arg(sensors);
+    };
 
-                vesc->commands()->getMcconf();
-                waitSignal(p, SIGNAL(updated()), 4000);
-                vesc->commands()->getAppConf();
-                waitSignal(ap, SIGNAL(updated()), 4000);
-                res += "\n\n" + genRes();
-            }
+    // Every node is reported, so that the ones that succeeded do not have to
+    // be detected again because another node failed.
+    auto nodes = runner.nodes();
+    for (int i = 0;i < nodes.size();i++) {
+        const auto &n = nodes.at(i);
+        QString node = nodes.size() > 1 ?
+                    (n.canId < 0 ? " on the local VESC" : QString(" on VESC %1").arg(n.canId)) : "";
 
-            vesc->commands()->setSendCan(canLastFwd, canLastId);
-            vesc->ignoreCanChange(false);
-            vesc->commands()->getMcconf();
-            waitSignal(p, SIGNAL(updated()), 4000);
-            vesc->commands()->getAppConf();
-            waitSignal(ap, SIGNAL(updated()), 4000);
-        } else {
-            QString reason;
-            switch (resDetect) {
-            case -1: reason = "Peristent fault, check realtime data page"; break;
-            case -10: reason = "Flux linkage detection failed"; break;
-            case -50: reason = "CAN detection timeout"; break;
-            case -51: reason = "CAN detection failed"; break;
-            case -100 + FAULT_CODE_NONE: reason = "No fault, detection failed for an unknown reason"; break;
-            case -100 + FAULT_CODE_OVER_VOLTAGE: reason = "Over voltage fault, check voltage is below set limit"; break;
-            case -100 + FAULT_CODE_UNDER_VOLTAGE: reason = "Under voltage fault, check voltage is above set limit. If using a power supply make sure the current limit is high enough."; break;
-            case -100 + FAULT_CODE_DRV: reason = "DRV fault, hardware fault occured. Check there are no shorts"; break;
-            case -100 + FAULT_CODE_ABS_OVER_CURRENT: reason = "Overcurrent fault, Check there are no shorts and ABS Overcurrent limit is sensible"; break;
-            case -100 + FAULT_CODE_OVER_TEMP_FET: reason = "Mosfet Overtemperature fault, Mosfets overheated, check for shorts. Cool down device"; break;
-            case -100 + FAULT_CODE_OVER_TEMP_MOTOR: reason = "Motor Overtemperature fault, Motor overheated, is the current limit OK?"; break;
-            case -100 + FAULT_CODE_GATE_DRIVER_OVER_VOLTAGE: reason = "Gate Driver over voltage, check for hardware failure"; break;
-            case -100 + FAULT_CODE_GATE_DRIVER_UNDER_VOLTAGE: reason = "Gate Driver under voltage, check for hardware failure"; break;
-            case -100 + FAULT_CODE_MCU_UNDER_VOLTAGE: reason = "MCU under voltage, check for hardware failure, shorts on outputs"; break;
-            case -100 + FAULT_CODE_BOOTING_FROM_WATCHDOG_RESET: reason = "Boot from watchdog reset, software locked up check for firmware corruption"; break;
-            case -100 + FAULT_CODE_ENCODER_SPI: reason = "Encoder SPI fault, check encoder connections"; break;
-            case -100 + FAULT_CODE_ENCODER_SINCOS_BELOW_MIN_AMPLITUDE: reason = "Encoder SINCOS below min amplitude, check encoder connections and magnet alignment / distance"; break;
-            case -100 + FAULT_CODE_ENCODER_SINCOS_ABOVE_MAX_AMPLITUDE: reason = "Encoder SINCOS above max amplitude, check encoder connections and magnet alignment / distance"; break;
-            case -100 + FAULT_CODE_FLASH_CORRUPTION: reason = "Flash corruption, reflash firmware immediately!"; break;
-            case -100 + FAULT_CODE_HIGH_OFFSET_CURRENT_SENSOR_1: reason = "High offset on current sensor 1, check for hardware failure"; break;
-            case -100 + FAULT_CODE_HIGH_OFFSET_CURRENT_SENSOR_2: reason = "High offset on current sensor 2, check for hardware failure"; break;
-            case -100 + FAULT_CODE_HIGH_OFFSET_CURRENT_SENSOR_3: reason = "High offset on current sensor 3, check for hardware failure"; break;
-            case -100 + FAULT_CODE_UNBALANCED_CURRENTS: reason = "Unbalanced currents, check for hardware failure"; break;
-            case -100 + FAULT_CODE_BRK: reason = "BRK, hardware protection triggered, check for shorts or possible hardware failure"; break;
-            case -100 + FAULT_CODE_RESOLVER_LOT: reason = "Encoder/Resolver: Loss of tracking"; break;
-            case -100 + FAULT_CODE_RESOLVER_DOS: reason = "Encoder/Resolver: Degradation of signal"; break;
-            case -100 + FAULT_CODE_RESOLVER_LOS: reason = "Encoder/Resolver: Loss of signal"; break;
-            case -100 + FAULT_CODE_FLASH_CORRUPTION_APP_CFG: reason = "Flash corruption, App config corrupt, rewrite app config to restore"; break;
-            case -100 + FAULT_CODE_FLASH_CORRUPTION_MC_CFG: reason = "Flash corruption, Motor config corrupt, rewrite motor config to restore"; break;
-            case -100 + FAULT_CODE_ENCODER_NO_MAGNET: reason = "Encoder no magnet, magnet is too weak or too far from the encoder"; break;
-            case -100 + FAULT_CODE_ENCODER_MAGNET_TOO_STRONG: reason = "Magnet too strong, magnet is too strong or too close to the encoder"; break;
-            case -100 + FAULT_CODE_PHASE_FILTER: reason = "Phase filter fault, invalid phase filter readings"; break;
-            case -100 + FAULT_CODE_ENCODER_FAULT: reason = "Encoder fault, check encoder connections and alignment"; break;
-
-            default: reason = QString::number(resDetect); break;
-            }
+        if (i == 1) {
+            res += "\n\nVESCs on CAN-bus:";
+        }
 
-            res = QString("Detection failed. Reason:\n%1").arg(reason);
-            detectOk = false;
+        if (i > 0) {
+            res += "\n\n";
         }
-    } else {
-        if (!pollRes.isEmpty()) {
-            res = QString("Detection failed. Reason:\n%1").arg(pollRes);
+
+        if (!vesc->isPortConnected()) {
+            res += "Detection failed. Reason:\nVESC disconnected during detection.";
+        } else if (!n.detectReplied) {
+            res += QString("Detection timed out%1.").arg(node);
+        } else if (n.result < 0) {
+            res += QString("Detection failed%1. Reason:\n%2").arg(node, detectAllFocReason(n.result));
+        } else if (!n.readOk) {
+            res += QString("Could not read the configuration%1. All VESCs must "
+                           "have the latest firmware to perform this operation.").arg(node);
         } else {
-            res = "Detection timed out.";
+            res += genRes(n.values);
+            continue;
         }
+
         detectOk = false;
+
+        if (!vesc->isPortConnected()) {
+            break;
+        }
     }
 
     if (detectOk) {
         res.prepend("Success!\n\n");
+    } else if (nodes.size() > 1) {
+        res.prepend("Detection did not succeed on all VESCs.\n\n");
+    }
+
+    if (nodes.size() > 1) {
+        res += "\n\nTimeline (D: detection, R: reading results):\n" + runner.timelineText();
+    }
+
+    // The replies from the other nodes were loaded into the configuration
+    // as well, read back the one of the selected VESC.
+    if (vesc->isPortConnected()) {
+        vesc->commands()->getMcconf();
+        waitSignal(vesc->mcConfig(), SIGNAL(updated()), 4000);
+        vesc->commands()->getAppConf();
+        waitSignal(vesc->appConfig(), SIGNAL(updated()), 4000);
     }
 
     vesc->commands()->disableAppOutput(0, true);
@@ -589,20 +607,9 @@ QString Utility::detectAllFoc(VescInterface *vesc,
 
 QVector<double> Utility::measureRLBlocking(VescInterface *vesc)
 {
-    QVector<double> res;
-
-    vesc->commands()->measureRL();
-
-    auto conn = connect(vesc->commands(), &Commands::motorRLReceived, [&res](double r, double l, double ld_lq_diff) {
-        res.append(r);
-        res.append(l);
-        res.append(ld_lq_diff);
-    });
-
-    waitSignal(vesc->commands(), SIGNAL(motorRLReceived(double, double, double)), 8000);
-    disconnect(conn);
-
-    return res;
+    auto req = vesc->commands()->measureRLAsync();
+    req->wait();
+    return req->result().value<QVector<double>>();
 }
 
 double Utility::measureLinkageOpenloopBlocking(VescInterface *vesc, double current,
@@ -677,22 +684,17 @@ bool Utility::waitMotorStop(VescInterface *vesc, double erpmTres, int timeoutMs)
 bool Utility::resetInputCan(VescInterface *vesc, QVector<int> canIds)
 {
     bool res = true;
+    ConfigParams *ap = vesc->appConfig();
 
-    bool canLastFwd = vesc->commands()->getSendCan();
-    int canLastId = vesc->commands()->getCanSendId();
-
-    vesc->ignoreCanChange(true);
-
-    auto update = [vesc]() {
+    auto prepare = [vesc, ap](int canId, QVector<QByteArray> &writes) {
+        (void)canId;
         bool res = true;
-        ConfigParams *ap = vesc->appConfig();
 
         if (isConnectedToHwVesc(vesc)) {
             if (!checkFwCompatibility(vesc)) {
                 vesc->emitMessageDialog("FW Versions",
                                         "All VESCs must have the latest firmware to perform this operation.",
                                         false, false);
-                res = false;
                 qWarning() << "Incompatible firmware";
                 return false;
             }
@@ -733,47 +735,34 @@ bool Utility::resetInputCan(VescInterface *vesc, QVector<int> canIds)
                 ap->updateParamEnum("send_can_status", canStatus);
             }
 
-            vesc->commands()->setAppConf();
-            res = waitSignal(vesc->commands(), SIGNAL(ackReceived(QString)), 4000);
-
-            if (!res) {
-                qWarning() << "Appconf set no ack received";
-                return false;
-            }
+            VByteArray vb;
+            vb.vbAppendInt8(COMM_SET_APPCONF);
+            ap->serialize(vb);
+            writes.append(vb);
         }
 
         return res;
     };
 
-    // Local VESC first
-    vesc->commands()->setSendCan(false);
-    res = update();
+    // Local VESC first, then all VESCs on CAN-bus
+    QVector<int> ids = canIds;
+    ids.prepend(-1);
 
-    // All VESCs on CAN-bus
-    if (res) {
-        for (int id: canIds) {
-            vesc->commands()->setSendCan(true, id);
+    CanFleetExecutor fleet(vesc);
+    res = fleet.run(ids, prepare);
 
-            res = update();
-            if (!res) {
-                break;
-            }
-        }
+    if (!res) {
+        qWarning() << "Appconf set failed on" << fleet.failedIds();
     }
 
-    vesc->commands()->setSendCan(canLastFwd, canLastId);
-
     if (isConnectedToHwVesc(vesc)) {
         vesc->commands()->getAppConf();
-        ConfigParams *ap = vesc->appConfig();
         if (!waitSignal(ap, SIGNAL(updated()), 4000)) {
             qWarning() << "Appconf not received";
             res = false;
         }
     }
 
-    vesc->ignoreCanChange(false);
-
     return res;
 }
 
@@ -851,7 +840,13 @@ bool Utility::setMcParamsFromCurrentConfigAllCan(VescInterface *vesc, QVector<in
         paramVec.append(qMakePair(s, config->getParamCopy(s)));
     }
 
-    auto updateConf = [&vesc, &config, &paramVec]() {
+    auto prepare = [&vesc, &config, &paramVec](int canId, QVector<QByteArray> &writes) {
+        (void)canId;
+
+        if (!isConnectedToHwVesc(vesc)) {
+            return true;
+        }
+
         if (!checkFwCompatibility(vesc)) {
             vesc->emitMessageDialog("FW Versions",
                                     "All VESCs must have the latest firmware to perform this operation.",
@@ -873,42 +868,27 @@ bool Utility::setMcParamsFromCurrentConfigAllCan(VescInterface *vesc, QVector<in
             config->updateParamFromOther(p.first, p.second, nullptr);
         }
 
-        vesc->commands()->setMcconf(false);
-
-        if (!waitSignal(vesc->commands(), SIGNAL(ackReceived(QString)), 4000)) {
-            vesc->emitMessageDialog("Write Motor Configuration",
-                                    "Could not write motor configuration.",
-                                    false, false);
-
-            return false;
-        }
+        VByteArray vb;
+        vb.vbAppendInt8(COMM_SET_MCCONF);
+        config->serialize(vb);
+        writes.append(vb);
 
         return true;
     };
 
-    // Start with local VESC
-    vesc->canTmpOverride(false, 0);
-
-    if (isConnectedToHwVesc(vesc)) {
-        res = updateConf();
-    }
+    // Start with local VESC, then every VESC on the CAN-bus
+    QVector<int> ids = canIds;
+    ids.prepend(-1);
 
-    // Now every VESC on the CAN-bus
-    if (res) {
-        for (int id: canIds) {
-            vesc->canTmpOverride(true, id);
+    CanFleetExecutor fleet(vesc);
+    res = fleet.run(ids, prepare);
 
-            if (isConnectedToHwVesc(vesc)) {
-                res = updateConf();
-                if (!res) {
-                    break;
-                }
-            }
-        }
+    if (!res && !fleet.failedIds().isEmpty()) {
+        vesc->emitMessageDialog("Write Motor Configuration",
+                                "Could not write motor configuration.",
+                                false, false);
     }
 
-    vesc->canTmpOverrideEnd();
-
     vesc->commands()->getMcconf();
     if (!waitSignal(config, SIGNAL(updated()), 4000)) {
         res = false;
@@ -950,8 +930,10 @@ bool Utility::setInvertDirection(VescInterface *vesc, int canId, bool inverted)
 
     if (res) {
         p->updateParamBool("m_invert_direction", inverted);
-        vesc->commands()->setMcconf(false);
-        res = waitSignal(vesc->commands(), SIGNAL(ackReceived(QString)), 4000);
+        // Nothing is written when the direction already was as requested
+        if (!vesc->commands()->setMcconfDelta(false).isEmpty()) {
+            res = waitSignal(vesc->commands(), SIGNAL(ackReceived(QString)), 4000);
+        }
     }
 
     vesc->commands()->setSendCan(canLastFwd, canLastId);
@@ -1068,14 +1050,9 @@ bool Utility::restoreConfAll(VescInterface *vesc, bool can, bool mc, bool app)
 {
     bool res = true;
 
-    bool canLastFwd = vesc->commands()->getSendCan();
-    int canLastId = vesc->commands()->getCanSendId();
+    auto prepare = [mc, app, vesc](int canId, QVector<QByteArray> &writes) {
+        (void)canId;
 
-    vesc->ignoreCanChange(true);
-    vesc->commands()->setSendCan(false);
-
-    auto update = [mc, app, vesc]() {
-        bool res = true;
         if (!isConnectedToHwVesc(vesc)) {
             return true;
         }
@@ -1090,48 +1067,41 @@ bool Utility::restoreConfAll(VescInterface *vesc, bool can, bool mc, bool app)
         if (mc) {
             ConfigParams *p = vesc->mcConfig();
             vesc->commands()->getMcconfDefault();
-            res = waitSignal(p, SIGNAL(updated()), 4000);
-
-            if (res) {
-                vesc->commands()->setMcconf(false);
-                res = waitSignal(vesc->commands(), SIGNAL(ackReceived(QString)), 4000);
-            } else {
+            if (!waitSignal(p, SIGNAL(updated()), 4000)) {
                 return false;
             }
+
+            VByteArray vb;
+            vb.vbAppendInt8(COMM_SET_MCCONF);
+            p->serialize(vb);
+            writes.append(vb);
         }
 
         if (app) {
             ConfigParams *p = vesc->appConfig();
             vesc->commands()->getAppConfDefault();
-            res = waitSignal(p, SIGNAL(updated()), 4000);
-
-            if (res) {
-                vesc->commands()->setAppConf();
-                res = waitSignal(vesc->commands(), SIGNAL(ackReceived(QString)), 4000);
-            } else {
+            if (!waitSignal(p, SIGNAL(updated()), 4000)) {
                 return false;
             }
+
+            VByteArray vb;
+            vb.vbAppendInt8(COMM_SET_APPCONF);
+            p->serialize(vb);
+            writes.append(vb);
         }
 
-        return res;
+        return true;
     };
 
-    res = update();
-
-    if (res && can) {
-        QVector<int> canDevs = Utility::scanCanVescOnly(vesc);
+    QVector<int> ids;
+    ids.append(-1);
 
-        for (int d: canDevs) {
-            vesc->commands()->setSendCan(true, d);
-            res = update();
-            if (!res) {
-                break;
-            }
-        }
+    if (can) {
+        ids.append(Utility::scanCanVescOnly(vesc));
     }
 
-    vesc->commands()->setSendCan(canLastFwd, canLastId);
-    vesc->ignoreCanChange(false);
+    CanFleetExecutor fleet(vesc);
+    res = fleet.run(ids, prepare);
 
     if (can) {
         if (!isConnectedToHwVesc(vesc)) {
@@ -1508,20 +1478,9 @@ FW_RX_PARAMS Utility::getFwVersionBlockingCan(VescInterface *vesc, int canId)
 
 MC_VALUES Utility::getMcValuesBlocking(VescInterface *vesc)
 {
-    MC_VALUES res;
-
-    auto conn = connect(vesc->commands(), &Commands::valuesReceived,
-                        [&](MC_VALUES val, unsigned int mask) {
-            (void)mask;
-            res = val;
-    });
-
-    vesc->commands()->getValues();
-    waitSignal(vesc->commands(), SIGNAL(valuesReceived(MC_VALUES, unsigned int)), 4000);
-
-    disconnect(conn);
-
-    return res;
+    auto req = vesc->commands()->getValuesAsync();
+    req->wait();
+    return req->isOk() ? req->result().value<MC_VALUES>() : MC_VALUES();
 }
 
 bool Utility::checkFwCompatibility(VescInterface *vesc)
@@ -1718,88 +1677,76 @@ double Utility::distLlhToLlh(double lat, double lon, double height,
     return sqrt(SQ(x - x2) + SQ(y - y2) + SQ(z - z2));
 }
 
-bool Utility::configCheckCompatibility(int fwMajor, int fwMinor)
-{
-    QDirIterator it("://res/config");
+namespace {
+struct ConfigIndex {
+    QVector<QPair<int, int>> versions;
+    QHash<QPair<int, int>, QString> dirs;
+};
 
-    while (it.hasNext()) {
-        QFileInfo fi(it.next());
-        QStringList names = fi.fileName().split("_o_");
+// The configurations are bundled resources, so they are only indexed once.
+const ConfigIndex &configIndex()
+{
+    static const ConfigIndex ind = []() {
+        ConfigIndex res;
+        for (const auto &e: FirmwareCatalog::entries("://res/config")) {
+            if (!e.isDir) {
+                continue;
+            }
 
-        if (fi.isDir()) {
-            for(auto name: names) {
+            for (const auto &name: e.names) {
                 auto parts = name.split(".");
                 if (parts.size() == 2) {
-                    int major = parts.at(0).toInt();
-                    int minor = parts.at(1).toInt();
-                    if (major == fwMajor && minor == fwMinor) {
-                        return true;
+                    auto ver = qMakePair(parts.at(0).toInt(), parts.at(1).toInt());
+                    res.versions.append(ver);
+                    if (!res.dirs.contains(ver)) {
+                        res.dirs.insert(ver, e.path);
                     }
                 }
             }
         }
-    }
+        return res;
+    }();
 
-    return false;
+    return ind;
+}
 }
 
-bool Utility::configLoad(VescInterface *vesc, int fwMajor, int fwMinor)
+bool Utility::configCheckCompatibility(int fwMajor, int fwMinor)
 {
-    QDirIterator it("://res/config");
+    return configIndex().dirs.contains(qMakePair(fwMajor, fwMinor));
+}
 
-    while (it.hasNext()) {
-        QFileInfo fi(it.next());
-        QStringList names = fi.fileName().split("_o_");
+bool Utility::configLoad(VescInterface *vesc, int fwMajor, int fwMinor)
+{
+    QString dir = configIndex().dirs.value(qMakePair(fwMajor, fwMinor));
 
-        if (fi.isDir()) {
-            for(auto name: names) {
-                auto parts = name.split(".");
-                if (parts.size() == 2) {
-                    int major = parts.at(0).toInt();
-                    int minor = parts.at(1).toInt();
-                    if (major == fwMajor && minor == fwMinor) {
-                        QFileInfo fMc(it.filePath() + "/parameters_mcconf.xml");
-                        QFileInfo fApp(it.filePath() + "/parameters_appconf.xml");
-                        QFileInfo fInfo(it.filePath() + "/info.xml");
-
-                        if (fMc.exists() && fApp.exists() && fInfo.exists()) {
-                            vesc->mcConfig()->loadParamsXml(fMc.absoluteFilePath());
-                            vesc->appConfig()->loadParamsXml(fApp.absoluteFilePath());
-                            vesc->infoConfig()->loadParamsXml(fInfo.absoluteFilePath());
-                            vesc->emitConfigurationChanged();
-                            return true;
-                        } else {
-                            qWarning() << "Configurations not found in firmware directory" << it.path();
-                            return false;
-                        }
-                    }
-                }
-            }
-        }
+    if (dir.isEmpty()) {
+        return false;
     }
 
-    return false;
+    QFileInfo fMc(dir + "/parameters_mcconf.xml");
+    QFileInfo fApp(dir + "/parameters_appconf.xml");
+    QFileInfo fInfo(dir + "/info.xml");
+
+    if (fMc.exists() && fApp.exists() && fInfo.exists()) {
+        vesc->mcConfig()->loadParamsXml(fMc.absoluteFilePath());
+        vesc->appConfig()->loadParamsXml(fApp.absoluteFilePath());
+        vesc->infoConfig()->loadParamsXml(fInfo.absoluteFilePath());
+        vesc->emitConfigurationChanged();
+        return true;
+    } else {
+        qWarning() << "Configurations not found in firmware directory" << dir;
+        return false;
+    }
 }
 
 QPair<int, int> Utility::configLatestSupported()
 {
     QPair<int, int> res = qMakePair(-1, -1);
-    QDirIterator it("://res/config");
 
-    while (it.hasNext()) {
-        QFileInfo fi(it.next());
-        QStringList names = fi.fileName().split("_o_");
-
-        if (fi.isDir()) {
-            foreach (auto name, names) {
-                auto parts = name.split(".");
-                if (parts.size() == 2) {
-                    QPair<int, int> ver = qMakePair(parts.at(0).toInt(), parts.at(1).toInt());
-                    if (ver > res) {
-                        res = ver;
-                    }
-                }
-            }
+    foreach (auto ver, configIndex().versions) {
+        if (ver > res) {
+            res = ver;
         }
     }
 
@@ -1820,26 +1767,7 @@ bool Utility::configLoadLatest(VescInterface *vesc)
 
 QVector<QPair<int, int> > Utility::configSupportedFws()
 {
-    QVector<QPair<int, int>> res;
-    QDirIterator it("://res/config");
-
-    while (it.hasNext()) {
-        QFileInfo fi(it.next());
-        QStringList names = fi.fileName().split("_o_");
-
-        if (fi.isDir()) {
-            for(auto name: names) {
-                auto parts = name.split(".");
-                if (parts.size() == 2) {
-                    int major = parts.at(0).toInt();
-                    int minor = parts.at(1).toInt();
-                    res.append(qMakePair(major, minor));
-                }
-            }
-        }
-    }
-
-    return res;
+    return configIndex().versions;
 }
 
 bool Utility::configLoadCompatible(VescInterface *vesc, QString &uuidRx)
@@ -2382,3 +2310,75 @@ QVariantMap Utility::getSafeAreaMargins(QQuickWindow *window)
     map["left"] = margins.left();
     return map;
 }
+
+/**
+ * @brief Utility::lzoCompressChunks
+ * LZO-compress data in independent chunks, the way they are sent during
+ * firmware upload. The chunks are split into one contiguous range per core,
+ * and each range is compressed with a dictionary that is allocated once.
+ *
+ * @param data
+ * The data to compress.
+ *
+ * @param chunkSize
+ * Chunk size. The last chunk can be shorter.
+ *
+ * @return
+ * The compressed chunks. A chunk is empty if compression failed.
+ */
+QVector<QByteArray> Utility::lzoCompressChunks(const QByteArray &data, int chunkSize)
+{
+    class CompressJob : public QRunnable
+    {
+    public:
+        CompressJob(const QByteArray &data, int chunkSize, QByteArray *res, int first, int last) :
+            mData(data), mChunkSize(chunkSize), mRes(res), mFirst(first), mLast(last) {}
+
+        void run() override {
+            lzokay::Dict<> dict;
+            QByteArray out(int(lzokay::compress_worst_size(std::size_t(mChunkSize))), 0);
+
+            for (int i = mFirst;i < mLast;i++) {
+                int ofs = i * mChunkSize;
+                int sz = qMin(mChunkSize, mData.size() - ofs);
+                std::size_t outLen = 0;
+
+                lzokay::EResult error = lzokay::compress(
+                            (const uint8_t*)mData.constData() + ofs, std::size_t(sz),
+                            (uint8_t*)out.data(), std::size_t(out.size()), outLen, dict);
+
+                if (error >= lzokay::EResult::Success) {
+                    mRes[i] = out.left(int(outLen));
+                }
+            }
+        }
+
+    private:
+        const QByteArray &mData;
+        int mChunkSize;
+        QByteArray *mRes;
+        int mFirst;
+        int mLast;
+    };
+
+    int chunks = (data.size() + chunkSize - 1) / chunkSize;
+    QVector<QByteArray> res(chunks);
+
+    if (chunks == 0) {
+        return res;
+    }
+
+    QThreadPool pool;
+    int jobs = qBound(1, QThread::idealThreadCount(), chunks);
+    pool.setMaxThreadCount(jobs);
+
+    for (int i = 0;i < jobs;i++) {
+        int first = chunks * i / jobs;
+        int last = chunks * (i + 1) / jobs;
+        pool.start(new CompressJob(data, chunkSize, res.data(), first, last));
+    }
+
+    pool.waitForDone();
+
+    return res;
+}
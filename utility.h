@@ -148,6 +148,8 @@ public:
 
     Q_INVOKABLE static QString md2html(QString md);
 
+    static QVector<QByteArray> lzoCompressChunks(const QByteArray &data, int chunkSize);
+
     Q_INVOKABLE QByteArray readAllFromFile(const QString &filePath);
 
 signals:
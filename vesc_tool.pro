@@ -226,7 +226,17 @@ SOURCES += main.cpp\
     startupwizard.cpp \
     utility.cpp \
     tcpserversimple.cpp \
-    hexfile.cpp
+    hexfile.cpp \
+    vescsessionmanager.cpp \
+    canfleetexecutor.cpp \
+    firmwarecatalog.cpp \
+    fwdelta.cpp \
+    commandrequest.cpp \
+    gpdstreamer.cpp \
+    telemetrystreamer.cpp \
+    metricsserver.cpp \
+    sdmirror.cpp \
+    focdetectrunner.cpp
 
 HEADERS  += mainwindow.h \
     bleuartdummy.h \
@@ -249,7 +259,17 @@ HEADERS  += mainwindow.h \
     startupwizard.h \
     utility.h \
     tcpserversimple.h \
-    hexfile.h
+    hexfile.h \
+    vescsessionmanager.h \
+    canfleetexecutor.h \
+    firmwarecatalog.h \
+    fwdelta.h \
+    commandrequest.h \
+    gpdstreamer.h \
+    telemetrystreamer.h \
+    metricsserver.h \
+    sdmirror.h \
+    focdetectrunner.h
 
 unix: {
 !ios: {
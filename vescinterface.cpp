@@ -26,12 +26,14 @@
 #include <cmath>
 #include <QRegularExpression>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QDir>
+#include <QScopedPointer>
 #include <cmath>
-#include "lzokay/lzokay.hpp"
 #include "vescinterface.h"
 #include "utility.h"
 #include "heatshrink/heatshrinkif.h"
+#include "fwdelta.h"
 
 #ifdef HAS_SERIALPORT
 #include <QSerialPortInfo>
@@ -61,6 +63,7 @@ VescInterface::VescInterface(QObject *parent) : QObject(parent)
     mCustomConfigRxDone = false;
     mQmlHwLoaded = false;
     mQmlAppLoaded = false;
+    mQmlAppFromDevice = false;
     mPacket = new Packet(this);
     mCommands = new Commands(this);
 
@@ -606,6 +609,11 @@ Commands *VescInterface::commands() const
     return mCommands;
 }
 
+Packet *VescInterface::packet() const
+{
+    return mPacket;
+}
+
 ConfigParams *VescInterface::mcConfig()
 {
     return mMcConfig;
@@ -1112,8 +1120,34 @@ bool VescInterface::swdEraseFlash()
     return true;
 }
 
+/**
+ * @brief VescInterface::swdUploadFw
+ * Upload firmware to the SWD target. The target must be erased before this.
+ *
+ * @param newFirmware
+ * The image to write.
+ *
+ * @param startAddr
+ * Flash address to write the image to.
+ *
+ * @param verify
+ * Read back the whole region after writing and compare it to the image. The
+ * region is read with pipelined requests, which is much faster than reading
+ * back each chunk after writing it.
+ *
+ * @param isLzo
+ * Compress the chunks with LZO if the target supports it.
+ *
+ * @param skipErased
+ * Do not write chunks that only contain the erased value of the flash. As the
+ * flash is erased before uploading, these already have the right content. Only
+ * use this if the target was erased.
+ *
+ * @return
+ * True on success, false otherwise.
+ */
 bool VescInterface::swdUploadFw(QByteArray newFirmware, uint32_t startAddr,
-                                bool verify, bool isLzo)
+                                bool verify, bool isLzo, bool skipErased)
 {
     bool supportsLzo = mCommands->getLimitedCompatibilityCommands().
             contains(int(COMM_BM_WRITE_FLASH_LZO));
@@ -1122,6 +1156,11 @@ bool VescInterface::swdUploadFw(QByteArray newFirmware, uint32_t startAddr,
         supportsLzo = false;
     }
 
+    if (verify && mCommands->isLimitedMode() &&
+            !mCommands->getLimitedCompatibilityCommands().contains(int(COMM_BM_MEM_READ))) {
+        verify = false;
+    }
+
     auto waitBmWriteRes = [this]() {
         int res = -10;
 
@@ -1141,7 +1180,7 @@ bool VescInterface::swdUploadFw(QByteArray newFirmware, uint32_t startAddr,
         return res;
     };
 
-    auto writeChunk = [this, &waitBmWriteRes, &verify]
+    auto writeChunk = [this, &waitBmWriteRes]
             (uint32_t addr, QByteArray chunk, QByteArray chunkLzo) {
         for (int i = 0;i < 3;i++) {
             if (chunkLzo.isEmpty()) {
@@ -1152,20 +1191,6 @@ bool VescInterface::swdUploadFw(QByteArray newFirmware, uint32_t startAddr,
 
             int res = waitBmWriteRes();
 
-            if (verify && (!mCommands->isLimitedMode() ||
-                           mCommands->getLimitedCompatibilityCommands().
-                           contains(int(COMM_BM_MEM_READ)))) {
-                QByteArray rdData = mCommands->bmReadMemWait(addr, quint16(chunk.size()));
-
-                if (rdData.size() != chunk.size()) {
-                    return -11;
-                }
-
-                if (rdData != chunk) {
-                    return -12;
-                }
-            }
-
             if (res != -10) {
                 return res;
             }
@@ -1174,40 +1199,67 @@ bool VescInterface::swdUploadFw(QByteArray newFirmware, uint32_t startAddr,
         return -20;
     };
 
+    auto showError = [this](int res) {
+        QString msg = "Unknown failure";
+
+        if (res == -20) {
+            msg = "Timed out";
+        } else if (res == -2) {
+            msg = "Write failed";
+        } else if (res == -1) {
+            msg = "Not connected to target";
+        } else if (res == -11) {
+            msg = "Verification failed (-11)";
+        } else if (res == -12) {
+            msg = "Verification failed (-12)";
+        }
+
+        emitMessageDialog("SWD Upload", msg, false, false);
+        emit fwUploadStatus(msg, 0.0, false);
+    };
+
+    const int chunkSize = 400;
+    const QByteArray erasedChunk(chunkSize, char(0xFF));
+
     mCancelSwdUpload = false;
+    const QByteArray image = newFirmware;
     int addr = int(startAddr);
     int szTot = newFirmware.size();
     int uploadSize = 2;
     int compChunks = 0;
     int nonCompChunks = 0;
+    int skippedChunks = 0;
+    QElapsedTimer writeTimer;
+    qint64 writeTimeMs = 0;
 
-    while (newFirmware.size() > 0) {
-        const int chunkSize = 400;
+    // Compress all chunks up front, so that the link does not wait for it
+    QVector<QByteArray> lzoChunks;
+    if (supportsLzo && isLzo) {
+        lzoChunks = Utility::lzoCompressChunks(newFirmware, chunkSize);
+    }
+    int chunkInd = 0;
 
+    while (newFirmware.size() > 0) {
         int sz = newFirmware.size() > chunkSize ? chunkSize : newFirmware.size();
 
         QByteArray in = newFirmware.mid(0, sz);
-        std::size_t outMaxSize = chunkSize + chunkSize / 16 + 64 + 3;
-        unsigned char out[1000];
-        std::size_t out_len = sz;
-
-        if (supportsLzo && isLzo) {
-            lzokay::EResult error = lzokay::compress((const uint8_t*)in.constData(), sz, out, outMaxSize, out_len);
-            if (error < lzokay::EResult::Success) {
-                qWarning() << "LZO Compress Error" << int(error);
-                isLzo = false;
-            }
-        }
+        QByteArray lzoChunk = lzoChunks.value(chunkInd++);
 
         int res = 1;
-        if (supportsLzo && isLzo && (out_len + 2) < uint32_t(sz)) {
-            compChunks++;
-            uploadSize += out_len + 2;
-            res = writeChunk(uint32_t(addr), in, QByteArray((const char*)out, int(out_len)));
+        if (skipErased && in == erasedChunk.left(sz)) {
+            skippedChunks++;
         } else {
-            nonCompChunks++;
-            uploadSize += sz;
-            res = writeChunk(uint32_t(addr), in, QByteArray());
+            writeTimer.start();
+            if (supportsLzo && isLzo && !lzoChunk.isEmpty() && (lzoChunk.size() + 2) < sz) {
+                compChunks++;
+                uploadSize += lzoChunk.size() + 2;
+                res = writeChunk(uint32_t(addr), in, lzoChunk);
+            } else {
+                nonCompChunks++;
+                uploadSize += sz;
+                res = writeChunk(uint32_t(addr), in, QByteArray());
+            }
+            writeTimeMs += writeTimer.elapsed();
         }
 
         newFirmware.remove(0, sz);
@@ -1216,23 +1268,7 @@ bool VescInterface::swdUploadFw(QByteArray newFirmware, uint32_t startAddr,
         if (res == 1) {
             emit fwUploadStatus("Uploading firmware over SWD", double(addr - startAddr) / double(szTot), true);
         } else {
-            QString msg = "Unknown failure";
-
-            if (res == -20) {
-                msg = "Timed out";
-            } else if (res == -2) {
-                msg = "Write failed";
-            } else if (res == -1) {
-                msg = "Not connected to target";
-            } else if (res == -11) {
-                msg = "Verification failed (-11)";
-            } else if (res == -12) {
-                msg = "Verification failed (-12)";
-            }
-
-            emitMessageDialog("SWD Upload", msg, false, false);
-            emit fwUploadStatus(msg, 0.0, false);
-
+            showError(res);
             return false;
         }
 
@@ -1248,7 +1284,57 @@ bool VescInterface::swdUploadFw(QByteArray newFirmware, uint32_t startAddr,
                  << "Incompressible chunks:" << nonCompChunks;
     }
 
-    emit fwUploadStatus("Upload done", 1.0, false);
+    // Used to estimate what the skipped writes and the per-chunk readback
+    // would have cost.
+    int writtenChunks = compChunks + nonCompChunks;
+    double msPerChunk = writtenChunks > 0 ? double(writeTimeMs) / double(writtenChunks) : 0.0;
+    QString doneMsg = "Upload done";
+
+    if (skippedChunks > 0) {
+        doneMsg += QString(", %1 erased chunks skipped (%2 s saved)").
+                arg(skippedChunks).arg(msPerChunk * skippedChunks / 1000.0, 0, 'f', 1);
+    }
+
+    if (verify) {
+        emit fwUploadStatus("Verifying flash", 0.0, true);
+
+        auto conn = connect(mCommands, &Commands::bmReadMemRegionProgress, [this](int done, int total) {
+            emit fwUploadStatus("Verifying flash", double(done) / double(qMax(1, total)), true);
+        });
+
+        QElapsedTimer verifyTimer;
+        verifyTimer.start();
+        QByteArray rdData = mCommands->bmReadMemRegion(startAddr, szTot);
+        qint64 verifyTimeMs = verifyTimer.elapsed();
+        disconnect(conn);
+
+        if (rdData.size() != szTot) {
+            showError(-11);
+            return false;
+        }
+
+        if (rdData != image) {
+            for (int i = 0;i < szTot;i++) {
+                if (rdData.at(i) != image.at(i)) {
+                    qWarning() << "SWD verification mismatch at" <<
+                                  QString("0x%1").arg(startAddr + uint32_t(i), 8, 16, QLatin1Char('0'));
+                    break;
+                }
+            }
+
+            showError(-12);
+            return false;
+        }
+
+        double chunksTot = double((szTot + chunkSize - 1) / chunkSize);
+        double savedMs = msPerChunk * chunksTot - double(verifyTimeMs);
+        doneMsg += QString(", verified in %1 s").arg(double(verifyTimeMs) / 1000.0, 0, 'f', 1);
+        if (savedMs > 0.0) {
+            doneMsg += QString(" (%1 s saved)").arg(savedMs / 1000.0, 0, 'f', 1);
+        }
+    }
+
+    emit fwUploadStatus(doneMsg, 1.0, false);
 
     return true;
 }
@@ -1391,7 +1477,8 @@ bool VescInterface::fwEraseBootloader(bool fwdCan)
     return true;
 }
 
-bool VescInterface::fwUpload(QByteArray &newFirmware, bool isBootloader, bool fwdCan, bool isLzo, bool autoDisconnect)
+bool VescInterface::fwUpload(QByteArray &newFirmware, bool isBootloader, bool fwdCan, bool isLzo,
+                             bool autoDisconnect, const QByteArray &deltaBase)
 {
     mIsLastFwBootloader = isBootloader;
     mFwUploadProgress = 0.0;
@@ -1451,6 +1538,49 @@ bool VescInterface::fwUpload(QByteArray &newFirmware, bool isBootloader, bool fw
         }
     }
 
+    // Send a patch against the image on the device instead of the full image
+    // when the firmware can apply it. The patch is only used when it saves
+    // a significant amount of data on the link.
+    bool isDelta = false;
+    const int hsMaxSize = 393208;
+    if (!isBootloader && !fwdCan && !deltaBase.isEmpty() && mLastFwParams.fwDeltaSupported) {
+        mFwUploadStatus = "Generating patch";
+        emit fwUploadStatus(mFwUploadStatus, mFwUploadProgress, true);
+
+        QByteArray patch = FwDelta::generate(deltaBase, newFirmware);
+        int fullBytes = FwDelta::wireBytes(newFirmware);
+        int deltaBytes = FwDelta::wireBytes(patch);
+
+        qDebug() << "Firmware patch size:" << patch.size() << "Wire bytes full:" << fullBytes
+                 << "Wire bytes patch:" << deltaBytes;
+
+        if (patch.size() <= hsMaxSize && deltaBytes < (fullBytes / 2)) {
+            newFirmware = patch;
+            isDelta = true;
+        }
+    }
+
+    int szTot = newFirmware.size();
+
+    if (szTot > 5000000) {
+        emitMessageDialog(tr("Firmware too big"),
+                          tr("The firmware you are trying to upload is unreasonably "
+                             "large, most likely it is an invalid file"), false);
+        return false;
+    }
+
+    // Heatshrink runs on its own thread while the buffer is erased. The size
+    // and CRC in the header are only known at the end, so the header is
+    // written last.
+    QScopedPointer<HeatshrinkStreamEncoder> hsEnc;
+    QElapsedTimer hsTimer;
+    if (!isDelta && szTot > hsMaxSize && szTot < 700000) { // If fw is much larger it is probably for the esp32
+        qDebug() << "Firmware is big, using heatshrink compression library";
+        hsEnc.reset(new HeatshrinkStreamEncoder(newFirmware));
+        hsEnc->start();
+        hsTimer.start();
+    }
+
     if (isBootloader) {
         if (mCommands->getLimitedSupportsEraseBootloader()) {
             mFwUploadStatus = "Erasing bootloader";
@@ -1540,57 +1670,74 @@ bool VescInterface::fwUpload(QByteArray &newFirmware, bool isBootloader, bool fw
     }
 
     int startAddr = addr;
-    int szTot = newFirmware.size();
     int uploadSize = 2;
     int compChunks = 0;
     int nonCompChunks = 0;
     int skipChunks = 0;
 
-    bool useHeatshrink = false;
-    if (szTot > 393208 && szTot < 700000) { // If fw is much larger it is probably for the esp32
-        useHeatshrink = true;
-        qDebug() << "Firmware is big, using heatshrink compression library";
-        int szOld = szTot;
-        HeatshrinkIf hs;
-        newFirmware = hs.encode(newFirmware);
-        szTot = newFirmware.size();
-        qDebug() << "New size:" << szTot << "(" << 100.0 * (double)szTot / (double)szOld << "%)";
+    QByteArray hsOut;
+    int hsConsumed = 0;
+    if (hsEnc) {
+        // The compressed size has to be checked before anything is written,
+        // so the upload starts when the encoder is done. Most of the encoding
+        // overlaps with the erase.
+        while (!hsEnc->isDone()) {
+            QEventLoop loop;
+            connect(hsEnc.data(), SIGNAL(outputAvailable()), &loop, SLOT(quit()));
+            connect(hsEnc.data(), SIGNAL(finished()), &loop, SLOT(quit()));
+            if (hsEnc->isDone()) {
+                break;
+            }
+            loop.exec();
+        }
+
+        hsOut = hsEnc->take();
+        newFirmware = hsOut;
         supportsLzo = false;
 
-        if (szTot > 393208) {
+        if (hsOut.size() > hsMaxSize) {
             emitMessageDialog(tr("Firmware too big"),
                               tr("The firmware you are trying to upload is too large for the "
                                  "bootloader even after compression."), false);
+            mFwUploadProgress = -1.0;
+            mFwUploadStatus = "Firmware too big";
+            emit fwUploadStatus(mFwUploadStatus, mFwUploadProgress, false);
             return false;
         }
     }
 
-    if (szTot > 5000000) {
-        emitMessageDialog(tr("Firmware too big"),
-                          tr("The firmware you are trying to upload is unreasonably "
-                             "large, most likely it is an invalid file"), false);
-        return false;
-    }
-
     if (!isBootloader) {
-        quint16 crc = Packet::crc16((const unsigned char*)newFirmware.constData(),
-                                    uint32_t(newFirmware.size()));
-        VByteArray sizeCrc;
-        if (useHeatshrink) {
-            uint32_t szShift = 0xCC;
-            szShift <<= 24;
-            szShift |= szTot;
-            sizeCrc.vbAppendUint32(szShift);
+        if (hsEnc) {
+            addr += 6;
         } else {
-            sizeCrc.vbAppendUint32(szTot);
+            quint16 crc = Packet::crc16((const unsigned char*)newFirmware.constData(),
+                                        uint32_t(newFirmware.size()));
+            VByteArray sizeCrc;
+            uint32_t szField = uint32_t(szTot);
+            if (isDelta) {
+                szField |= uint32_t(0xDD) << 24;
+            }
+            sizeCrc.vbAppendUint32(szField);
+            sizeCrc.vbAppendUint16(crc);
+            newFirmware.prepend(sizeCrc);
         }
-        sizeCrc.vbAppendUint16(crc);
-        newFirmware.prepend(sizeCrc);
     }
 
     int lzoFailures = 0;
     const int chunkSize = 384;
-    while (newFirmware.size() > 0) {
+
+    // Compress all chunks up front, so that the link does not wait for it
+    QVector<QByteArray> lzoChunks;
+    if (isLzo && supportsLzo) {
+        lzoChunks = Utility::lzoCompressChunks(newFirmware, chunkSize);
+    }
+    int chunkInd = 0;
+
+    while (true) {
+        if (newFirmware.isEmpty()) {
+            break;
+        }
+
         if (mCancelFwUpload) {
             mFwUploadProgress = -1.0;
             mFwUploadStatus = "Upload cancelled";
@@ -1601,6 +1748,7 @@ bool VescInterface::fwUpload(QByteArray &newFirmware, bool isBootloader, bool fw
         int sz = newFirmware.size() > chunkSize ? chunkSize : newFirmware.size();
 
         QByteArray in = newFirmware.mid(0, sz);
+        QByteArray lzoChunk = lzoChunks.value(chunkInd++);
 
         bool hasData = false;
         foreach (auto b, in) {
@@ -1612,23 +1760,10 @@ bool VescInterface::fwUpload(QByteArray &newFirmware, bool isBootloader, bool fw
 
         int res = 1;
         if (hasData) {
-            std::size_t outMaxSize = chunkSize + chunkSize / 16 + 64 + 3;
-            unsigned char out[1000];
-            std::size_t out_len = sz;
-
-            if (isLzo && supportsLzo) {
-                lzokay::EResult error = lzokay::compress((const uint8_t*)in.constData(), sz, out,outMaxSize, out_len);
-                if (error < lzokay::EResult::Success) {
-                    qWarning() << "LZO Compress Error" << int(error);
-                    isLzo = false;
-                }
-            }
-
-            if (isLzo && supportsLzo && (out_len + 2) < uint32_t(sz)) {
+            if (isLzo && supportsLzo && !lzoChunk.isEmpty() && (lzoChunk.size() + 2) < sz) {
                 compChunks++;
-                uploadSize += out_len + 2;
-                res = writeChunk(uint32_t(addr), QByteArray((const char*)out, int(out_len)),
-                                 true, uint16_t(sz));
+                uploadSize += lzoChunk.size() + 2;
+                res = writeChunk(uint32_t(addr), lzoChunk, true, uint16_t(sz));
 
                 if (res != 1) {
                     res = writeChunk(uint32_t(addr), in, false, 0);
@@ -1660,7 +1795,15 @@ bool VescInterface::fwUpload(QByteArray &newFirmware, bool isBootloader, bool fw
         addr += sz;
 
         if (res == 1) {
-            mFwUploadProgress = double(addr - startAddr) / double(szTot);
+            if (hsEnc) {
+                // The compressed size is not known yet, use how much of the
+                // input the uploaded output corresponds to.
+                hsConsumed += sz;
+                mFwUploadProgress = double(hsEnc->inputForOutput(hsConsumed)) /
+                        double(qMax(1, hsEnc->inputSize()));
+            } else {
+                mFwUploadProgress = double(addr - startAddr) / double(szTot);
+            }
             mFwUploadStatus = "Uploading ";
             if (isBootloader) {
                 mFwUploadStatus += "Bootloader";
@@ -1685,10 +1828,40 @@ bool VescInterface::fwUpload(QByteArray &newFirmware, bool isBootloader, bool fw
         }
     }
 
+    if (hsEnc && !isBootloader) {
+        quint16 crc = Packet::crc16((const unsigned char*)hsOut.constData(),
+                                    uint32_t(hsOut.size()));
+        VByteArray sizeCrc;
+        uint32_t szShift = 0xCC;
+        szShift <<= 24;
+        szShift |= uint32_t(hsOut.size());
+        sizeCrc.vbAppendUint32(szShift);
+        sizeCrc.vbAppendUint16(crc);
+
+        if (writeChunk(uint32_t(startAddr), sizeCrc, false, 0) != 1) {
+            QString msg = "Writing firmware header failed";
+            emitMessageDialog("Firmware Upload", msg, false, false);
+            mFwUploadProgress = -1.0;
+            mFwUploadStatus = msg;
+            emit fwUploadStatus(mFwUploadStatus, mFwUploadProgress, false);
+            return false;
+        }
+    }
+
     mFwUploadProgress = -1.0;
     mFwUploadStatus = "Upload done";
     emit fwUploadStatus(mFwUploadStatus, 1.0, false);
 
+    if (hsEnc) {
+        qint64 encMs = hsEnc->encodeTimeMs();
+        qDebug() << "Heatshrink In:" << hsEnc->inputSize() << "Out:" << hsOut.size()
+                 << "Compression Ratio:" << double(hsOut.size()) / double(hsEnc->inputSize())
+                 << "\nEncode time:" << encMs << "ms ("
+                 << double(hsEnc->inputSize()) / 1024.0 / (double(qMax(encMs, qint64(1))) / 1000.0)
+                 << "kB/s ) Upload time:" << hsTimer.elapsed() << "ms"
+                 << "\nSkipped chunks:" << skipChunks << "(" << skipChunks * chunkSize << "b )";
+    }
+
     if (supportsLzo && isLzo) {
         qDebug() << "Uploaded:" << uploadSize << "Initial Size:" << szTot << "Compression Ratio:"
                  << double(uploadSize) / double(szTot - skipChunks * chunkSize)
@@ -1991,6 +2164,7 @@ bool VescInterface::loadRtLogFile(QByteArray data)
     res = true;
 
     emitStatusMessage(QString("Loaded %1 log entries").arg(lineNum - 1), true);
+    emit rtLogLoaded();
 
     return res;
 }
@@ -4057,82 +4231,30 @@ void VescInterface::fwVersionReceived(FW_RX_PARAMS params)
     }
 
     // Read qmlui APP
+    mQmlAppCacheFile.clear();
+    if (!confCacheDir.isEmpty()) {
+        mQmlAppCacheFile = confCacheDir + "/qml_app.bin";
+    }
+
     if (mLoadQmlUiOnConnect && params.hasQmlApp) {
         bool cacheLoadOk = false;
 
-        QString confCacheFile;
-        if (!confCacheDir.isEmpty()) {
-            confCacheFile = confCacheDir + "/qml_app.bin";
-        }
-
-        if (!confCacheFile.isEmpty()) {
-            QFile f(confCacheFile);
+        if (!mQmlAppCacheFile.isEmpty()) {
+            QFile f(mQmlAppCacheFile);
             if (f.exists() && f.open(QIODevice::ReadOnly)) {
                 auto qmlData = f.readAll();
                 f.close();
 
                 mQmlApp = QString::fromUtf8(qUncompress(qmlData));
                 mQmlAppLoaded = true;
+                mQmlAppFromDevice = false;
                 emitStatusMessage("Got cached qmlui App", true);
                 cacheLoadOk = true;
             }
         }
 
         if (!cacheLoadOk) {
-            QByteArray qmlData;
-            int lenQmlLast = -1;
-            auto conn = connect(mCommands, &Commands::qmluiAppRx,
-                                [&](int lenQml, int ofsQml, QByteArray data) {
-                if (qmlData.size() <= ofsQml) {
-                    qmlData.append(data);
-                }
-                lenQmlLast = lenQml;
-            });
-
-            auto getQmlChunk = [&](int size, int offset, int tries, int timeout) {
-                bool res = false;
-
-                for (int j = 0;j < tries;j++) {
-                    mCommands->qmlUiAppGet(size, offset);
-                    res = Utility::waitSignal(mCommands, SIGNAL(qmluiAppRx(int,int,QByteArray)), timeout);
-                    if (res) {
-                        break;
-                    }
-                }
-                return res;
-            };
-
-            if (getQmlChunk(10, 0, 5, 1500)) {
-                while (qmlData.size() < lenQmlLast) {
-                    int dataLeft = lenQmlLast - qmlData.size();
-                    if (!getQmlChunk(dataLeft > 400 ? 400 : dataLeft, qmlData.size(), 5, 1500)) {
-                        break;
-                    }
-                }
-
-                if (qmlData.size() == lenQmlLast) {
-                    mQmlApp = QString::fromUtf8(qUncompress(qmlData));
-                    mQmlAppLoaded = true;
-                    emitStatusMessage("Got qmlui App", true);
-
-                    if (!confCacheFile.isEmpty()) {
-                        QFile f(confCacheFile);
-                        if (f.open(QIODevice::WriteOnly)) {
-                            f.write(qmlData);
-                            f.close();
-                            emitStatusMessage(QString("Cached %1").arg(confCacheFile), true);
-                        }
-                    }
-                } else {
-                    mQmlAppLoaded = false;
-                    emitMessageDialog("Get qmlui App",
-                                      "Could not read qmlui App from hardware",
-                                      false, false);
-                    disconnect(conn);
-                }
-            }
-
-            disconnect(conn);
+            readQmlApp();
         }
     }
 
@@ -4734,6 +4856,145 @@ QString VescInterface::qmlApp()
     return mQmlAppLoaded ? mQmlApp : "";
 }
 
+/**
+ * @brief VescInterface::qmlAppFromDevice
+ * @return
+ * True if qmlApp() was read from the device, and not from the cache in the
+ * app data directory, since connecting or the last upload.
+ */
+bool VescInterface::qmlAppFromDevice()
+{
+    return mQmlAppLoaded && mQmlAppFromDevice;
+}
+
+/**
+ * @brief VescInterface::reloadQmlApp
+ * Read the QML app from the device again and update the cache with it.
+ *
+ * @param silent
+ * Do not show a dialog if reading fails, and keep the current copy.
+ *
+ * @return
+ * True if the app was read.
+ */
+bool VescInterface::reloadQmlApp(bool silent)
+{
+    if (!isPortConnected() || !mLastFwParams.hasQmlApp) {
+        return false;
+    }
+
+    return readQmlApp(silent);
+}
+
+/**
+ * @brief VescInterface::qmlAppDeviceSize
+ * Read the size of the compressed QML app on the device, without reading
+ * the app itself.
+ *
+ * @return
+ * The size in bytes, or -1 if there is no app or it could not be read.
+ */
+int VescInterface::qmlAppDeviceSize()
+{
+    if (!isPortConnected() || !mLastFwParams.hasQmlApp) {
+        return -1;
+    }
+
+    int res = -1;
+    auto conn = connect(mCommands, &Commands::qmluiAppRx,
+                        [&res](int lenQml, int ofsQml, QByteArray data) {
+        (void)ofsQml;
+        (void)data;
+        res = lenQml;
+    });
+
+    for (int i = 0;i < 3;i++) {
+        mCommands->qmlUiAppGet(10, 0);
+        if (Utility::waitSignal(mCommands, SIGNAL(qmluiAppRx(int,int,QByteArray)), 1500)) {
+            break;
+        }
+    }
+
+    disconnect(conn);
+    return res;
+}
+
+/**
+ * @brief VescInterface::invalidateQmlApp
+ * Call when the QML app on the device has been changed, e.g. by uploading
+ * or erasing it. The cached copy is removed and qmlApp() is no longer
+ * considered to be what the device runs.
+ */
+void VescInterface::invalidateQmlApp()
+{
+    mQmlAppFromDevice = false;
+
+    if (!mQmlAppCacheFile.isEmpty()) {
+        QFile::remove(mQmlAppCacheFile);
+    }
+}
+
+bool VescInterface::readQmlApp(bool silent)
+{
+    QByteArray qmlData;
+    int lenQmlLast = -1;
+    bool res = false;
+    auto conn = connect(mCommands, &Commands::qmluiAppRx,
+                        [&](int lenQml, int ofsQml, QByteArray data) {
+        if (qmlData.size() <= ofsQml) {
+            qmlData.append(data);
+        }
+        lenQmlLast = lenQml;
+    });
+
+    auto getQmlChunk = [&](int size, int offset, int tries, int timeout) {
+        bool res = false;
+
+        for (int j = 0;j < tries;j++) {
+            mCommands->qmlUiAppGet(size, offset);
+            res = Utility::waitSignal(mCommands, SIGNAL(qmluiAppRx(int,int,QByteArray)), timeout);
+            if (res) {
+                break;
+            }
+        }
+        return res;
+    };
+
+    if (getQmlChunk(10, 0, 5, 1500)) {
+        while (qmlData.size() < lenQmlLast) {
+            int dataLeft = lenQmlLast - qmlData.size();
+            if (!getQmlChunk(dataLeft > 400 ? 400 : dataLeft, qmlData.size(), 5, 1500)) {
+                break;
+            }
+        }
+
+        if (qmlData.size() == lenQmlLast) {
+            mQmlApp = QString::fromUtf8(qUncompress(qmlData));
+            mQmlAppLoaded = true;
+            mQmlAppFromDevice = true;
+            res = true;
+            emitStatusMessage("Got qmlui App", true);
+
+            if (!mQmlAppCacheFile.isEmpty()) {
+                QFile f(mQmlAppCacheFile);
+                if (f.open(QIODevice::WriteOnly)) {
+                    f.write(qmlData);
+                    f.close();
+                    emitStatusMessage(QString("Cached %1").arg(mQmlAppCacheFile), true);
+                }
+            }
+        } else if (!silent) {
+            mQmlAppLoaded = false;
+            emitMessageDialog("Get qmlui App",
+                              "Could not read qmlui App from hardware",
+                              false, false);
+        }
+    }
+
+    disconnect(conn);
+    return res;
+}
+
 void VescInterface::updateFwRx(bool fwRx)
 {
     bool change = mFwVersionReceived != fwRx;
@@ -4747,6 +5008,9 @@ void VescInterface::updateFwRx(bool fwRx)
         mCustomConfigRxDone = false;
         mQmlHwLoaded = false;
         mQmlAppLoaded = false;
+        mQmlAppFromDevice = false;
+        mCommands->invalidateConfigShadow();
+        mCommands->resetSeqEnvelope();
     }
 }
 
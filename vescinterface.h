@@ -70,6 +70,7 @@ public:
     explicit VescInterface(QObject *parent = nullptr);
     ~VescInterface();
     Q_INVOKABLE Commands *commands() const;
+    Packet *packet() const;
     Q_INVOKABLE ConfigParams *mcConfig();
     Q_INVOKABLE ConfigParams *appConfig();
     Q_INVOKABLE ConfigParams *infoConfig();
@@ -123,14 +124,15 @@ public:
     // SWD Programming
     bool swdEraseFlash();
     bool swdUploadFw(QByteArray newFirmware, uint32_t startAddr = 0,
-                     bool verify = false, bool isLzo = true);
+                     bool verify = false, bool isLzo = true, bool skipErased = false);
     void swdCancel();
     bool swdReboot();
 
     // Firmware Updates
     bool fwEraseNewApp(bool fwdCan, quint32 fwSize);
     bool fwEraseBootloader(bool fwdCan);
-    bool fwUpload(QByteArray &newFirmware, bool isBootloader = false, bool fwdCan = false, bool isLzo = true, bool autoDisconnect = true);
+    bool fwUpload(QByteArray &newFirmware, bool isBootloader = false, bool fwdCan = false, bool isLzo = true,
+                  bool autoDisconnect = true, const QByteArray &deltaBase = QByteArray());
     Q_INVOKABLE bool fwUpdate(QByteArray newFirmware) { return fwUpload(newFirmware, false, false, true, false); }
     Q_INVOKABLE void fwUploadCancel();
     Q_INVOKABLE double getFwUploadProgress();
@@ -247,6 +249,10 @@ public:
     Q_INVOKABLE bool qmlAppLoaded();
     Q_INVOKABLE QString qmlHw();
     Q_INVOKABLE QString qmlApp();
+    Q_INVOKABLE bool qmlAppFromDevice();
+    Q_INVOKABLE bool reloadQmlApp(bool silent = false);
+    int qmlAppDeviceSize();
+    void invalidateQmlApp();
 
     Q_INVOKABLE QString getLastTcpHubVescID() const;
     Q_INVOKABLE QString getLastTcpHubVescPass() const;
@@ -278,6 +284,7 @@ public:
 
 signals:
     void statusMessage(const QString &msg, bool isGood);
+    void rtLogLoaded();
     void messageDialog(const QString &title, const QString &msg, bool isGood, bool richText);
     void fwUploadStatus(const QString &status, double progress, bool isOngoing);
     void serialPortNotWritable(const QString &port);
@@ -367,7 +374,9 @@ private:
     bool mQmlHwLoaded;
     QString mQmlHw;
     bool mQmlAppLoaded;
+    bool mQmlAppFromDevice;
     QString mQmlApp;
+    QString mQmlAppCacheFile;
 
     QTimer *mTimer;
     Packet *mPacket;
@@ -480,6 +489,7 @@ private:
     bool mIgnoreCustomConfigs;
 
     void updateFwRx(bool fwRx);
+    bool readQmlApp(bool silent = false);
     void setLastConnectionType(conn_t type);
 
 };
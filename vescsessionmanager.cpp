@@ -0,0 +1,582 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "vescsessionmanager.h"
+#include "utility.h"
+#include "packet.h"
+#include "heatshrink/heatshrinkif.h"
+
+#include <QDebug>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <memory>
+
+VescSessionManager::VescSessionManager(QObject *parent) : QObject(parent)
+{
+    mNextId = 0;
+    mMaxParallel = 64;
+}
+
+VescSessionManager::~VescSessionManager()
+{
+    removeAllSessions();
+}
+
+int VescSessionManager::addSession()
+{
+    VescInterface *vesc = new VescInterface(this);
+    vesc->fwConfig()->loadParamsXml("://res/config/fw.xml");
+    Utility::configLoadLatest(vesc);
+
+    int id = mNextId++;
+    Session s;
+    s.vesc = vesc;
+    s.name = tr("Session %1").arg(id);
+    mSessions.insert(id, s);
+
+    connect(vesc, &VescInterface::statusMessage, this, [this, id](const QString &msg, bool isGood) {
+        emit sessionStatus(id, msg, isGood);
+    });
+
+    connect(vesc, &VescInterface::messageDialog, this, [this, id]
+            (const QString &title, const QString &msg, bool isGood, bool richText) {
+        (void)richText;
+        emit sessionStatus(id, title + ": " + msg, isGood);
+    });
+
+    emit sessionAdded(id);
+    return id;
+}
+
+int VescSessionManager::addSerialSession(QString port, int baudrate)
+{
+    int id = addSession();
+    mSessions[id].name = port;
+
+    if (!mSessions[id].vesc->connectSerial(port, baudrate)) {
+        qWarning() << "Could not open" << port;
+    }
+
+    return id;
+}
+
+int VescSessionManager::addTcpSession(QString server, int port)
+{
+    int id = addSession();
+    mSessions[id].name = QString("%1:%2").arg(server).arg(port);
+    mSessions[id].vesc->connectTcp(server, port);
+    return id;
+}
+
+void VescSessionManager::removeSession(int id)
+{
+    if (!mSessions.contains(id)) {
+        return;
+    }
+
+    Session s = mSessions.take(id);
+    s.vesc->commands()->cancelRequests();
+    s.vesc->disconnectPort();
+    s.vesc->deleteLater();
+
+    emit sessionRemoved(id);
+}
+
+void VescSessionManager::removeAllSessions()
+{
+    for (auto id: sessionIds()) {
+        removeSession(id);
+    }
+}
+
+QVector<int> VescSessionManager::sessionIds() const
+{
+    auto ids = mSessions.keys().toVector();
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+int VescSessionManager::sessionNum() const
+{
+    return mSessions.size();
+}
+
+VescInterface *VescSessionManager::session(int id) const
+{
+    if (mSessions.contains(id)) {
+        return mSessions.value(id).vesc;
+    }
+
+    return nullptr;
+}
+
+QString VescSessionManager::sessionName(int id) const
+{
+    return mSessions.value(id).name;
+}
+
+/**
+ * @brief VescSessionManager::setMaxParallel
+ * Limit how many sessions runOnAll keeps busy at the same time.
+ */
+void VescSessionManager::setMaxParallel(int num)
+{
+    mMaxParallel = qMax(1, num);
+}
+
+int VescSessionManager::maxParallel() const
+{
+    return mMaxParallel;
+}
+
+/**
+ * @brief VescSessionManager::threadPool
+ * The pool that the sessions share for work that would block the thread
+ * they live on.
+ */
+QThreadPool *VescSessionManager::threadPool()
+{
+    return &mPool;
+}
+
+/**
+ * @brief VescSessionManager::runOnAll
+ * Start op on each of the given sessions, with at most maxParallel() of them
+ * running at a time. The op calls done with its result when it is finished,
+ * and must not block. Waits with an event loop until all of them are done.
+ *
+ * @param op
+ * The operation.
+ *
+ * @param ids
+ * The sessions to run op on, all sessions if empty.
+ *
+ * @return
+ * The result of every session.
+ */
+QHash<int, QVariant> VescSessionManager::runOnAll(SessionOp op, QVector<int> ids)
+{
+    if (ids.isEmpty()) {
+        ids = sessionIds();
+    }
+
+    QVector<int> todo;
+    for (auto id: ids) {
+        if (mSessions.contains(id)) {
+            todo.append(id);
+        }
+    }
+
+    QHash<int, QVariant> res;
+    if (todo.isEmpty()) {
+        return res;
+    }
+
+    // The state is shared with the callbacks, which can outlive this call
+    // if an op reports done more than once or after a session was removed.
+    struct RunState {
+        QEventLoop loop;
+        int next = 0;
+        int running = 0;
+        int done = 0;
+        bool finished = false;
+    };
+    auto state = std::make_shared<RunState>();
+    int total = todo.size();
+
+    std::function<void()> startNext;
+    startNext = [&]() {
+        while (state->running < mMaxParallel && state->next < total) {
+            int id = todo.at(state->next++);
+            state->running++;
+
+            auto reported = std::make_shared<bool>(false);
+            op(mSessions.value(id).vesc, [&, state, id, reported](const QVariant &r) {
+                if (*reported || state->finished) {
+                    return;
+                }
+
+                *reported = true;
+                res.insert(id, r);
+                state->running--;
+                state->done++;
+                emit fleetProgress(state->done, total);
+
+                if (state->done == total) {
+                    state->loop.quit();
+                } else {
+                    startNext();
+                }
+            });
+        }
+    };
+
+    startNext();
+    if (state->done < total) {
+        state->loop.exec();
+    }
+    state->finished = true;
+
+    return res;
+}
+
+QVariant VescSessionManager::runOn(int id, SessionOp op)
+{
+    QVector<int> ids;
+    ids.append(id);
+    return runOnAll(op, ids).value(id);
+}
+
+QVector<int> VescSessionManager::connectAll(int timeoutMs)
+{
+    return failedIds(runOnAll([timeoutMs](VescInterface *vesc, OpDone done) {
+        if (!vesc->isPortConnected() && !vesc->reconnectLastPort()) {
+            done(false);
+            return;
+        }
+
+        if (vesc->fwRx()) {
+            done(true);
+            return;
+        }
+
+        vesc->commands()->getFwVersionAsync(timeoutMs)->then([done](CommandRequest *r) {
+            done(r->isOk());
+        });
+    }));
+}
+
+void VescSessionManager::disconnectAll()
+{
+    for (const auto &s: mSessions) {
+        s.vesc->disconnectPort();
+    }
+}
+
+QVector<int> VescSessionManager::readMcConfAll(int timeoutMs)
+{
+    return failedIds(runOnAll([timeoutMs](VescInterface *vesc, OpDone done) {
+        vesc->commands()->getMcconfAsync(timeoutMs)->then([done](CommandRequest *r) {
+            done(r->isOk());
+        });
+    }));
+}
+
+QVector<int> VescSessionManager::readAppConfAll(int timeoutMs)
+{
+    return failedIds(runOnAll([timeoutMs](VescInterface *vesc, OpDone done) {
+        vesc->commands()->getAppConfAsync(timeoutMs)->then([done](CommandRequest *r) {
+            done(r->isOk());
+        });
+    }));
+}
+
+/**
+ * @brief VescSessionManager::writeMcConfXmlAll
+ * Read the motor configuration of every session, apply the XML file on top
+ * of it and write it back. A session only succeeds when its own
+ * COMM_SET_MCCONF reply arrives.
+ */
+QVector<int> VescSessionManager::writeMcConfXmlAll(QString path, int timeoutMs)
+{
+    return failedIds(runOnAll([path, timeoutMs](VescInterface *vesc, OpDone done) {
+        Commands *c = vesc->commands();
+        c->getMcconfAsync(timeoutMs)->then([vesc, c, path, timeoutMs, done](CommandRequest *r) {
+            if (!r->isOk() || !vesc->mcConfig()->loadXml(path, "MCConfiguration")) {
+                done(false);
+                return;
+            }
+
+            c->request(COMM_SET_MCCONF, [c]() { c->setMcconf(false); },
+                       nullptr, timeoutMs)->then([done](CommandRequest *r) {
+                done(r->isOk());
+            });
+        });
+    }));
+}
+
+QVector<int> VescSessionManager::writeAppConfXmlAll(QString path, int timeoutMs)
+{
+    return failedIds(runOnAll([path, timeoutMs](VescInterface *vesc, OpDone done) {
+        Commands *c = vesc->commands();
+        c->getAppConfAsync(timeoutMs)->then([vesc, c, path, timeoutMs, done](CommandRequest *r) {
+            if (!r->isOk() || !vesc->appConfig()->loadXml(path, "APPConfiguration")) {
+                done(false);
+                return;
+            }
+
+            c->request(COMM_SET_APPCONF, [c]() { c->setAppConf(); },
+                       nullptr, timeoutMs)->then([done](CommandRequest *r) {
+                done(r->isOk());
+            });
+        });
+    }));
+}
+
+/**
+ * @brief VescSessionManager::fwUploadAll
+ * Upload the same firmware to all sessions at the same time. Images that are
+ * too large for the bootloader are compressed with heatshrink, on the shared
+ * thread pool while the sessions erase their buffers. The chunks are then
+ * written with up to window of them in flight on each link. The header with
+ * the size and CRC is written last, so a session that fails half way does not
+ * have a valid image in its buffer. CAN-forwarding, bootloaders, LZO and
+ * patches are not supported here, use VescInterface::fwUpload for those.
+ *
+ * @param newFirmware
+ * The firmware image.
+ *
+ * @param hw
+ * Only upload to sessions with this hardware name. Other sessions fail. An
+ * empty string uploads to all sessions.
+ *
+ * @param window
+ * How many chunks to keep in flight on each link.
+ *
+ * @return
+ * The sessions that failed.
+ */
+QVector<int> VescSessionManager::fwUploadAll(QByteArray newFirmware, QString hw, int window)
+{
+    const int hsMaxSize = 393208;
+    const int chunkSize = 384;
+    int szTot = newFirmware.size();
+
+    if (szTot == 0 || szTot > 5000000) {
+        qWarning() << "Invalid firmware size" << szTot;
+        return sessionIds();
+    }
+
+    // The image is compressed while the sessions erase
+    class EncodeJob : public QRunnable {
+    public:
+        EncodeJob(QByteArray in, QByteArray *out, QAtomicInt *done, QEventLoop *loop) :
+            mIn(in), mOut(out), mDone(done), mLoop(loop) {}
+
+        void run() override {
+            HeatshrinkIf hs;
+            *mOut = hs.encode(mIn);
+            mDone->storeRelease(1);
+            QMetaObject::invokeMethod(mLoop, "quit", Qt::QueuedConnection);
+        }
+
+    private:
+        QByteArray mIn;
+        QByteArray *mOut;
+        QAtomicInt *mDone;
+        QEventLoop *mLoop;
+    };
+
+    bool useHs = szTot > hsMaxSize && szTot < 700000;
+    QByteArray image = newFirmware;
+    QAtomicInt encDone(useHs ? 0 : 1);
+    QEventLoop encLoop;
+
+    if (useHs) {
+        mPool.start(new EncodeJob(newFirmware, &image, &encDone, &encLoop));
+    }
+
+    QHash<int, QVariant> erased = runOnAll([hw, szTot](VescInterface *vesc, OpDone done) {
+        auto fwParams = vesc->getLastFwRxParams();
+        if (!vesc->isPortConnected() || (!hw.isEmpty() && fwParams.hw != hw)) {
+            done(false);
+            return;
+        }
+
+        vesc->commands()->eraseNewAppAsync(quint32(szTot), fwParams.hwType, fwParams.hw)->
+                then([done](CommandRequest *r) {
+            done(r->isOk() && !r->reply().isEmpty() && r->reply().at(0) != 0);
+        });
+    });
+
+    if (!encDone.loadAcquire()) {
+        encLoop.exec();
+    }
+
+    QVector<int> failed = failedIds(erased);
+
+    if (useHs && image.size() > hsMaxSize) {
+        qWarning() << "Firmware too big for the bootloader even after compression";
+        return sessionIds();
+    }
+
+    VByteArray header;
+    quint32 szField = quint32(image.size());
+    if (useHs) {
+        szField |= quint32(0xCC) << 24;
+    }
+    header.vbAppendUint32(szField);
+    header.vbAppendUint16(Packet::crc16((const unsigned char*)image.constData(),
+                                        uint32_t(image.size())));
+
+    QVector<int> ids;
+    for (auto id: erased.keys()) {
+        if (!failed.contains(id)) {
+            ids.append(id);
+        }
+    }
+
+    if (ids.isEmpty()) {
+        return failed;
+    }
+
+    window = qMax(1, window);
+
+    auto written = runOnAll([image, header, window, chunkSize](VescInterface *vesc, OpDone done) {
+        Commands *c = vesc->commands();
+        auto fwParams = vesc->getLastFwRxParams();
+
+        struct WriteState {
+            int sent = 0;
+            int inFlight = 0;
+            bool ok = true;
+            bool headerSent = false;
+        };
+        auto state = std::make_shared<WriteState>();
+        auto fill = std::make_shared<std::function<void()> >();
+
+        auto finished = [c, fwParams, state, done, fill]() {
+            if (state->ok) {
+                c->jumpToBootloader(false, fwParams.hwType, fwParams.hw);
+            }
+            done(state->ok);
+
+            // fill and the reply handler refer to each other, release them
+            // when nothing is running them anymore.
+            QTimer::singleShot(0, c, [fill]() { *fill = nullptr; });
+        };
+
+        auto onReply = [state, fill, finished](CommandRequest *r) {
+            state->inFlight--;
+
+            if (!r->isOk() || r->reply().isEmpty() || r->reply().at(0) == 0) {
+                state->ok = false;
+            }
+
+            if (state->ok) {
+                (*fill)();
+            } else if (state->inFlight == 0) {
+                finished();
+            }
+        };
+
+        *fill = [c, fwParams, image, header, window, chunkSize, state, onReply, finished]() {
+            while (state->ok && state->inFlight < window && state->sent < image.size()) {
+                int sz = qMin(chunkSize, image.size() - state->sent);
+                QByteArray chunk = image.mid(state->sent, sz);
+                quint32 offset = quint32(state->sent + header.size());
+                state->sent += sz;
+
+                // The buffer is erased, so chunks with only 0xFF are skipped
+                if (chunk.count(char(0xFF)) == chunk.size()) {
+                    continue;
+                }
+
+                state->inFlight++;
+                c->writeNewAppDataAsync(chunk, offset, fwParams.hwType, fwParams.hw)->then(onReply);
+            }
+
+            if (state->inFlight > 0 || !state->ok) {
+                return;
+            }
+
+            if (!state->headerSent) {
+                state->headerSent = true;
+                state->inFlight++;
+                c->writeNewAppDataAsync(header, 0, fwParams.hwType, fwParams.hw)->then(onReply);
+            } else {
+                finished();
+            }
+        };
+
+        (*fill)();
+    }, ids);
+
+    failed.append(failedIds(written));
+    std::sort(failed.begin(), failed.end());
+    return failed;
+}
+
+/**
+ * @brief VescSessionManager::captureTelemetryAll
+ * Poll the values of all sessions at rateHz for durationMs. A new poll is
+ * only sent on a session when the previous one has been answered, so slow
+ * links are not flooded.
+ */
+QHash<int, QVector<MC_VALUES> > VescSessionManager::captureTelemetryAll(int durationMs, int rateHz, unsigned int mask)
+{
+    QHash<int, QVector<MC_VALUES> > ret;
+    QList<QMetaObject::Connection> conns;
+
+    // When the last poll of each session was sent, -1 when it was answered
+    QHash<int, qint64> pollTime;
+    QElapsedTimer clock;
+    clock.start();
+
+    for (auto id: sessionIds()) {
+        ret.insert(id, QVector<MC_VALUES>());
+        ret[id].reserve(durationMs * rateHz / 1000 + 1);
+        pollTime.insert(id, -1);
+
+        conns.append(connect(mSessions.value(id).vesc->commands(), &Commands::valuesReceived,
+                             this, [&ret, &pollTime, id](MC_VALUES values, unsigned int mask) {
+            (void)mask;
+            ret[id].append(values);
+            pollTime[id] = -1;
+        }));
+    }
+
+    QEventLoop loop;
+    QTimer pollTimer;
+    pollTimer.setInterval(qMax(1, 1000 / qMax(1, rateHz)));
+    connect(&pollTimer, &QTimer::timeout, [this, &pollTime, &clock, mask]() {
+        for (auto it = pollTime.begin();it != pollTime.end();++it) {
+            // Poll again after a second if the reply was lost
+            if (it.value() < 0 || (clock.elapsed() - it.value()) > 1000) {
+                it.value() = clock.elapsed();
+                mSessions.value(it.key()).vesc->commands()->getValuesSelective(mask);
+            }
+        }
+    });
+    pollTimer.start();
+
+    QTimer::singleShot(durationMs, &loop, SLOT(quit()));
+    loop.exec();
+
+    pollTimer.stop();
+    for (const auto &c: conns) {
+        disconnect(c);
+    }
+
+    return ret;
+}
+
+QVector<int> VescSessionManager::failedIds(const QHash<int, QVariant> &res)
+{
+    QVector<int> failed;
+    for (auto it = res.begin();it != res.end();++it) {
+        if (!it.value().toBool()) {
+            failed.append(it.key());
+        }
+    }
+    std::sort(failed.begin(), failed.end());
+    return failed;
+}
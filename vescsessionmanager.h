@@ -0,0 +1,102 @@
+/*
+    Copyright 2026 Benjamin Vedder	benjamin@vedder.se
+
+    This file is part of VESC Tool.
+
+    VESC Tool is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    VESC Tool is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef VESCSESSIONMANAGER_H
+#define VESCSESSIONMANAGER_H
+
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include <QVariant>
+#include <QEventLoop>
+#include <QThreadPool>
+#include <functional>
+
+#include "vescinterface.h"
+
+/*
+ * Holds many independent VescInterface sessions, each with its own transport,
+ * Packet, Commands and configuration cache. All sessions live on the calling
+ * thread and fleet operations are built from the asynchronous requests in
+ * Commands, so every link is busy at the same time without a thread per
+ * session. Replies are matched by the request of the session they came
+ * from, so an ack on one link is never taken for another. Work that is
+ * heavy on the CPU, such as compressing a firmware image, runs on a thread
+ * pool that is shared by all sessions.
+ */
+class VescSessionManager : public QObject
+{
+    Q_OBJECT
+public:
+    typedef std::function<void(const QVariant &res)> OpDone;
+    typedef std::function<void(VescInterface *vesc, OpDone done)> SessionOp;
+
+    explicit VescSessionManager(QObject *parent = nullptr);
+    ~VescSessionManager();
+
+    int addSession();
+    int addSerialSession(QString port, int baudrate = 115200);
+    int addTcpSession(QString server, int port);
+    void removeSession(int id);
+    void removeAllSessions();
+    QVector<int> sessionIds() const;
+    int sessionNum() const;
+    VescInterface *session(int id) const;
+    QString sessionName(int id) const;
+
+    void setMaxParallel(int num);
+    int maxParallel() const;
+    QThreadPool *threadPool();
+
+    QHash<int, QVariant> runOnAll(SessionOp op, QVector<int> ids = QVector<int>());
+    QVariant runOn(int id, SessionOp op);
+
+    // Fleet operations. They return the ids of the sessions that failed.
+    QVector<int> connectAll(int timeoutMs = 4000);
+    void disconnectAll();
+    QVector<int> readMcConfAll(int timeoutMs = 4000);
+    QVector<int> readAppConfAll(int timeoutMs = 4000);
+    QVector<int> writeMcConfXmlAll(QString path, int timeoutMs = 4000);
+    QVector<int> writeAppConfXmlAll(QString path, int timeoutMs = 4000);
+    QVector<int> fwUploadAll(QByteArray newFirmware, QString hw = "", int window = 4);
+    QHash<int, QVector<MC_VALUES> > captureTelemetryAll(int durationMs, int rateHz,
+                                                        unsigned int mask = 0xFFFFFFFF);
+
+signals:
+    void sessionAdded(int id);
+    void sessionRemoved(int id);
+    void fleetProgress(int done, int total);
+    void sessionStatus(int id, const QString &msg, bool isGood);
+
+private:
+    struct Session {
+        VescInterface *vesc;
+        QString name;
+    };
+
+    QHash<int, Session> mSessions;
+    int mNextId;
+    int mMaxParallel;
+    QThreadPool mPool;
+
+    static QVector<int> failedIds(const QHash<int, QVariant> &res);
+
+};
+
+#endif // VESCSESSIONMANAGER_H